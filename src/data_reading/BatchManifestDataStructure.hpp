@@ -0,0 +1,177 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef BATCHMANIFESTDATASTRUCTURE_HPP_
+#define BATCHMANIFESTDATASTRUCTURE_HPP_
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "AbstractDataStructure.hpp"
+
+/**
+ * Helper class to read in a manifest of compounds for a batch run.
+ *
+ * Each line gives a name for the compound (used for its output folder)
+ * followed by the drug arguments for that compound, in the same form as on the
+ * command line, e.g.
+ *
+ * compound_A --pic50-herg 5.2 5.4 --hill-herg 0.9 1.1
+ * compound_B --ic50-na 30 --ic50-cal 12
+ *
+ * All these arguments take numbers, which are stored against the option name.
+ * Concentrations can also be given for each compound, e.g. --plasma-concs 1 10 100
+ */
+class BatchManifestDataStructure : public AbstractDataStructure
+{
+private:
+    /** The compound names, in the order they appear in the file. */
+    std::vector<std::string> mNames;
+
+    /** For each compound, the values given for each option. */
+    std::vector<std::map<std::string, std::vector<double> > > mArguments;
+
+protected:
+    virtual void LoadALine(std::stringstream& rLine)
+    {
+        std::string name;
+        rLine >> name;
+        if (name.empty() || name.substr(0, 2) == "--")
+        {
+            EXCEPTION("Each line of a batch file should start with a compound name, not '" << name << "'.");
+        }
+        if (std::find(mNames.begin(), mNames.end(), name) != mNames.end())
+        {
+            EXCEPTION("Compound '" << name << "' appears more than once in the batch file.");
+        }
+
+        std::map<std::string, std::vector<double> > arguments;
+        std::string option;
+        std::string entry;
+        while (rLine >> entry)
+        {
+            if (entry.substr(0, 2) == "--")
+            {
+                option = entry;
+                if (arguments.count(option) > 0u)
+                {
+                    EXCEPTION("Option " << option << " is given more than once for compound '" << name << "'.");
+                }
+                arguments[option] = std::vector<double>();
+                continue;
+            }
+            if (option.empty())
+            {
+                EXCEPTION("Expected an option (like --pic50-herg) after compound '" << name << "', not '" << entry << "'.");
+            }
+            std::stringstream value_stream(entry);
+            double value;
+            value_stream >> value;
+            if (value_stream.fail() || !value_stream.eof())
+            {
+                EXCEPTION("Could not read '" << entry << "' as a number for option " << option << " of compound '" << name << "'.");
+            }
+            arguments[option].push_back(value);
+        }
+
+        mNames.push_back(name);
+        mArguments.push_back(arguments);
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param rFileFinder  The manifest file.
+     */
+    BatchManifestDataStructure(const FileFinder& rFileFinder)
+            : AbstractDataStructure()
+    {
+        LoadDataFromFile(rFileFinder.GetAbsolutePath());
+    };
+
+    /**
+     * @return The number of compounds in the manifest.
+     */
+    unsigned GetNumCompounds() const
+    {
+        return mNames.size();
+    }
+
+    /**
+     * @param compoundIndex  The index of a compound.
+     * @return The name of that compound.
+     */
+    const std::string& rGetName(unsigned compoundIndex) const
+    {
+        return mNames.at(compoundIndex);
+    }
+
+    /**
+     * @param compoundIndex  The index of a compound.
+     * @return The values given for each option for this compound.
+     */
+    const std::map<std::string, std::vector<double> >& rGetArguments(unsigned compoundIndex) const
+    {
+        return mArguments.at(compoundIndex);
+    }
+
+    /**
+     * Check that every option given in the manifest is one we know about.
+     *
+     * @param rAllowedOptions  The options that can be given for each compound.
+     */
+    void CheckOptions(const std::set<std::string>& rAllowedOptions) const
+    {
+        for (unsigned i = 0; i < mNames.size(); i++)
+        {
+            for (const auto& r_argument : mArguments[i])
+            {
+                if (rAllowedOptions.count(r_argument.first) == 0u)
+                {
+                    EXCEPTION("Option " << r_argument.first << " (for compound '" << mNames[i] << "') can't be used in a batch file, only drug and concentration arguments can be given for each compound.");
+                }
+                if (r_argument.second.empty())
+                {
+                    EXCEPTION("Option " << r_argument.first << " (for compound '" << mNames[i] << "') needs at least one value.");
+                }
+            }
+        }
+    }
+};
+
+#endif // BATCHMANIFESTDATASTRUCTURE_HPP_
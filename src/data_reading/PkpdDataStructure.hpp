@@ -36,6 +36,11 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef PKPDDATASTRUCTURE_HPP_
 #define PKPDDATASTRUCTURE_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <boost/shared_ptr.hpp>
+
 #include "AbstractDataStructure.hpp"
 
 /**
@@ -65,6 +70,24 @@ private:
      */
     std::vector<std::vector<double> > mClinicalDoses;
 
+    /** Whether to keep the concentrations in #mClinicalDoses, or just note their maximum. */
+    bool mKeepConcentrations;
+
+    /**
+     * If the concentrations aren't kept in memory, they are written here in binary as they are read,
+     * one row of #mNumPatients doubles per time, so the file never needs to be parsed again.
+     */
+    boost::shared_ptr<FILE> mpSpilledConcentrations;
+
+    /** Throw if the concentrations weren't kept. */
+    void CheckConcentrationsWereKept()
+    {
+        if (!mKeepConcentrations)
+        {
+            EXCEPTION("The concentrations in the PKPD file were not kept, see PkpdDataStructure constructor.");
+        }
+    }
+
 protected:
     virtual void LoadALine(std::stringstream& rLine)
     {
@@ -93,23 +116,83 @@ protected:
         }
 
         mTimes.push_back(time);
-        mClinicalDoses.push_back(concs_at_this_time);
+        if (mKeepConcentrations)
+        {
+            mClinicalDoses.push_back(concs_at_this_time);
+        }
+        else if (fwrite(concs_at_this_time.data(), sizeof(double), concs_at_this_time.size(), mpSpilledConcentrations.get())
+                 != concs_at_this_time.size())
+        {
+            EXCEPTION("Couldn't write the PKPD concentrations at time " << time << " to a temporary file.");
+        }
     }
 
 public:
-    PkpdDataStructure(FileFinder& rFileFinder)
+    /**
+     * Constructor, reads in the file.
+     *
+     * @param rFileFinder  The PKPD file.
+     * @param keepConcentrations  Whether to keep all the concentrations in memory (defaults to true).
+     *     If not, they are put in a temporary file, and can only be got back in blocks of times with
+     *     GetConcentrationsAtTimeIndices() (e.g. by a PkpdInterpolator).
+     */
+    PkpdDataStructure(FileFinder& rFileFinder, bool keepConcentrations = true)
             : AbstractDataStructure(),
               mMaxConc(-DBL_MAX),
-              mNumPatients(UNSIGNED_UNSET)
+              mNumPatients(UNSIGNED_UNSET),
+              mKeepConcentrations(keepConcentrations)
     {
+        if (!mKeepConcentrations)
+        {
+            FILE* p_file = std::tmpfile();
+            if (p_file == NULL)
+            {
+                EXCEPTION("Couldn't open a temporary file for the PKPD concentrations.");
+            }
+            mpSpilledConcentrations.reset(p_file, fclose);
+        }
         LoadDataFromFile(rFileFinder.GetAbsolutePath());
     };
 
     std::vector<double>& GetConcentrationsAtTimeIndex(unsigned index)
     {
+        CheckConcentrationsWereKept();
         return mClinicalDoses[index];
     }
 
+    /**
+     * Get the concentrations at a block of times, whether or not they were kept in memory.
+     *
+     * @param firstIndex  The first time index.
+     * @param numIndices  How many times to get (fewer are given if the file ends first).
+     * @param rConcs  Filled in with the concentrations of every patient at the first time, then the next, and so on.
+     * @return The number of times whose concentrations were got.
+     */
+    unsigned GetConcentrationsAtTimeIndices(unsigned firstIndex, unsigned numIndices, std::vector<double>& rConcs)
+    {
+        numIndices = firstIndex < mTimes.size() ? std::min(numIndices, (unsigned)(mTimes.size()) - firstIndex) : 0u;
+        const unsigned num_patients = mTimes.empty() ? 0u : mNumPatients;
+        rConcs.resize((size_t)(numIndices) * num_patients);
+        if (mKeepConcentrations)
+        {
+            for (unsigned t = 0; t < numIndices; t++)
+            {
+                std::copy(mClinicalDoses[firstIndex + t].begin(), mClinicalDoses[firstIndex + t].end(),
+                          rConcs.begin() + (size_t)(t) * num_patients);
+            }
+        }
+        else if (!rConcs.empty())
+        {
+            FILE* p_file = mpSpilledConcentrations.get();
+            if (fseek(p_file, (long)((size_t)(firstIndex) * num_patients * sizeof(double)), SEEK_SET) != 0
+                || fread(rConcs.data(), sizeof(double), rConcs.size(), p_file) != rConcs.size())
+            {
+                EXCEPTION("Couldn't read the PKPD concentrations back from a temporary file.");
+            }
+        }
+        return numIndices;
+    }
+
     double GetMaximumConcentration()
     {
         return mMaxConc;
@@ -122,6 +205,7 @@ public:
             EXCEPTION("Patient index " << patientIndex << " requested but there are only " << mNumPatients << " in the data file.");
         }
 
+        CheckConcentrationsWereKept();
         std::vector<double> conc_through_time_this_patient(mTimes.size());
 
         for (unsigned t = 0; t < mTimes.size(); t++)
@@ -132,6 +216,52 @@ public:
         return conc_through_time_this_patient;
     }
 
+    /**
+     * Choose concentrations that follow the distribution of concentrations in the file,
+     * so that more of them are placed where patients spend more of their time.
+     *
+     * @param numConcentrations  How many concentrations to choose (at least two).
+     * @return Increasing concentrations at evenly spaced quantiles of all the non-zero
+     * concentrations in the file, from the lowest to the highest (any repeats are only
+     * given once, so there can be fewer than asked for).
+     */
+    std::vector<double> GetConcentrationQuantiles(unsigned numConcentrations)
+    {
+        if (numConcentrations < 2u)
+        {
+            EXCEPTION("At least two concentrations are needed to cover the PKPD concentrations, not " << numConcentrations << ".");
+        }
+
+        CheckConcentrationsWereKept();
+        std::vector<double> all_concs;
+        for (unsigned t = 0; t < mClinicalDoses.size(); t++)
+        {
+            for (unsigned p = 0; p < mClinicalDoses[t].size(); p++)
+            {
+                if (mClinicalDoses[t][p] > 0.0)
+                {
+                    all_concs.push_back(mClinicalDoses[t][p]);
+                }
+            }
+        }
+        if (all_concs.empty())
+        {
+            EXCEPTION("There are no non-zero concentrations in the PKPD file.");
+        }
+        std::sort(all_concs.begin(), all_concs.end());
+
+        std::vector<double> quantiles;
+        for (unsigned i = 0; i < numConcentrations; i++)
+        {
+            const unsigned index = (unsigned)(std::round((double)(i) * (double)(all_concs.size() - 1u) / (double)(numConcentrations - 1u)));
+            if (quantiles.empty() || all_concs[index] > quantiles.back())
+            {
+                quantiles.push_back(all_concs[index]);
+            }
+        }
+        return quantiles;
+    }
+
     unsigned GetNumberOfPatients()
     {
         return mNumPatients;
@@ -0,0 +1,146 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+
+#include "Exception.hpp"
+#include "PkpdDataStructure.hpp"
+#include "PkpdInterpolator.hpp"
+#include "WorkerPool.hpp"
+
+PkpdInterpolator::PkpdInterpolator(const std::vector<double>& rConcs, const std::vector<double>& rValues)
+        : mConcs(rConcs),
+          mValues(rValues),
+          mNumConcs(rConcs.size()),
+          mFirstSearchStep(0u)
+{
+    if (rConcs.empty() || rConcs.size() != rValues.size())
+    {
+        EXCEPTION("Need the same (non-zero) number of concentrations and values to interpolate, not "
+                  << rConcs.size() << " and " << rValues.size() << ".");
+    }
+
+    // Pad to a power of two, so the binary search below takes a fixed number of steps.
+    unsigned padded_size = 1u;
+    while (padded_size < mNumConcs)
+    {
+        padded_size *= 2u;
+    }
+    mConcs.resize(padded_size, DBL_MAX);
+    mFirstSearchStep = padded_size / 2u;
+}
+
+double PkpdInterpolator::Interpolate(double conc) const
+{
+    if (conc <= mConcs[0])
+    {
+        return mValues[0];
+    }
+    if (conc >= mConcs[mNumConcs - 1u])
+    {
+        return mValues[mNumConcs - 1u];
+    }
+
+    // Find the last concentration below conc (without branches, so the compiler can use conditional moves).
+    unsigned lower_idx = 0u;
+    for (unsigned step = mFirstSearchStep; step > 0u; step /= 2u)
+    {
+        lower_idx = (mConcs[lower_idx + step] < conc) ? lower_idx + step : lower_idx;
+    }
+
+    // The same sums as ApPredictMethods::DoLinearInterpolation(), so we get identical answers.
+    const double lower_x = mConcs[lower_idx];
+    const double upper_x = mConcs[lower_idx + 1u];
+    const double lower_y = mValues[lower_idx];
+    const double upper_y = mValues[lower_idx + 1u];
+
+    return lower_y + ((conc - lower_x) / (upper_x - lower_x)) * (upper_y - lower_y);
+}
+
+void PkpdInterpolator::Interpolate(const double* pConcs, unsigned numConcs, double* pResults) const
+{
+    for (unsigned i = 0; i < numConcs; i++)
+    {
+        pResults[i] = Interpolate(pConcs[i]);
+    }
+}
+
+unsigned PkpdInterpolator::InterpolatePkpdData(PkpdDataStructure& rData,
+                                               std::ostream& rOutput,
+                                               unsigned numThreads,
+                                               unsigned numRowsPerBlock) const
+{
+    const std::vector<std::string> times = rData.GetTimes();
+    const unsigned num_patients = times.empty() ? 0u : rData.GetNumberOfPatients();
+
+    WorkerPool pool(numThreads);
+    std::vector<double> concs;
+    std::vector<std::string> rows;
+    unsigned num_rows_written = 0u;
+
+    while (num_rows_written < times.size())
+    {
+        const unsigned num_rows = rData.GetConcentrationsAtTimeIndices(num_rows_written, std::max(1u, numRowsPerBlock), concs);
+
+        // Interpolate and format each row of the block on the workers
+        rows.assign(num_rows, std::string());
+        pool.Run(num_rows, [&](unsigned row, unsigned /*worker*/) {
+            std::vector<double> results(num_patients);
+            Interpolate(concs.data() + (size_t)(row) * num_patients, num_patients, results.data());
+
+            std::string& r_output = rows[row];
+            r_output = times[num_rows_written + row];
+            char buffer[32];
+            for (double result : results)
+            {
+                // %g is how an ostream writes doubles by default.
+                snprintf(buffer, sizeof(buffer), "\t%g", result);
+                r_output += buffer;
+            }
+        });
+
+        for (unsigned row = 0; row < num_rows; row++)
+        {
+            rOutput << rows[row] << "\n";
+        }
+        num_rows_written += num_rows;
+    }
+    rOutput << std::flush;
+
+    return num_rows_written;
+}
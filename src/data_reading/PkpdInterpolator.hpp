@@ -0,0 +1,113 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef PKPDINTERPOLATOR_HPP_
+#define PKPDINTERPOLATOR_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+class PkpdDataStructure;
+
+/**
+ * Interpolates a quantity (e.g. APD90) that has been simulated at a set of concentrations
+ * onto every concentration in a PKPD file.
+ *
+ * The data are streamed through in blocks of rows, which are interpolated on a pool of
+ * threads and written out in order, so that virtual population files with many thousands
+ * of patients never have to be held in memory.
+ *
+ * Interpolation is linear, and held constant beyond the simulated concentrations, giving
+ * the same answers as ApPredictMethods::DoLinearInterpolation().
+ */
+class PkpdInterpolator
+{
+private:
+    /** The simulated concentrations, padded to a power of two with DBL_MAX. */
+    std::vector<double> mConcs;
+
+    /** The quantity at each of the simulated concentrations. */
+    std::vector<double> mValues;
+
+    /** The number of simulated concentrations. */
+    unsigned mNumConcs;
+
+    /** The first step of the binary search (half the padded size of #mConcs). */
+    unsigned mFirstSearchStep;
+
+public:
+    /**
+     * Constructor
+     *
+     * @param rConcs  The simulated concentrations, in increasing order.
+     * @param rValues  The quantity at each of these concentrations.
+     */
+    PkpdInterpolator(const std::vector<double>& rConcs, const std::vector<double>& rValues);
+
+    /**
+     * @param conc  A concentration.
+     * @return The quantity interpolated to this concentration.
+     */
+    double Interpolate(double conc) const;
+
+    /**
+     * Interpolate the quantity to many concentrations (e.g. every patient at one time).
+     *
+     * @param pConcs  The concentrations.
+     * @param numConcs  How many there are.
+     * @param pResults  Filled in with the quantity at each concentration.
+     */
+    void Interpolate(const double* pConcs, unsigned numConcs, double* pResults) const;
+
+    /**
+     * Write out each time in some PKPD data followed by the interpolated quantity for each
+     * patient, tab separated, one row per time. No header is written.
+     *
+     * @param rData  The PKPD data, which needn't have kept its concentrations in memory.
+     * @param rOutput  Where to write the interpolated values.
+     * @param numThreads  The number of threads to interpolate with (see WorkerPool).
+     * @param numRowsPerBlock  How many times to interpolate at once.
+     *
+     * @return The number of rows written.
+     */
+    unsigned InterpolatePkpdData(PkpdDataStructure& rData,
+                                 std::ostream& rOutput,
+                                 unsigned numThreads = 1u,
+                                 unsigned numRowsPerBlock = 256u) const;
+};
+
+#endif // PKPDINTERPOLATOR_HPP_
@@ -40,6 +40,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "OutputFileHandler.hpp"
 #include "CommandLineArguments.hpp"
 #include "Exception.hpp"
+#include "PetscTools.hpp"
 
 ActionPotentialDownsampler::ActionPotentialDownsampler(const std::string& rFoldername,
                                                        const std::string& rFilename,
@@ -50,6 +51,11 @@ ActionPotentialDownsampler::ActionPotentialDownsampler(const std::string& rFolde
                                                        double windowStart)
 {
     OutputFileHandler handler(rFoldername, false); // don't wipe the folder!
+    if (!PetscTools::AmMaster())
+    {
+        // Only the master process writes output.
+        return;
+    }
     out_stream output_file = handler.OpenOutputFile(rFilename);
 
     *output_file << "Time(ms)\tMembrane_Voltage(mV)\n";
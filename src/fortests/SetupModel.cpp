@@ -34,6 +34,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <boost/assign.hpp>
+#include <mutex>
 
 #include "CheckpointArchiveTypes.hpp"
 
@@ -106,8 +107,8 @@ SetupModel::SetupModel(const double& rHertz,
         {
             EXCEPTION("Trying to set up a dynamically loaded model without a working directory in SetupModel constructor.");
         }
-        CellMLLoader loader(cellml_file, *mpHandler, {});
-        mpModel = loader.LoadCvodeCell();
+        mpCellMLLoader.reset(new CellMLLoader(cellml_file, *mpHandler, {}));
+        mpModel = mpCellMLLoader->LoadCvodeCell();
     }
     else
     {
@@ -136,6 +137,7 @@ SetupModel::SetupModel(const double& rHertz,
 
         // set numerical Jacobean if needed
         mpModel->ForceUseOfNumericalJacobian(SetupModel::forceNumericalJModels.find(modelName) != SetupModel::forceNumericalJModels.end());
+        mModelName = modelName;
     }
     // std::cout << "* model = " << mpModel->GetSystemName() << std::endl;
 
@@ -191,6 +193,40 @@ SetupModel::SetupModel(const double& rHertz,
 
     mpModel->SetStimulusFunction(p_regular_stimulus); // Assign the regular stimulus to the cell's stimulus
     mpModel->SetTolerances(1e-8, 1e-8);
+    mInitialStateVariables = mpModel->GetStdVecStateVariables();
+    mpInitialStimulus.reset(new RegularStimulus(s_magnitude, s_duration, s1_period, s_start));
+}
+
+/**
+ * Models are made on several threads at once (see SetupModel::MakeAnotherModel()),
+ * but loading CellML isn't thread safe.
+ */
+static std::mutex CellMLLoaderMutex;
+
+boost::shared_ptr<AbstractCvodeCell> SetupModel::MakeAnotherModel()
+{
+    boost::shared_ptr<AbstractCvodeCell> p_model;
+    if (mpCellMLLoader)
+    {
+        std::lock_guard<std::mutex> lock(CellMLLoaderMutex);
+        p_model = mpCellMLLoader->LoadCvodeCell();
+    }
+    else
+    {
+        boost::shared_ptr<AbstractStimulusFunction> p_stimulus;
+        boost::shared_ptr<AbstractIvpOdeSolver> p_solver;
+        p_model.reset((AbstractCvodeCell*)ModelFactory::Create(mModelName, "AnalyticCvode", p_solver, p_stimulus));
+        p_model->ForceUseOfNumericalJacobian(SetupModel::forceNumericalJModels.find(mModelName) != SetupModel::forceNumericalJModels.end());
+    }
+
+    boost::shared_ptr<RegularStimulus> p_copied_stimulus(new RegularStimulus(mpInitialStimulus->GetMagnitude(),
+                                                                              mpInitialStimulus->GetDuration(),
+                                                                              mpInitialStimulus->GetPeriod(),
+                                                                              mpInitialStimulus->GetStartTime()));
+    p_model->SetStimulusFunction(p_copied_stimulus);
+    p_model->SetTolerances(1e-8, 1e-8);
+    p_model->SetStateVariables(mInitialStateVariables);
+    return p_model;
 }
 
 boost::shared_ptr<AbstractCvodeCell> SetupModel::GetModel()
@@ -39,7 +39,9 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <boost/shared_ptr.hpp>
 
 #include "AbstractCvodeCell.hpp"
+#include "CellMLLoader.hpp"
 #include "OutputFileHandler.hpp"
+#include "RegularStimulus.hpp"
 
 #include "ModelFactory.hpp"
 #include <unordered_set>
@@ -70,6 +72,18 @@ private:
     /** The cell model (in CVODE format) */
     boost::shared_ptr<AbstractCvodeCell> mpModel;
 
+    /** The name of the model in the ModelFactory, if it didn't come from a CellML file. */
+    std::string mModelName;
+
+    /** The loader for the model, if it came from a CellML file. */
+    boost::shared_ptr<CellMLLoader> mpCellMLLoader;
+
+    /** The state variables #mpModel was set up with. */
+    std::vector<double> mInitialStateVariables;
+
+    /** A copy of the stimulus #mpModel was set up with (which may be moved later). */
+    boost::shared_ptr<RegularStimulus> mpInitialStimulus;
+
 public:
     /**
      * This method generates a cell model for one of the models specified by #model_index.
@@ -115,6 +129,15 @@ public:
      * @return a pointer to the model
      */
     boost::shared_ptr<AbstractCvodeCell> GetModel();
+
+    /**
+     * Make another model the same as the one the constructor set up (with the same stimulus,
+     * tolerances and initial state variables), without reading the command line or any
+     * files again, e.g. for use on another thread. This can be called from several threads at once.
+     *
+     * @return a new model.
+     */
+    boost::shared_ptr<AbstractCvodeCell> MakeAnotherModel();
 };
 
 #endif // SETUPMODEL_HPP_
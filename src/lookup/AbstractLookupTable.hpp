@@ -0,0 +1,105 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef ABSTRACTLOOKUPTABLE_HPP_
+#define ABSTRACTLOOKUPTABLE_HPP_
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+/**
+ * The interface for interpolating quantities of interest from a lookup table,
+ * whether it is a LookupTableGenerator (which can also make and refine the table)
+ * or a read-only CompiledLookupTable (for instance one mapped from a file).
+ */
+class AbstractLookupTable
+{
+public:
+    /**
+     * Destructor - default
+     */
+    virtual ~AbstractLookupTable(){};
+
+    /**
+     * Helper method that just returns DIM, to avoid template chaos.
+     */
+    virtual unsigned GetDimension() const = 0;
+
+    /**
+     * @return The names of each parameter in each dimension of this table.
+     */
+    virtual std::vector<std::string> GetParameterNames() const = 0;
+
+    /**
+     * @return The number of quantities of interest in this table.
+     */
+    virtual unsigned GetNumQoIs() const = 0;
+
+    /**
+     * Provide an interpolated estimate for the quantities of interest
+     * throughout parameter space.
+     *
+     * @param rParameterPoints  The points in parameter space at which we
+     * would like to estimate QoIs.
+     * @return The QoI estimates at these points.
+     */
+    virtual std::vector<std::vector<double> > Interpolate(const std::vector<std::vector<double> >& rParameterPoints) const = 0;
+
+    /**
+     * Provide an interpolated estimate for the quantities of interest at a batch of points,
+     * the same as the method above but without allocating anything for each point.
+     *
+     * @param pParameterPoints  The points in parameter space, GetDimension() values for the first point, then the second, etc.
+     * @param numPoints  The number of points.
+     * @param pResults  Filled in with the QoI estimates, GetNumQoIs() for the first point, then the second, etc.
+     */
+    virtual void Interpolate(const double* pParameterPoints, unsigned numPoints, double* pResults) const = 0;
+
+    /**
+     * Make a table of fewer dimensions from the slice of this one where the other parameters
+     * are at the maximum of the table (for ApPredict tables, a scaling of 1.0, i.e. no block).
+     *
+     * The maximum is always a face of the boxes, so the smaller table interpolates exactly
+     * as this one does on the slice, but at the cost of its own dimension.
+     *
+     * @param rDimensionsToKeep  The dimensions of this table to keep, in increasing order.
+     * @return The table of the slice, with the parameter names of the dimensions kept.
+     */
+    virtual boost::shared_ptr<AbstractLookupTable> MakeSlice(const std::vector<unsigned>& rDimensionsToKeep) const = 0;
+};
+
+#endif // ABSTRACTLOOKUPTABLE_HPP_
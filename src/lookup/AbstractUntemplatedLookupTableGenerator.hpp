@@ -42,16 +42,17 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ClassIsAbstract.hpp"
 
 #include "AbstractCvodeCell.hpp"
+#include "AbstractLookupTable.hpp"
 #include "QuantityOfInterest.hpp"
 #include "SingleActionPotentialPrediction.hpp"
 
 /**
  * A class to allow a nice interface for ApPredictMethods to use any dimension
- * Lookup table.
+ * Lookup table generator (interpolating from it is in AbstractLookupTable).
  *
  * No member variables...
  */
-class AbstractUntemplatedLookupTableGenerator
+class AbstractUntemplatedLookupTableGenerator : public AbstractLookupTable
 {
 private:
     /** Needed for serialization. */
@@ -152,6 +153,53 @@ public:
       */
     virtual unsigned GetMaxNumPaces() = 0;
 
+    /**
+     * Set how many threads to evaluate points on.
+     *
+     * @param numThreads  The number of threads, zero (the default) means one per hardware thread.
+     */
+    virtual void SetNumThreads(unsigned numThreads) = 0;
+
+    /**
+     * Set how many boxes to subdivide in each round of refinement.
+     *
+     * @param numBoxes  The number of boxes whose new corners are evaluated in one batch, defaults to one.
+     */
+    virtual void SetNumBoxesToRefineTogether(unsigned numBoxes) = 0;
+
+    /**
+     * Set whether to split boxes only along the dimensions that cause most of their error.
+     *
+     * @param anisotropic  Whether to do this, defaults to false.
+     */
+    virtual void SetAnisotropicRefinement(bool anisotropic) = 0;
+
+    /**
+     * Set whether each worker thread re-uses one model for all of its points.
+     *
+     * @param reuseModels  Whether to do this, defaults to true.
+     */
+    virtual void SetReuseModels(bool reuseModels) = 0;
+
+    /**
+     * Set whether to start each new point from the steady state of the nearest point already evaluated.
+     *
+     * @param continuation  Whether to do this, defaults to false.
+     */
+    virtual void SetContinuation(bool continuation) = 0;
+
+    /**
+     * Keep an append-only journal of evaluations, and read back any that are in it already.
+     *
+     * @param rFileName  The full path of the journal file.
+     */
+    virtual void SetJournalFile(const std::string& rFileName) = 0;
+
+    /**
+     * Empty the journal, once the generator has been archived.
+     */
+    virtual void StartNewJournal() = 0;
+
     /**
       * Add a quantity of interest to create a lookup table for.
       *
@@ -205,15 +253,14 @@ public:
     //    std::vector<c_vector<double, DIM> >& rParameterPoints);
 
     /**
-     * Provide an interpolated estimate for the quantities of interest
-     * throughout
-     * parameter space.
+     * Write the table as a flat file that CompiledLookupTable can map straight into memory,
+     * see LookupTableLoader::LoadCompiledTable().
      *
-     * @param rParameterPoints  The points in parameter space at which we
-     * would like to estimate QoIs.
-     * @return The QoI estimates at these points.
+     * @param rFileName  The full path of the file to write.
+     * @param rArchiveFileName  The full path of the archive this generator was loaded from, if any,
+     *                          so that the file can be told apart from one for an older archive.
      */
-    virtual std::vector<std::vector<double> > Interpolate(const std::vector<std::vector<double> >& rParameterPoints) = 0;
+    virtual void SaveCompiledTable(const std::string& rFileName, const std::string& rArchiveFileName = "") = 0;
 
     /**
      * @return The number of evaluations (points in the lookup table at which
@@ -227,16 +274,6 @@ public:
      * @param frequency  The pacing frequency to use (in Hz).
      */
     virtual void SetPacingFrequency(double frequency) = 0;
-
-    /**
-     * Helper method that just returns DIM, to avoid template chaos.
-     */
-    virtual unsigned GetDimension() const = 0;
-
-    /**
-     * @return The names of each parameter in each dimension of this table.
-     */
-    virtual std::vector<std::string> GetParameterNames() const = 0;
 };
 
 CLASS_IS_ABSTRACT(AbstractUntemplatedLookupTableGenerator)
@@ -0,0 +1,1020 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "CompiledLookupTable.hpp"
+
+/**
+ * @param numBytes  A number of bytes.
+ * @return The number rounded up to a multiple of 8, so that the next array of a table is aligned for doubles.
+ */
+static size_t PadToEightBytes(size_t numBytes)
+{
+    return (numBytes + 7u) / 8u * 8u;
+}
+
+/**
+ * @param rFileName  The full path of a file.
+ * @param rSize  Filled in with its size in bytes.
+ * @param rModified  Filled in with when it was last modified (seconds since the epoch).
+ * @return Whether the file exists.
+ */
+static bool GetFileSizeAndTime(const std::string& rFileName, uint64_t& rSize, int64_t& rModified)
+{
+    struct stat file_status;
+    if (stat(rFileName.c_str(), &file_status) != 0)
+    {
+        return false;
+    }
+    rSize = file_status.st_size;
+    rModified = file_status.st_mtime;
+    return true;
+}
+
+template <unsigned DIM>
+CompiledLookupTable<DIM>::CompiledLookupTable(ParameterBox<DIM>& rOriginalBox,
+                                              const std::vector<std::string>& rParameterNames)
+        : mIsMapped(false),
+          mIndexBits(0u),
+          mIndexScale(1.0),
+          mIndexCellBits(0u)
+{
+    if (rOriginalBox.mpParentBox)
+    {
+        EXCEPTION("A lookup table can only be compiled from the original parameter box.");
+    }
+
+    // Number the boxes breadth-first, so that the daughters of each box are together.
+    std::vector<ParameterBox<DIM>*> boxes(1u, &rOriginalBox);
+    std::vector<unsigned> first_daughters;
+    std::vector<unsigned> num_daughters;
+    std::vector<unsigned> leaf_indices;
+    unsigned num_leaves = 0u;
+    for (unsigned i = 0; i < boxes.size(); i++)
+    {
+        const std::vector<ParameterBox<DIM>*>& r_daughters = boxes[i]->mDaughterBoxes;
+        first_daughters.push_back(boxes.size());
+        num_daughters.push_back(boxes[i]->mAmParent ? r_daughters.size() : 0u);
+        if (boxes[i]->mAmParent)
+        {
+            boxes.insert(boxes.end(), r_daughters.begin(), r_daughters.end());
+            leaf_indices.push_back(UNSIGNED_UNSET);
+        }
+        else
+        {
+            leaf_indices.push_back(num_leaves++);
+        }
+    }
+    const unsigned num_boxes = boxes.size();
+
+    // Number the corners of the leaves in the order they are first used.
+    std::vector<unsigned> corner_ids(rOriginalBox.mCornerLocations.size(), UNSIGNED_UNSET);
+    std::vector<unsigned> original_corner_ids;
+    std::vector<unsigned> leaf_corner_ids(num_leaves * NUM_CORNERS);
+    for (unsigned box = 0; box < num_boxes; box++)
+    {
+        const unsigned leaf = leaf_indices[box];
+        for (unsigned i = 0; leaf != UNSIGNED_UNSET && i < NUM_CORNERS; i++)
+        {
+            const unsigned corner_id = boxes[box]->mCornerIds[i];
+            if (!rOriginalBox.CornerHasData(corner_id))
+            {
+                EXCEPTION("A lookup table can only be compiled once the corners of all its boxes have been evaluated.");
+            }
+            if (corner_ids[corner_id] == UNSIGNED_UNSET)
+            {
+                corner_ids[corner_id] = original_corner_ids.size();
+                original_corner_ids.push_back(corner_id);
+            }
+            leaf_corner_ids[leaf * NUM_CORNERS + i] = corner_ids[corner_id];
+        }
+    }
+    const unsigned num_corners = original_corner_ids.size();
+    const unsigned num_qois = rOriginalBox.mNumQoIs;
+
+    LayOutTable(num_qois, num_boxes, num_leaves, num_corners, rParameterNames);
+
+    // Fill in the arrays, which are in our own buffer.
+    double* p_box_mins = const_cast<double*>(mpBoxMins);
+    double* p_box_maxs = const_cast<double*>(mpBoxMaxs);
+    double* p_leaf_mins = const_cast<double*>(mpLeafMins);
+    double* p_leaf_widths = const_cast<double*>(mpLeafWidths);
+    double* p_corner_locations = const_cast<double*>(mpCornerLocations);
+    double* p_corner_qois = const_cast<double*>(mpCornerQoIs);
+    for (unsigned box = 0; box < num_boxes; box++)
+    {
+        const ParameterBox<DIM>* p_box = boxes[box];
+        const unsigned leaf = leaf_indices[box];
+        for (unsigned j = 0; j < DIM; j++)
+        {
+            p_box_mins[j * num_boxes + box] = p_box->mMin[j];
+            p_box_maxs[j * num_boxes + box] = p_box->mMax[j];
+            if (leaf != UNSIGNED_UNSET)
+            {
+                p_leaf_mins[j * num_leaves + leaf] = p_box->mMin[j];
+                p_leaf_widths[j * num_leaves + leaf] = p_box->mMax[j] - p_box->mMin[j];
+            }
+        }
+    }
+    for (unsigned corner = 0; corner < num_corners; corner++)
+    {
+        const unsigned corner_id = original_corner_ids[corner];
+        for (unsigned j = 0; j < DIM; j++)
+        {
+            p_corner_locations[corner * DIM + j] = rOriginalBox.mCornerLocations[corner_id][j];
+        }
+        for (unsigned qoi_idx = 0; qoi_idx < num_qois; qoi_idx++)
+        {
+            p_corner_qois[corner * num_qois + qoi_idx] = rOriginalBox.mCornerQoIs[qoi_idx][corner_id];
+        }
+    }
+    std::copy(first_daughters.begin(), first_daughters.end(), const_cast<unsigned*>(mpFirstDaughters));
+    std::copy(num_daughters.begin(), num_daughters.end(), const_cast<unsigned*>(mpNumDaughters));
+    std::copy(leaf_indices.begin(), leaf_indices.end(), const_cast<unsigned*>(mpLeafIndices));
+    std::copy(leaf_corner_ids.begin(), leaf_corner_ids.end(), const_cast<unsigned*>(mpLeafCornerIds));
+}
+
+template <unsigned DIM>
+CompiledLookupTable<DIM>::CompiledLookupTable(unsigned numQoIs,
+                                              unsigned numBoxes,
+                                              unsigned numLeaves,
+                                              unsigned numCorners,
+                                              const std::vector<std::string>& rParameterNames)
+        : mIsMapped(false),
+          mIndexBits(0u),
+          mIndexScale(1.0),
+          mIndexCellBits(0u)
+{
+    LayOutTable(numQoIs, numBoxes, numLeaves, numCorners, rParameterNames);
+}
+
+template <unsigned DIM>
+size_t CompiledLookupTable<DIM>::GetTableSize(size_t numQoIs, size_t numBoxes, size_t numLeaves, size_t numCorners, size_t namesSize)
+{
+    return sizeof(CompiledLookupTableHeader) + namesSize
+        + sizeof(double) * (2u * DIM * numBoxes + 2u * DIM * numLeaves + (DIM + numQoIs) * numCorners)
+        + PadToEightBytes(sizeof(unsigned) * (3u * numBoxes + NUM_CORNERS * numLeaves));
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::LayOutTable(unsigned numQoIs,
+                                           unsigned numBoxes,
+                                           unsigned numLeaves,
+                                           unsigned numCorners,
+                                           const std::vector<std::string>& rParameterNames)
+{
+    // The header, the names and the arrays are in one block, as they are in a file.
+    std::string names;
+    for (unsigned j = 0; j < rParameterNames.size(); j++)
+    {
+        names += rParameterNames[j] + '\0';
+    }
+    names.resize(PadToEightBytes(names.size()), '\0');
+
+    CompiledLookupTableHeader header;
+    memcpy(header.mFormat, COMPILED_LOOKUP_TABLE_FORMAT, sizeof(header.mFormat));
+    header.mVersion = COMPILED_LOOKUP_TABLE_VERSION;
+    header.mByteOrder = COMPILED_LOOKUP_TABLE_BYTE_ORDER;
+    header.mDimension = DIM;
+    header.mNumQoIs = numQoIs;
+    header.mNumBoxes = numBoxes;
+    header.mNumLeaves = numLeaves;
+    header.mNumCorners = numCorners;
+    header.mNamesSize = names.size();
+    header.mSize = GetTableSize(numQoIs, numBoxes, numLeaves, numCorners, names.size());
+    header.mSourceSize = 0u;
+    header.mSourceModified = 0;
+
+    mBuffer.resize(header.mSize / sizeof(double), 0.0);
+    char* p_table = reinterpret_cast<char*>(mBuffer.data());
+    memcpy(p_table, &header, sizeof(header));
+    memcpy(p_table + sizeof(header), names.data(), names.size());
+    SetUpFromMemory(p_table, header.mSize);
+}
+
+template <unsigned DIM>
+CompiledLookupTable<DIM>::CompiledLookupTable(const std::string& rFileName, const std::string& rSourceFileName)
+        : mIsMapped(true),
+          mIndexBits(0u),
+          mIndexScale(1.0),
+          mIndexCellBits(0u)
+{
+    int file = open(rFileName.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        EXCEPTION("Could not open the compiled lookup table '" << rFileName << "'.");
+    }
+    struct stat file_status;
+    if (fstat(file, &file_status) != 0 || (size_t)file_status.st_size < sizeof(CompiledLookupTableHeader))
+    {
+        close(file);
+        EXCEPTION("'" << rFileName << "' is not a compiled lookup table.");
+    }
+
+    // The pages are shared with any other process mapping the file, and only read when they are used.
+    mTableSize = file_status.st_size;
+    void* p_mapping = mmap(NULL, mTableSize, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (p_mapping == MAP_FAILED)
+    {
+        EXCEPTION("Could not map the compiled lookup table '" << rFileName << "' into memory.");
+    }
+    mpTable = static_cast<const char*>(p_mapping);
+
+    try
+    {
+        SetUpFromMemory(mpTable, mTableSize);
+        if (!rSourceFileName.empty())
+        {
+            CompiledLookupTableHeader header;
+            memcpy(&header, mpTable, sizeof(header));
+            uint64_t source_size;
+            int64_t source_modified;
+            if (!GetFileSizeAndTime(rSourceFileName, source_size, source_modified)
+                || source_size != header.mSourceSize || source_modified != header.mSourceModified)
+            {
+                EXCEPTION("This compiled lookup table is out of date, it wasn't made from '" << rSourceFileName << "' as it is now.");
+            }
+        }
+        CheckTree();
+    }
+    catch (Exception& e)
+    {
+        munmap(p_mapping, mTableSize);
+        EXCEPTION("'" << rFileName << "' could not be used: " << e.GetShortMessage());
+    }
+}
+
+template <unsigned DIM>
+CompiledLookupTable<DIM>::~CompiledLookupTable()
+{
+    if (mIsMapped)
+    {
+        munmap(const_cast<char*>(mpTable), mTableSize);
+    }
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::SetUpFromMemory(const char* pTable, size_t size)
+{
+    CompiledLookupTableHeader header;
+    if (size < sizeof(header))
+    {
+        EXCEPTION("This is not a compiled lookup table.");
+    }
+    memcpy(&header, pTable, sizeof(header));
+    if (memcmp(header.mFormat, COMPILED_LOOKUP_TABLE_FORMAT, sizeof(header.mFormat)) != 0)
+    {
+        EXCEPTION("This is not a compiled lookup table.");
+    }
+    if (header.mByteOrder != COMPILED_LOOKUP_TABLE_BYTE_ORDER)
+    {
+        EXCEPTION("This compiled lookup table was written on a machine with a different byte order.");
+    }
+    if (header.mVersion != COMPILED_LOOKUP_TABLE_VERSION)
+    {
+        EXCEPTION("This compiled lookup table is version " << header.mVersion << " of the format, only version "
+                                                           << COMPILED_LOOKUP_TABLE_VERSION << " can be read.");
+    }
+    if (header.mDimension != DIM)
+    {
+        EXCEPTION("This compiled lookup table has " << header.mDimension << " dimensions, not " << DIM << ".");
+    }
+
+    mpTable = pTable;
+    mTableSize = size;
+    mNumQoIs = header.mNumQoIs;
+    mNumBoxes = header.mNumBoxes;
+    mNumLeaves = header.mNumLeaves;
+    mNumCorners = header.mNumCorners;
+
+    // The other counts are small enough that the size can't overflow, but the QoIs can be too many for it.
+    if (mNumCorners > 0u && mNumQoIs > size / sizeof(double) / mNumCorners)
+    {
+        EXCEPTION("This compiled lookup table is the wrong size, it may be truncated.");
+    }
+    const size_t expected_size = GetTableSize(mNumQoIs, mNumBoxes, mNumLeaves, mNumCorners, header.mNamesSize);
+    if (header.mNamesSize % 8u != 0u || header.mSize != size || expected_size != size || mNumBoxes == 0u)
+    {
+        EXCEPTION("This compiled lookup table is the wrong size, it may be truncated.");
+    }
+
+    // The names end in NULs, and are padded with more of them.
+    const char* p_names = pTable + sizeof(header);
+    if (header.mNamesSize > 0u && p_names[header.mNamesSize - 1u] != '\0')
+    {
+        EXCEPTION("The parameter names of this compiled lookup table are not terminated.");
+    }
+    mParameterNames.clear();
+    for (size_t i = 0; i < header.mNamesSize && p_names[i] != '\0'; i += mParameterNames.back().size() + 1u)
+    {
+        mParameterNames.push_back(std::string(p_names + i));
+    }
+
+    const double* p_doubles = reinterpret_cast<const double*>(p_names + header.mNamesSize);
+    mpBoxMins = p_doubles;
+    mpBoxMaxs = mpBoxMins + DIM * (size_t)mNumBoxes;
+    mpLeafMins = mpBoxMaxs + DIM * (size_t)mNumBoxes;
+    mpLeafWidths = mpLeafMins + DIM * (size_t)mNumLeaves;
+    mpCornerLocations = mpLeafWidths + DIM * (size_t)mNumLeaves;
+    mpCornerQoIs = mpCornerLocations + DIM * (size_t)mNumCorners;
+
+    const unsigned* p_unsigneds = reinterpret_cast<const unsigned*>(mpCornerQoIs + (size_t)mNumQoIs * mNumCorners);
+    mpFirstDaughters = p_unsigneds;
+    mpNumDaughters = mpFirstDaughters + mNumBoxes;
+    mpLeafIndices = mpNumDaughters + mNumBoxes;
+    mpLeafCornerIds = mpLeafIndices + mNumBoxes;
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::CheckTree() const
+{
+    // The daughters of each box come straight after those of the box before it, and the leaves are numbered in turn.
+    size_t next_daughter = 1u;
+    unsigned next_leaf = 0u;
+    for (unsigned box = 0; box < mNumBoxes; box++)
+    {
+        if (mpNumDaughters[box] == 0u)
+        {
+            if (mpLeafIndices[box] != next_leaf || next_leaf == mNumLeaves)
+            {
+                EXCEPTION("Box " << box << " of this compiled lookup table has the wrong leaf index.");
+            }
+            next_leaf++;
+        }
+        else
+        {
+            if (mpLeafIndices[box] != UNSIGNED_UNSET || mpFirstDaughters[box] != next_daughter
+                || next_daughter <= box || next_daughter + mpNumDaughters[box] > mNumBoxes)
+            {
+                EXCEPTION("The daughters of box " << box << " of this compiled lookup table are wrong.");
+            }
+            next_daughter += mpNumDaughters[box];
+        }
+    }
+    if (next_daughter != mNumBoxes || next_leaf != mNumLeaves)
+    {
+        EXCEPTION("This compiled lookup table has boxes that aren't in its tree.");
+    }
+
+    for (size_t idx = 0; idx < NUM_CORNERS * (size_t)mNumLeaves; idx++)
+    {
+        if (mpLeafCornerIds[idx] >= mNumCorners)
+        {
+            EXCEPTION("Leaf " << idx / NUM_CORNERS << " of this compiled lookup table has a corner that doesn't exist.");
+        }
+    }
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::WriteToFile(const std::string& rFileName, const std::string& rSourceFileName) const
+{
+    CompiledLookupTableHeader header;
+    memcpy(&header, mpTable, sizeof(header));
+    header.mSourceSize = 0u;
+    header.mSourceModified = 0;
+    if (!rSourceFileName.empty() && !GetFileSizeAndTime(rSourceFileName, header.mSourceSize, header.mSourceModified))
+    {
+        EXCEPTION("Could not find '" << rSourceFileName << "', which the compiled lookup table '" << rFileName << "' is made from.");
+    }
+
+    // Write to a file no other thread or process will be using, and then move it into place, so that
+    // the file isn't truncated under anyone who has it mapped.
+    std::stringstream temp_file_name;
+    temp_file_name << rFileName << ".tmp_" << getpid() << "_" << std::this_thread::get_id();
+    std::ofstream file(temp_file_name.str().c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(mpTable + sizeof(header), mTableSize - sizeof(header));
+    file.close();
+    if (!file || std::rename(temp_file_name.str().c_str(), rFileName.c_str()) != 0)
+    {
+        std::remove(temp_file_name.str().c_str());
+        EXCEPTION("Could not write the compiled lookup table '" << rFileName << "'.");
+    }
+}
+
+template <unsigned DIM>
+bool CompiledLookupTable<DIM>::IsMappedFromFile() const
+{
+    return mIsMapped;
+}
+
+template <unsigned DIM>
+unsigned CompiledLookupTable<DIM>::GetDimension() const
+{
+    return DIM;
+}
+
+template <unsigned DIM>
+std::vector<std::string> CompiledLookupTable<DIM>::GetParameterNames() const
+{
+    return mParameterNames;
+}
+
+template <unsigned DIM>
+unsigned CompiledLookupTable<DIM>::GetNumCorners() const
+{
+    return mNumCorners;
+}
+
+template <unsigned DIM>
+const double* CompiledLookupTable<DIM>::GetCornerLocation(unsigned corner) const
+{
+    assert(corner < mNumCorners);
+    return mpCornerLocations + corner * DIM;
+}
+
+template <unsigned DIM>
+const double* CompiledLookupTable<DIM>::GetCornerQoIs(unsigned corner) const
+{
+    assert(corner < mNumCorners);
+    return mpCornerQoIs + corner * mNumQoIs;
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::BuildPointLocationIndex() const
+{
+    // The table has to be the unit hypercube...
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        if (mpBoxMins[j * mNumBoxes] != 0.0 || mpBoxMaxs[j * mNumBoxes] != 1.0)
+        {
+            return;
+        }
+    }
+
+    // ...and each leaf a dyadic block of it, halved few enough times to fit in a 64 bit Morton code.
+    const int max_depth = 63u / DIM;
+    std::vector<unsigned> depths(DIM * mNumLeaves);
+    std::vector<uint64_t> min_coords(DIM * mNumLeaves);
+    unsigned num_bits = 0u;
+    for (unsigned idx = 0; idx < DIM * mNumLeaves; idx++)
+    {
+        int exponent;
+        if (std::frexp(mpLeafWidths[idx], &exponent) != 0.5 || exponent > 1 || 1 - exponent > max_depth)
+        {
+            return;
+        }
+        depths[idx] = 1 - exponent;
+        const double scaled_min = std::ldexp(mpLeafMins[idx], depths[idx]);
+        if (scaled_min != std::floor(scaled_min))
+        {
+            return;
+        }
+        min_coords[idx] = (uint64_t)scaled_min;
+        num_bits = std::max(num_bits, depths[idx]);
+    }
+    if (num_bits == 0u)
+    {
+        // Only the original box, no need for an index.
+        return;
+    }
+    mIndexBits = num_bits;
+    mIndexScale = std::ldexp(1.0, mIndexBits);
+
+    // Hash each leaf by the Morton code of its minimum corner, and number the sizes of leaf.
+    std::map<std::vector<unsigned>, unsigned> depth_ids;
+    mLeafDepths.resize(mNumLeaves);
+    for (unsigned leaf = 0; leaf < mNumLeaves; leaf++)
+    {
+        std::vector<unsigned> depth(DIM);
+        uint64_t coords[DIM];
+        for (unsigned j = 0; j < DIM; j++)
+        {
+            depth[j] = depths[j * mNumLeaves + leaf];
+            coords[j] = min_coords[j * mNumLeaves + leaf] << (mIndexBits - depth[j]);
+        }
+
+        std::map<std::vector<unsigned>, unsigned>::iterator it = depth_ids.find(depth);
+        if (it == depth_ids.end())
+        {
+            // The leading depth[j] digits of each coordinate are those of the minimum corner.
+            uint64_t mask_coords[DIM];
+            for (unsigned j = 0; j < DIM; j++)
+            {
+                mask_coords[j] = (((uint64_t)1u << depth[j]) - 1u) << (mIndexBits - depth[j]);
+            }
+            it = depth_ids.insert(std::make_pair(depth, (unsigned)mDepthMasks.size())).first;
+            mDepthMasks.push_back(GetMortonCode(mask_coords));
+        }
+        mLeafDepths[leaf] = it->second;
+        mLeafCodes[GetMortonCode(coords)] = leaf;
+    }
+
+    // Cut the index into no more than twice as many cells as there are leaves,
+    // and list the sizes of the leaves that overlap each cell.
+    while (mIndexCellBits < mIndexBits && ((uint64_t)1u << (DIM * (mIndexCellBits + 1u))) <= 2u * mNumLeaves)
+    {
+        mIndexCellBits++;
+    }
+    const unsigned shift = mIndexBits - mIndexCellBits;
+    std::vector<std::set<unsigned> > cell_depths(1u << (DIM * mIndexCellBits));
+    for (unsigned leaf = 0; leaf < mNumLeaves; leaf++)
+    {
+        uint64_t first[DIM];
+        uint64_t last[DIM];
+        uint64_t cell[DIM];
+        for (unsigned j = 0; j < DIM; j++)
+        {
+            const unsigned leaf_shift = mIndexBits - depths[j * mNumLeaves + leaf];
+            const uint64_t min_coord = min_coords[j * mNumLeaves + leaf] << leaf_shift;
+            first[j] = min_coord >> shift << shift;
+            last[j] = (min_coord + ((uint64_t)1u << leaf_shift) - 1u) >> shift << shift;
+            cell[j] = first[j];
+        }
+
+        // Visit every cell in the block first..last
+        while (true)
+        {
+            cell_depths[GetMortonCode(cell) >> (DIM * shift)].insert(mLeafDepths[leaf]);
+
+            unsigned j = 0;
+            while (j < DIM && cell[j] == last[j])
+            {
+                cell[j] = first[j];
+                j++;
+            }
+            if (j == DIM)
+            {
+                break;
+            }
+            cell[j] += (uint64_t)1u << shift;
+        }
+    }
+
+    mCellDepthStarts.push_back(0u);
+    for (unsigned cell = 0; cell < cell_depths.size(); cell++)
+    {
+        mCellDepths.insert(mCellDepths.end(), cell_depths[cell].begin(), cell_depths[cell].end());
+        mCellDepthStarts.push_back(mCellDepths.size());
+    }
+}
+
+template <unsigned DIM>
+uint64_t CompiledLookupTable<DIM>::GetMortonCode(const uint64_t* pCoords) const
+{
+    uint64_t code = 0u;
+    for (unsigned b = 0; b < mIndexBits; b++)
+    {
+        for (unsigned j = 0; j < DIM; j++)
+        {
+            code |= ((pCoords[j] >> b) & 1u) << (b * DIM + j);
+        }
+    }
+    return code;
+}
+
+template <unsigned DIM>
+unsigned CompiledLookupTable<DIM>::GetNumQoIs() const
+{
+    return mNumQoIs;
+}
+
+template <unsigned DIM>
+unsigned CompiledLookupTable<DIM>::GetNumLeaves() const
+{
+    return mNumLeaves;
+}
+
+template <unsigned DIM>
+bool CompiledLookupTable<DIM>::IsPointInBox(unsigned box, const double* pPoint) const
+{
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        if (pPoint[j] > mpBoxMaxs[j * mNumBoxes + box] || pPoint[j] < mpBoxMins[j * mNumBoxes + box])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::EnsurePointLocationIndex() const
+{
+    std::call_once(mPointLocationIndexOnce, &CompiledLookupTable<DIM>::BuildPointLocationIndex, this);
+}
+
+template <unsigned DIM>
+bool CompiledLookupTable<DIM>::HasPointLocationIndex() const
+{
+    EnsurePointLocationIndex();
+    return mIndexBits > 0u;
+}
+
+template <unsigned DIM>
+unsigned CompiledLookupTable<DIM>::FindLeafContainingPoint(const double* pPoint) const
+{
+    EnsurePointLocationIndex();
+    if (mIndexBits > 0u)
+    {
+        // Scaling by a power of two is exact, so each coordinate is cut to whole numbers exactly,
+        // except that the maximum faces of the table belong to the last leaves.
+        const uint64_t max_coord = ((uint64_t)1u << mIndexBits) - 1u;
+        uint64_t coords[DIM];
+        unsigned j = 0;
+        for (; j < DIM && pPoint[j] >= 0.0 && pPoint[j] <= 1.0; j++)
+        {
+            coords[j] = std::min((uint64_t)(pPoint[j] * mIndexScale), max_coord);
+        }
+
+        // Points outside the table (or not numbers) are left to the tree walk to deal with.
+        if (j == DIM)
+        {
+            const uint64_t code = GetMortonCode(coords);
+            const uint64_t cell = code >> (DIM * (mIndexBits - mIndexCellBits));
+            for (unsigned k = mCellDepthStarts[cell]; k < mCellDepthStarts[cell + 1u]; k++)
+            {
+                std::unordered_map<uint64_t, unsigned>::const_iterator it = mLeafCodes.find(code & mDepthMasks[mCellDepths[k]]);
+                if (it != mLeafCodes.end() && mLeafDepths[it->second] == mCellDepths[k])
+                {
+                    return it->second;
+                }
+            }
+        }
+    }
+    return FindLeafInTree(pPoint);
+}
+
+template <unsigned DIM>
+unsigned CompiledLookupTable<DIM>::FindLeafInTree(const double* pPoint) const
+{
+    if (!IsPointInBox(0u, pPoint))
+    {
+        EXCEPTION("This point is not contained within this box (or any of its children).");
+    }
+
+    unsigned box = 0u;
+    while (mpLeafIndices[box] == UNSIGNED_UNSET)
+    {
+        // Where the point is on a face shared by daughters, the tree of boxes goes with the last of them.
+        unsigned daughter = mpFirstDaughters[box] + mpNumDaughters[box];
+        while (daughter > mpFirstDaughters[box] && !IsPointInBox(daughter - 1u, pPoint))
+        {
+            daughter--;
+        }
+        if (daughter == mpFirstDaughters[box])
+        {
+            EXCEPTION("This point is not contained within this box (or any of its children).");
+        }
+        box = daughter - 1u;
+    }
+    return mpLeafIndices[box];
+}
+
+template <unsigned DIM>
+template <unsigned LANES>
+void CompiledLookupTable<DIM>::InterpolateInLeaves(const unsigned* pLeaves, const double* pPoints, double* pResults) const
+{
+    // Nondimensionalise each point within its leaf, and find where the QoIs at its corners are
+    double points[DIM][LANES];
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        for (unsigned lane = 0; lane < LANES; lane++)
+        {
+            const unsigned idx = j * mNumLeaves + pLeaves[lane];
+            points[j][lane] = (pPoints[lane * DIM + j] - mpLeafMins[idx]) / mpLeafWidths[idx];
+        }
+    }
+    unsigned corner_qoi_starts[NUM_CORNERS][LANES];
+    for (unsigned i = 0; i < NUM_CORNERS; i++)
+    {
+        for (unsigned lane = 0; lane < LANES; lane++)
+        {
+            corner_qoi_starts[i][lane] = mpLeafCornerIds[pLeaves[lane] * NUM_CORNERS + i] * mNumQoIs;
+        }
+    }
+
+    // The weights of the corners along dimensions 0..j-1 are in weights[0..2^j-1],
+    // add dimension j by splitting each of them in two.
+    double weights[NUM_CORNERS][LANES];
+    for (unsigned lane = 0; lane < LANES; lane++)
+    {
+        weights[0][lane] = 1.0;
+    }
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        for (unsigned i = 0; i < (1u << j); i++)
+        {
+            for (unsigned lane = 0; lane < LANES; lane++)
+            {
+                weights[i + (1u << j)][lane] = weights[i][lane] * points[j][lane];
+                weights[i][lane] *= (1.0 - points[j][lane]);
+            }
+        }
+    }
+
+    for (unsigned qoi_idx = 0; qoi_idx < mNumQoIs; qoi_idx++)
+    {
+        double qois[LANES];
+        for (unsigned lane = 0; lane < LANES; lane++)
+        {
+            qois[lane] = 0.0;
+        }
+        for (unsigned i = 0; i < NUM_CORNERS; i++)
+        {
+            for (unsigned lane = 0; lane < LANES; lane++)
+            {
+                qois[lane] += weights[i][lane] * mpCornerQoIs[corner_qoi_starts[i][lane] + qoi_idx];
+            }
+        }
+        for (unsigned lane = 0; lane < LANES; lane++)
+        {
+            pResults[lane * mNumQoIs + qoi_idx] = qois[lane];
+        }
+    }
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::InterpolateInLeaf(unsigned leaf, const double* pPoint, double* pQoIs) const
+{
+    InterpolateInLeaves<1u>(&leaf, pPoint, pQoIs);
+}
+
+template <unsigned DIM>
+void CompiledLookupTable<DIM>::Interpolate(const double* pPoints, unsigned numPoints, double* pResults) const
+{
+    unsigned leaves[NUM_LANES];
+    unsigned i = 0;
+    for (; i + NUM_LANES <= numPoints; i += NUM_LANES)
+    {
+        for (unsigned lane = 0; lane < NUM_LANES; lane++)
+        {
+            leaves[lane] = FindLeafContainingPoint(pPoints + (i + lane) * DIM);
+        }
+        InterpolateInLeaves<NUM_LANES>(leaves, pPoints + i * DIM, pResults + i * mNumQoIs);
+    }
+
+    // Any points left over are done one at a time.
+    for (; i < numPoints; i++)
+    {
+        const double* p_point = pPoints + i * DIM;
+        InterpolateInLeaf(FindLeafContainingPoint(p_point), p_point, pResults + i * mNumQoIs);
+    }
+}
+
+template <unsigned DIM>
+std::vector<std::vector<double> > CompiledLookupTable<DIM>::Interpolate(const std::vector<std::vector<double> >& rPoints) const
+{
+    // Put the points together for the method above.
+    std::vector<double> points(rPoints.size() * DIM);
+    for (unsigned i = 0; i < rPoints.size(); i++)
+    {
+        assert(rPoints[i].size() == DIM);
+        std::copy(rPoints[i].begin(), rPoints[i].end(), points.begin() + i * DIM);
+    }
+    std::vector<double> results(rPoints.size() * mNumQoIs);
+    Interpolate(points.data(), rPoints.size(), results.data());
+
+    std::vector<std::vector<double> > interpolated_values;
+    for (unsigned i = 0; i < rPoints.size(); i++)
+    {
+        interpolated_values.push_back(std::vector<double>(results.begin() + i * mNumQoIs,
+                                                          results.begin() + (i + 1u) * mNumQoIs));
+    }
+    return interpolated_values;
+}
+
+template <unsigned DIM>
+boost::shared_ptr<AbstractLookupTable> CompiledLookupTable<DIM>::MakeSlice(const std::vector<unsigned>& rDimensionsToKeep) const
+{
+    for (unsigned k = 0; k < rDimensionsToKeep.size(); k++)
+    {
+        if (rDimensionsToKeep[k] >= DIM || (k > 0u && rDimensionsToKeep[k] <= rDimensionsToKeep[k - 1u]))
+        {
+            EXCEPTION("The dimensions of a slice must be dimensions of the table, in increasing order.");
+        }
+    }
+
+    boost::shared_ptr<AbstractLookupTable> p_slice;
+    switch (rDimensionsToKeep.size())
+    {
+        case 1u:
+            p_slice = MakeSliceWithDimension<1u>(rDimensionsToKeep);
+            break;
+        case 2u:
+            p_slice = MakeSliceWithDimension<2u>(rDimensionsToKeep);
+            break;
+        case 3u:
+            p_slice = MakeSliceWithDimension<3u>(rDimensionsToKeep);
+            break;
+        case 4u:
+            p_slice = MakeSliceWithDimension<4u>(rDimensionsToKeep);
+            break;
+        case 5u:
+            p_slice = MakeSliceWithDimension<5u>(rDimensionsToKeep);
+            break;
+        case 6u:
+            p_slice = MakeSliceWithDimension<6u>(rDimensionsToKeep);
+            break;
+        case 7u:
+            p_slice = MakeSliceWithDimension<7u>(rDimensionsToKeep);
+            break;
+        default:
+            EXCEPTION("A slice of a lookup table must keep at least one of its dimensions.");
+    }
+    return p_slice;
+}
+
+template <unsigned DIM>
+template <unsigned SLICE_DIM>
+boost::shared_ptr<AbstractLookupTable> CompiledLookupTable<DIM>::MakeSliceWithDimension(const std::vector<unsigned>& rDimensionsToKeep) const
+{
+    assert(rDimensionsToKeep.size() == SLICE_DIM);
+    std::vector<unsigned> dimensions_dropped;
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        if (std::find(rDimensionsToKeep.begin(), rDimensionsToKeep.end(), j) == rDimensionsToKeep.end())
+        {
+            dimensions_dropped.push_back(j);
+        }
+    }
+
+    // The boxes on the slice are those reaching the maximum of the table along the dimensions dropped,
+    // and a box with only one daughter on the slice (cut only along those dimensions) is replaced by it.
+    std::vector<std::vector<unsigned> > daughters_on_slice(mNumBoxes);
+    for (unsigned box = 0; box < mNumBoxes; box++)
+    {
+        for (unsigned daughter = mpFirstDaughters[box]; daughter < mpFirstDaughters[box] + mpNumDaughters[box]; daughter++)
+        {
+            unsigned k = 0;
+            while (k < dimensions_dropped.size()
+                   && mpBoxMaxs[dimensions_dropped[k] * mNumBoxes + daughter] == mpBoxMaxs[dimensions_dropped[k] * mNumBoxes])
+            {
+                k++;
+            }
+            if (k == dimensions_dropped.size())
+            {
+                daughters_on_slice[box].push_back(daughter);
+            }
+        }
+    }
+    for (unsigned box = mNumBoxes; box-- > 0u;)
+    {
+        // The daughters come after their mothers, so are already replaced.
+        for (unsigned i = 0; i < daughters_on_slice[box].size(); i++)
+        {
+            const unsigned daughter = daughters_on_slice[box][i];
+            if (daughters_on_slice[daughter].size() == 1u)
+            {
+                daughters_on_slice[box][i] = daughters_on_slice[daughter][0];
+            }
+        }
+    }
+
+    // Number the boxes of the slice breadth-first, as they are numbered in the table.
+    std::vector<unsigned> boxes(1u, daughters_on_slice[0].size() == 1u ? daughters_on_slice[0][0] : 0u);
+    std::vector<unsigned> first_daughters;
+    std::vector<unsigned> num_daughters;
+    std::vector<unsigned> leaf_indices;
+    std::vector<unsigned> leaves;
+    for (unsigned i = 0; i < boxes.size(); i++)
+    {
+        const std::vector<unsigned>& r_daughters = daughters_on_slice[boxes[i]];
+        first_daughters.push_back(boxes.size());
+        num_daughters.push_back(r_daughters.size());
+        boxes.insert(boxes.end(), r_daughters.begin(), r_daughters.end());
+        if (mpLeafIndices[boxes[i]] == UNSIGNED_UNSET)
+        {
+            leaf_indices.push_back(UNSIGNED_UNSET);
+        }
+        else
+        {
+            leaf_indices.push_back(leaves.size());
+            leaves.push_back(mpLeafIndices[boxes[i]]);
+        }
+    }
+
+    // The corners of each leaf on the slice are those with the binary digits of the dimensions dropped set,
+    // in the same order, number them in the order they are first used.
+    const unsigned num_slice_corners = 1u << SLICE_DIM;
+    std::map<unsigned, unsigned> corner_ids;
+    std::vector<unsigned> original_corner_ids;
+    std::vector<unsigned> leaf_corner_ids;
+    for (unsigned leaf = 0; leaf < leaves.size(); leaf++)
+    {
+        for (unsigned i = 0; i < num_slice_corners; i++)
+        {
+            unsigned corner = 0u;
+            for (unsigned k = 0; k < dimensions_dropped.size(); k++)
+            {
+                corner |= 1u << dimensions_dropped[k];
+            }
+            for (unsigned k = 0; k < SLICE_DIM; k++)
+            {
+                corner |= ((i >> k) & 1u) << rDimensionsToKeep[k];
+            }
+            const unsigned corner_id = mpLeafCornerIds[leaves[leaf] * NUM_CORNERS + corner];
+            std::map<unsigned, unsigned>::iterator it = corner_ids.find(corner_id);
+            if (it == corner_ids.end())
+            {
+                it = corner_ids.insert(std::make_pair(corner_id, (unsigned)original_corner_ids.size())).first;
+                original_corner_ids.push_back(corner_id);
+            }
+            leaf_corner_ids.push_back(it->second);
+        }
+    }
+
+    std::vector<std::string> parameter_names;
+    for (unsigned k = 0; k < SLICE_DIM && mParameterNames.size() == DIM; k++)
+    {
+        parameter_names.push_back(mParameterNames[rDimensionsToKeep[k]]);
+    }
+
+    CompiledLookupTable<SLICE_DIM>* p_slice = new CompiledLookupTable<SLICE_DIM>(mNumQoIs, boxes.size(), leaves.size(),
+                                                                                 original_corner_ids.size(), parameter_names);
+    boost::shared_ptr<AbstractLookupTable> p_table(p_slice);
+
+    double* p_box_mins = const_cast<double*>(p_slice->mpBoxMins);
+    double* p_box_maxs = const_cast<double*>(p_slice->mpBoxMaxs);
+    double* p_leaf_mins = const_cast<double*>(p_slice->mpLeafMins);
+    double* p_leaf_widths = const_cast<double*>(p_slice->mpLeafWidths);
+    double* p_corner_locations = const_cast<double*>(p_slice->mpCornerLocations);
+    double* p_corner_qois = const_cast<double*>(p_slice->mpCornerQoIs);
+    for (unsigned k = 0; k < SLICE_DIM; k++)
+    {
+        const unsigned j = rDimensionsToKeep[k];
+        for (unsigned box = 0; box < boxes.size(); box++)
+        {
+            p_box_mins[k * boxes.size() + box] = mpBoxMins[j * mNumBoxes + boxes[box]];
+            p_box_maxs[k * boxes.size() + box] = mpBoxMaxs[j * mNumBoxes + boxes[box]];
+        }
+        for (unsigned leaf = 0; leaf < leaves.size(); leaf++)
+        {
+            p_leaf_mins[k * leaves.size() + leaf] = mpLeafMins[j * mNumLeaves + leaves[leaf]];
+            p_leaf_widths[k * leaves.size() + leaf] = mpLeafWidths[j * mNumLeaves + leaves[leaf]];
+        }
+        for (unsigned corner = 0; corner < original_corner_ids.size(); corner++)
+        {
+            p_corner_locations[corner * SLICE_DIM + k] = mpCornerLocations[original_corner_ids[corner] * DIM + j];
+        }
+    }
+    for (unsigned corner = 0; corner < original_corner_ids.size(); corner++)
+    {
+        std::copy(GetCornerQoIs(original_corner_ids[corner]), GetCornerQoIs(original_corner_ids[corner]) + mNumQoIs,
+                  p_corner_qois + corner * mNumQoIs);
+    }
+    std::copy(first_daughters.begin(), first_daughters.end(), const_cast<unsigned*>(p_slice->mpFirstDaughters));
+    std::copy(num_daughters.begin(), num_daughters.end(), const_cast<unsigned*>(p_slice->mpNumDaughters));
+    std::copy(leaf_indices.begin(), leaf_indices.end(), const_cast<unsigned*>(p_slice->mpLeafIndices));
+    std::copy(leaf_corner_ids.begin(), leaf_corner_ids.end(), const_cast<unsigned*>(p_slice->mpLeafCornerIds));
+
+    return p_table;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////
+
+template class CompiledLookupTable<1u>;
+template class CompiledLookupTable<2u>;
+template class CompiledLookupTable<3u>;
+template class CompiledLookupTable<4u>;
+template class CompiledLookupTable<5u>;
+template class CompiledLookupTable<6u>;
+template class CompiledLookupTable<7u>;
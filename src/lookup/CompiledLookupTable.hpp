@@ -0,0 +1,513 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef COMPILEDLOOKUPTABLE_HPP_
+#define COMPILEDLOOKUPTABLE_HPP_
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AbstractLookupTable.hpp"
+#include "Exception.hpp"
+#include "ParameterBox.hpp"
+
+/**
+ * The start of a compiled lookup table (in memory, and in the files written by CompiledLookupTable::WriteToFile()).
+ *
+ * It is followed by the parameter names (each ending in a NUL, padded with NULs to #mNamesSize bytes) and then,
+ * each starting on a multiple of 8 bytes, the arrays of doubles: box minimums, box maximums, leaf minimums,
+ * leaf widths, corner locations and corner QoIs, then the arrays of 32 bit unsigned integers: first daughters,
+ * numbers of daughters, leaf indices and leaf corner ids (see the members of CompiledLookupTable).
+ */
+struct CompiledLookupTableHeader
+{
+    /** Identifies the file, the characters of #COMPILED_LOOKUP_TABLE_FORMAT. */
+    char mFormat[8];
+
+    /** The version of the layout, #COMPILED_LOOKUP_TABLE_VERSION. Increment this on any change to the layout. */
+    uint32_t mVersion;
+
+    /** #COMPILED_LOOKUP_TABLE_BYTE_ORDER, to spot a file written on a machine with the other byte order. */
+    uint32_t mByteOrder;
+
+    /** The number of parameters (DIM). */
+    uint32_t mDimension;
+
+    /** The number of QoIs at each corner. */
+    uint32_t mNumQoIs;
+
+    /** The number of boxes in the tree. */
+    uint32_t mNumBoxes;
+
+    /** The number of boxes with no daughters. */
+    uint32_t mNumLeaves;
+
+    /** The number of corners of the leaves. */
+    uint32_t mNumCorners;
+
+    /** The number of bytes of parameter names, a multiple of 8. */
+    uint32_t mNamesSize;
+
+    /** The size of the whole table in bytes, to spot a truncated file. */
+    uint64_t mSize;
+
+    /** The size in bytes of the archive the table was compiled from (see CompiledLookupTable::WriteToFile()), zero if none. */
+    uint64_t mSourceSize;
+
+    /** When the archive the table was compiled from was last modified (seconds since the epoch), zero if none. */
+    int64_t mSourceModified;
+};
+
+/** The characters at the start of a compiled lookup table file. */
+static const char COMPILED_LOOKUP_TABLE_FORMAT[8] = { 'A', 'p', 'P', 'r', 'e', 'd', 'L', 'T' };
+
+/** The version of the compiled lookup table layout. */
+static const uint32_t COMPILED_LOOKUP_TABLE_VERSION = 2u;
+
+/** A number whose bytes are all different, to check the byte order. */
+static const uint32_t COMPILED_LOOKUP_TABLE_BYTE_ORDER = 0x01020304u;
+
+/**
+ * A read-only copy of a lookup table (a tree of ParameterBox es) in flat arrays, for
+ * interpolating at many points quickly once the table has been generated or loaded.
+ *
+ * The arrays are all in one block of memory, laid out as described in CompiledLookupTableHeader,
+ * either made from a tree of boxes or mapped read-only from a file written by WriteToFile(),
+ * in which case processes using the same file share it. Mapping a file reads the header and the
+ * arrays of unsigned integers (to check that they describe a tree of boxes), the rest of the file
+ * is only read as it is needed.
+ *
+ * The boxes are numbered breadth-first from the original box, so the daughters of each box are
+ * next to each other, and finding the box containing a point is a walk down these arrays in the
+ * same way as ParameterBox::GetBoxContainingPoint(). The boxes with no daughters (the leaves) have
+ * their own arrays of bounds, one array for each dimension, and the ids of their corners,
+ * whose locations and QoIs are stored once for all the leaves sharing them.
+ *
+ * Where the table is the unit hypercube cut into halves (as the LookupTableGenerator makes them), every
+ * leaf is a dyadic block, so it is also found from the Morton code of the point (the binary digits of its
+ * coordinates interleaved). Each leaf is hashed by the Morton code of its minimum corner, and the point's
+ * code with the digits below the leaf's size cleared is looked up for each size of leaf there is near the
+ * point. The tree walk always takes the upper half of a box for a point on the face between the halves,
+ * which is the same as each leaf owning its minimum faces but not its maximum ones (except on the faces
+ * of the table), so this finds the same leaf exactly. The index is made by the first point located,
+ * so a table that is mapped and never used doesn't cost a pass over its leaves.
+ *
+ * Points are interpolated a few at a time, by a kernel whose loops over the corners of a box and over
+ * the points are fixed at compile time (by DIM and #NUM_LANES), so that the compiler can unroll them and
+ * vectorise across the points with whatever SIMD instructions it has been told it can use (AVX2, AVX-512),
+ * or leave them as scalar code otherwise.
+ *
+ * The arithmetic is the same as ParameterBox::InterpolatePoint(), so the answers are identical.
+ */
+template <unsigned DIM>
+class CompiledLookupTable : public AbstractLookupTable
+{
+private:
+    friend class TestCompiledLookupTable;
+
+    /** Tables of other dimensions fill in the slices they make (see MakeSlice()). */
+    template <unsigned OTHER_DIM>
+    friend class CompiledLookupTable;
+
+    /** The number of points interpolated together, enough to fill an AVX-512 register with doubles. */
+    static const unsigned NUM_LANES = 8u;
+
+    /** The number of corners of each box. */
+    static const unsigned NUM_CORNERS = 1u << DIM;
+
+    /** The table, when it was made from a tree of boxes (doubles, so that it is aligned for them). */
+    std::vector<double> mBuffer;
+
+    /** Whether the table was mapped from a file (rather than being in #mBuffer). */
+    bool mIsMapped;
+
+    /** The start of the table (its CompiledLookupTableHeader). */
+    const char* mpTable;
+
+    /** The size of the table in bytes. */
+    size_t mTableSize;
+
+    /** The names of the parameters in each dimension. */
+    std::vector<std::string> mParameterNames;
+
+    /** The number of QoIs at each corner. */
+    unsigned mNumQoIs;
+
+    /** The number of boxes in the tree. */
+    unsigned mNumBoxes;
+
+    /** The number of boxes with no daughters. */
+    unsigned mNumLeaves;
+
+    /** The number of corners of the leaves. */
+    unsigned mNumCorners;
+
+    /** The minimum of each box, all the boxes along dimension 0, then dimension 1, etc. */
+    const double* mpBoxMins;
+
+    /** The maximum of each box, laid out as #mpBoxMins. */
+    const double* mpBoxMaxs;
+
+    /** The minimum of each leaf, all the leaves along dimension 0, then dimension 1, etc. */
+    const double* mpLeafMins;
+
+    /** The width of each leaf, laid out as #mpLeafMins. */
+    const double* mpLeafWidths;
+
+    /** The location of each corner, DIM values for corner 0, then corner 1, etc. */
+    const double* mpCornerLocations;
+
+    /** The QoIs at each corner, #mNumQoIs values for corner 0, then corner 1, etc. */
+    const double* mpCornerQoIs;
+
+    /** For each box, the index of its first daughter (its daughters are next to each other). */
+    const unsigned* mpFirstDaughters;
+
+    /** For each box, its number of daughters (zero for the leaves). */
+    const unsigned* mpNumDaughters;
+
+    /** For each box, its index amongst the leaves, UNSIGNED_UNSET if it has daughters. */
+    const unsigned* mpLeafIndices;
+
+    /**
+     * The ids of the 2^DIM corners of each leaf, in the order given by the binary digits
+     * of the corner index (as in ParameterBox), for leaf 0, then leaf 1, etc.
+     */
+    const unsigned* mpLeafCornerIds;
+
+    /**
+     * Makes the point location index the first time a point is located (see EnsurePointLocationIndex()).
+     * The index members below are filled in under it, which is why they are mutable.
+     */
+    mutable std::once_flag mPointLocationIndexOnce;
+
+    /**
+     * The number of binary digits of each coordinate in the Morton codes of the point location index,
+     * zero if the table has no index (because it isn't the unit hypercube cut into halves, or is too deep).
+     */
+    mutable unsigned mIndexBits;
+
+    /** 2^#mIndexBits, to scale coordinates to integers. */
+    mutable double mIndexScale;
+
+    /** The number of leading binary digits of each coordinate that pick a cell of #mCellDepthStarts. */
+    mutable unsigned mIndexCellBits;
+
+    /** The Morton code of the minimum corner of each leaf, mapped to the leaf. */
+    mutable std::unordered_map<uint64_t, unsigned> mLeafCodes;
+
+    /** For each leaf, the index of its size (the number of times it has been halved along each dimension) in #mDepthMasks. */
+    mutable std::vector<unsigned> mLeafDepths;
+
+    /** For each size of leaf, the digits of a Morton code that give the minimum corner of the leaf containing a point. */
+    mutable std::vector<uint64_t> mDepthMasks;
+
+    /**
+     * For each cell of the index (a Morton code cut down to #mIndexCellBits digits for each coordinate),
+     * where its sizes of leaf start in #mCellDepths (with one extra entry at the end).
+     */
+    mutable std::vector<unsigned> mCellDepthStarts;
+
+    /** The sizes of leaf (indices into #mDepthMasks) of the leaves overlapping each cell of the index. */
+    mutable std::vector<unsigned> mCellDepths;
+
+    /**
+     * The tables point into their own memory, so can't be copied.
+     *
+     * @param rOther  Another table.
+     */
+    CompiledLookupTable(const CompiledLookupTable<DIM>& rOther);
+
+    /**
+     * The tables point into their own memory, so can't be copied.
+     *
+     * @param rOther  Another table.
+     * @return This table.
+     */
+    CompiledLookupTable<DIM>& operator=(const CompiledLookupTable<DIM>& rOther);
+
+    /**
+     * Constructor, lays out a table of the given size for its arrays to be filled in.
+     *
+     * @param numQoIs  The number of QoIs at each corner.
+     * @param numBoxes  The number of boxes in the tree.
+     * @param numLeaves  The number of boxes with no daughters.
+     * @param numCorners  The number of corners of the leaves.
+     * @param rParameterNames  The names of the parameters in each dimension (if any).
+     */
+    CompiledLookupTable(unsigned numQoIs,
+                        unsigned numBoxes,
+                        unsigned numLeaves,
+                        unsigned numCorners,
+                        const std::vector<std::string>& rParameterNames);
+
+    /**
+     * @param numQoIs  The number of QoIs at each corner.
+     * @param numBoxes  The number of boxes in the tree.
+     * @param numLeaves  The number of boxes with no daughters.
+     * @param numCorners  The number of corners of the leaves.
+     * @param namesSize  The number of bytes of parameter names.
+     * @return The size in bytes of a table of this size, laid out as described in CompiledLookupTableHeader.
+     */
+    static size_t GetTableSize(size_t numQoIs, size_t numBoxes, size_t numLeaves, size_t numCorners, size_t namesSize);
+
+    /**
+     * Write the header and the names of a table of the given size into #mBuffer,
+     * and point the members at its (zeroed) arrays.
+     *
+     * @param numQoIs  The number of QoIs at each corner.
+     * @param numBoxes  The number of boxes in the tree.
+     * @param numLeaves  The number of boxes with no daughters.
+     * @param numCorners  The number of corners of the leaves.
+     * @param rParameterNames  The names of the parameters in each dimension (if any).
+     */
+    void LayOutTable(unsigned numQoIs,
+                     unsigned numBoxes,
+                     unsigned numLeaves,
+                     unsigned numCorners,
+                     const std::vector<std::string>& rParameterNames);
+
+    /**
+     * Check the header of a table and point the members at its arrays.
+     *
+     * @param pTable  The start of the table.
+     * @param size  Its size in bytes.
+     */
+    void SetUpFromMemory(const char* pTable, size_t size);
+
+    /**
+     * Check that the arrays of unsigned integers of a table from a file describe a tree of boxes numbered
+     * breadth-first, with each leaf numbered in turn and every corner id in range, so that a damaged file
+     * throws here instead of reading outside the table later.
+     */
+    void CheckTree() const;
+
+    /**
+     * @param box  The index of a box.
+     * @param pPoint  A point in parameter space (DIM values).
+     * @return Whether the point is within the box (including its faces).
+     */
+    bool IsPointInBox(unsigned box, const double* pPoint) const;
+
+    /**
+     * @param pCoords  Integer coordinates, #mIndexBits binary digits each (DIM values).
+     * @return Their Morton code, digit b of coordinate j being digit b*DIM+j of the code.
+     */
+    uint64_t GetMortonCode(const uint64_t* pCoords) const;
+
+    /**
+     * Make the point location index (#mLeafCodes etc.) if the leaves are all dyadic blocks of
+     * the unit hypercube, otherwise leave #mIndexBits zero.
+     */
+    void BuildPointLocationIndex() const;
+
+    /**
+     * Call BuildPointLocationIndex() if it hasn't been called yet, safely from any number of threads.
+     */
+    void EnsurePointLocationIndex() const;
+
+    /**
+     * Find the leaf containing a point by walking down the tree of boxes.
+     *
+     * @param pPoint  A point in parameter space (DIM values).
+     * @return The index of the leaf containing the point.
+     */
+    unsigned FindLeafInTree(const double* pPoint) const;
+
+    /**
+     * The interpolation kernel, interpolates the QoIs at LANES points, each within a given leaf.
+     *
+     * The weight of each corner is built up one dimension at a time, the corners with binary digit j
+     * clear being multiplied by (1-x_j) and those with it set by x_j, which multiplies the same
+     * factors in the same order as ParameterBox::InterpolatePoint() without testing any bits.
+     *
+     * @param pLeaves  The index of the leaf containing each point (LANES values).
+     * @param pPoints  The points, DIM values for the first point, then DIM for the second, etc.
+     * @param pResults  Filled in with the #mNumQoIs QoIs at the first point, then the second, etc.
+     */
+    template <unsigned LANES>
+    void InterpolateInLeaves(const unsigned* pLeaves, const double* pPoints, double* pResults) const;
+
+    /**
+     * Make the table of a slice, see MakeSlice().
+     *
+     * @param rDimensionsToKeep  The dimensions of this table to keep (SLICE_DIM of them, in increasing order).
+     * @return The table of the slice.
+     */
+    template <unsigned SLICE_DIM>
+    boost::shared_ptr<AbstractLookupTable> MakeSliceWithDimension(const std::vector<unsigned>& rDimensionsToKeep) const;
+
+public:
+    /**
+     * Constructor, copies the table out of the tree of boxes.
+     *
+     * @param rOriginalBox  The original box of a lookup table, every box with no daughters must have
+     *                      data at all its corners.
+     * @param rParameterNames  The names of the parameters in each dimension (if any).
+     */
+    CompiledLookupTable(ParameterBox<DIM>& rOriginalBox,
+                        const std::vector<std::string>& rParameterNames = std::vector<std::string>());
+
+    /**
+     * Constructor, maps a table written by WriteToFile() read-only into memory.
+     *
+     * If the archive the table was compiled from is given, and it isn't the size it was or has been
+     * modified since, the table is out of date and an exception is thrown.
+     *
+     * @param rFileName  The full path of the file.
+     * @param rSourceFileName  The full path of the archive the table was compiled from (optional).
+     */
+    CompiledLookupTable(const std::string& rFileName, const std::string& rSourceFileName = "");
+
+    /**
+     * Destructor, unmaps the file if there is one.
+     */
+    ~CompiledLookupTable();
+
+    /**
+     * Write the table to a file, which can be mapped back into memory with the constructor above.
+     *
+     * The table is written under a temporary name and then renamed, so a process that is using the
+     * file being replaced keeps the old one, and nobody ever maps half a table.
+     *
+     * @param rFileName  The full path of the file.
+     * @param rSourceFileName  The full path of the archive the table was compiled from, whose size and
+     *                         modification time are kept in the file to tell when it is out of date (optional).
+     */
+    void WriteToFile(const std::string& rFileName, const std::string& rSourceFileName = "") const;
+
+    /**
+     * @return Whether the table was mapped from a file.
+     */
+    bool IsMappedFromFile() const;
+
+    /**
+     * @return DIM
+     */
+    unsigned GetDimension() const;
+
+    /**
+     * @return The names of the parameters in each dimension.
+     */
+    std::vector<std::string> GetParameterNames() const;
+
+    /**
+     * @return The number of QoIs interpolated at each point.
+     */
+    unsigned GetNumQoIs() const;
+
+    /**
+     * @return The number of boxes with no daughters, which the table interpolates within.
+     */
+    unsigned GetNumLeaves() const;
+
+    /**
+     * @return The number of corners of the leaves, the points at which the QoIs are known.
+     */
+    unsigned GetNumCorners() const;
+
+    /**
+     * @param corner  The id of a corner.
+     * @return The location of the corner (DIM values).
+     */
+    const double* GetCornerLocation(unsigned corner) const;
+
+    /**
+     * @param corner  The id of a corner.
+     * @return The QoIs at the corner (GetNumQoIs() values).
+     */
+    const double* GetCornerQoIs(unsigned corner) const;
+
+    /**
+     * @return Whether points are located with the Morton code index rather than by walking the tree.
+     */
+    bool HasPointLocationIndex() const;
+
+    /**
+     * Find the leaf containing a point, where a point is on the boundary of two boxes
+     * this is the same one as ParameterBox::GetBoxContainingPoint() would find.
+     *
+     * If the point is outside the table an exception is thrown.
+     *
+     * @param pPoint  A point in parameter space (DIM values).
+     * @return The index of the leaf containing the point.
+     */
+    unsigned FindLeafContainingPoint(const double* pPoint) const;
+
+    /**
+     * Interpolate the QoIs within a leaf.
+     *
+     * @param leaf  The index of the leaf.
+     * @param pPoint  A point within the leaf (DIM values).
+     * @param pQoIs  Filled in with the #mNumQoIs QoIs at the point.
+     */
+    void InterpolateInLeaf(unsigned leaf, const double* pPoint, double* pQoIs) const;
+
+    /**
+     * Interpolate the QoIs at some points, #NUM_LANES at a time.
+     *
+     * @param pPoints  The points, DIM values for the first point, then DIM for the second, etc.
+     * @param numPoints  The number of points.
+     * @param pResults  Filled in with the QoIs at each point, GetNumQoIs() for the first point, then the second, etc.
+     */
+    void Interpolate(const double* pPoints, unsigned numPoints, double* pResults) const;
+
+    /**
+     * Interpolate the QoIs at some points.
+     *
+     * @param rPoints  The points, each with DIM values.
+     * @return The QoIs at each point.
+     */
+    std::vector<std::vector<double> > Interpolate(const std::vector<std::vector<double> >& rPoints) const;
+
+    /**
+     * Make a table of fewer dimensions from the slice of this one where the other parameters are
+     * at the maximum of the table.
+     *
+     * Only the boxes touching that face are kept, boxes that were only cut along the other dimensions
+     * are replaced by their upper halves, and the leaves keep the corners on the face. The tree walk
+     * takes the upper halves on the face anyway, and the corners that are dropped have weights of
+     * exactly zero there, so the slice finds the same leaves and gives identical answers.
+     *
+     * @param rDimensionsToKeep  The dimensions of this table to keep, in increasing order.
+     * @return The table of the slice, held in memory, with the parameter names of the dimensions kept.
+     */
+    boost::shared_ptr<AbstractLookupTable> MakeSlice(const std::vector<unsigned>& rDimensionsToKeep) const;
+};
+
+#endif // COMPILEDLOOKUPTABLE_HPP_
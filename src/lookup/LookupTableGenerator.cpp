@@ -33,27 +33,155 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
-#include <boost/scoped_array.hpp> // to avoid variable length arrays.
-#include <iomanip>                // for setprecision()
-#include <pthread.h>              // for pthread_create, pthread_join, etc
-#include <unistd.h>               // Timing delays to make pthreads behave themselves
-
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip> // for setprecision()
+#include <mutex>
+#include <sstream>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/serialization/string.hpp>
+
+#include "DistributedTasks.hpp"
 #include "FileFinder.hpp"
 #include "LookupTableGenerator.hpp"
 #include "ParameterBox.hpp"
+#include "PetscTools.hpp"
 #include "SetupModel.hpp"
 #include "SingleActionPotentialPrediction.hpp"
+#include "SteadyStateCache.hpp"
+#include "WorkerPool.hpp"
 
-void *ThreadedActionPotential(void *argument); // Forward declaration.
+/**
+ * Setting up a model can involve loading (or even compiling) it, and writing files,
+ * so only one worker at a time does it.
+ */
+static std::mutex SetupModelMutex;
 
 struct ThreadReturnData
 {
-    bool exceptionOccurred;
+    bool exceptionOccurred = false;
     std::string exceptionMessage;
-    unsigned errorOccurred;
+    unsigned errorOccurred = 0u;
     std::vector<double> QoIs;
+    std::vector<double> stateVariables;
+
+    /**
+     * Archive the answer, so it can be sent to the other processes.
+     *
+     * @param archive  the archive
+     * @param version  the current version of this class
+     */
+    template <class Archive>
+    void serialize(Archive& archive, const unsigned int version)
+    {
+        archive & exceptionOccurred;
+        archive & exceptionMessage;
+        archive & errorOccurred;
+        archive & QoIs;
+        archive & stateVariables;
+    }
 };
 
+/**
+ * Share the answers between all the MPI processes, each process should have filled in the
+ * answers for its own points (see DistributedTasks), and on return all processes have all
+ * the answers. Does nothing when running sequentially.
+ *
+ * @param rAnswers  The answers, one per point.
+ */
+void ShareThreadReturnData(std::vector<ThreadReturnData>& rAnswers)
+{
+    if (PetscTools::IsSequential())
+    {
+        return;
+    }
+
+    std::vector<std::string> packed_answers(rAnswers.size());
+    for (unsigned i = 0; i < rAnswers.size(); i++)
+    {
+        if (DistributedTasks::IsMine(i))
+        {
+            std::ostringstream stream;
+            boost::archive::binary_oarchive output_arch(stream);
+            output_arch << rAnswers[i];
+            packed_answers[i] = stream.str();
+        }
+    }
+
+    DistributedTasks::ShareResults(packed_answers);
+
+    for (unsigned i = 0; i < rAnswers.size(); i++)
+    {
+        std::istringstream stream(packed_answers[i]);
+        boost::archive::binary_iarchive input_arch(stream);
+        input_arch >> rAnswers[i];
+    }
+}
+
+/*
+ * The journal is a header (see GetJournalHeader()) followed by a sequence of records in
+ * native binary format, each one being the evaluation number, the parameter point, error
+ * code, QoIs and state variables (vectors and strings are written as their size followed
+ * by their entries).
+ */
+static void WriteToJournal(std::ofstream& rJournal, unsigned value)
+{
+    rJournal.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void WriteToJournal(std::ofstream& rJournal, const std::string& rValue)
+{
+    WriteToJournal(rJournal, (unsigned)(rValue.size()));
+    rJournal.write(rValue.data(), rValue.size());
+}
+
+static void WriteToJournal(std::ofstream& rJournal, const std::vector<double>& rValues)
+{
+    WriteToJournal(rJournal, (unsigned)(rValues.size()));
+    rJournal.write(reinterpret_cast<const char*>(rValues.data()), rValues.size() * sizeof(double));
+}
+
+static bool ReadFromJournal(std::ifstream& rJournal, unsigned& rValue)
+{
+    rJournal.read(reinterpret_cast<char*>(&rValue), sizeof(rValue));
+    return rJournal.good();
+}
+
+static bool ReadFromJournal(std::ifstream& rJournal, std::vector<double>& rValues, unsigned maxSize)
+{
+    // A size that is too big means the record is damaged, rather than that we should try to allocate it.
+    unsigned size;
+    if (!ReadFromJournal(rJournal, size) || size > maxSize)
+    {
+        return false;
+    }
+    rValues.resize(size);
+    rJournal.read(reinterpret_cast<char*>(rValues.data()), size * sizeof(double));
+    return rJournal.good();
+}
+
+static bool ReadFromJournal(std::ifstream& rJournal, std::string& rValue)
+{
+    unsigned size;
+    if (!ReadFromJournal(rJournal, size) || size > (1u << 20))
+    {
+        return false;
+    }
+    rValue.resize(size);
+    rJournal.read(&rValue[0], size);
+    return rJournal.good();
+}
+
+/** The most state variables a journal record can have when we don't know how many the model has yet. */
+static const unsigned MaxJournalledStateVariables = 1u << 12;
+
+/** The start of every journal header, see LookupTableGenerator::GetJournalHeader(). */
+static const std::string JournalHeaderStart = "ApPredict lookup table journal 1\n";
+
 struct ThreadInputData
 {
     std::vector<double> scalings;
@@ -65,14 +193,27 @@ struct ThreadInputData
     unsigned mModelIndex;
     double mFrequency;
     double mVoltageThreshold;
+    boost::shared_ptr<SteadyStateCache> mpSteadyStateCache;
 };
 
+void ThreadedActionPotential(const ThreadInputData& rInput,
+                             boost::shared_ptr<AbstractCvodeCell>& rpModel,
+                             ThreadReturnData& rOutput); // Forward declaration.
+
 /* Private constructor - just for archiving */
 template <unsigned DIM>
 LookupTableGenerator<DIM>::LookupTableGenerator()
     : AbstractUntemplatedLookupTableGenerator(),
       mModelIndex(0u),
-      mpParentBox(NULL){};
+      mpParentBox(NULL),
+      mContinuation(false),
+      mNumPointsIndexed(0u),
+      mNumThreads(0u),
+      mNumBoxesToRefineTogether(1u),
+      mAnisotropicRefinement(false),
+      mpCompileTableOnce(new std::once_flag),
+      mReuseModels(true),
+      mJournalSize(0){};
 
 template <unsigned DIM>
 LookupTableGenerator<DIM>::LookupTableGenerator(
@@ -89,7 +230,15 @@ LookupTableGenerator<DIM>::LookupTableGenerator(
       mMaxRefinementDifference(UNSIGNED_UNSET),
       mpParentBox(new ParameterBox<DIM>(NULL)),
       mMaxNumPaces(UNSIGNED_UNSET),
-      mVoltageThreshold(-50.0)
+      mVoltageThreshold(-50.0),
+      mContinuation(false),
+      mNumPointsIndexed(0u),
+      mNumThreads(0u),
+      mNumBoxesToRefineTogether(1u),
+      mAnisotropicRefinement(false),
+      mpCompileTableOnce(new std::once_flag),
+      mReuseModels(true),
+      mJournalSize(0)
 {
     // empty
 }
@@ -116,29 +265,53 @@ bool LookupTableGenerator<DIM>::GenerateLookupTable()
             "for.");
     }
 
+    // The journal must have been kept for a table like this one.
+    if (!mJournalFileName.empty())
+    {
+        if (mJournalHeader.empty())
+        {
+            StartNewJournal();
+        }
+        else if (mJournalHeader != GetJournalHeader())
+        {
+            EXCEPTION("The journal file " << mJournalFileName << " was kept for a different lookup table. It has\n"
+                                          << mJournalHeader << "but this generator has\n"
+                                          << GetJournalHeader());
+        }
+    }
+
+    // The table is about to change, so any compiled copy will be out of date.
+    mpCompiledTable.reset();
+    mpCompileTableOnce.reset(new std::once_flag);
+
     // Get a pointer to the output file for us to use when writing
     OutputFileHandler handler(mOutputFolder, false);
     FileFinder output_file = handler.FindFile(mOutputFileName + ".dat");
     out_stream p_file;
 
-    // Overwrite any existing output file as we will dump stored results from our
-    // archive anyway.
-    p_file = handler.OpenOutputFile(mOutputFileName + ".dat");
+    // Every process keeps its own copy of the parameter boxes and results,
+    // but only the master writes them out.
+    if (PetscTools::AmMaster())
+    {
+        // Overwrite any existing output file as we will dump stored results from our
+        // archive anyway.
+        p_file = handler.OpenOutputFile(mOutputFileName + ".dat");
 
-    *p_file << std::setprecision(8);
+        *p_file << std::setprecision(8);
 
-    // Write out the header line - no longer auto-read, but easy to read by eye so we keep it.
-    *p_file << mParameterNames.size() << "\t" << mQuantitiesToRecord.size();
-    for (unsigned i = 0; i < mParameterNames.size(); i++)
-    {
-        *p_file << "\t" << mParameterNames[i];
-    }
-    for (unsigned i = 0; i < mQuantitiesToRecord.size(); i++)
-    {
-        // Write out enum as ints
-        *p_file << "\t" << (int)(mQuantitiesToRecord[i]);
+        // Write out the header line - no longer auto-read, but easy to read by eye so we keep it.
+        *p_file << mParameterNames.size() << "\t" << mQuantitiesToRecord.size();
+        for (unsigned i = 0; i < mParameterNames.size(); i++)
+        {
+            *p_file << "\t" << mParameterNames[i];
+        }
+        for (unsigned i = 0; i < mQuantitiesToRecord.size(); i++)
+        {
+            // Write out enum as ints
+            *p_file << "\t" << (int)(mQuantitiesToRecord[i]);
+        }
+        *p_file << std::endl;
     }
-    *p_file << std::endl;
 
     // Do a few special things the first time round.
     if (!mGenerationHasBegun)
@@ -192,7 +365,7 @@ bool LookupTableGenerator<DIM>::GenerateLookupTable()
     // (we are probably recovering an archive and the pre-existing .dat file may be gone).
     {
         std::cout << "Generation has already begun" << std::endl;
-        for (unsigned i = 0; i < mParameterPointData.size(); i++)
+        for (unsigned i = 0; i < mParameterPointData.size() && PetscTools::AmMaster(); i++)
         {
             std::stringstream line_of_output;
             line_of_output << std::setprecision(8);
@@ -219,51 +392,46 @@ bool LookupTableGenerator<DIM>::GenerateLookupTable()
         }
     }
 
+    // All the quantities of interest are refined together, each box is chosen by its largest error
+    // estimate relative to the tolerance for that QoI, so we stop when every QoI meets its tolerance.
     bool meets_all_tolerances = false;
-    for (unsigned quantitiy_idx = 0u; quantitiy_idx < mQuantitiesToRecord.size();
-         quantitiy_idx++)
-    {
-        // While we are still less than the maximum number of evaluations then
-        // refine boxes.
-        bool meets_tolerance = false;
-        while (mNumEvaluations < mMaxNumEvaluations)
-        {
-            // Find which parameter box has the largest variation between its corners
-            ParameterBox<DIM> *p_box = mpParentBox->FindBoxWithLargestQoIErrorEstimate(
-                quantitiy_idx, mQoITolerances[quantitiy_idx],
-                mMaxRefinementDifference);
-
-            // If we don't get a box back, then we can quit this while loop,
-            // as variation in this QoI is within tols.
-            if (!p_box)
-            {
-                std::cout
-                    << "Error estimates are within requested tolerances... finishing\n"
-                    << std::flush;
-                meets_tolerance = true;
-                break;
-            }
-
-            // Subdivide this box (NB if we GetCorners() after this,
-            // it includes the new points and makes no sense!).
-            CornerSet new_parameter_points = p_box->SubDivide();
-
-            // Evaluate at these points.
-            RunEvaluationsForThesePoints(new_parameter_points, p_file);
-        }
+    while (!mQuantitiesToRecord.empty() && mNumEvaluations < mMaxNumEvaluations)
+    {
+        // Find which parameter boxes have the largest variation between their corners
+        std::vector<ParameterBox<DIM> *> boxes = mpParentBox->FindBoxesWithLargestNormalisedQoIErrorEstimates(
+            mQoITolerances, mNumBoxesToRefineTogether, mMaxRefinementDifference);
 
-        if (meets_tolerance && quantitiy_idx == 0u)
+        // If we don't get a box back, then we can quit this while loop,
+        // as variation in every QoI is within tols.
+        if (boxes.empty())
         {
+            std::cout
+                << "Error estimates are within requested tolerances... finishing\n"
+                << std::flush;
             meets_all_tolerances = true;
+            break;
         }
 
-        if (!meets_tolerance)
+        // Subdivide these boxes (NB if we GetCorners() after this,
+        // it includes the new points and makes no sense!).
+        // Neighbouring boxes share their new corners, so each point is only evaluated once.
+        CornerSet new_parameter_points;
+        for (unsigned i = 0; i < boxes.size(); i++)
         {
-            meets_all_tolerances = false;
+            CornerSet new_points_in_this_box = mAnisotropicRefinement
+                ? boxes[i]->SubDivide(boxes[i]->GetDimensionsToRefine(mQoITolerances))
+                : boxes[i]->SubDivide();
+            new_parameter_points.insert(new_points_in_this_box.begin(), new_points_in_this_box.end());
         }
+
+        // Evaluate at these points all together.
+        RunEvaluationsForThesePoints(new_parameter_points, p_file);
     }
 
-    p_file->close();
+    if (PetscTools::AmMaster())
+    {
+        p_file->close();
+    }
 
     if (meets_all_tolerances)
     {
@@ -279,85 +447,118 @@ template <unsigned DIM>
 void LookupTableGenerator<DIM>::RunEvaluationsForThesePoints(
     CornerSet setOfPoints, out_stream &rFile)
 {
-    // Setup variables to control threading
-    unsigned num_threads = setOfPoints.size();
-    boost::scoped_array<ThreadInputData> thread_data(new ThreadInputData[num_threads]);
-    // struct ThreadInputData thread_data[num_threads];
-    boost::scoped_array<void *> answers(new void *[num_threads]);
-    int return_code;
+    const unsigned num_points = setOfPoints.size();
+    std::vector<c_vector<double, DIM> *> points(setOfPoints.begin(), setOfPoints.end());
 
-    // Generate the threads
-    boost::scoped_array<pthread_t> threads(new pthread_t[num_threads]);
+    // Any points we have results for in the journal don't need simulating again.
+    std::vector<boost::shared_ptr<ParameterPointData> > journalled_data(num_points);
+    std::vector<unsigned> points_to_evaluate;
+    for (unsigned i = 0; i < num_points; i++)
+    {
+        std::vector<double> point(points[i]->begin(), points[i]->end());
+        auto journalled = mJournalledResults.find(point);
+        if (journalled != mJournalledResults.end())
+        {
+            journalled_data[i] = journalled->second;
+            mJournalledResults.erase(journalled);
+        }
+        else
+        {
+            points_to_evaluate.push_back(i);
+        }
+    }
 
-    // Create a couple of counters for convenience
-    CornerSetIter iter;
-    int i;
+    // Set up the inputs for each point
+    const unsigned num_to_evaluate = points_to_evaluate.size();
+    boost::shared_ptr<SteadyStateCache> p_steady_state_cache = SteadyStateCache::CreateFromCommandLine();
+    std::vector<ThreadInputData> thread_data(num_to_evaluate);
+    std::vector<ThreadReturnData> answers(num_to_evaluate);
 
-    /*
-     *This loop launches each of the threads.
-     */
-    for (iter = setOfPoints.begin(), i = 0;
-         iter != setOfPoints.end();
-         ++iter, ++i)
+    for (unsigned i = 0; i < num_to_evaluate; i++)
     {
+        const c_vector<double, DIM>& r_point = *(points[points_to_evaluate[i]]);
         std::vector<double> scalings;
         for (unsigned j = 0; j < DIM; j++)
         {
-            scalings.push_back((*(*iter))[j]);
+            scalings.push_back(r_point[j]);
         }
         thread_data[i].scalings = scalings;
         thread_data[i].mParameterNames = mParameterNames;
         thread_data[i].mUnscaledParameters = mUnscaledParameters;
         thread_data[i].mQuantitiesToRecord = mQuantitiesToRecord;
-        thread_data[i].mInitialConditions = mInitialConditions;
+        thread_data[i].mInitialConditions = mContinuation ? GetNearestState(r_point) : mInitialConditions;
         thread_data[i].mMaxNumPaces = mMaxNumPaces;
         thread_data[i].mModelIndex = mModelIndex;
         thread_data[i].mFrequency = mFrequency;
         thread_data[i].mVoltageThreshold = mVoltageThreshold;
-
-        // std::cout << "Launching pthread[" << i << "]" << std::endl;
-
-        // Launch the ThreadedActionPotential method on this thread
-        return_code = pthread_create(&threads[i], NULL, ThreadedActionPotential,
-                                     (void *)&thread_data[i]);
-
-        assert(0 == return_code); // Check launch worked OK
-        EXCEPT_IF_NOT(0 == return_code);
-
-        // Horrific seg. faults without the below line - bug in p_threads?
-        usleep(1e5); // 0.1 second pause to allow thread to launch properly!
+        thread_data[i].mpSteadyStateCache = p_steady_state_cache;
     }
 
     /*
-     * This loop gets the answers back from all the threads.
+     * The points are dealt out between the processes, and each process works through its share with a
+     * fixed number of threads, each taking the next point as soon as it has finished its last one and
+     * storing the answer in that point's slot. Then every process gets every answer, so they can all
+     * refine their parameter boxes in the same way.
+     *
+     * (Every process reads the same journal, so they all agree on which points to evaluate.)
      */
-    for (iter = setOfPoints.begin(), i = 0;
-         iter != setOfPoints.end();
-         ++iter, ++i)
+    if (num_to_evaluate > 0u)
     {
-        // Get the answers back
-        return_code = pthread_join(threads[i], &answers[i]);
-        assert(0 == return_code);
-        EXCEPT_IF_NOT(0 == return_code);
+        const unsigned num_my_points = DistributedTasks::GetMyTasks(num_to_evaluate).size();
+        unsigned num_threads = (mNumThreads == 0u) ? WorkerPool::GetNumHardwareThreads() : mNumThreads;
+        num_threads = std::max(1u, std::min(num_threads, num_my_points));
+        WorkerPool pool(num_threads);
+        if (mWorkerModels.size() < num_threads)
+        {
+            mWorkerModels.resize(num_threads);
+        }
+        DistributedTasks::RunMyTasks(pool, num_to_evaluate, [&](unsigned task_index, unsigned worker_index) {
+            if (mReuseModels)
+            {
+                ThreadedActionPotential(thread_data[task_index], mWorkerModels[worker_index], answers[task_index]);
+            }
+            else
+            {
+                boost::shared_ptr<AbstractCvodeCell> p_new_model;
+                ThreadedActionPotential(thread_data[task_index], p_new_model, answers[task_index]);
+            }
+        });
+        ShareThreadReturnData(answers);
+    }
 
-        // Translate back from the structs to sensible formats.
-        ThreadReturnData *thread_results = (ThreadReturnData *)answers[i];
-        if (thread_results->exceptionOccurred)
+    /*
+     * The answers are recorded in the order of the points, so the table (and its refinement)
+     * does not depend on which point happened to finish first.
+     */
+    std::vector<unsigned> new_evaluations;
+    for (unsigned i = 0, answer_index = 0; i < num_points; i++)
+    {
+        boost::shared_ptr<ParameterPointData> data = journalled_data[i];
+        if (!data)
         {
-            EXCEPTION(
-                "A thread threw the exception: " << thread_results->exceptionMessage);
+            // Translate back from the structs to sensible formats.
+            ThreadReturnData *thread_results = &answers[answer_index++];
+            if (thread_results->exceptionOccurred)
+            {
+                EXCEPTION(
+                    "A thread threw the exception: " << thread_results->exceptionMessage);
+            }
+
+            data = boost::shared_ptr<ParameterPointData>(
+                new ParameterPointData(thread_results->QoIs, thread_results->errorOccurred));
+            if (mContinuation)
+            {
+                data->SetStateVariables(thread_results->stateVariables);
+            }
+            new_evaluations.push_back(mNumEvaluations);
         }
 
-        unsigned error_occurred = thread_results->errorOccurred;
-        std::vector<double> results = thread_results->QoIs;
-        c_vector<double, DIM> *p_scalings = *iter;
-        delete thread_results; // Clean up memory
+        const unsigned error_occurred = data->GetErrorCode();
+        const std::vector<double>& results = data->rGetQoIs();
+        c_vector<double, DIM> *p_scalings = points[i];
 
         // Store all the info in the master process and tell boxes about it.
         {
-            boost::shared_ptr<ParameterPointData> data = boost::shared_ptr<ParameterPointData>(
-                new ParameterPointData(results, error_occurred));
-
             mParameterPoints.push_back(*p_scalings);
             mParameterPointData.push_back(data);
             mNumEvaluations++;
@@ -366,6 +567,12 @@ void LookupTableGenerator<DIM>::RunEvaluationsForThesePoints(
             mpParentBox->AssignQoIValues(p_scalings, data);
             // This should have updated our error estimates in the ParameterPointData*
 
+            // Only the master writes the results out.
+            if (!PetscTools::AmMaster())
+            {
+                continue;
+            }
+
             std::stringstream line_of_output;
             line_of_output << std::setprecision(8);
             for (unsigned j = 0; j < DIM; j++)
@@ -384,7 +591,7 @@ void LookupTableGenerator<DIM>::RunEvaluationsForThesePoints(
                 for (unsigned j = 0; j < num_estimates; j++)
                 {
                     line_of_output << "\t" << data->rGetQoIErrorEstimates()[j];
-                    if (i == (int)(num_threads - 1u))
+                    if (i == num_points - 1u)
                     {
                         // An extra bit of reporting that might be nice can only be called when all boxes have all corner data
                         // i.e. when the last thread has finished, so will appear sporadically in the output!
@@ -396,21 +603,183 @@ void LookupTableGenerator<DIM>::RunEvaluationsForThesePoints(
             *rFile << line_of_output.str() << std::endl;
         }
     }
+
+    AppendToJournal(new_evaluations);
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::AppendToJournal(const std::vector<unsigned>& rEvaluations)
+{
+    if (mJournalFileName.empty() || rEvaluations.empty() || !PetscTools::AmMaster())
+    {
+        return;
+    }
+
+    // If we were stopped while writing the last record, cut it off, or the records after it would be read from the wrong place.
+    if (boost::filesystem::exists(mJournalFileName) && boost::filesystem::file_size(mJournalFileName) != (boost::uintmax_t)mJournalSize)
+    {
+        boost::filesystem::resize_file(mJournalFileName, mJournalSize);
+    }
+
+    std::ofstream journal(mJournalFileName.c_str(), std::ios::binary | std::ios::app);
+    for (unsigned i = 0; i < rEvaluations.size(); i++)
+    {
+        const unsigned evaluation = rEvaluations[i];
+        WriteToJournal(journal, evaluation);
+        WriteToJournal(journal, std::vector<double>(mParameterPoints[evaluation].begin(), mParameterPoints[evaluation].end()));
+        WriteToJournal(journal, mParameterPointData[evaluation]->GetErrorCode());
+        WriteToJournal(journal, mParameterPointData[evaluation]->rGetQoIs());
+        WriteToJournal(journal, mParameterPointData[evaluation]->rGetStateVariables());
+    }
+    journal.close(); // Flushes this batch to disk before we start on the next one.
+    if (journal.fail())
+    {
+        EXCEPTION("Could not write to the journal file " << mJournalFileName);
+    }
+    mJournalSize = boost::filesystem::file_size(mJournalFileName);
+}
+
+template <unsigned DIM>
+std::string LookupTableGenerator<DIM>::GetJournalHeader() const
+{
+    std::stringstream header;
+    header << std::setprecision(17) << JournalHeaderStart
+           << "model " << mModelIndex << "\n"
+           << "frequency " << mFrequency << "\n";
+    for (unsigned i = 0; i < mParameterNames.size(); i++)
+    {
+        header << "parameter " << mParameterNames[i] << " " << mMinimums[i] << " " << mMaximums[i] << "\n";
+    }
+    header << "qois";
+    for (unsigned i = 0; i < mQuantitiesToRecord.size(); i++)
+    {
+        header << " " << (unsigned)(mQuantitiesToRecord[i]);
+    }
+    header << "\n";
+    return header.str();
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SetJournalFile(const std::string& rFileName)
+{
+    mJournalFileName = rFileName;
+    mJournalHeader.clear();
+    mJournalledResults.clear();
+    mJournalSize = 0;
+
+    // An empty (or missing) journal gets its header when the table is next generated.
+    std::ifstream journal(rFileName.c_str(), std::ios::binary);
+    if (journal.peek() != std::ifstream::traits_type::eof())
+    {
+        if (!ReadFromJournal(journal, mJournalHeader) || mJournalHeader.compare(0, JournalHeaderStart.size(), JournalHeaderStart) != 0)
+        {
+            mJournalHeader.clear();
+            EXCEPTION("The file " << rFileName << " is not a lookup table journal (or is from an older version of ApPredict).");
+        }
+        if (mQuantitiesToRecord.empty())
+        {
+            mJournalHeader.clear();
+            EXCEPTION("Add the quantities of interest before setting the journal file " << rFileName);
+        }
+        mJournalSize = journal.tellg();
+    }
+
+    const unsigned max_num_state_variables = mInitialConditions.empty() ? MaxJournalledStateVariables : mInitialConditions.size();
+    while (journal.good())
+    {
+        // If we were stopped while writing the last record it may be incomplete, we just ignore it
+        // (and it is cut off before anything else is appended, see AppendToJournal()).
+        unsigned evaluation;
+        std::vector<double> point;
+        unsigned error_code;
+        std::vector<double> qois;
+        std::vector<double> state_variables;
+        if (!ReadFromJournal(journal, evaluation)
+            || !ReadFromJournal(journal, point, DIM)
+            || point.size() != DIM
+            || !ReadFromJournal(journal, error_code)
+            || !ReadFromJournal(journal, qois, mQuantitiesToRecord.size())
+            || !ReadFromJournal(journal, state_variables, max_num_state_variables))
+        {
+            break;
+        }
+        mJournalSize = journal.tellg();
+
+        // Skip evaluations that are already in this generator (from its archive).
+        if (evaluation < mNumEvaluations)
+        {
+            continue;
+        }
+
+        boost::shared_ptr<ParameterPointData> p_data(new ParameterPointData(qois, error_code));
+        if (!state_variables.empty())
+        {
+            p_data->SetStateVariables(state_variables);
+        }
+        mJournalledResults[point] = p_data;
+    }
+
+    if (!mJournalledResults.empty())
+    {
+        std::cout << "Read " << mJournalledResults.size() << " evaluations from the journal.\n";
+    }
 }
 
-void *ThreadedActionPotential(void *argument)
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::StartNewJournal()
+{
+    if (mJournalFileName.empty())
+    {
+        EXCEPTION("No journal file has been set, see SetJournalFile().");
+    }
+
+    // The new journal is written alongside the old one and then moved over it, so if we are stopped
+    // part way through there is still a journal with a complete header.
+    const std::string header = GetJournalHeader();
+    bool failed = false;
+    if (PetscTools::AmMaster())
+    {
+        const std::string new_journal_filename = mJournalFileName + ".new";
+        {
+            std::ofstream journal(new_journal_filename.c_str(), std::ios::binary | std::ios::trunc);
+            WriteToJournal(journal, header);
+            journal.close();
+            failed = journal.fail();
+        }
+        failed = failed || std::rename(new_journal_filename.c_str(), mJournalFileName.c_str()) != 0;
+    }
+    // Everyone has to know if the master failed, or the others would wait for it forever.
+    if (PetscTools::ReplicateBool(failed))
+    {
+        EXCEPTION("Could not start a new journal file " << mJournalFileName);
+    }
+    mJournalHeader = header;
+    mJournalledResults.clear();
+    mJournalSize = sizeof(unsigned) + header.size();
+    PetscTools::Barrier("LookupTableGenerator::StartNewJournal");
+}
+
+void ThreadedActionPotential(const ThreadInputData& rInput,
+                             boost::shared_ptr<AbstractCvodeCell>& rpModel,
+                             ThreadReturnData& rOutput)
 {
     // bool debugging_on = true;
 
-    struct ThreadInputData *my_data;
-    my_data = (struct ThreadInputData *)argument;
+    const ThreadInputData* my_data = &rInput;
 
     std::vector<double> scalings = my_data->scalings;
     assert(scalings.size() == my_data->mParameterNames.size());
 
-    SetupModel setup(my_data->mFrequency,
-                     my_data->mModelIndex); // Ten tusscher '06 at 1 Hz
-    boost::shared_ptr<AbstractCvodeCell> p_model = setup.GetModel();
+    // Each worker sets up its model the first time it is used, and then re-uses it for later points,
+    // every parameter and state variable that a point changes is set again below.
+    if (!rpModel)
+    {
+        std::lock_guard<std::mutex> lock(SetupModelMutex);
+        SetupModel setup(my_data->mFrequency,
+                         my_data->mModelIndex); // Ten tusscher '06 at 1 Hz
+        rpModel = setup.GetModel();
+    }
+    boost::shared_ptr<AbstractCvodeCell> p_model = rpModel;
 
     // Do parameter scalings
     for (unsigned i = 0; i < scalings.size(); i++)
@@ -431,6 +800,7 @@ void *ThreadedActionPotential(void *argument)
     // Reset the state variables to the 'standard' steady state
     N_Vector state_vars = MakeNVector(my_data->mInitialConditions);
     p_model->SetStateVariables(state_vars);
+    p_model->ResetSolver(); // So CVODE starts afresh, as it would with a new model.
 
     SingleActionPotentialPrediction ap_runner(p_model);
     ap_runner.SuppressOutput();
@@ -439,44 +809,87 @@ void *ThreadedActionPotential(void *argument)
     ap_runner.SetVoltageThresholdForRecordingAsActionPotential(
         my_data->mVoltageThreshold);
 
+    // Re-use the results of an identical simulation if we have them.
+    bool calculate_qnet = std::find(my_data->mQuantitiesToRecord.begin(), my_data->mQuantitiesToRecord.end(), QNet) != my_data->mQuantitiesToRecord.end();
+    SteadyStateResult result;
+    std::string description;
+    bool cached = false;
+    if (my_data->mpSteadyStateCache)
+    {
+        std::stringstream extra;
+        extra << "qnet " << calculate_qnet << "\n";
+        description = ap_runner.GetSteadyStateDescription(p_model, 0.1) + extra.str();
+        cached = my_data->mpSteadyStateCache->Load(description, result);
+    }
+
     // Call the SingleActionPotentialPrediction methods.
     try
     {
-        //        if (debugging_on)
-        //        {
-        //            std::stringstream filename;
-        //            for (unsigned i = 0; i < scalings.size(); i++)
-        //            {
-        //                filename << scalings[i] << "_";
-        //            }
-        //            OdeSolution solution = ap_runner.RunSteadyPacingExperiment();
-        //            solution.WriteToFile("Debugging_Lookup", filename.str(), "ms",
-        //            1, false);
-        //        }
-        //        else
-        //        {
-        ap_runner.RunSteadyPacingExperiment();
-        //        }
+        if (!cached)
+        {
+            //        if (debugging_on)
+            //        {
+            //            std::stringstream filename;
+            //            for (unsigned i = 0; i < scalings.size(); i++)
+            //            {
+            //                filename << scalings[i] << "_";
+            //            }
+            //            OdeSolution solution = ap_runner.RunSteadyPacingExperiment();
+            //            solution.WriteToFile("Debugging_Lookup", filename.str(), "ms",
+            //            1, false);
+            //        }
+            //        else
+            //        {
+            ap_runner.RunSteadyPacingExperiment();
+            //        }
+
+            result.mErrorOccurred = ap_runner.DidErrorOccur();
+            result.mErrorCode = ap_runner.GetErrorCode(); // 0 if there was no error
+            if (result.mErrorOccurred)
+            {
+                result.mErrorMessage = ap_runner.GetErrorMessage();
+            }
+            else
+            {
+                result.mApd90 = ap_runner.GetApd90();
+                result.mApd50 = ap_runner.GetApd50();
+                result.mUpstroke = ap_runner.GetUpstrokeVelocity();
+                result.mPeak = ap_runner.GetPeakVoltage();
+                result.mPeakTime = ap_runner.GetTimeOfPeakVoltage();
+                result.mCaMax = ap_runner.GetCaMax();
+                result.mCaMin = ap_runner.GetCaMin();
+                if (calculate_qnet)
+                {
+                    result.mQNet = ap_runner.CalculateQNet();
+                }
+            }
+            result.mStateVariables = p_model->GetStdVecStateVariables();
+            if (my_data->mpSteadyStateCache)
+            {
+                my_data->mpSteadyStateCache->Save(description, result);
+            }
+        }
     }
     catch (Exception &e)
     {
-        ThreadReturnData *return_data = new ThreadReturnData;
-        return_data->exceptionOccurred = true;
-        return_data->exceptionMessage = e.GetShortMessage();
+        rOutput.exceptionOccurred = true;
+        rOutput.exceptionMessage = e.GetShortMessage();
 
+        // The model may have been left in a bad state, so the next point gets a new one.
+        rpModel.reset();
         DeleteVector(state_vars);
-        pthread_exit(return_data);
+        return;
     }
 
-    unsigned error_occurred = ap_runner.GetErrorCode(); // 0 if there was no error
+    unsigned error_occurred = result.mErrorCode;
 
     // Record the results
     std::vector<double> results;
     for (unsigned i = 0; i < my_data->mQuantitiesToRecord.size(); i++)
     {
-        if (ap_runner.DidErrorOccur())
+        if (result.mErrorOccurred)
         {
-            std::string error_message = ap_runner.GetErrorMessage();
+            std::string error_message = result.mErrorMessage;
             std::cout << "Lookup table generator reports that " << error_message
                       << "\n"
                       << std::flush;
@@ -513,34 +926,33 @@ void *ThreadedActionPotential(void *argument)
         double temp;
         if (my_data->mQuantitiesToRecord[i] == Apd90)
         {
-            temp = ap_runner.GetApd90();
+            temp = result.mApd90;
         }
         else if (my_data->mQuantitiesToRecord[i] == Apd50)
         {
-            temp = ap_runner.GetApd50();
+            temp = result.mApd50;
         }
         else if (my_data->mQuantitiesToRecord[i] == UpstrokeVelocity)
         {
-            temp = ap_runner.GetUpstrokeVelocity();
+            temp = result.mUpstroke;
         }
         else if (my_data->mQuantitiesToRecord[i] == PeakVoltage)
         {
-            temp = ap_runner.GetPeakVoltage();
+            temp = result.mPeak;
         }
         else if (my_data->mQuantitiesToRecord[i] == QNet)
         {
-            temp = ap_runner.CalculateQNet();
+            temp = result.mQNet;
         }
         results.push_back(temp);
     }
 
-    ThreadReturnData *return_data = new ThreadReturnData;
-    return_data->QoIs = results;
-    return_data->errorOccurred = error_occurred;
-    return_data->exceptionOccurred = false;
+    rOutput.QoIs = results;
+    rOutput.stateVariables = result.mStateVariables;
+    rOutput.errorOccurred = error_occurred;
+    rOutput.exceptionOccurred = false;
 
     DeleteVector(state_vars);
-    pthread_exit(return_data);
 }
 
 template <unsigned DIM>
@@ -642,14 +1054,29 @@ void LookupTableGenerator<DIM>::SetMaxVariationInRefinement(
 
 template <unsigned DIM>
 std::vector<std::vector<double>> LookupTableGenerator<DIM>::Interpolate(
-    const std::vector<c_vector<double, DIM>> &rParameterPoints)
+    const std::vector<c_vector<double, DIM>> &rParameterPoints) const
 {
     std::vector<std::vector<double>> interpolated_values;
+    if (rParameterPoints.empty())
+    {
+        return interpolated_values;
+    }
+
+    // Put the points together for the compiled table.
+    std::vector<double> points(rParameterPoints.size() * DIM);
+    for (unsigned i = 0; i < rParameterPoints.size(); i++)
+    {
+        std::copy(rParameterPoints[i].begin(), rParameterPoints[i].end(), points.begin() + i * DIM);
+    }
+
+    const unsigned num_qois = rGetCompiledTable().GetNumQoIs();
+    std::vector<double> results(rParameterPoints.size() * num_qois);
+    Interpolate(points.data(), rParameterPoints.size(), results.data());
 
     for (unsigned i = 0; i < rParameterPoints.size(); i++)
     {
-        interpolated_values.push_back(
-            mpParentBox->InterpolateQoIsAt(rParameterPoints[i]));
+        interpolated_values.push_back(std::vector<double>(results.begin() + i * num_qois,
+                                                          results.begin() + (i + 1u) * num_qois));
     }
 
     return interpolated_values;
@@ -657,22 +1084,45 @@ std::vector<std::vector<double>> LookupTableGenerator<DIM>::Interpolate(
 
 template <unsigned DIM>
 std::vector<std::vector<double>> LookupTableGenerator<DIM>::Interpolate(
-    const std::vector<std::vector<double>> &rParameterPoints)
+    const std::vector<std::vector<double>> &rParameterPoints) const
 {
-    // Convert std::vector to c_vector...
-    std::vector<c_vector<double, DIM>> c_vec_parameter_points;
-    for (unsigned i = 0; i < rParameterPoints.size(); i++)
-    {
-        assert(rParameterPoints[i].size() == DIM);
-        c_vector<double, DIM> c_vec_point;
-        for (unsigned j = 0; j < DIM; j++)
-        {
-            c_vec_point[j] = rParameterPoints[i][j];
-        }
-        c_vec_parameter_points.push_back(c_vec_point);
-    }
-    // Now just call the method above.
-    return Interpolate(c_vec_parameter_points);
+    return rGetCompiledTable().Interpolate(rParameterPoints);
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::Interpolate(const double *pParameterPoints,
+                                            unsigned numPoints,
+                                            double *pResults) const
+{
+    rGetCompiledTable().Interpolate(pParameterPoints, numPoints, pResults);
+}
+
+template <unsigned DIM>
+unsigned LookupTableGenerator<DIM>::GetNumQoIs() const
+{
+    return mQuantitiesToRecord.size();
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SaveCompiledTable(const std::string &rFileName, const std::string &rArchiveFileName)
+{
+    rGetCompiledTable().WriteToFile(rFileName, rArchiveFileName);
+}
+
+template <unsigned DIM>
+boost::shared_ptr<AbstractLookupTable> LookupTableGenerator<DIM>::MakeSlice(const std::vector<unsigned> &rDimensionsToKeep) const
+{
+    return rGetCompiledTable().MakeSlice(rDimensionsToKeep);
+}
+
+template <unsigned DIM>
+const CompiledLookupTable<DIM> &LookupTableGenerator<DIM>::rGetCompiledTable() const
+{
+    // Threads interpolating at the same time wait for whichever of them makes the copy.
+    std::call_once(*mpCompileTableOnce, [this]() {
+        mpCompiledTable.reset(new CompiledLookupTable<DIM>(*mpParentBox, mParameterNames));
+    });
+    return *mpCompiledTable;
 }
 
 template <unsigned DIM>
@@ -687,6 +1137,92 @@ void LookupTableGenerator<DIM>::SetMaxNumPaces(unsigned numPaces)
     mMaxNumPaces = numPaces;
 }
 
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SetNumThreads(unsigned numThreads)
+{
+    mNumThreads = numThreads;
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SetContinuation(bool continuation)
+{
+    mContinuation = continuation;
+}
+
+template <unsigned DIM>
+std::vector<double> LookupTableGenerator<DIM>::GetNearestState(const c_vector<double, DIM>& rPoint)
+{
+    // Index any points evaluated since last time (all of them, after loading from an archive).
+    for (; mNumPointsIndexed < mParameterPoints.size(); mNumPointsIndexed++)
+    {
+        const c_vector<double, DIM>& r_point = mParameterPoints[mNumPointsIndexed];
+        mEvaluationIndices[std::vector<double>(r_point.begin(), r_point.end())] = mNumPointsIndexed;
+    }
+
+    // The point is a corner of a new box, whose parent is the box that was subdivided.
+    ParameterBox<DIM>* p_box = mpParentBox->GetBoxContainingPoint(rPoint);
+    if (p_box->GetGeneration() > 0u)
+    {
+        p_box = p_box->GetParent();
+    }
+
+    // Points with errors may not have reached a sensible steady state, so we don't start from those.
+    // If none of the box's corners will do, try its parent's, but go no further up the tree.
+    const std::vector<double>* p_nearest_state = &mInitialConditions;
+    double nearest_distance = DBL_MAX;
+    for (unsigned level = 0; level < 2u && p_nearest_state == &mInitialConditions; level++)
+    {
+        std::vector<c_vector<double, DIM>*> corners = p_box->GetCornersAsVector();
+        for (unsigned i = 0; i < corners.size(); i++)
+        {
+            auto evaluation = mEvaluationIndices.find(std::vector<double>(corners[i]->begin(), corners[i]->end()));
+            if (evaluation == mEvaluationIndices.end())
+            {
+                continue;
+            }
+            const boost::shared_ptr<ParameterPointData>& p_data = mParameterPointData[evaluation->second];
+            if (!p_data->HasStateVariables() || p_data->GetErrorCode() != 0u)
+            {
+                continue;
+            }
+            const double distance = norm_2(*(corners[i]) - rPoint);
+            if (distance < nearest_distance)
+            {
+                nearest_distance = distance;
+                p_nearest_state = &(p_data->rGetStateVariables());
+            }
+        }
+        if (p_box->GetGeneration() == 0u)
+        {
+            break;
+        }
+        p_box = p_box->GetParent();
+    }
+    return *p_nearest_state;
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SetNumBoxesToRefineTogether(unsigned numBoxes)
+{
+    if (numBoxes == 0u)
+    {
+        EXCEPTION("At least one box must be refined at a time.");
+    }
+    mNumBoxesToRefineTogether = numBoxes;
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SetAnisotropicRefinement(bool anisotropic)
+{
+    mAnisotropicRefinement = anisotropic;
+}
+
+template <unsigned DIM>
+void LookupTableGenerator<DIM>::SetReuseModels(bool reuseModels)
+{
+    mReuseModels = reuseModels;
+}
+
 template <unsigned DIM>
 unsigned LookupTableGenerator<DIM>::GetMaxNumPaces()
 {
@@ -697,6 +1233,7 @@ template <unsigned DIM>
 void LookupTableGenerator<DIM>::SetPacingFrequency(double frequency)
 {
     mFrequency = frequency;
+    mWorkerModels.clear(); // These were set up for the old frequency.
 }
 
 template <unsigned DIM>
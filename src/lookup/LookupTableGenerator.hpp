@@ -37,6 +37,9 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define LOOKUPTABLEGENERATOR_HPP_
 
 #include <boost/shared_ptr.hpp>
+#include <ios>
+#include <map>
+#include <mutex>
 #include <set>
 // Seems that whatever version of ublas we are using now contains
 // boost serialization methods for c_vector, which is nice.
@@ -49,6 +52,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "AbstractCvodeCell.hpp"
 #include "AbstractUntemplatedLookupTableGenerator.hpp"
+#include "CompiledLookupTable.hpp"
 #include "Exception.hpp"
 #include "OutputFileHandler.hpp"
 #include "ParameterBox.hpp"
@@ -127,6 +131,14 @@ private:
         {
             mVoltageThreshold = -50;
         }
+        if (version > 3u)
+        {
+            archive& mContinuation;
+        }
+        else
+        {
+            mContinuation = false;
+        }
     }
 
     /** Helper wrappers round these long-winded set and iterator names */
@@ -198,9 +210,118 @@ private:
 	 * an excited AP" or not. */
     double mVoltageThreshold;
 
+    /**
+     * Whether to start each new point from the steady state of the nearest point already evaluated,
+     * rather than from mInitialConditions.
+     */
+    bool mContinuation;
+
+    /**
+     * The index in #mParameterPoints of each point evaluated, so that GetNearestState() can find the
+     * steady states at the corners of a box without searching through every point. This isn't archived,
+     * but is filled in from #mParameterPoints when it is needed.
+     */
+    std::map<std::vector<double>, unsigned> mEvaluationIndices;
+
+    /** How many of #mParameterPoints are in #mEvaluationIndices so far. */
+    unsigned mNumPointsIndexed;
+
+    /**
+     * New points are corners of the boxes just made by subdividing a box, so the nearest points
+     * already evaluated are the corners of the box that was subdivided, or failing that its parent's.
+     * Only these are searched, so this takes the same time however big the table is.
+     *
+     * @param rPoint  A point in parameter space.
+     * @return The steady state of the nearest of these corners already evaluated without error,
+     *         or mInitialConditions if none of them has a steady state kept.
+     */
+    std::vector<double> GetNearestState(const c_vector<double, DIM>& rPoint);
+
+    /**
+     * The number of threads to evaluate points on, zero means one per hardware thread.
+     * This is a setting for the machine we are running on, so it isn't archived.
+     */
+    unsigned mNumThreads;
+
+    /**
+     * The number of boxes to subdivide before evaluating all their new corners in one batch,
+     * one (the default) refines the single worst box at a time. Also not archived.
+     */
+    unsigned mNumBoxesToRefineTogether;
+
+    /**
+     * Whether to split boxes only along the dimensions that cause most of their error,
+     * see SetAnisotropicRefinement(). Not archived.
+     */
+    bool mAnisotropicRefinement;
+
+    /**
+     * A flat read-only copy of the table for interpolating, made when it is first needed
+     * after the table is generated or loaded, and thrown away if it is refined again. Not archived.
+     */
+    mutable boost::shared_ptr<CompiledLookupTable<DIM> > mpCompiledTable;
+
+    /**
+     * Makes sure #mpCompiledTable is only made once, however many threads interpolate at the same time.
+     * Replaced with a new flag whenever the compiled copy is thrown away. Not archived.
+     */
+    boost::shared_ptr<std::once_flag> mpCompileTableOnce;
+
+    /**
+     * @return The flat copy of the table for interpolating (see #mpCompiledTable), making it if need be.
+     */
+    const CompiledLookupTable<DIM>& rGetCompiledTable() const;
+
+    /**
+     * A model for each worker thread, set up when the worker first needs it and re-used for
+     * every point after that, rather than setting up a model for each point. Not archived.
+     */
+    std::vector<boost::shared_ptr<AbstractCvodeCell> > mWorkerModels;
+
+    /** Whether to use #mWorkerModels, see SetReuseModels(). Not archived. */
+    bool mReuseModels;
+
+    /**
+     * The journal file that each newly evaluated point is appended to (see SetJournalFile()),
+     * empty if we aren't keeping one. This is a setting for the run, so it isn't archived.
+     */
+    std::string mJournalFileName;
+
+    /**
+     * The header of the journal file (see GetJournalHeader()), as read from the file
+     * or written to it, empty if the journal hasn't got one yet.
+     */
+    std::string mJournalHeader;
+
+    /**
+     * Results read from the journal that are not in the table yet, by parameter point.
+     * When refinement reaches one of these points again the result is used instead of a simulation.
+     */
+    std::map<std::vector<double>, boost::shared_ptr<ParameterPointData> > mJournalledResults;
+
+    /**
+     * The size in bytes of the header and complete records of the journal. Anything after this is a
+     * record we were stopped while writing, which is cut off before the journal is appended to.
+     */
+    std::streamoff mJournalSize;
+
+    /**
+     * Append the results of some evaluations to the journal (only the master does this).
+     *
+     * @param rEvaluations  The indices of the evaluations in #mParameterPoints and #mParameterPointData.
+     */
+    void AppendToJournal(const std::vector<unsigned>& rEvaluations);
+
+    /**
+     * @return The header for a journal of this generator's evaluations. It records the model,
+     * pacing frequency, parameters and their ranges, and the QoIs, so a journal can't be
+     * replayed into a table that it wasn't kept for.
+     */
+    std::string GetJournalHeader() const;
+
     /**
 	 * This method will farm out the evaluation of a set of points using
-	 * multi-threading.
+	 * multi-threading (see SetNumThreads()).
 	 *
 	 * @param setOfPoints  A collection of points in parameter space at which to
 	 * evaluate QoIs.
@@ -296,6 +417,86 @@ public:
 	 */
     unsigned GetMaxNumPaces();
 
+    /**
+     * Set how many threads to evaluate points on.
+     *
+     * @param numThreads  The number of threads, zero (the default) means one per hardware thread.
+     */
+    void SetNumThreads(unsigned numThreads);
+
+    /**
+     * Set how many boxes to subdivide in each round of refinement.
+     *
+     * With more than one, the boxes with the largest error estimates are subdivided together and
+     * all of their new corners evaluated in one batch, which keeps more threads busy in low dimensions
+     * (at the cost of sometimes refining a box that one-at-a-time refinement would have left alone).
+     * The maximum number of evaluations may be overshot by up to one batch.
+     *
+     * @param numBoxes  The number of boxes to refine at a time, defaults to one.
+     */
+    void SetNumBoxesToRefineTogether(unsigned numBoxes);
+
+    /**
+     * Set whether to split boxes only along the dimensions whose curvature causes most of the
+     * error in the QoIs (see ParameterBox::GetDimensionsToRefine()), rather than along all of them.
+     *
+     * Subdividing a box along every dimension needs up to 3^DIM - 2^DIM new points, often the QoIs
+     * change quickly with only one or two of the parameters, and halving the box along just those
+     * needs far fewer, which makes tables in six or seven dimensions affordable.
+     *
+     * @param anisotropic  Whether to do this, defaults to false.
+     */
+    void SetAnisotropicRefinement(bool anisotropic);
+
+    /**
+     * Set whether each worker thread re-uses one model for all of its points, or sets up a new
+     * model for every point as the generator used to. Both give identical tables, re-using the
+     * models is just quicker.
+     *
+     * @param reuseModels  Whether to re-use the models, defaults to true.
+     */
+    void SetReuseModels(bool reuseModels);
+
+    /**
+     * Set whether to start each new point from the steady state of the nearest point
+     * already evaluated (by distance in parameter space), rather than from the control
+     * steady state. Points in a refined part of the table are then close to their
+     * neighbours and need far fewer paces to reach steady state.
+     *
+     * Only points evaluated while this is switched on keep their steady state.
+     *
+     * @param continuation  Whether to do this, defaults to false.
+     */
+    void SetContinuation(bool continuation);
+
+    /**
+     * Keep an append-only journal of evaluations, so that a run which is stopped can carry on
+     * without re-running the simulations it had done since the generator was last archived.
+     *
+     * The results of each batch of points are appended to the journal (by the master process)
+     * as soon as they have been evaluated, so this costs time in proportion to the new points
+     * rather than the whole table. Any results already in the journal for evaluations beyond those
+     * in this generator are read back in, and are used instead of simulating when refinement reaches
+     * those points again, so set up a new (or loaded) generator as before and it will replay them.
+     *
+     * Archiving the generator is then only needed occasionally, to compact the journal,
+     * see StartNewJournal().
+     *
+     * The journal starts with a header recording the model, pacing frequency, parameters and
+     * their ranges, and QoIs. GenerateLookupTable() throws if these don't match the generator's,
+     * so set the parameters and QoIs before calling this.
+     *
+     * @param rFileName  The full path of the journal file (it is created when the table is
+     *     next generated if it doesn't exist).
+     */
+    void SetJournalFile(const std::string& rFileName);
+
+    /**
+     * Empty the journal (leaving just its header), call this once the generator has been
+     * archived (safely), as the archive then contains everything in the journal.
+     */
+    void StartNewJournal();
+
     /**
 	 * Add a quantity of interest to create a lookup table for.
 	 *
@@ -337,7 +538,7 @@ public:
 	 * like to estimate QoIs.
 	 * @return The QoI estimates at these points.
 	 */
-    std::vector<std::vector<double> > Interpolate(const std::vector<c_vector<double, DIM> >& rParameterPoints);
+    std::vector<std::vector<double> > Interpolate(const std::vector<c_vector<double, DIM> >& rParameterPoints) const;
 
     /**
 	 * Provide an interpolated estimate for the quantities of interest throughout
@@ -346,7 +547,40 @@ public:
 	 * @param rParameterPoints  The points in parameter space at which we would like to estimate QoIs.
 	 * @return The QoI estimates at these points.
 	 */
-    std::vector<std::vector<double> > Interpolate(const std::vector<std::vector<double> >& rParameterPoints);
+    std::vector<std::vector<double> > Interpolate(const std::vector<std::vector<double> >& rParameterPoints) const;
+
+    /**
+     * Provide an interpolated estimate for the quantities of interest throughout parameter space,
+     * the same as the methods above but without allocating anything for each point.
+     *
+     * @param pParameterPoints  The points in parameter space, DIM values for the first point, then the second, etc.
+     * @param numPoints  The number of points.
+     * @param pResults  Filled in with the QoI estimates, one for each quantity of interest at the first point,
+     *                  then the second, etc. (so it must have room for numPoints times the number of QoIs).
+     */
+    void Interpolate(const double* pParameterPoints, unsigned numPoints, double* pResults) const;
+
+    /**
+     * @return The number of quantities of interest in this table.
+     */
+    unsigned GetNumQoIs() const;
+
+    /**
+     * Write the table as a flat file that CompiledLookupTable can map straight into memory.
+     *
+     * @param rFileName  The full path of the file to write.
+     * @param rArchiveFileName  The full path of the archive this generator was loaded from (if any).
+     */
+    void SaveCompiledTable(const std::string& rFileName, const std::string& rArchiveFileName = "");
+
+    /**
+     * Make a table of fewer dimensions from the slice of this one where the other parameters are at
+     * their maximum, see CompiledLookupTable::MakeSlice().
+     *
+     * @param rDimensionsToKeep  The dimensions of this table to keep, in increasing order.
+     * @return The table of the slice.
+     */
+    boost::shared_ptr<AbstractLookupTable> MakeSlice(const std::vector<unsigned>& rDimensionsToKeep) const;
 
     /**
 	 * @return The number of evaluations (points in the lookup table at which
@@ -395,7 +629,7 @@ namespace serialization
     template <unsigned DIM>
     struct version<LookupTableGenerator<DIM> >
     {
-        CHASTE_VERSION_CONTENT(3); // Increment this on serialize method changes.
+        CHASTE_VERSION_CONTENT(4); // Increment this on serialize method changes.
     };
 } // namespace serialization
 } // namespace boost
@@ -33,6 +33,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <sstream>
 #include <boost/archive/archive_exception.hpp>
 #include <sys/stat.h> // For system commands to download and unpack Lookup Table file.
 
@@ -41,8 +42,10 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CommandLineArguments.hpp"
 #include "FileFinder.hpp"
+#include "PetscTools.hpp"
 
 // ApPredict includes
+#include "CompiledLookupTable.hpp"
 #include "LookupTableGenerator.hpp"
 #include "LookupTableLoader.hpp"
 
@@ -105,16 +108,22 @@ LookupTableLoader::LookupTableLoader(const std::string& rModelName, const double
             if (std::find(website_list.begin(), website_list.end(), possible_list[i]) != website_list.end())
             {
                 std::cout << "Web lookup table found for " << possible_list[i] << std::endl;
-                mBestAvailableLookupTable = possible_list[i];
-                // Download and unpack it
-                DownloadAndUnpack(mBestAvailableLookupTable);
-                break;
+                // Download and unpack it, or carry on looking if we can't
+                if (DownloadAndUnpack(possible_list[i]))
+                {
+                    mBestAvailableLookupTable = possible_list[i];
+                    break;
+                }
             }
         }
 
         if (mBestAvailableLookupTable != "")
         {
             LoadTableFromLocalBoostArchive(mBestAvailableLookupTable);
+            if (mpLookupTable)
+            {
+                SliceToIdealChannels();
+            }
         }
         else
         {
@@ -157,9 +166,41 @@ void LookupTableLoader::DecideIdealTable()
 void LookupTableLoader::LoadTableFromLocalBoostArchive(const std::string& rLookupTableBaseName)
 {
     // See if there is a table available in current working directory.
+    FileFinder compiled_table_file(rLookupTableBaseName + ".lut", RelativeTo::AbsoluteOrCwd);
     FileFinder ascii_archive_file(rLookupTableBaseName + ".arch", RelativeTo::AbsoluteOrCwd);
     FileFinder binary_archive_file(rLookupTableBaseName + "_BINARY.arch", RelativeTo::AbsoluteOrCwd);
 
+    // A compiled table is mapped straight into memory rather than deserialised, so we try that first,
+    // unless the archive it was made from (the one we would load, binary in preference) has changed since.
+    if (compiled_table_file.IsFile())
+    {
+        std::string archive_file_name;
+        if (binary_archive_file.IsFile())
+        {
+            archive_file_name = binary_archive_file.GetAbsolutePath();
+        }
+        else if (ascii_archive_file.IsFile())
+        {
+            archive_file_name = ascii_archive_file.GetAbsolutePath();
+        }
+
+        try
+        {
+            std::cout << "Mapping compiled lookup table into memory..." << std::flush;
+            Timer::Reset();
+            mpLookupTable = LoadCompiledTable(compiled_table_file.GetAbsolutePath(), archive_file_name);
+            std::cout << " done in " << Timer::GetElapsedTime()
+                      << " secs.\nLookup table is available for generation of credible "
+                         "intervals.\n";
+            return;
+        }
+        catch (Exception& e)
+        {
+            WARNING("Could not use compiled lookup table, error was: "
+                    << e.GetMessage() << "\nTrying the boost archives instead.");
+        }
+    }
+
     if (!ascii_archive_file.IsFile() && !binary_archive_file.IsFile())
     {
         // Neither local ascii nor binary are present.
@@ -208,6 +249,8 @@ void LookupTableLoader::LoadTableFromLocalBoostArchive(const std::string& rLooku
             }
         }
 
+        CompileLoadedTable(compiled_table_file.GetAbsolutePath(), binary_archive_file.GetAbsolutePath());
+
         // We have finished and loaded the generator.
         return;
     }
@@ -252,12 +295,13 @@ void LookupTableLoader::LoadTableFromLocalBoostArchive(const std::string& rLooku
         std::cout << " loaded in " << Timer::GetElapsedTime() << " secs."
                                                                  "\nLookup table is available for generation of credible intervals.\n";
 
+        bool binary_archive_saved = false;
         try
         {
             std::cout << "Saving a binary version of the archive for faster loading next time..." << std::flush;
 
             // Save a binary version to speed things up next time round.
-            AbstractUntemplatedLookupTableGenerator* const p_arch_generator = mpLookupTable.get();
+            AbstractUntemplatedLookupTableGenerator* const p_arch_generator = p_generator;
 
             std::ofstream binary_ofs(binary_archive_file.GetAbsolutePath().c_str(),
                                      std::ios::binary);
@@ -266,15 +310,181 @@ void LookupTableLoader::LoadTableFromLocalBoostArchive(const std::string& rLooku
             output_arch << p_arch_generator;
 
             std::cout << "done!\n";
+            binary_archive_saved = true;
         }
         catch (Exception& e)
         {
             WARNING("Did not manage to create binary lookup table archive. Error was: "
                     << e.GetMessage() << "\nContinuing to use ascii archive.");
         }
+
+        // Next time the binary archive will be the one loaded, so the compiled table is said to be made from that.
+        CompileLoadedTable(compiled_table_file.GetAbsolutePath(),
+                           binary_archive_saved ? binary_archive_file.GetAbsolutePath() : ascii_archive_file.GetAbsolutePath());
+    }
+}
+
+void LookupTableLoader::CompileLoadedTable(const std::string& rCompiledTableFileName,
+                                           const std::string& rArchiveFileName)
+{
+    boost::shared_ptr<AbstractUntemplatedLookupTableGenerator> p_generator
+        = boost::dynamic_pointer_cast<AbstractUntemplatedLookupTableGenerator>(mpLookupTable);
+    assert(p_generator);
+
+    std::cout << "Saving a compiled version of the lookup table for faster loading next time..." << std::flush;
+
+    // Every process may have just written the binary archive, so wait for them all before its size and time are noted.
+    PetscTools::Barrier("LookupTableLoader::CompileLoadedTable");
+
+    // Only the master writes the file (under a temporary name which is then renamed, so that no process
+    // using an old one has it truncated), and not at all if another run has already made it from this archive.
+    bool failed = false;
+    std::string error = "The master process could not write it.";
+    if (PetscTools::AmMaster())
+    {
+        try
+        {
+            try
+            {
+                LoadCompiledTable(rCompiledTableFileName, rArchiveFileName);
+            }
+            catch (Exception&)
+            {
+                p_generator->SaveCompiledTable(rCompiledTableFileName, rArchiveFileName);
+            }
+        }
+        catch (Exception& e)
+        {
+            failed = true;
+            error = e.GetMessage();
+        }
+    }
+    PetscTools::Barrier("LookupTableLoader::CompileLoadedTable");
+    if (PetscTools::ReplicateBool(failed))
+    {
+        WARNING("Did not manage to create compiled lookup table. Error was: "
+                << error << "\nContinuing to use the boost archive.");
+        return;
+    }
+
+    try
+    {
+        // Use it straight away, it takes much less memory than the generator.
+        mpLookupTable = LoadCompiledTable(rCompiledTableFileName, rArchiveFileName);
+        std::cout << "done!\n";
+    }
+    catch (Exception& e)
+    {
+        WARNING("Did not manage to use the compiled lookup table. Error was: "
+                << e.GetMessage() << "\nContinuing to use the boost archive.");
     }
 }
 
+void LookupTableLoader::SliceToIdealChannels()
+{
+    // The metadata names of each channel's conductance, in the order of #mIdealChannelsInvolved
+    // (see the tuple at the top of TestMakeALookupTable; Ito has a different name in some models).
+    const std::vector<std::vector<std::string> > channel_metadata_names{
+        { "membrane_rapid_delayed_rectifier_potassium_current_conductance" },
+        { "membrane_slow_delayed_rectifier_potassium_current_conductance" },
+        { "membrane_fast_sodium_current_conductance" },
+        { "membrane_L_type_calcium_current_conductance" },
+        { "membrane_transient_outward_current_conductance", "membrane_fast_transient_outward_current_conductance" },
+        { "membrane_persistent_sodium_current_conductance" },
+        { "membrane_inward_rectifier_potassium_current_conductance" }
+    };
+    assert(channel_metadata_names.size() == mIdealChannelsInvolved.size());
+
+    // The table knows which parameter each of its dimensions is, so find the channel for each one.
+    const std::vector<std::string> parameter_names = mpLookupTable->GetParameterNames();
+    std::vector<unsigned> dimensions_to_keep;
+    for (unsigned dimension = 0; dimension < parameter_names.size(); dimension++)
+    {
+        unsigned channel = UNSIGNED_UNSET;
+        for (unsigned i = 0; i < channel_metadata_names.size() && channel == UNSIGNED_UNSET; i++)
+        {
+            if (std::find(channel_metadata_names[i].begin(), channel_metadata_names[i].end(),
+                          parameter_names[dimension])
+                != channel_metadata_names[i].end())
+            {
+                channel = i;
+            }
+        }
+        if (channel == UNSIGNED_UNSET)
+        {
+            EXCEPTION("Dimension " << dimension << " of the lookup table " << mBestAvailableLookupTable
+                                   << " is '" << parameter_names[dimension]
+                                   << "', which is not the conductance of a channel ApPredict knows about.");
+        }
+        if (mIdealChannelsInvolved[channel].second)
+        {
+            dimensions_to_keep.push_back(dimension);
+        }
+    }
+    const unsigned dimension = parameter_names.size();
+    if (dimensions_to_keep.empty() || dimensions_to_keep.size() == dimension)
+    {
+        return;
+    }
+
+    // The channels that aren't blocked always have a scaling of 1.0, the top face of the table.
+    try
+    {
+        std::cout << "Slicing the " << dimension << "d lookup table down to the " << dimensions_to_keep.size()
+                  << " channels involved..." << std::flush;
+        Timer::Reset();
+        mpLookupTable = mpLookupTable->MakeSlice(dimensions_to_keep);
+        std::cout << " done in " << Timer::GetElapsedTime() << " secs.\n";
+    }
+    catch (Exception& e)
+    {
+        WARNING("Did not manage to slice the lookup table. Error was: "
+                << e.GetMessage() << "\nContinuing to use the whole table.");
+    }
+}
+
+boost::shared_ptr<AbstractLookupTable> LookupTableLoader::LoadCompiledTable(const std::string& rFileName,
+                                                                           const std::string& rArchiveFileName)
+{
+    // Read just the header to find out which dimension of table it is.
+    CompiledLookupTableHeader header;
+    std::ifstream file(rFileName.c_str(), std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        EXCEPTION("'" << rFileName << "' is not a compiled lookup table.");
+    }
+    file.close();
+
+    boost::shared_ptr<AbstractLookupTable> p_table;
+    switch (header.mDimension)
+    {
+        case 1u:
+            p_table.reset(new CompiledLookupTable<1u>(rFileName, rArchiveFileName));
+            break;
+        case 2u:
+            p_table.reset(new CompiledLookupTable<2u>(rFileName, rArchiveFileName));
+            break;
+        case 3u:
+            p_table.reset(new CompiledLookupTable<3u>(rFileName, rArchiveFileName));
+            break;
+        case 4u:
+            p_table.reset(new CompiledLookupTable<4u>(rFileName, rArchiveFileName));
+            break;
+        case 5u:
+            p_table.reset(new CompiledLookupTable<5u>(rFileName, rArchiveFileName));
+            break;
+        case 6u:
+            p_table.reset(new CompiledLookupTable<6u>(rFileName, rArchiveFileName));
+            break;
+        case 7u:
+            p_table.reset(new CompiledLookupTable<7u>(rFileName, rArchiveFileName));
+            break;
+        default:
+            EXCEPTION("'" << rFileName << "' is not a compiled lookup table.");
+    }
+    return p_table;
+}
+
 std::vector<std::string> LookupTableLoader::GetManifestOfTablesOnGarysWebsite()
 {
     const std::string manifest_filename = "appredict_lookup_table_manifest.txt";
@@ -284,40 +494,51 @@ std::vector<std::string> LookupTableLoader::GetManifestOfTablesOnGarysWebsite()
     std::string mainfest_URL = mRemoteURL + manifest_filename;
     FileFinder manifest(manifest_filename, RelativeTo::AbsoluteOrCwd);
 
-    // First check to see whether the remote manifest is accessible
-    // The "--server-response" argument prints the server status and the "--spider" means don't download anything.
-    std::string command = "wget --server-response --spider " + mainfest_URL;
-    int return_code = system(command.c_str());
-    if (return_code != 0)
+    // Only the master goes to the web, so that the processes don't all write the same file at once.
+    bool manifest_downloaded = false;
+    if (PetscTools::AmMaster())
     {
-        std::cout << "Could not find the remote manifest of available Lookup Tables on the web, "
-                     "we either don't have web access or the lookup table host server is down..."
-                  << std::endl;
-        return available_tables;
-    }
-
-    try
-    {
-        if (manifest.IsFile())
+        // First check to see whether the remote manifest is accessible
+        // The "--server-response" argument prints the server status and the "--spider" means don't download anything.
+        std::string command = "wget --server-response --spider " + mainfest_URL;
+        int return_code = system(command.c_str());
+        if (return_code != 0)
         {
-            std::cout << "\n\nAttempting to overwrite local lookup table manifest with the latest from:\n"
-                      << mainfest_URL << "\n\n";
+            std::cout << "Could not find the remote manifest of available Lookup Tables on the web, "
+                         "we either don't have web access or the lookup table host server is down..."
+                      << std::endl;
         }
         else
         {
-            std::cout << "\n\nAttempting to download lookup table manifest from:\n"
-                      << mainfest_URL << "\n\n";
-        }
+            try
+            {
+                if (manifest.IsFile())
+                {
+                    std::cout << "\n\nAttempting to overwrite local lookup table manifest with the latest from:\n"
+                              << mainfest_URL << "\n\n";
+                }
+                else
+                {
+                    std::cout << "\n\nAttempting to download lookup table manifest from:\n"
+                              << mainfest_URL << "\n\n";
+                }
 
-        EXPECT0(system, "wget --dns-timeout=10 --connect-timeout=10 -O " + manifest_filename + " " + mainfest_URL);
+                EXPECT0(system, "wget --dns-timeout=10 --connect-timeout=10 -O " + manifest_filename + " " + mainfest_URL);
 
-        std::cout << "Download succeeded.\n";
+                std::cout << "Download succeeded.\n";
+                manifest_downloaded = true;
+            }
+            catch (Exception& e)
+            {
+                std::cout << "Could not download and unpack the Lookup Table manifest, "
+                             "we either don't have web access or the lookup table host server is down..."
+                          << std::endl;
+            }
+        }
     }
-    catch (Exception& e)
+    PetscTools::Barrier("LookupTableLoader::GetManifestOfTablesOnGarysWebsite");
+    if (!PetscTools::ReplicateBool(manifest_downloaded))
     {
-        std::cout << "Could not download and unpack the Lookup Table manifest, "
-                     "we either don't have web access or the lookup table host server is down..."
-                  << std::endl;
         return available_tables;
     }
 
@@ -354,6 +575,8 @@ std::vector<std::string> LookupTableLoader::GetManifestOfLocalTablesInCwd()
     FileFinder cwd("", RelativeTo::AbsoluteOrCwd);
 
     std::vector<FileFinder> matching_files = cwd.FindMatches("*.arch");
+    std::vector<FileFinder> compiled_files = cwd.FindMatches("*.lut");
+    matching_files.insert(matching_files.end(), compiled_files.begin(), compiled_files.end());
 
     const std::string binary_ending = "_BINARY";
 
@@ -469,28 +692,37 @@ std::vector<std::string> LookupTableLoader::GenerateAllCompatibleTables()
     return compatible_tables;
 }
 
-void LookupTableLoader::DownloadAndUnpack(const std::string& rArchiveFileBaseName)
+bool LookupTableLoader::DownloadAndUnpack(const std::string& rArchiveFileBaseName)
 {
     std::string lookup_table_URL = mRemoteURL + rArchiveFileBaseName + ".arch.tgz";
-    try
+
+    // Only the master downloads and unpacks, the others wait for the files to appear.
+    bool unpacked = false;
+    if (PetscTools::AmMaster())
     {
-        std::cout << "\n\nAttempting to download an action potential lookup table from:\n"
-                  << lookup_table_URL << "\n\n";
+        try
+        {
+            std::cout << "\n\nAttempting to download an action potential lookup table from:\n"
+                      << lookup_table_URL << "\n\n";
 
-        EXPECT0(system, "wget --dns-timeout=10 --connect-timeout=10 " + lookup_table_URL);
+            EXPECT0(system, "wget --dns-timeout=10 --connect-timeout=10 " + lookup_table_URL);
 
-        std::cout << "Download succeeded, unpacking...\n";
+            std::cout << "Download succeeded, unpacking...\n";
 
-        EXPECT0(system, "tar xzf " + rArchiveFileBaseName + ".arch.tgz");
+            EXPECT0(system, "tar xzf " + rArchiveFileBaseName + ".arch.tgz");
 
-        std::cout << "Unpacking succeeded, removing .tgz file...\n";
+            std::cout << "Unpacking succeeded, removing .tgz file...\n";
 
-        EXPECT0(system, "rm -f " + rArchiveFileBaseName + ".arch.tgz");
-    }
-    catch (Exception& e)
-    {
-        std::cout << "Could not download and unpack the Lookup Table archive, continuing without it..." << std::endl;
+            EXPECT0(system, "rm -f " + rArchiveFileBaseName + ".arch.tgz");
+            unpacked = true;
+        }
+        catch (Exception& e)
+        {
+            std::cout << "Could not download and unpack the Lookup Table archive, continuing without it..." << std::endl;
+        }
     }
+    PetscTools::Barrier("LookupTableLoader::DownloadAndUnpack");
+    return PetscTools::ReplicateBool(unpacked);
 }
 
 bool LookupTableLoader::IsLookupTableAvailable()
@@ -498,7 +730,7 @@ bool LookupTableLoader::IsLookupTableAvailable()
     return (mpLookupTable != nullptr);
 }
 
-boost::shared_ptr<AbstractUntemplatedLookupTableGenerator> LookupTableLoader::GetLookupTable()
+boost::shared_ptr<AbstractLookupTable> LookupTableLoader::GetLookupTable()
 {
     if (mpLookupTable == nullptr)
     {
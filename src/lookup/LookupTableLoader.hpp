@@ -39,6 +39,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <boost/shared_ptr.hpp>
 
 // ApPredict includes
+#include "AbstractLookupTable.hpp"
 #include "AbstractUntemplatedLookupTableGenerator.hpp"
 
 /**
@@ -51,6 +52,12 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  * Also looks at the manifest of ones that are available to download from the web and does
  * that if needed.
+ *
+ * Once a table has been loaded from a boost archive it is also saved as a compiled table
+ * (a ".lut" file, see CompiledLookupTable), which is mapped straight into memory next time,
+ * unless the archive it was made from has changed since.
+ * Where a table of more channels than we need has to be used, it is cut down to the slice
+ * where the other channels are not blocked.
  */
 class LookupTableLoader
 {
@@ -58,7 +65,7 @@ private:
     /**
 	   * The lookup table to return.
 	   */
-    boost::shared_ptr<AbstractUntemplatedLookupTableGenerator> mpLookupTable;
+    boost::shared_ptr<AbstractLookupTable> mpLookupTable;
 
     /**
      * This is the set of channels that could be involved, and the ones that are,
@@ -100,6 +107,7 @@ private:
      * A list of tables that are available at #mRemoteURL.
      *
      * Only returns tables that are relevant for this model and pacing rate.
+     * This is collective, only the master process downloads the manifest.
      *
      * @return an unordered list of available tables.
      */
@@ -113,16 +121,43 @@ private:
     std::vector<std::string> GetManifestOfLocalTablesInCwd();
 
     /**
-     * Load this local file, convert to binary if we can
+     * Load this local file, from a compiled table if there is one, otherwise from a boost archive,
+     * convert to binary and compiled tables if we can.
+     *
+     * @param rLookupTableBaseName  the table's file name, without the extension.
      */
     void LoadTableFromLocalBoostArchive(const std::string& rLookupTableBaseName);
 
+    /**
+     * Save the generator that has just been loaded into #mpLookupTable as a compiled table,
+     * and use that instead (it takes less memory), or carry on with the generator if that fails.
+     *
+     * This is collective, only the master process writes the file.
+     *
+     * @param rCompiledTableFileName  the full path of the compiled table to write.
+     * @param rArchiveFileName  the full path of the archive the generator was loaded from.
+     */
+    void CompileLoadedTable(const std::string& rCompiledTableFileName, const std::string& rArchiveFileName);
+
+    /**
+     * Replace #mpLookupTable, which was loaded from #mBestAvailableLookupTable, with the slice of it
+     * where the channels that aren't involved have a scaling of 1.0, so that it is interpolated at the
+     * cost of the ideal table's dimension (see AbstractLookupTable::MakeSlice()).
+     *
+     * Each dimension is matched to its channel by the table's parameter name, and an EXCEPTION is
+     * thrown if one of them isn't a channel in #mIdealChannelsInvolved.
+     */
+    void SliceToIdealChannels();
+
     /**
      * Download and unzip a particular archive from #mRemoteURL.
      *
+     * This is collective, only the master process goes to the web.
+     *
      * @param rArchiveFileBaseName  the archive to get.
+     * @return whether the archive was downloaded and unpacked.
      */
-    void DownloadAndUnpack(const std::string& rArchiveFileBaseName);
+    bool DownloadAndUnpack(const std::string& rArchiveFileBaseName);
 
     /**
      * The URL where the manifest and lookup tables are available from.
@@ -159,7 +194,19 @@ public:
     /**
 	   * @return  a pointer to the lowest dimension LookupTable that is available.
 	   */
-    boost::shared_ptr<AbstractUntemplatedLookupTableGenerator> GetLookupTable();
+    boost::shared_ptr<AbstractLookupTable> GetLookupTable();
+
+    /**
+     * Map a compiled table (written by AbstractUntemplatedLookupTableGenerator::SaveCompiledTable())
+     * into memory, whatever its dimension.
+     *
+     * @param rFileName  the full path of the file.
+     * @param rArchiveFileName  the full path of the archive the table was made from, if given and
+     *                          it has changed since, the table is out of date and an exception is thrown.
+     * @return  the table.
+     */
+    static boost::shared_ptr<AbstractLookupTable> LoadCompiledTable(const std::string& rFileName,
+                                                                    const std::string& rArchiveFileName = "");
 };
 
 #endif // LOOKUPTABLELOADER_HPP_
@@ -33,11 +33,16 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <algorithm>
 #include <bitset> // for binary ops.
+#include <cmath>
 
 #include "Exception.hpp"
 #include "ParameterBox.hpp"
 
+/** Boxes narrower than this in every dimension are not refined any more (nor are dimensions narrower than this split). */
+static const double BOX_WIDTH_TOLERANCE = 1e-5;
+
 template <unsigned DIM>
 ParameterBox<DIM>::ParameterBox(ParameterBox<DIM>* pParent,
                                 const c_vector<double, DIM>& rMin,
@@ -46,6 +51,7 @@ ParameterBox<DIM>::ParameterBox(ParameterBox<DIM>* pParent,
           mpParentBox(pParent),
           mMin(rMin),
           mMax(rMax),
+          mNumQoIs(0u),
           mAllCornersEvaluated(false)
 {
     if (!mpParentBox)
@@ -60,83 +66,194 @@ ParameterBox<DIM>::ParameterBox(ParameterBox<DIM>* pParent,
         mpGreatGrandParentBox = mpParentBox->GetGreatGrandParent();
     }
 
-    c_vector<double, DIM>* p_existing_corner; // Some working memory
-
     // Create a basic grid of the corners of this new box first
-    for (unsigned i = 0; i < pow(2, DIM); i++)
+    for (unsigned i = 0; i < (1u << DIM); i++)
     {
-        // Use a binary conversion to get the right indices in place for the corners
-        std::bitset<DIM> bin_i(i);
-        c_vector<double, DIM> new_corner;
-        for (unsigned j = 0; j < DIM; j++)
-        {
-            new_corner[j] = mMin[j] + (mMax[j] - mMin[j]) * (double)(bin_i[j]);
-        }
-
-        // Make a pointer to new location
-        c_vector<double, DIM>* p_new_corner = new c_vector<double, DIM>(new_corner);
+        c_vector<double, DIM> new_corner = GetCornerLocation(i);
 
         // See if any of the other boxes have a corner that matches this location,
-        // Because we made a smart iterator with our own comparison method this should work!
-        DataMapIter iter = mpGreatGrandParentBox->mParameterPointDataMap.find(p_new_corner);
-        if (iter != mpGreatGrandParentBox->mParameterPointDataMap.end())
+        // the great grandparent looks them up with our own comparison method.
+        unsigned corner_id = mpGreatGrandParentBox->FindCornerId(new_corner);
+        if (corner_id != UNSIGNED_UNSET)
         {
-            // Also take note of any QoIs that have been evaluated on parent.
-            p_existing_corner = (*iter).first;
-            mCorners.push_back(p_existing_corner);
-            mParameterPointDataMap[p_existing_corner] = (*iter).second;
-
             // If the existing corner is in a neighbouring box from this sub-division,
             // and therefore has not been evaluated yet, also prepare a prediction site here.
-            if ((*iter).second == boost::shared_ptr<ParameterPointData>())
+            if (!mpGreatGrandParentBox->CornerHasData(corner_id))
             {
-                mParameterPointDataMapPredictions[p_existing_corner] = boost::shared_ptr<ParameterPointData>();
+                mPredictedCornerIds.push_back(corner_id);
+                mPredictedQoIs.push_back(std::vector<double>());
             }
-            delete p_new_corner;
         }
         else
         {
-            // Make a new corner map here
-            mParameterPointDataMap[p_new_corner] = boost::shared_ptr<ParameterPointData>();
-            mParameterPointDataMapPredictions[p_new_corner] = boost::shared_ptr<ParameterPointData>();
-            // and store the real data points also on the great grandparent
-            mpGreatGrandParentBox->mParameterPointDataMap[p_new_corner] = boost::shared_ptr<ParameterPointData>();
-            // Make a list of new box corner
-            mCorners.push_back(p_new_corner);
-            mNewCorners.insert(p_new_corner);
+            // Make a new corner, stored on the great grandparent
+            corner_id = mpGreatGrandParentBox->FindOrAddCornerId(new_corner);
+            mPredictedCornerIds.push_back(corner_id);
+            mPredictedQoIs.push_back(std::vector<double>());
+            mNewCornerIds.push_back(corner_id);
         }
+        mCornerIds[i] = corner_id;
     }
 }
 
 template <unsigned DIM>
 ParameterBox<DIM>::~ParameterBox()
 {
-    // If I am the original parent box, get all the corners,
-    // and delete them all. Nobody else does anything.
-    if (!mpParentBox)
+    // The corners are stored (by value) on the original parent box,
+    // so we just delete any daughter boxes that we made.
+    if (mAmParent)
     {
-        for (DataMapIter iter = mParameterPointDataMap.begin();
-             iter != mParameterPointDataMap.end();
-             ++iter)
+        for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
         {
-            delete (*iter).first; // Delete the corner pointer
+            delete mDaughterBoxes[i];
         }
     }
+}
 
-    // Also delete any daughter boxes that we made.
-    if (mAmParent)
+template <unsigned DIM>
+c_vector<double, DIM> ParameterBox<DIM>::GetCornerLocation(unsigned index) const
+{
+    // Use a binary conversion to get the right indices in place for the corners
+    std::bitset<DIM> bin_i(index);
+    c_vector<double, DIM> corner;
+    for (unsigned j = 0; j < DIM; j++)
     {
-        for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
+        corner[j] = mMin[j] + (mMax[j] - mMin[j]) * (double)(bin_i[j]);
+    }
+    return corner;
+}
+
+template <unsigned DIM>
+typename ParameterBox<DIM>::CornerKey ParameterBox<DIM>::GetCornerKey(const c_vector<double, DIM>& rLocation) const
+{
+    assert(mpGreatGrandParentBox == this);
+    const double num_steps = 1099511627776.0; // 2^40
+    CornerKey key;
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        const double width = mMax[j] - mMin[j];
+        key[j] = width > 0.0 ? std::llround((rLocation[j] - mMin[j]) / width * num_steps) : 0;
+    }
+    return key;
+}
+
+template <unsigned DIM>
+unsigned ParameterBox<DIM>::FindCornerId(const c_vector<double, DIM>& rLocation)
+{
+    assert(mpGreatGrandParentBox == this);
+    typename std::unordered_map<CornerKey, unsigned, CornerKeyHash>::const_iterator iter = mCornerIdLookup.find(GetCornerKey(rLocation));
+    if (iter == mCornerIdLookup.end())
+    {
+        return UNSIGNED_UNSET;
+    }
+    return (*iter).second;
+}
+
+template <unsigned DIM>
+unsigned ParameterBox<DIM>::FindOrAddCornerId(const c_vector<double, DIM>& rLocation)
+{
+    unsigned corner_id = FindCornerId(rLocation);
+    if (corner_id == UNSIGNED_UNSET)
+    {
+        corner_id = mCornerLocations.size();
+        mCornerLocations.push_back(rLocation);
+        mCornerIdLookup[GetCornerKey(rLocation)] = corner_id;
+        mCornerErrorCodes.push_back(UNSIGNED_UNSET);
+    }
+    return corner_id;
+}
+
+template <unsigned DIM>
+bool ParameterBox<DIM>::CornerHasData(unsigned cornerId) const
+{
+    assert(mpGreatGrandParentBox == this);
+    return mCornerErrorCodes[cornerId] != UNSIGNED_UNSET;
+}
+
+template <unsigned DIM>
+void ParameterBox<DIM>::SetCornerData(unsigned cornerId, const ParameterPointData& rData)
+{
+    assert(mpGreatGrandParentBox == this);
+    const std::vector<double>& r_qois = rData.rGetQoIs();
+    if (mNumQoIs == 0u)
+    {
+        mNumQoIs = r_qois.size();
+    }
+    assert(r_qois.size() == mNumQoIs);
+
+    mCornerQoIs.resize(mNumQoIs);
+    for (unsigned qoi_idx = 0; qoi_idx < mNumQoIs; qoi_idx++)
+    {
+        if (mCornerQoIs[qoi_idx].size() < mCornerLocations.size())
         {
-            delete mDaughterBoxes[i];
+            mCornerQoIs[qoi_idx].resize(mCornerLocations.size());
         }
+        mCornerQoIs[qoi_idx][cornerId] = r_qois[qoi_idx];
+    }
+    mCornerErrorCodes[cornerId] = rData.GetErrorCode();
+}
+
+template <unsigned DIM>
+void ParameterBox<DIM>::ConvertFromOldArchive(const std::vector<c_vector<double, DIM>*>& rCorners,
+                                              const CornerSet& rNewCorners,
+                                              const DataMap& rDataMap,
+                                              const DataMap& rPredictionsMap)
+{
+    ParameterBox<DIM>* p_original_box = mpGreatGrandParentBox;
+
+    // Parent boxes had thrown their corners away, so work them out again for everyone.
+    for (unsigned i = 0; i < (1u << DIM); i++)
+    {
+        mCornerIds[i] = p_original_box->FindOrAddCornerId(GetCornerLocation(i));
+    }
+
+    for (CornerSetIter iter = rNewCorners.begin(); iter != rNewCorners.end(); ++iter)
+    {
+        mNewCornerIds.push_back(p_original_box->FindOrAddCornerId(**iter));
+    }
+
+    for (typename DataMap::const_iterator iter = rDataMap.begin(); iter != rDataMap.end(); ++iter)
+    {
+        const unsigned corner_id = p_original_box->FindOrAddCornerId(*((*iter).first));
+        if ((*iter).second && !p_original_box->CornerHasData(corner_id))
+        {
+            p_original_box->SetCornerData(corner_id, *((*iter).second));
+        }
+        p_original_box->mCornersFromOldArchive.insert((*iter).first);
+    }
+
+    for (typename DataMap::const_iterator iter = rPredictionsMap.begin(); iter != rPredictionsMap.end(); ++iter)
+    {
+        mPredictedCornerIds.push_back(p_original_box->FindOrAddCornerId(*((*iter).first)));
+        mPredictedQoIs.push_back((*iter).second ? (*iter).second->rGetQoIs() : std::vector<double>());
+        p_original_box->mCornersFromOldArchive.insert((*iter).first);
+    }
+
+    p_original_box->mCornersFromOldArchive.insert(rCorners.begin(), rCorners.end());
+    p_original_box->mCornersFromOldArchive.insert(rNewCorners.begin(), rNewCorners.end());
+
+    // The original box is loaded last, and nothing else refers to the old corners.
+    if (!mpParentBox)
+    {
+        for (typename std::set<c_vector<double, DIM>*>::iterator iter = mCornersFromOldArchive.begin();
+             iter != mCornersFromOldArchive.end();
+             ++iter)
+        {
+            delete *iter;
+        }
+        mCornersFromOldArchive.clear();
     }
 }
 
 template <unsigned DIM>
 std::set<c_vector<double, DIM>*, c_vector_compare<DIM> > ParameterBox<DIM>::GetNewCorners()
 {
-    return mNewCorners;
+    CornerSet new_corners;
+    for (unsigned i = 0; i < mNewCornerIds.size(); i++)
+    {
+        new_corners.insert(&(mpGreatGrandParentBox->mCornerLocations[mNewCornerIds[i]]));
+    }
+    return new_corners;
 }
 
 template <unsigned DIM>
@@ -150,12 +267,20 @@ std::set<c_vector<double, DIM>*, c_vector_compare<DIM> > ParameterBox<DIM>::GetC
 {
     CornerSet corner_set;
 
-    // Get any corners that we own,
-    for (unsigned i = 0; i < mCorners.size(); i++)
+    // The original box has all of them.
+    if (mpGreatGrandParentBox == this)
     {
-        corner_set.insert(mCorners[i]);
+        for (unsigned i = 0; i < mCornerLocations.size(); i++)
+        {
+            corner_set.insert(&(mCornerLocations[i]));
+        }
+        return corner_set;
     }
 
+    // Get any corners that we own,
+    std::vector<c_vector<double, DIM>*> own_corners = GetOwnCorners();
+    corner_set.insert(own_corners.begin(), own_corners.end());
+
     // Also include any corners that our children own.
     for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
     {
@@ -179,7 +304,16 @@ std::vector<c_vector<double, DIM>*> ParameterBox<DIM>::GetCornersAsVector()
 template <unsigned DIM>
 std::vector<c_vector<double, DIM>*> ParameterBox<DIM>::GetOwnCorners()
 {
-    return mCorners;
+    // Parent boxes leave their corners to their daughters.
+    std::vector<c_vector<double, DIM>*> corners;
+    if (!mAmParent)
+    {
+        for (unsigned i = 0; i < (1u << DIM); i++)
+        {
+            corners.push_back(&(mpGreatGrandParentBox->mCornerLocations[mCornerIds[i]]));
+        }
+    }
+    return corners;
 }
 
 template <unsigned DIM>
@@ -214,84 +348,112 @@ template <unsigned DIM>
 std::vector<ParameterBox<DIM>*> ParameterBox<DIM>::GetWholeFamilyOfBoxes()
 {
     std::vector<ParameterBox<DIM>*> all_boxes;
+    AddWholeFamilyOfBoxes(all_boxes);
+    return all_boxes;
+}
+
+template <unsigned DIM>
+void ParameterBox<DIM>::AddWholeFamilyOfBoxes(std::vector<ParameterBox<DIM>*>& rBoxes)
+{
     for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
     {
-        std::vector<ParameterBox<DIM>*> daughter_family_boxes = mDaughterBoxes[i]->GetWholeFamilyOfBoxes();
-        for (unsigned j = 0; j < daughter_family_boxes.size(); j++)
-        {
-            all_boxes.push_back(daughter_family_boxes[j]);
-        }
+        mDaughterBoxes[i]->AddWholeFamilyOfBoxes(rBoxes);
     }
-    all_boxes.push_back(this);
-    return all_boxes;
+    rBoxes.push_back(this);
 }
 
 template <unsigned DIM>
 std::set<c_vector<double, DIM>*, c_vector_compare<DIM> > ParameterBox<DIM>::SubDivide()
+{
+    std::vector<unsigned> all_dimensions;
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        all_dimensions.push_back(j);
+    }
+    return SubDivide(all_dimensions);
+}
+
+template <unsigned DIM>
+std::set<c_vector<double, DIM>*, c_vector_compare<DIM> > ParameterBox<DIM>::SubDivide(const std::vector<unsigned>& rDimensions)
 {
     if (mAmParent)
     {
         EXCEPTION("Already subdivided this box.");
     }
 
-    CornerSet new_corners;
+    std::vector<unsigned> dimensions(rDimensions);
+    std::sort(dimensions.begin(), dimensions.end());
+    if (dimensions.empty()
+        || dimensions.back() >= DIM
+        || std::adjacent_find(dimensions.begin(), dimensions.end()) != dimensions.end())
+    {
+        EXCEPTION("A box can only be subdivided along between 1 and " << DIM << " different dimensions, each less than " << DIM << ".");
+    }
 
-    // In order to subdivide a box we require there to be data in existence at all its corners.
-    assert(mParameterPointDataMap.size() == mCorners.size());
+    CornerSet new_corners;
 
     // Loop over each daughter box, we need to create them all at once.
-    for (unsigned i = 0; i < pow(2, DIM); i++)
+    for (unsigned i = 0; i < (1u << dimensions.size()); i++)
     {
-        // Use a binary conversion to get the right indices in place.
+        // Use a binary conversion to get the right indices in place,
+        // each bit says which half of the box to take along one of the dimensions.
         std::bitset<DIM> bin_i(i);
-        c_vector<double, DIM> corner;
-        for (unsigned j = 0; j < DIM; j++)
+        c_vector<double, DIM> min = mMin;
+        c_vector<double, DIM> max = mMax;
+        for (unsigned j = 0; j < dimensions.size(); j++)
         {
-            corner[j] = mMin[j] + 0.5 * (mMax[j] - mMin[j]) * (double)(bin_i[j]);
-        }
+            const unsigned dim = dimensions[j];
 
-        // The new boxes are half the width in each dimension of this one.
-        c_vector<double, DIM> min = corner;
-        c_vector<double, DIM> max = corner + 0.5 * (mMax - mMin);
+            // The new boxes are half the width of this one in these dimensions.
+            min[dim] = mMin[dim] + 0.5 * (mMax[dim] - mMin[dim]) * (double)(bin_i[j]);
+            max[dim] = min[dim] + 0.5 * (mMax[dim] - mMin[dim]);
+        }
 
         ParameterBox<DIM>* daughter_box = new ParameterBox<DIM>(this, min, max);
 
         mDaughterBoxes.push_back(daughter_box);
         CornerSet new_corners_for_this_daughter = daughter_box->GetNewCorners();
-        for (unsigned j = 0; j < new_corners_for_this_daughter.size(); j++)
-        {
-            new_corners.insert(new_corners_for_this_daughter.begin(), new_corners_for_this_daughter.end());
-        }
+        new_corners.insert(new_corners_for_this_daughter.begin(), new_corners_for_this_daughter.end());
+    }
+
+    // The daughters are waiting for predictions at their new corners, and also at any corners they share
+    // that a neighbouring box has just created but which have not been evaluated yet (if several boxes are
+    // subdivided before evaluating).
+    std::set<unsigned> corners_to_predict;
+    for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
+    {
+        corners_to_predict.insert(mDaughterBoxes[i]->mPredictedCornerIds.begin(),
+                                  mDaughterBoxes[i]->mPredictedCornerIds.end());
     }
 
     // Work out interpolated estimates for each QoI
-    for (CornerSetIter iter = new_corners.begin();
-         iter != new_corners.end();
+    for (std::set<unsigned>::iterator iter = corners_to_predict.begin();
+         iter != corners_to_predict.end();
          ++iter)
     {
-        c_vector<double, DIM>* new_corner = *(iter);
-
         // For each new corner generate an estimate of its QoIs
         // based on interpolation of the existing box.
         std::vector<double> predicted_qois;
-        InterpolatePoint(*new_corner, predicted_qois);
+        InterpolatePoint(mpGreatGrandParentBox->mCornerLocations[*iter], predicted_qois);
 
         // Store these estimates for comparison with real data later.
         // We don't care whether an error actually occurred or not for this.
         boost::shared_ptr<ParameterPointData> predicted_data = boost::shared_ptr<ParameterPointData>(new ParameterPointData(predicted_qois, 0u));
-        AssignQoIValues(new_corner, predicted_data, true);
+        AssignQoIValuesAtCorner(*iter, predicted_data, true);
     }
 
     // Tidy up things that a parent box doesn't need.
-    mCorners.clear();
-    mParameterPointDataMapPredictions.clear();
-    if (!(mpGreatGrandParentBox == this))
+    mPredictedCornerIds.clear();
+    mPredictedQoIs.clear();
+    mAmParent = true; // I am not actually a parent until I have worked out predictions from my own corners!
+
+    // Our daughters will join the refinement queues when they have been evaluated,
+    // and we will be taken off when we reach the top.
+    if (mpGreatGrandParentBox->mpRefinementQueues)
     {
-        // Great grandparent box keeps track of the entire data structure,
-        // everyone else wipes it on sub-division.
-        mParameterPointDataMap.clear();
+        mpGreatGrandParentBox->mpRefinementQueues->mMaxGeneration = std::max(mpGreatGrandParentBox->mpRefinementQueues->mMaxGeneration,
+                                                                             mGeneration + 1u);
     }
-    mAmParent = true; // I am not actually a parent until I clear my own corners!
     return new_corners;
 }
 
@@ -300,83 +462,179 @@ void ParameterBox<DIM>::AssignQoIValues(c_vector<double, DIM>* pCorner,
                                         boost::shared_ptr<ParameterPointData> pParameterPointData,
                                         bool isPredictedQoI)
 {
-    DataMap* p_data_map;
-    // If this is a QoI prediction then store it in the predictions map,
-    // otherwise store in the 'proper' map.
-    if (isPredictedQoI)
+    // Look the corner up once, then boxes only need to compare its id with theirs.
+    const unsigned corner_id = mpGreatGrandParentBox->FindCornerId(*pCorner);
+    if (corner_id == UNSIGNED_UNSET)
     {
-        p_data_map = &mParameterPointDataMapPredictions;
+        return;
     }
-    else
+
+    if (!isPredictedQoI)
     {
-        p_data_map = &mParameterPointDataMap;
+        // If the corner already has data associated with it, this is ignored.
+        if (mpGreatGrandParentBox->CornerHasData(corner_id))
+        {
+            return;
+        }
+        mpGreatGrandParentBox->SetCornerData(corner_id, *pParameterPointData);
     }
 
-    // Each corner is only in each box once, so we can safely take the first find result...
-    DataMapIter iter = p_data_map->find(pCorner);
+    AssignQoIValuesAtCorner(corner_id, pParameterPointData, isPredictedQoI);
+}
 
-    // If we found the relevant corner in this box, and it doesn't already have data associated with it.
-    if (iter != p_data_map->end() && (*iter).second == NULL)
+template <unsigned DIM>
+void ParameterBox<DIM>::AssignQoIValuesAtCorner(unsigned cornerId,
+                                                boost::shared_ptr<ParameterPointData> pParameterPointData,
+                                                bool isPredictedQoI)
+{
+    // See if this box is waiting for a prediction or real data at this corner.
+    std::vector<unsigned>::iterator iter = std::find(mPredictedCornerIds.begin(), mPredictedCornerIds.end(), cornerId);
+    if (iter != mPredictedCornerIds.end())
     {
-        (*iter).second = pParameterPointData;
+        const unsigned slot = iter - mPredictedCornerIds.begin();
 
-        // If this is real data and we are a child box, look to see if the fake data exists
-        if (!isPredictedQoI && !(mpGreatGrandParentBox == this))
+        // If this is a QoI prediction then store it, if we haven't got one already.
+        if (isPredictedQoI)
         {
-            DataMapIter iter2 = mParameterPointDataMapPredictions.find(pCorner);
-            if (iter2 != mParameterPointDataMapPredictions.end())
+            if (mPredictedQoIs[slot].empty())
             {
-                // If it does, we found a prediction, so evaluate it.
-                std::vector<double> predictions = (*iter2).second->rGetQoIs();
-                std::vector<double> real_values = pParameterPointData->rGetQoIs();
-                std::vector<double> errors_in_predicitons;
-                assert(predictions.size() == real_values.size());
-                for (unsigned i = 0; i < predictions.size(); i++)
-                {
-                    double difference = predictions[i] - real_values[i];
-                    //std::cout << "QoI[" << i << "]: prediction = " << predictions[i] << ", \treal = " <<
-                    //        real_values[i] << ", \tdifference = " << difference << "\n" << std::flush;
-                    errors_in_predicitons.push_back(difference);
-                }
-                pParameterPointData->SetErrorEstimates(errors_in_predicitons);
-                mErrorsInQoIs.push_back(errors_in_predicitons);
+                mPredictedQoIs[slot] = pParameterPointData->rGetQoIs();
+            }
+        }
+        // If this is real data and we are a child box, we have a prediction to evaluate.
+        else if (!(mpGreatGrandParentBox == this))
+        {
+            const std::vector<double>& predictions = mPredictedQoIs[slot];
+            const std::vector<double>& real_values = pParameterPointData->rGetQoIs();
+            std::vector<double> errors_in_predicitons;
+            assert(predictions.size() == real_values.size());
+            for (unsigned i = 0; i < predictions.size(); i++)
+            {
+                double difference = predictions[i] - real_values[i];
+                errors_in_predicitons.push_back(difference);
+            }
+            pParameterPointData->SetErrorEstimates(errors_in_predicitons);
+            mErrorsInQoIs.push_back(errors_in_predicitons);
 
-                // Erase the predicted ParameterPointData in the map, and remove the entry.
-                mParameterPointDataMapPredictions.erase(pCorner);
+            // Remove the prediction.
+            mPredictedCornerIds.erase(iter);
+            mPredictedQoIs.erase(mPredictedQoIs.begin() + slot);
 
-                // If we have now evaluated all of the predictions
-                if (mParameterPointDataMapPredictions.size() == 0)
-                {
-                    mAllCornersEvaluated = true;
+            // If we have now evaluated all of the predictions
+            if (mPredictedCornerIds.size() == 0)
+            {
+                mAllCornersEvaluated = true;
 
-                    mMaxErrorsInEachQoI.clear();
-                    // Take each QoI error at first corner to be the max for now.
-                    for (unsigned i = 0; i < mErrorsInQoIs[0].size(); i++)
-                    {
-                        mMaxErrorsInEachQoI.push_back(fabs(mErrorsInQoIs[0][i]));
-                    }
+                mMaxErrorsInEachQoI.clear();
+                // Take each QoI error at first corner to be the max for now.
+                for (unsigned i = 0; i < mErrorsInQoIs[0].size(); i++)
+                {
+                    mMaxErrorsInEachQoI.push_back(fabs(mErrorsInQoIs[0][i]));
+                }
 
-                    // For each other corner
-                    for (unsigned i = 1u; i < mErrorsInQoIs.size(); i++)
+                // For each other corner
+                for (unsigned i = 1u; i < mErrorsInQoIs.size(); i++)
+                {
+                    // For each QoI.
+                    for (unsigned j = 0; j < mErrorsInQoIs[i].size(); j++)
                     {
-                        // For each QoI.
-                        for (unsigned j = 0; j < mErrorsInQoIs[i].size(); j++)
+                        if (fabs(mErrorsInQoIs[i][j]) > mMaxErrorsInEachQoI[j])
                         {
-                            if (fabs(mErrorsInQoIs[i][j]) > mMaxErrorsInEachQoI[j])
-                            {
-                                mMaxErrorsInEachQoI[j] = fabs(mErrorsInQoIs[i][j]);
-                            }
+                            mMaxErrorsInEachQoI[j] = fabs(mErrorsInQoIs[i][j]);
                         }
                     }
                 }
+
+                CalculateErrorsInEachDimension();
+
+                // Now we have an error estimate we can be considered for refinement.
+                mpGreatGrandParentBox->AddToRefinementQueues(this);
             }
         }
     }
 
-    // Also pass on the instruction to our children boxes.
+    // Also pass on the instruction to those children boxes that this could be a corner of.
+    const c_vector<double, DIM>& r_corner = mpGreatGrandParentBox->mCornerLocations[cornerId];
     for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
     {
-        mDaughterBoxes[i]->AssignQoIValues(pCorner, pParameterPointData, isPredictedQoI);
+        if (mDaughterBoxes[i]->IsPointNearThisBox(r_corner))
+        {
+            mDaughterBoxes[i]->AssignQoIValuesAtCorner(cornerId, pParameterPointData, isPredictedQoI);
+        }
+    }
+}
+
+template <unsigned DIM>
+void ParameterBox<DIM>::CalculateErrorsInEachDimension()
+{
+    assert(mpParentBox);
+    const ParameterBox<DIM>* p_original_box = mpGreatGrandParentBox;
+    const unsigned num_qois = p_original_box->mNumQoIs;
+    const c_vector<double, DIM>& r_parent_min = mpParentBox->mMin;
+    const c_vector<double, DIM>& r_parent_max = mpParentBox->mMax;
+
+    // Whether the parent split each dimension, and if so whether we are the upper half.
+    std::bitset<DIM> split;
+    std::bitset<DIM> upper_half;
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        split[j] = (mMax[j] - mMin[j]) < 0.75 * (r_parent_max[j] - r_parent_min[j]);
+        upper_half[j] = split[j] && (mMin[j] > r_parent_min[j] + TOL);
+    }
+
+    mMaxErrorsInEachDimension.resize(DIM);
+    for (unsigned dim = 0; dim < DIM; dim++)
+    {
+        if (!split[dim])
+        {
+            // We are as wide as our parent along this dimension, so its errors still apply,
+            // and our corners can't tell us about them, so they count towards our error estimate too.
+            mMaxErrorsInEachDimension[dim] = mpParentBox->mMaxErrorsInEachDimension.empty()
+                ? std::vector<double>()
+                : mpParentBox->mMaxErrorsInEachDimension[dim];
+            for (unsigned q = 0; q < mMaxErrorsInEachDimension[dim].size() && q < mMaxErrorsInEachQoI.size(); q++)
+            {
+                mMaxErrorsInEachQoI[q] = std::max(mMaxErrorsInEachQoI[q], mMaxErrorsInEachDimension[dim][q]);
+            }
+            continue;
+        }
+
+        // Look at our corners that are in the middle of an edge of the parent along this dimension,
+        // the parent predicted those from the average of the ends of that edge.
+        mMaxErrorsInEachDimension[dim] = std::vector<double>(num_qois, 0.0);
+        for (unsigned i = 0; i < (1u << DIM); i++)
+        {
+            std::bitset<DIM> bin_i(i);
+            std::bitset<DIM> parent_index;
+            bool on_edge_midpoint = true;
+            for (unsigned j = 0; j < DIM; j++)
+            {
+                // Our lower corner is the parent's midpoint along this dimension if we are the upper half, and vice versa.
+                const bool at_parent_midpoint = split[j] && (bin_i[j] != upper_half[j]);
+                if (at_parent_midpoint != (j == dim))
+                {
+                    on_edge_midpoint = false;
+                    break;
+                }
+                parent_index[j] = bin_i[j];
+            }
+            if (!on_edge_midpoint)
+            {
+                continue;
+            }
+
+            parent_index[dim] = 0;
+            const unsigned end_0 = mpParentBox->mCornerIds[parent_index.to_ulong()];
+            parent_index[dim] = 1;
+            const unsigned end_1 = mpParentBox->mCornerIds[parent_index.to_ulong()];
+            const unsigned midpoint = mCornerIds[i];
+            for (unsigned q = 0; q < num_qois; q++)
+            {
+                const std::vector<double>& r_qois = p_original_box->mCornerQoIs[q];
+                const double error = 0.5 * (r_qois[end_0] + r_qois[end_1]) - r_qois[midpoint];
+                mMaxErrorsInEachDimension[dim][q] = std::max(mMaxErrorsInEachDimension[dim][q], fabs(error));
+            }
+        }
     }
 }
 
@@ -395,6 +653,49 @@ bool ParameterBox<DIM>::DoesBoxNeedFurtherRefinement(const double& rTolerance,
     }
     assert(!mAmParent);
 
+    if (!IsBoxWideEnoughToRefine())
+    {
+        return false;
+    }
+
+    return (GetMaxErrorInQoIEstimateInThisBox(rQuantityIndex) > rTolerance);
+}
+
+template <unsigned DIM>
+bool ParameterBox<DIM>::DoesBoxNeedFurtherRefinement(const std::vector<double>& rTolerances)
+{
+    assert(!mAmParent);
+
+    if (!IsBoxWideEnoughToRefine())
+    {
+        return false;
+    }
+
+    // We have no idea what the errors are in the original box.
+    if (!mpParentBox)
+    {
+        return true;
+    }
+
+    assert(mAllCornersEvaluated);
+    assert(rTolerances.size() <= mMaxErrorsInEachQoI.size());
+    if (this->GetNumErrors() == (1u << DIM))
+    {
+        return false;
+    }
+    for (unsigned i = 0; i < rTolerances.size(); i++)
+    {
+        if (mMaxErrorsInEachQoI[i] > rTolerances[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <unsigned DIM>
+bool ParameterBox<DIM>::IsBoxWideEnoughToRefine()
+{
     // Hardcode a stopping criteria based on the width of the box.
     c_vector<double, DIM> box_width; // should be able to combine with line below but optimised gcc 7.4.0 didn't like it!
     box_width = mMax - mMin;
@@ -406,13 +707,32 @@ bool ParameterBox<DIM>::DoesBoxNeedFurtherRefinement(const double& rTolerance,
             max_width = box_width[i];
         }
     }
-    double box_width_tolerance = 1e-5;
-    if (max_width < box_width_tolerance)
+    return (max_width >= BOX_WIDTH_TOLERANCE);
+}
+
+template <unsigned DIM>
+double ParameterBox<DIM>::GetMaxNormalisedErrorInQoIEstimatesInThisBox(const std::vector<double>& rTolerances)
+{
+    if (!mpParentBox)
     {
-        return false;
+        return DBL_MAX;
     }
 
-    return (GetMaxErrorInQoIEstimateInThisBox(rQuantityIndex) > rTolerance);
+    assert(mAllCornersEvaluated);
+    assert(rTolerances.size() <= mMaxErrorsInEachQoI.size());
+    assert(!mAmParent);
+
+    if (this->GetNumErrors() == (1u << DIM))
+    {
+        return 0.0;
+    }
+
+    double max_normalised_error = 0.0;
+    for (unsigned i = 0; i < rTolerances.size(); i++)
+    {
+        max_normalised_error = std::max(max_normalised_error, mMaxErrorsInEachQoI[i] / rTolerances[i]);
+    }
+    return max_normalised_error;
 }
 
 template <unsigned DIM>
@@ -427,13 +747,13 @@ double ParameterBox<DIM>::GetMaxErrorInQoIEstimateInThisBox(const unsigned& rQua
 
     // Otherwise all these things should be true!
     assert(mAllCornersEvaluated);
-    assert(mParameterPointDataMapPredictions.size() == 0u);
+    assert(mPredictedCornerIds.size() == 0u);
     assert(mMaxErrorsInEachQoI.size() > 0u);
     assert(!mAmParent);
 
     // First check to see if all the corners have errors, if they do we don't want to
     // bother refining this box, so we say it has no error associated with it.
-    if (this->GetNumErrors() == mCorners.size())
+    if (this->GetNumErrors() == (1u << DIM))
     {
         return 0.0;
     }
@@ -479,7 +799,6 @@ void ParameterBox<DIM>::GetErrorEstimateInAllBoxes(ParameterBox<DIM>*& pBestBox,
             assert(mAllCornersEvaluated);
         if (mpParentBox)
             assert(mMaxErrorsInEachQoI.size() > 0u);
-        assert(mParameterPointDataMap.size() == pow(2, DIM)); // Check we have an entry for all of our corners.
         assert(mDaughterBoxes.size() == 0u);
 
         if (DoesBoxNeedFurtherRefinement(rTolerance, rQuantityIndex))
@@ -533,6 +852,61 @@ void ParameterBox<DIM>::GetErrorEstimateInAllBoxes(ParameterBox<DIM>*& pBestBox,
     return;
 }
 
+template <unsigned DIM>
+std::vector<unsigned> ParameterBox<DIM>::GetDimensionsToRefine(const std::vector<double>& rTolerances,
+                                                               const double& rFraction)
+{
+    std::vector<unsigned> all_dimensions;
+    std::vector<unsigned> wide_dimensions;
+    for (unsigned j = 0; j < DIM; j++)
+    {
+        all_dimensions.push_back(j);
+        if (mMax[j] - mMin[j] >= BOX_WIDTH_TOLERANCE)
+        {
+            wide_dimensions.push_back(j);
+        }
+    }
+
+    // We need an error for each dimension to choose some.
+    if (!mpParentBox || mMaxErrorsInEachDimension.size() != DIM || wide_dimensions.empty())
+    {
+        return all_dimensions;
+    }
+    std::vector<double> normalised_errors(DIM, 0.0);
+    double max_normalised_error = 0.0;
+    for (unsigned i = 0; i < wide_dimensions.size(); i++)
+    {
+        const std::vector<double>& r_errors = mMaxErrorsInEachDimension[wide_dimensions[i]];
+        if (r_errors.size() < rTolerances.size())
+        {
+            return all_dimensions;
+        }
+        for (unsigned q = 0; q < rTolerances.size(); q++)
+        {
+            normalised_errors[wide_dimensions[i]] = std::max(normalised_errors[wide_dimensions[i]], r_errors[q] / rTolerances[q]);
+        }
+        max_normalised_error = std::max(max_normalised_error, normalised_errors[wide_dimensions[i]]);
+    }
+
+    // If the error in this box isn't mostly down to the QoIs curving along one dimension
+    // or another, it comes from them varying with a combination of dimensions, so split all of them.
+    if (max_normalised_error == 0.0
+        || max_normalised_error < rFraction * GetMaxNormalisedErrorInQoIEstimatesInThisBox(rTolerances))
+    {
+        return all_dimensions;
+    }
+
+    std::vector<unsigned> dimensions;
+    for (unsigned i = 0; i < wide_dimensions.size(); i++)
+    {
+        if (normalised_errors[wide_dimensions[i]] >= rFraction * max_normalised_error)
+        {
+            dimensions.push_back(wide_dimensions[i]);
+        }
+    }
+    return dimensions;
+}
+
 template <unsigned DIM>
 ParameterBox<DIM>* ParameterBox<DIM>::FindBoxWithLargestQoIErrorEstimate(const unsigned& rQuantityIndex,
                                                                          const double& rTolerance,
@@ -544,24 +918,48 @@ ParameterBox<DIM>* ParameterBox<DIM>::FindBoxWithLargestQoIErrorEstimate(const u
         EXCEPTION("Only the original parameter box should call this method.");
     }
 
-    ParameterBox<DIM>* p_box = nullptr;
-    double error_in_QoI_estimate = -DBL_MAX; // The estimate for the emulator error within this box.
-    unsigned num_QoI_error_codes = UNSIGNED_UNSET; // The number of corners at which QoI error codes were thrown.
-    GetErrorEstimateInAllBoxes(p_box, error_in_QoI_estimate, num_QoI_error_codes, rTolerance, rQuantityIndex);
+    SetUpRefinementQueues(rQuantityIndex, std::vector<double>(1u, rTolerance));
+    return ChooseBoxToRefine(rMaxGenerationDifference);
+}
 
-    // If there is somewhere that doesn't meet the tolerances
-    if (error_in_QoI_estimate > rTolerance)
+template <unsigned DIM>
+ParameterBox<DIM>* ParameterBox<DIM>::FindBoxWithLargestNormalisedQoIErrorEstimate(const std::vector<double>& rTolerances,
+                                                                                   const unsigned& rMaxGenerationDifference)
+{
+    if (mpParentBox)
     {
-        assert(p_box);
+        EXCEPTION("Only the original parameter box should call this method.");
+    }
+    for (unsigned i = 0; i < rTolerances.size(); i++)
+    {
+        if (!(rTolerances[i] > 0.0))
+        {
+            EXCEPTION("The tolerance for each quantity of interest must be positive.");
+        }
+    }
 
-        ParameterBox<DIM>* most_refined = GetMostRefinedChild();
-        ParameterBox<DIM>* least_refined = GetLeastRefinedChild(rTolerance, rQuantityIndex);
+    // With only one QoI there is nothing to normalise, so keep exactly the usual ordering.
+    SetUpRefinementQueues(rTolerances.size() == 1u ? 0u : UNSIGNED_UNSET, rTolerances);
+    return ChooseBoxToRefine(rMaxGenerationDifference);
+}
+
+template <unsigned DIM>
+ParameterBox<DIM>* ParameterBox<DIM>::ChooseBoxToRefine(const unsigned& rMaxGenerationDifference)
+{
+    assert(mpRefinementQueues);
+    ParameterBox<DIM>* p_box = GetTopOfQueue(mpRefinementQueues->mToRefine);
+
+    // If there is somewhere that doesn't meet the tolerances
+    if (p_box)
+    {
+        const unsigned most_refined_generation = mpRefinementQueues->mMaxGeneration;
+        ParameterBox<DIM>* least_refined = GetTopOfQueue(mpRefinementQueues->mLeastRefined);
 
         // Check the selected box isn't going to refine one area too much,
         // if it is refine least refined area instead.
         if (least_refined // if an unrefined box exists that doesn't meet the tolerances.
-            && ((most_refined->GetGeneration() - least_refined->GetGeneration()) == rMaxGenerationDifference)
-            && (p_box->GetGeneration() == GetMostRefinedChild()->GetGeneration()))
+            && ((most_refined_generation - least_refined->GetGeneration()) == rMaxGenerationDifference)
+            && (p_box->GetGeneration() == most_refined_generation))
         {
             return least_refined;
         }
@@ -571,6 +969,179 @@ ParameterBox<DIM>* ParameterBox<DIM>::FindBoxWithLargestQoIErrorEstimate(const u
     return p_box;
 }
 
+template <unsigned DIM>
+void ParameterBox<DIM>::SetUpRefinementQueues(const unsigned& rQuantityIndex, const std::vector<double>& rTolerances)
+{
+    assert(!mpParentBox);
+    if (mpRefinementQueues
+        && mpRefinementQueues->mQuantityIndex == rQuantityIndex
+        && mpRefinementQueues->mTolerances == rTolerances)
+    {
+        return;
+    }
+
+    // One scan of the tree, from now on the queues are kept up to date as boxes are evaluated.
+    mpRefinementQueues.reset(new RefinementQueues);
+    mpRefinementQueues->mQuantityIndex = rQuantityIndex;
+    mpRefinementQueues->mTolerances = rTolerances;
+    mpRefinementQueues->mMaxGeneration = GetMostRefinedChild()->GetGeneration();
+
+    std::vector<ParameterBox<DIM>*> boxes;
+    GetBoxesNeedingRefinement(boxes, *mpRefinementQueues);
+    for (unsigned i = 0; i < boxes.size(); i++)
+    {
+        AddToRefinementQueues(boxes[i]);
+    }
+}
+
+template <unsigned DIM>
+void ParameterBox<DIM>::AddToRefinementQueues(ParameterBox<DIM>* pBox)
+{
+    assert(!mpParentBox);
+    if (!mpRefinementQueues
+        || !pBox->DoesBoxNeedFurtherRefinement(*mpRefinementQueues))
+    {
+        return;
+    }
+
+    RefinementCandidate candidate;
+    candidate.mpBox = pBox;
+    candidate.mErrorEstimate = pBox->GetErrorEstimateForRefinement(*mpRefinementQueues);
+    candidate.mNumErrors = pBox->GetNumErrors();
+    candidate.mGeneration = pBox->GetGeneration();
+    candidate.mPath = pBox->GetPathFromOriginalBox();
+    mpRefinementQueues->mToRefine.push(candidate);
+    mpRefinementQueues->mLeastRefined.push(candidate);
+}
+
+template <unsigned DIM>
+bool ParameterBox<DIM>::DoesBoxNeedFurtherRefinement(const RefinementQueues& rQueues)
+{
+    if (rQueues.mQuantityIndex == UNSIGNED_UNSET)
+    {
+        return DoesBoxNeedFurtherRefinement(rQueues.mTolerances);
+    }
+    return DoesBoxNeedFurtherRefinement(rQueues.mTolerances[0], rQueues.mQuantityIndex);
+}
+
+template <unsigned DIM>
+double ParameterBox<DIM>::GetErrorEstimateForRefinement(const RefinementQueues& rQueues)
+{
+    if (rQueues.mQuantityIndex == UNSIGNED_UNSET)
+    {
+        return GetMaxNormalisedErrorInQoIEstimatesInThisBox(rQueues.mTolerances);
+    }
+    return GetMaxErrorInQoIEstimateInThisBox(rQueues.mQuantityIndex);
+}
+
+template <unsigned DIM>
+template <class QUEUE>
+ParameterBox<DIM>* ParameterBox<DIM>::GetTopOfQueue(QUEUE& rQueue)
+{
+    while (!rQueue.empty() && rQueue.top().mpBox->IsParent())
+    {
+        rQueue.pop();
+    }
+    return rQueue.empty() ? nullptr : rQueue.top().mpBox;
+}
+
+template <unsigned DIM>
+std::vector<unsigned> ParameterBox<DIM>::GetPathFromOriginalBox()
+{
+    std::vector<unsigned> path;
+    for (ParameterBox<DIM>* p_box = this; p_box->mpParentBox; p_box = p_box->mpParentBox)
+    {
+        const std::vector<ParameterBox<DIM>*>& r_siblings = p_box->mpParentBox->mDaughterBoxes;
+        path.push_back(std::find(r_siblings.begin(), r_siblings.end(), p_box) - r_siblings.begin());
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+template <unsigned DIM>
+void ParameterBox<DIM>::GetBoxesNeedingRefinement(std::vector<ParameterBox<DIM>*>& rBoxes,
+                                                  const RefinementQueues& rQueues)
+{
+    if (!mAmParent)
+    {
+        if (DoesBoxNeedFurtherRefinement(rQueues))
+        {
+            rBoxes.push_back(this);
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
+        {
+            mDaughterBoxes[i]->GetBoxesNeedingRefinement(rBoxes, rQueues);
+        }
+    }
+}
+
+template <unsigned DIM>
+std::vector<ParameterBox<DIM>*> ParameterBox<DIM>::FindBoxesWithLargestQoIErrorEstimates(const unsigned& rQuantityIndex,
+                                                                                         const double& rTolerance,
+                                                                                         const unsigned& rNumBoxes,
+                                                                                         const unsigned& rMaxGenerationDifference)
+{
+    // This checks we are the original box and sets up the queues.
+    FindBoxWithLargestQoIErrorEstimate(rQuantityIndex, rTolerance, rMaxGenerationDifference);
+    return ChooseBoxesToRefine(rNumBoxes, rMaxGenerationDifference);
+}
+
+template <unsigned DIM>
+std::vector<ParameterBox<DIM>*> ParameterBox<DIM>::FindBoxesWithLargestNormalisedQoIErrorEstimates(const std::vector<double>& rTolerances,
+                                                                                                   const unsigned& rNumBoxes,
+                                                                                                   const unsigned& rMaxGenerationDifference)
+{
+    FindBoxWithLargestNormalisedQoIErrorEstimate(rTolerances, rMaxGenerationDifference);
+    return ChooseBoxesToRefine(rNumBoxes, rMaxGenerationDifference);
+}
+
+template <unsigned DIM>
+std::vector<ParameterBox<DIM>*> ParameterBox<DIM>::ChooseBoxesToRefine(const unsigned& rNumBoxes,
+                                                                       const unsigned& rMaxGenerationDifference)
+{
+    std::vector<ParameterBox<DIM>*> chosen_boxes;
+
+    // The usual first choice.
+    ParameterBox<DIM>* p_first_box = ChooseBoxToRefine(rMaxGenerationDifference);
+    if (!p_first_box || rNumBoxes == 0u)
+    {
+        return chosen_boxes;
+    }
+    chosen_boxes.push_back(p_first_box);
+
+    // Don't let a batch refine one area too much beyond the least refined box.
+    ParameterBox<DIM>* p_least_refined = GetTopOfQueue(mpRefinementQueues->mLeastRefined);
+
+    // Take the others off the top of the queue, nothing has been refined yet so they all go back afterwards.
+    std::vector<RefinementCandidate> taken;
+    while (chosen_boxes.size() < rNumBoxes && GetTopOfQueue(mpRefinementQueues->mToRefine))
+    {
+        taken.push_back(mpRefinementQueues->mToRefine.top());
+        mpRefinementQueues->mToRefine.pop();
+
+        ParameterBox<DIM>* p_box = taken.back().mpBox;
+        if (p_box == p_first_box)
+        {
+            continue;
+        }
+        if (rMaxGenerationDifference != UNSIGNED_UNSET && p_least_refined
+            && p_box->GetGeneration() + 1u > p_least_refined->GetGeneration() + rMaxGenerationDifference)
+        {
+            continue;
+        }
+        chosen_boxes.push_back(p_box);
+    }
+    for (unsigned i = 0; i < taken.size(); i++)
+    {
+        mpRefinementQueues->mToRefine.push(taken[i]);
+    }
+
+    return chosen_boxes;
+}
+
 template <unsigned DIM>
 ParameterBox<DIM>* ParameterBox<DIM>::GetBoxContainingPoint(const c_vector<double, DIM>& rPoint)
 {
@@ -592,7 +1163,7 @@ ParameterBox<DIM>* ParameterBox<DIM>::GetBoxContainingPoint(const c_vector<doubl
     // If it is a parent then ask daughters...
     ParameterBox<DIM>* p_box = this;
 
-    std::vector<ParameterBox<DIM>*> daughters = GetDaughterBoxes();
+    const std::vector<ParameterBox<DIM>*>& daughters = mDaughterBoxes;
     for (unsigned i = 0; i < daughters.size(); i++)
     {
         if (daughters[i]->IsPointInThisBox(rPoint))
@@ -627,19 +1198,13 @@ void ParameterBox<DIM>::InterpolatePoint(const c_vector<double, DIM>& rPoint,
 {
     // I am a child box.
     assert(!mAmParent);
-    // And check some data has been assigned to my corners
-    assert((*(mParameterPointDataMap.begin())).second != boost::shared_ptr<ParameterPointData>());
 
-    // Work out how many QoIs we should have, same across all parameter points, so just take the first one.
-    DataMapIter iter = mParameterPointDataMap.begin();
-    unsigned num_qois = (*iter).second->rGetQoIs().size();
+    // The QoIs at every corner are stored together on the original box, the same number at each.
+    const ParameterBox<DIM>* p_original_box = mpGreatGrandParentBox;
+    const unsigned num_qois = p_original_box->mNumQoIs;
 
     // Wipe the existing QoIs vector.
-    rQoIs.resize(num_qois);
-    for (unsigned qoi_idx = 0; qoi_idx < num_qois; qoi_idx++)
-    {
-        rQoIs[qoi_idx] = 0.0;
-    }
+    rQoIs.assign(num_qois, 0.0);
 
     c_vector<double, DIM> point = rPoint;
     // Nondimensionalise the point within this box
@@ -650,8 +1215,12 @@ void ParameterBox<DIM>::InterpolatePoint(const c_vector<double, DIM>& rPoint,
 
     // See doxygen comment for this method for some detail of what is going on here.
     // This is in the same order as corners (as it is how we originally calculated them!).
-    for (unsigned i = 0; i < pow(2, DIM); i++)
+    double multipliers[1u << DIM];
+    for (unsigned i = 0; i < (1u << DIM); i++)
     {
+        // And check some data has been assigned to my corners
+        assert(p_original_box->CornerHasData(mCornerIds[i]));
+
         // Use a binary conversion to get the right indices in place.
         std::bitset<DIM> bin_i(i);
         double multiplier_for_this_corner = 1.0;
@@ -666,10 +1235,16 @@ void ParameterBox<DIM>::InterpolatePoint(const c_vector<double, DIM>& rPoint,
                 multiplier_for_this_corner *= point[j];
             }
         }
+        multipliers[i] = multiplier_for_this_corner;
+    }
 
-        for (unsigned qoi_idx = 0; qoi_idx < num_qois; qoi_idx++)
+    // Then each QoI in turn, from its own array.
+    for (unsigned qoi_idx = 0; qoi_idx < num_qois; qoi_idx++)
+    {
+        const std::vector<double>& r_corner_qois = p_original_box->mCornerQoIs[qoi_idx];
+        for (unsigned i = 0; i < (1u << DIM); i++)
         {
-            rQoIs[qoi_idx] += multiplier_for_this_corner * mParameterPointDataMap[mCorners[i]]->rGetQoIs()[qoi_idx];
+            rQoIs[qoi_idx] += multipliers[i] * r_corner_qois[mCornerIds[i]];
         }
     }
 }
@@ -689,14 +1264,34 @@ bool ParameterBox<DIM>::IsPointInThisBox(const c_vector<double, DIM>& rPoint)
     return within;
 }
 
+template <unsigned DIM>
+bool ParameterBox<DIM>::IsPointNearThisBox(const c_vector<double, DIM>& rPoint)
+{
+    for (unsigned i = 0; i < DIM; i++)
+    {
+        if (rPoint[i] > mMax[i] + TOL || rPoint[i] < mMin[i] - TOL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 template <unsigned DIM>
 unsigned ParameterBox<DIM>::GetNumErrors()
 {
     unsigned error_count = 0u;
 
-    for (unsigned i = 0; i < mCorners.size(); i++)
+    // Parent boxes leave their corners to their daughters.
+    if (mAmParent)
     {
-        if (mParameterPointDataMap[mCorners[i]]->GetErrorCode() > 0u)
+        return error_count;
+    }
+
+    for (unsigned i = 0; i < (1u << DIM); i++)
+    {
+        assert(mpGreatGrandParentBox->CornerHasData(mCornerIds[i]));
+        if (mpGreatGrandParentBox->mCornerErrorCodes[mCornerIds[i]] > 0u)
         {
             error_count++;
         }
@@ -712,7 +1307,6 @@ ParameterBox<DIM>* ParameterBox<DIM>::GetMostRefinedChild()
 
     if (!mAmParent)
     {
-        assert(mCorners.size() == pow(2, DIM));
         assert(mDaughterBoxes.size() == 0u);
         p_box = this;
     }
@@ -739,7 +1333,6 @@ ParameterBox<DIM>* ParameterBox<DIM>::GetLeastRefinedChild(const double& rTolera
 
     if (!mAmParent)
     {
-        assert(mCorners.size() == pow(2, DIM));
         assert(mDaughterBoxes.size() == 0u);
 
         if (DoesBoxNeedFurtherRefinement(rTolerance, rQuantityIndex))
@@ -775,7 +1368,7 @@ std::vector<double> ParameterBox<DIM>::GetMaxErrorsInPredictedQoIs() const
     }
 
     assert(mMaxErrorsInEachQoI.size() > 0u);
-    assert(mParameterPointDataMapPredictions.size() == 0u);
+    assert(mPredictedCornerIds.size() == 0u);
     return mMaxErrorsInEachQoI;
 }
 
@@ -789,35 +1382,9 @@ double ParameterBox<DIM>::ReportPercentageOfSpaceWhereToleranceIsMetForQoI(const
         EXCEPTION("Only the original parameter box should call this method.");
     }
 
-    std::vector<ParameterBox<DIM>*> all_boxes = this->GetWholeFamilyOfBoxes();
-
     double area_met = 0.0;
     double area_not = 0.0;
-    for (unsigned i = 0; i < all_boxes.size(); i++)
-    {
-        if (all_boxes[i]->IsParent())
-        {
-            // We only want to look at 'bottom level' boxes.
-            continue;
-        }
-
-        c_vector<double, DIM> widths; // should be able to combine with line below but optimised gcc 7.4.0 didn't like it!
-        widths = all_boxes[i]->mMax - all_boxes[i]->mMin;
-        double area_box = widths[0];
-        for (unsigned j = 1; j < DIM; j++)
-        {
-            area_box *= widths[j];
-        }
-
-        if (all_boxes[i]->DoesBoxNeedFurtherRefinement(rTolerance, rQuantityIndex))
-        {
-            area_not += area_box;
-        }
-        else
-        {
-            area_met += area_box;
-        }
-    }
+    AddAreasMeetingTolerance(area_met, area_not, rTolerance, rQuantityIndex);
 
     // This line will fail if you are using this structure for something that isn't
     // describing a [0,1]^D hypercube. In which case comment it out safely. But it is a
@@ -827,6 +1394,40 @@ double ParameterBox<DIM>::ReportPercentageOfSpaceWhereToleranceIsMetForQoI(const
     return 100.0 * area_met / (area_not + area_met);
 }
 
+template <unsigned DIM>
+void ParameterBox<DIM>::AddAreasMeetingTolerance(double& rAreaMet,
+                                                 double& rAreaNotMet,
+                                                 const double& rTolerance,
+                                                 const unsigned& rQuantityIndex)
+{
+    if (mAmParent)
+    {
+        // We only want to look at 'bottom level' boxes.
+        for (unsigned i = 0; i < mDaughterBoxes.size(); i++)
+        {
+            mDaughterBoxes[i]->AddAreasMeetingTolerance(rAreaMet, rAreaNotMet, rTolerance, rQuantityIndex);
+        }
+        return;
+    }
+
+    c_vector<double, DIM> widths; // should be able to combine with line below but optimised gcc 7.4.0 didn't like it!
+    widths = mMax - mMin;
+    double area_box = widths[0];
+    for (unsigned j = 1; j < DIM; j++)
+    {
+        area_box *= widths[j];
+    }
+
+    if (DoesBoxNeedFurtherRefinement(rTolerance, rQuantityIndex))
+    {
+        rAreaNotMet += area_box;
+    }
+    else
+    {
+        rAreaMet += area_box;
+    }
+}
+
 /////////////////////////////////////////////////////////////////////
 // Explicit instantiation
 /////////////////////////////////////////////////////////////////////
@@ -37,17 +37,25 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define PARAMETERBOX_HPP
 
 #include <boost/shared_ptr.hpp>
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <map>
+#include <queue>
 #include <set>
+#include <unordered_map>
 #include "ChasteSerialization.hpp" // Should be included before any other Chaste headers.
+#include "ChasteSerializationVersion.hpp"
 #include "ParameterPointData.hpp"
 #include "UblasVectorInclude.hpp" // Chaste helper header to get c_vectors included with right namespace.
 
 // Seems that whatever version of ublas I am using now contains boost serialization
 // methods for c_vector, which is nice.
+#include <boost/serialization/deque.hpp>
 #include <boost/serialization/map.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
 
 static const double TOL = 1e-12;
@@ -81,6 +89,12 @@ struct c_vector_compare
     }
 };
 
+template <unsigned DIM>
+class CompiledLookupTable;
+
+template <unsigned DIM>
+class LookupTableGenerator;
+
 /**
  * This class stores the co-ordinates of the corners of N-D boxes.
  *
@@ -97,30 +111,116 @@ private:
     /** Needed for serialization. */
     friend class boost::serialization::access;
     friend class TestParameterBox;
+    friend class TestCompiledLookupTable;
+    friend class CompiledLookupTable<DIM>;
+    friend class LookupTableGenerator<DIM>;
+    /**
+     * Save the object.
+     *
+     * @param archive the archive
+     * @param version the current version of this class
+     */
+    template <class Archive>
+    void save(Archive& archive, const unsigned int version) const
+    {
+        archive << mAmParent;
+        archive << mpParentBox;
+        archive << mpGreatGrandParentBox;
+        archive << mMin;
+        archive << mMax;
+        archive << mCornerIds;
+        archive << mNewCornerIds;
+        archive << mDaughterBoxes;
+        archive << mPredictedCornerIds;
+        archive << mPredictedQoIs;
+        archive << mErrorsInQoIs;
+        archive << mMaxErrorsInEachQoI;
+        archive << mAllCornersEvaluated;
+        archive << mGeneration;
+        // These are empty except on the great-grandparent.
+        archive << mCornerLocations;
+        archive << mNumQoIs;
+        archive << mCornerErrorCodes;
+        archive << mCornerQoIs;
+        archive << mMaxErrorsInEachDimension;
+    }
+
     /**
-     * Archive the object.
+     * Load the object.
      *
      * @param archive the archive
      * @param version the current version of this class
      */
     template <class Archive>
-    void serialize(Archive& archive, const unsigned int version)
+    void load(Archive& archive, const unsigned int version)
     {
-        archive& mAmParent;
-        archive& mpParentBox;
-        archive& mpGreatGrandParentBox;
-        archive& mMin;
-        archive& mMax;
-        archive& mCorners;
-        archive& mNewCorners;
-        archive& mDaughterBoxes;
-        archive& mParameterPointDataMap;
-        archive& mParameterPointDataMapPredictions;
-        archive& mErrorsInQoIs;
-        archive& mMaxErrorsInEachQoI;
-        archive& mAllCornersEvaluated;
-        archive& mGeneration;
+        archive >> mAmParent;
+        archive >> mpParentBox;
+        archive >> mpGreatGrandParentBox;
+        archive >> mMin;
+        archive >> mMax;
+        if (version >= 1u)
+        {
+            archive >> mCornerIds;
+            archive >> mNewCornerIds;
+            archive >> mDaughterBoxes;
+            archive >> mPredictedCornerIds;
+            archive >> mPredictedQoIs;
+            archive >> mErrorsInQoIs;
+            archive >> mMaxErrorsInEachQoI;
+            archive >> mAllCornersEvaluated;
+            archive >> mGeneration;
+            archive >> mCornerLocations;
+            archive >> mNumQoIs;
+            archive >> mCornerErrorCodes;
+            if (version >= 3u)
+            {
+                archive >> mCornerQoIs;
+            }
+            else
+            {
+                // These used to be stored all together, mNumQoIs for each corner in turn.
+                std::vector<double> corner_qois;
+                archive >> corner_qois;
+                const unsigned num_corners_with_qois = mNumQoIs == 0u ? 0u : corner_qois.size() / mNumQoIs;
+                mCornerQoIs.assign(mNumQoIs, std::vector<double>(num_corners_with_qois));
+                for (unsigned corner_id = 0; corner_id < num_corners_with_qois; corner_id++)
+                {
+                    for (unsigned qoi_idx = 0; qoi_idx < mNumQoIs; qoi_idx++)
+                    {
+                        mCornerQoIs[qoi_idx][corner_id] = corner_qois[corner_id * mNumQoIs + qoi_idx];
+                    }
+                }
+            }
+            for (unsigned i = 0; i < mCornerLocations.size(); i++)
+            {
+                mCornerIdLookup[GetCornerKey(mCornerLocations[i])] = i;
+            }
+            if (version >= 2u)
+            {
+                archive >> mMaxErrorsInEachDimension;
+            }
+        }
+        else
+        {
+            // Older versions of this class kept pointers to corners, and maps of their data, in each box.
+            std::vector<c_vector<double, DIM>*> corners;
+            CornerSet new_corners;
+            DataMap data_map;
+            DataMap predictions_map;
+            archive >> corners;
+            archive >> new_corners;
+            archive >> mDaughterBoxes;
+            archive >> data_map;
+            archive >> predictions_map;
+            archive >> mErrorsInQoIs;
+            archive >> mMaxErrorsInEachQoI;
+            archive >> mAllCornersEvaluated;
+            archive >> mGeneration;
+            ConvertFromOldArchive(corners, new_corners, data_map, predictions_map);
+        }
     }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 
     typedef typename std::set<c_vector<double, DIM>*, c_vector_compare<DIM> > CornerSet;
     typedef typename std::set<c_vector<double, DIM>*, c_vector_compare<DIM> >::iterator CornerSetIter;
@@ -129,6 +229,30 @@ private:
     typedef typename std::map<c_vector<double, DIM>*, boost::shared_ptr<ParameterPointData>, c_vector_compare<DIM> > DataMap;
     typedef typename std::map<c_vector<double, DIM>*, boost::shared_ptr<ParameterPointData>, c_vector_compare<DIM> >::iterator DataMapIter;
 
+    /**
+     * Where a corner is, as a whole number of the smallest steps we could get to by halving
+     * the original box in each dimension (see GetCornerKey()).
+     */
+    typedef std::array<int64_t, DIM> CornerKey;
+
+    /** Hashes a #CornerKey for the look-up from corner locations to ids. */
+    struct CornerKeyHash
+    {
+        /**
+         * @param rKey  A corner key.
+         * @return Its hash.
+         */
+        std::size_t operator()(const CornerKey& rKey) const
+        {
+            std::size_t hash = 0u;
+            for (unsigned j = 0; j < DIM; j++)
+            {
+                hash = hash * 1000003u ^ std::hash<int64_t>()(rKey[j]);
+            }
+            return hash;
+        }
+    };
+
     /** Whether this box has been subdivided and has children boxes */
     bool mAmParent;
 
@@ -146,33 +270,67 @@ private:
     /** The N-Dim maximum of this box */
     c_vector<double, DIM> mMax;
 
-    /** The locations of this box's vertices in N-D space */
-    std::vector<c_vector<double, DIM>*> mCorners;
+    /**
+     * The ids of this box's vertices (see #mCornerLocations), in the order given by the
+     * binary digits of their index (see constructor). Only meaningful while this box has no children.
+     */
+    unsigned mCornerIds[1u << DIM];
 
-    /** New corners that were created especially for this box */
-    CornerSet mNewCorners;
+    /** The ids of new corners that were created especially for this box */
+    std::vector<unsigned> mNewCornerIds;
 
     /** Pointers to the children (subdivisions) of this box */
     std::vector<ParameterBox<DIM>*> mDaughterBoxes;
 
     /**
-     * The QoIs and errors associated with this box's corners,
-     * only populated by the great-grandparent and the children
-     * not the intermediate boxes.
-     *
-     * Children keep a minimal map of their own corners,
+     * The ids of this box's corners that don't have data yet, for which we
+     * want to compare a prediction with the real data when it comes.
      *
-     * Great-grandparent keeps an entire map of the whole thing.
+     * This is only held by the local children boxes.
      */
-    DataMap mParameterPointDataMap;
+    std::vector<unsigned> mPredictedCornerIds;
 
     /**
-     * A map of predicted ParameterPointData for new
-     * corners, populated at subdivision time.
-     *
-     * This is only held by the local children boxes.
+     * The QoIs predicted at the corners in #mPredictedCornerIds (at subdivision time),
+     * empty until the prediction has been made.
+     */
+    std::vector<std::vector<double> > mPredictedQoIs;
+
+    /**
+     * The location of every corner of every box, indexed by corner id,
+     * only populated by the great-grandparent. This is a deque so that
+     * adding corners doesn't move the existing ones (pointers to them are
+     * handed out by GetCorners() and SubDivide()).
+     */
+    std::deque<c_vector<double, DIM> > mCornerLocations;
+
+    /**
+     * A look-up from a corner's key (see GetCornerKey()) to its id, only populated by the
+     * great-grandparent. This is only needed when creating boxes, and to find the corner
+     * passed to AssignQoIValues().
+     */
+    std::unordered_map<CornerKey, unsigned, CornerKeyHash> mCornerIdLookup;
+
+    /** The number of QoIs at each corner, set when the first data is assigned. */
+    unsigned mNumQoIs;
+
+    /**
+     * The error code for the QoI evaluation at each corner (by id), or UNSIGNED_UNSET
+     * if it hasn't been evaluated yet. Only populated by the great-grandparent.
+     */
+    std::vector<unsigned> mCornerErrorCodes;
+
+    /**
+     * The QoIs at each corner, one vector for each QoI indexed by corner id, so that
+     * each QoI is contiguous. Only populated by the great-grandparent.
+     */
+    std::vector<std::vector<double> > mCornerQoIs;
+
+    /**
+     * Corners that were loaded from an older archive, which are deleted by the
+     * great-grandparent once it has finished loading. Never archived.
      */
-    DataMap mParameterPointDataMapPredictions;
+    std::set<c_vector<double, DIM>*> mCornersFromOldArchive;
 
     /**
      * The errors in the QoIs at each new corner / predicted data point.
@@ -184,7 +342,8 @@ private:
     std::vector<std::vector<double> > mErrorsInQoIs;
 
     /**
-     * The maximum errors in each QoIs over all new data points.
+     * The maximum errors in each QoIs over all new data points (and, if our parent only
+     * split some dimensions, the errors along the others, see #mMaxErrorsInEachDimension).
      *
      * This is populated by AssignQoI values when it has been called for
      * ALL of the new corners.
@@ -196,6 +355,246 @@ private:
      */
     bool mAllCornersEvaluated;
 
+    /**
+     * For each dimension, the largest error in each QoI at corners of this box that the parent
+     * box predicted from the two ends of one of its edges along that dimension alone, i.e. the
+     * error due to the QoIs curving along that dimension. Dimensions that the parent didn't split
+     * keep the parent's errors. Set once all corners are evaluated, a row is empty if we don't
+     * know (for the original box, and boxes from older archives).
+     */
+    std::vector<std::vector<double> > mMaxErrorsInEachDimension;
+
+    /**
+     * An entry in the refinement queues (see RefinementQueues), giving everything
+     * needed to compare boxes without looking at the rest of the tree.
+     */
+    struct RefinementCandidate
+    {
+        /** The box (which has no children of its own when it is added). */
+        ParameterBox<DIM>* mpBox;
+        /** Its error estimate for the quantity of interest being refined. */
+        double mErrorEstimate;
+        /** The number of its corners with QoI error codes. */
+        unsigned mNumErrors;
+        /** Its generation. */
+        unsigned mGeneration;
+        /** Daughter indices leading to it from the original box, so that ties go the way a depth-first scan would. */
+        std::vector<unsigned> mPath;
+    };
+
+    /** Orders the queue of boxes to refine: fewest QoI error codes, then largest error estimate, first. */
+    struct RefineFirst
+    {
+        /**
+         * @param rA  A candidate.
+         * @param rB  Another candidate.
+         * @return Whether rB should be refined before rA.
+         */
+        bool operator()(const RefinementCandidate& rA, const RefinementCandidate& rB) const
+        {
+            if (rA.mNumErrors != rB.mNumErrors)
+            {
+                return rB.mNumErrors < rA.mNumErrors;
+            }
+            if (rA.mErrorEstimate != rB.mErrorEstimate)
+            {
+                return rB.mErrorEstimate > rA.mErrorEstimate;
+            }
+            return rB.mPath < rA.mPath;
+        }
+    };
+
+    /** Orders the queue of least refined boxes: lowest generation first. */
+    struct LeastRefinedFirst
+    {
+        /**
+         * @param rA  A candidate.
+         * @param rB  Another candidate.
+         * @return Whether rB is less refined than rA.
+         */
+        bool operator()(const RefinementCandidate& rA, const RefinementCandidate& rB) const
+        {
+            if (rA.mGeneration != rB.mGeneration)
+            {
+                return rB.mGeneration < rA.mGeneration;
+            }
+            return rB.mPath < rA.mPath;
+        }
+    };
+
+    /**
+     * Queues of the boxes (with no children) that don't meet the tolerance for one quantity of
+     * interest (or for all of them), kept up to date as boxes are evaluated, so that choosing the
+     * next box to refine doesn't need a scan of the whole tree. Boxes that have since been
+     * subdivided are only taken off the queues when they reach the top.
+     */
+    struct RefinementQueues
+    {
+        /**
+         * The quantity of interest these queues are for, UNSIGNED_UNSET if they are for all
+         * of them (with error estimates normalised by each one's tolerance).
+         */
+        unsigned mQuantityIndex;
+        /** The tolerance these queues are for (one for each QoI if they are for all of them). */
+        std::vector<double> mTolerances;
+        /** The largest generation of any box. */
+        unsigned mMaxGeneration;
+        /** The boxes in the order they should be refined. */
+        std::priority_queue<RefinementCandidate, std::vector<RefinementCandidate>, RefineFirst> mToRefine;
+        /** The boxes in order of refinement level. */
+        std::priority_queue<RefinementCandidate, std::vector<RefinementCandidate>, LeastRefinedFirst> mLeastRefined;
+    };
+
+    /**
+     * The refinement queues, only held by the great-grandparent. These are set up
+     * when first needed (and not archived) and set up again if the quantity of interest
+     * or tolerance being refined changes.
+     */
+    boost::shared_ptr<RefinementQueues> mpRefinementQueues;
+
+    /**
+     * @param index  The index of a corner of this box, from 0 to 2^DIM - 1.
+     * @return The location of that corner, given by the binary digits of the index.
+     */
+    c_vector<double, DIM> GetCornerLocation(unsigned index) const;
+
+    /**
+     * Only the great-grandparent should call this.
+     *
+     * Every corner is made by halving boxes, so is a whole number of 2^-40ths of the way across
+     * this box in each dimension (boxes are never refined that far, see BOX_WIDTH_TOLERANCE).
+     * Rounding to these steps gives the same key for locations that are the same but for
+     * rounding errors, so corners can be looked up exactly rather than with a fuzzy comparison.
+     *
+     * @param rLocation  A location in parameter space.
+     * @return The key for a corner at this location.
+     */
+    CornerKey GetCornerKey(const c_vector<double, DIM>& rLocation) const;
+
+    /**
+     * Only the great-grandparent should call this.
+     *
+     * @param rLocation  A location in parameter space.
+     * @return The id of the corner at this location, or UNSIGNED_UNSET if there isn't one.
+     */
+    unsigned FindCornerId(const c_vector<double, DIM>& rLocation);
+
+    /**
+     * Only the great-grandparent should call this.
+     *
+     * @param rLocation  A location in parameter space.
+     * @return The id of the corner at this location, which is added if there isn't one already.
+     */
+    unsigned FindOrAddCornerId(const c_vector<double, DIM>& rLocation);
+
+    /**
+     * Only the great-grandparent should call this.
+     *
+     * @param cornerId  The id of a corner.
+     * @return Whether data has been assigned to this corner.
+     */
+    bool CornerHasData(unsigned cornerId) const;
+
+    /**
+     * Store the QoIs and error code for a corner, only the great-grandparent should call this.
+     *
+     * @param cornerId  The id of a corner.
+     * @param rData  The data evaluated there.
+     */
+    void SetCornerData(unsigned cornerId, const ParameterPointData& rData);
+
+    /**
+     * The recursive part of AssignQoIValues(), passing the corner's id down to the boxes that may have it as a corner.
+     *
+     * @param cornerId  The id of the corner at which we have evaluated the QoIs.
+     * @param pParameterPointData The data values at this point in parameter space.
+     * @param isPredictedQoI  Whether this is a predicted QoI or a real one.
+     */
+    void AssignQoIValuesAtCorner(unsigned cornerId,
+                                 boost::shared_ptr<ParameterPointData> pParameterPointData,
+                                 bool isPredictedQoI);
+
+    /**
+     * Set up this box's corners from the members of an older version of this class.
+     *
+     * @param rCorners  The pointers to this box's corners.
+     * @param rNewCorners  The pointers to the corners created for this box.
+     * @param rDataMap  The data at this box's corners (or all corners, for the great-grandparent).
+     * @param rPredictionsMap  The predicted data at this box's corners that were waiting for real data.
+     */
+    void ConvertFromOldArchive(const std::vector<c_vector<double, DIM>*>& rCorners,
+                               const CornerSet& rNewCorners,
+                               const DataMap& rDataMap,
+                               const DataMap& rPredictionsMap);
+
+    /**
+     * Work out #mMaxErrorsInEachDimension, once all the corners of this box have been evaluated.
+     */
+    void CalculateErrorsInEachDimension();
+
+    /**
+     * Set up the refinement queues for this quantity of interest and tolerance, if they aren't already.
+     *
+     * @param rQuantityIndex  The index of the quantity of interest we are examining at present,
+     *                        or UNSIGNED_UNSET for all of them.
+     * @param rTolerances  The error estimate we are happy with (for each QoI if they are all examined).
+     */
+    void SetUpRefinementQueues(const unsigned& rQuantityIndex, const std::vector<double>& rTolerances);
+
+    /**
+     * @param rQueues  Some refinement queues.
+     * @return Whether this box needs further refinement for the quantities of interest the queues are for.
+     */
+    bool DoesBoxNeedFurtherRefinement(const RefinementQueues& rQueues);
+
+    /**
+     * @param rQueues  Some refinement queues.
+     * @return The error estimate in this box that the queues are ordered by.
+     */
+    double GetErrorEstimateForRefinement(const RefinementQueues& rQueues);
+
+    /**
+     * Choose the box to refine from the refinement queues (which must be set up),
+     * see FindBoxWithLargestQoIErrorEstimate().
+     *
+     * @param rMaxGenerationDifference  The maximum difference in refinement levels in terms of generation.
+     * @return The box to refine, if any.
+     */
+    ParameterBox<DIM>* ChooseBoxToRefine(const unsigned& rMaxGenerationDifference);
+
+    /**
+     * Choose boxes to refine together from the refinement queues (which must be set up),
+     * see FindBoxesWithLargestQoIErrorEstimates().
+     *
+     * @param rNumBoxes  The maximum number of boxes to return.
+     * @param rMaxGenerationDifference  The maximum difference in refinement levels in terms of generation.
+     * @return The boxes to refine, if any.
+     */
+    std::vector<ParameterBox<DIM>*> ChooseBoxesToRefine(const unsigned& rNumBoxes,
+                                                        const unsigned& rMaxGenerationDifference);
+
+    /**
+     * Add a box that has just had all its corners evaluated to the refinement queues,
+     * if there are any and the box doesn't meet their tolerance.
+     *
+     * @param pBox  The box.
+     */
+    void AddToRefinementQueues(ParameterBox<DIM>* pBox);
+
+    /**
+     * Take any boxes that have been subdivided off the top of a refinement queue.
+     *
+     * @param rQueue  The queue.
+     * @return The box at the top of the queue, or nullptr if it is empty.
+     */
+    template <class QUEUE>
+    static ParameterBox<DIM>* GetTopOfQueue(QUEUE& rQueue);
+
+    /**
+     * @return The indices of the daughters leading to this box from the original box.
+     */
+    std::vector<unsigned> GetPathFromOriginalBox();
+
     /**
      * Get a measure of the error associated with predicting the quantity of interest in this box.
      * Calculated by providing an interpolated estimate from parent, and then comparing with
@@ -213,6 +612,9 @@ private:
      * Calls GetMaxErrorInQoIEstimateInThisBox() for any children and updates a pointer to the
      * one with the largest error estimate above the tolerance.
      *
+     * This is a scan of the whole tree, FindBoxWithLargestQoIErrorEstimate() now uses the
+     * refinement queues instead, this is kept to check them against.
+     *
      * @param pBestBox  Reference to a pointer to the box with the largest variation at present.
      * @param rErrorEstimateInBestBox  The value of the largest error estimate associated with the best box to refine.
      * @param rNumberQoIErrorCodesInBestBox  The number of QoI error codes thrown in the best box to refine.
@@ -225,8 +627,38 @@ private:
                                     const double& rTolerance,
                                     const unsigned& rQuantityIndex);
 
+    /**
+     * Collects every box (with no children of its own) that doesn't yet meet the tolerance.
+     *
+     * @param rBoxes  The boxes found so far, to be added to.
+     * @param rQueues  The refinement queues giving the tolerance(s) and quantities of interest.
+     */
+    void GetBoxesNeedingRefinement(std::vector<ParameterBox<DIM>*>& rBoxes,
+                                   const RefinementQueues& rQueues);
+
+    /**
+     * Add the areas of boxes (with no children) that do and don't meet the tolerance.
+     *
+     * @param rAreaMet  The area meeting the tolerance so far, to be added to.
+     * @param rAreaNotMet  The area not meeting the tolerance so far, to be added to.
+     * @param rTolerance  The error estimate we are happy with.
+     * @param rQuantityIndex  The index of the quantity of interest we are examining at present.
+     */
+    void AddAreasMeetingTolerance(double& rAreaMet,
+                                  double& rAreaNotMet,
+                                  const double& rTolerance,
+                                  const unsigned& rQuantityIndex);
+
+    /**
+     * Add this box, and all the boxes contained within it, to a list.
+     *
+     * @param rBoxes  The list to add to.
+     */
+    void AddWholeFamilyOfBoxes(std::vector<ParameterBox<DIM>*>& rBoxes);
+
     /** Private constructor, just for use by archiving */
-    ParameterBox(){};
+    ParameterBox()
+            : mNumQoIs(0u){};
 
     /**
      * @return A pointer to (one of) the children with the largest generation number.
@@ -249,6 +681,12 @@ private:
      */
     bool IsPointInThisBox(const c_vector<double, DIM>& rPoint);
 
+    /**
+     * @return Whether a point is within (the tolerance in c_vector_compare of) this box,
+     * so that it might be one of its corners.
+     */
+    bool IsPointNearThisBox(const c_vector<double, DIM>& rPoint);
+
     /**
      * Perform interpolation within this box.
      *
@@ -359,6 +797,30 @@ private:
      */
     bool DoesBoxNeedFurtherRefinement(const double& rTolerance, const unsigned& rQuantityIndex);
 
+    /**
+     * Report whether this box needs further refinement for any quantity of interest.
+     *
+     * @param rTolerances  The error estimate that we are happy with in each QoI.
+     *
+     * @return Whether this box needs further refinement or not.
+     */
+    bool DoesBoxNeedFurtherRefinement(const std::vector<double>& rTolerances);
+
+    /**
+     * @return Whether this box is still wide enough to be refined (see DoesBoxNeedFurtherRefinement()).
+     */
+    bool IsBoxWideEnoughToRefine();
+
+    /**
+     * Get the largest error estimate in any QoI in this box, each relative to that QoI's tolerance,
+     * so that a value above one means some QoI doesn't meet its tolerance.
+     * As in GetMaxErrorInQoIEstimateInThisBox(), boxes whose corners all have errors have no error.
+     *
+     * @param rTolerances  The error estimate that we are happy with in each QoI.
+     * @return The largest normalised error estimate.
+     */
+    double GetMaxNormalisedErrorInQoIEstimatesInThisBox(const std::vector<double>& rTolerances);
+
 public:
     /**
      * Constructor
@@ -395,6 +857,36 @@ public:
      */
     CornerSet SubDivide();
 
+    /**
+     * Subdivide this box into 2^k by halving it along k of its dimensions only,
+     * leaving its width in the others alone, e.g. along one dimension gives two boxes,
+     * with 2^(DIM-1) new points rather than up to 3^DIM - 2^DIM.
+     *
+     * Makes this box into a parent and creates daughter boxes.
+     *
+     * @param rDimensions  The dimensions to halve this box along (see GetDimensionsToRefine()).
+     * @return The new points in parameter space at which quantities of interest need to be evaluated.
+     */
+    CornerSet SubDivide(const std::vector<unsigned>& rDimensions);
+
+    /**
+     * Choose the dimensions to subdivide this box along, those whose curvature causes most of the
+     * error in the QoIs (see #mMaxErrorsInEachDimension).
+     *
+     * Each dimension's error is taken relative to the tolerance for each QoI, as in
+     * GetMaxNormalisedErrorInQoIEstimatesInThisBox(), and dimensions within rFraction of the largest
+     * are chosen. All dimensions are chosen if we don't have an error for each dimension yet, or the errors
+     * along the dimensions don't explain the error in the box (if the QoIs vary with a combination of
+     * parameters). Dimensions narrower than the width at which refinement stops are not chosen.
+     *
+     * @param rTolerances  The error estimate that we are happy with in each QoI.
+     * @param rFraction  How close to the largest error (as a fraction of it) another dimension's error
+     *                   needs to be for the box to be split along that dimension too, defaults to a half.
+     * @return The dimensions to subdivide this box along, in increasing order.
+     */
+    std::vector<unsigned> GetDimensionsToRefine(const std::vector<double>& rTolerances,
+                                                const double& rFraction = 0.5);
+
     /**
      * Tell this box, and any children, the values of the quantities of interest (QoIs) at a given point.
      *
@@ -422,6 +914,58 @@ public:
                                                           const double& rTolerance,
                                                           const unsigned& rMaxGenerationDifference = UNSIGNED_UNSET);
 
+    /**
+     * Find up to rNumBoxes parameter boxes to refine together.
+     *
+     * The first box is always the one FindBoxWithLargestQoIErrorEstimate() would choose, the others are
+     * the remaining boxes that don't meet the tolerance, those with fewer QoI error codes first and then
+     * in order of decreasing error estimate. Boxes that would be refined more than rMaxGenerationDifference
+     * beyond the least refined box are left for later.
+     *
+     * If all boxes meet the tolerance an empty vector is returned.
+     *
+     * @param quantityIndex  The index of the quantity of interest to check.
+     * @param tolerance  The tolerance for this quantity of interest across the box.
+     * @param numBoxes  The maximum number of boxes to return.
+     * @param maxGenerationDifference  The maximum difference in refinement levels in terms of generation.
+     *
+     * @return The boxes that most exceed the tolerance in the quantity of interest, if any.
+     */
+    std::vector<ParameterBox<DIM>*> FindBoxesWithLargestQoIErrorEstimates(const unsigned& rQuantityIndex,
+                                                                          const double& rTolerance,
+                                                                          const unsigned& rNumBoxes,
+                                                                          const unsigned& rMaxGenerationDifference = UNSIGNED_UNSET);
+
+    /**
+     * Find the parameter box that has the largest error estimate in any quantity of interest,
+     * relative to that quantity's tolerance, so that all of them can be refined together.
+     * Will not over-refine one area if a rMaxGenerationDifference is set.
+     *
+     * If all boxes meet all the tolerances a null pointer is returned.
+     *
+     * @param rTolerances  The tolerance for each quantity of interest across a box.
+     * @param maxGenerationDifference  The maximum difference in refinement levels in terms of generation.
+     *
+     * @return The box that most exceeds the tolerances, if any.
+     */
+    ParameterBox<DIM>* FindBoxWithLargestNormalisedQoIErrorEstimate(const std::vector<double>& rTolerances,
+                                                                    const unsigned& rMaxGenerationDifference = UNSIGNED_UNSET);
+
+    /**
+     * Find up to rNumBoxes parameter boxes to refine together, in the same way as
+     * FindBoxesWithLargestQoIErrorEstimates() but with all the quantities of interest,
+     * see FindBoxWithLargestNormalisedQoIErrorEstimate().
+     *
+     * @param rTolerances  The tolerance for each quantity of interest across a box.
+     * @param numBoxes  The maximum number of boxes to return.
+     * @param maxGenerationDifference  The maximum difference in refinement levels in terms of generation.
+     *
+     * @return The boxes that most exceed the tolerances, if any.
+     */
+    std::vector<ParameterBox<DIM>*> FindBoxesWithLargestNormalisedQoIErrorEstimates(const std::vector<double>& rTolerances,
+                                                                                    const unsigned& rNumBoxes,
+                                                                                    const unsigned& rMaxGenerationDifference = UNSIGNED_UNSET);
+
     /**
      * Calculate a regular grid interpolation by finding the box containing the point and
      * interpolating QoIs from its corners.
@@ -457,4 +1001,23 @@ EXPORT_TEMPLATE_CLASS1(ParameterBox, 5u)
 EXPORT_TEMPLATE_CLASS1(ParameterBox, 6u)
 EXPORT_TEMPLATE_CLASS1(ParameterBox, 7u)
 
+// Keep track of the archive version we are using
+namespace boost
+{
+namespace serialization
+{
+    /**
+     * Specify a version number for archive backwards compatibility.
+     *
+     * This is how to do BOOST_CLASS_VERSION(ParameterBox, 1)
+     * with a templated class.
+     */
+    template <unsigned DIM>
+    struct version<ParameterBox<DIM> >
+    {
+        CHASTE_VERSION_CONTENT(3); // Increment this on save/load method changes.
+    };
+} // namespace serialization
+} // namespace boost
+
 #endif // PARAMETERBOX_HPP
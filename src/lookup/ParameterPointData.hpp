@@ -58,6 +58,7 @@ private:
         archive << mQoIs;
         archive << mErrorCode;
         archive << mErrorEstimates;
+        archive << mStateVariables;
     }
 
     /**
@@ -89,6 +90,10 @@ private:
             }
         }
         archive >> mErrorEstimates;
+        if (version >= 2)
+        {
+            archive >> mStateVariables;
+        }
     }
     BOOST_SERIALIZATION_SPLIT_MEMBER()
 
@@ -101,6 +106,9 @@ private:
     /** Whether an error occurred (code>1) whilst we were evaluating the QoIs.*/
     unsigned mErrorCode;
 
+    /** The steady state variables of the model at this point (empty if they weren't kept). */
+    std::vector<double> mStateVariables;
+
     /** Private constructor for archiving only. */
     ParameterPointData(){};
 
@@ -167,11 +175,30 @@ public:
      * ApPredict/src/single_cell/AbstractActionPotentialMethod::GetErrorCode
      */
     unsigned GetErrorCode() const { return mErrorCode; }
+
+    /**
+     * Keep the steady state the model reached at this point, so that nearby points can start from it.
+     * @param rStateVariables  The state variables.
+     */
+    void SetStateVariables(const std::vector<double>& rStateVariables)
+    {
+        mStateVariables = rStateVariables;
+    }
+
+    /**
+     * @return Whether the steady state variables were kept for this point.
+     */
+    bool HasStateVariables() const { return (mStateVariables.size() > 0u); }
+
+    /**
+     * @return The steady state variables at this point (empty if they weren't kept).
+     */
+    const std::vector<double>& rGetStateVariables() const { return mStateVariables; }
 };
 
 #include "SerializationExportWrapper.hpp"
 CHASTE_CLASS_EXPORT(ParameterPointData)
-BOOST_CLASS_VERSION(ParameterPointData, 1) // This is the second version of
-// archiving for this class (member variable changed)
+BOOST_CLASS_VERSION(ParameterPointData, 2) // This is the third version of
+// archiving for this class (state variables added)
 
 #endif // PARAMETERPOINTDATA_HPP_
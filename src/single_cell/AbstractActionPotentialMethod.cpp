@@ -35,6 +35,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 // Standard headers
 #include <cmath>
+#include <iomanip>
+#include <sstream>
 
 // Chaste includes
 #include "SteadyStateRunner.hpp"
@@ -606,6 +608,42 @@ void AbstractActionPotentialMethod::
     mActionPotentialThresholdSetManually = true;
 }
 
+double AbstractActionPotentialMethod::GetVoltageThresholdForRecordingAsActionPotential()
+{
+    return mActionPotentialThreshold;
+}
+
+std::string AbstractActionPotentialMethod::GetSteadyStateDescription(
+    boost::shared_ptr<AbstractCvodeCell> pModel, double printingTimeStep)
+{
+    boost::shared_ptr<RegularStimulus> p_stimulus = boost::static_pointer_cast<RegularStimulus>(
+        pModel->GetStimulusFunction());
+
+    std::stringstream description;
+    description << std::setprecision(17);
+    description << "model " << pModel->GetSystemName() << "\n";
+    for (unsigned i = 0; i < pModel->GetNumberOfParameters(); i++)
+    {
+        description << pModel->rGetParameterNames()[i] << " " << pModel->GetParameter(i) << "\n";
+    }
+    description << "state";
+    const std::vector<double> state_variables = pModel->GetStdVecStateVariables();
+    for (unsigned i = 0; i < state_variables.size(); i++)
+    {
+        description << " " << state_variables[i];
+    }
+    description << "\ntolerances " << pModel->GetRelativeTolerance() << " " << pModel->GetAbsoluteTolerance()
+                << "\nmax_time_step " << pModel->GetMaxTimestep();
+    description << "\nstimulus " << p_stimulus->GetMagnitude() << " " << p_stimulus->GetDuration()
+                << " " << p_stimulus->GetPeriod() << " " << p_stimulus->GetStartTime() << "\n"
+                << "max_paces " << mMaxNumPaces << "\n"
+                << "printing_time_step " << printingTimeStep << "\n"
+                << "threshold " << mActionPotentialThreshold << " " << mActionPotentialThresholdSetManually << "\n"
+                << "errors " << mNoOneToOneCorrespondenceIsError << " " << mAlternansIsError << "\n"
+                << "control " << mDefaultParametersApd90 << " " << mDefaultParametersTimeOfVMax << "\n";
+    return description.str();
+}
+
 void AbstractActionPotentialMethod::SetControlActionPotentialDuration90(
     double apd90)
 {
@@ -359,6 +359,24 @@ public:
      */
     void SetVoltageThresholdForRecordingAsActionPotential(double threshold);
 
+    /**
+     * @return The voltage which is considered to be a triggered action potential.
+     */
+    double GetVoltageThresholdForRecordingAsActionPotential();
+
+    /**
+     * Describe everything that determines the result of running SteadyStatePacingExperiment()
+     * on this model from its current state with this method's settings, to identify results
+     * in a SteadyStateCache. This includes the solver tolerances and maximum time step; the
+     * maximum number of solver steps is set from the stimulus period and number of paces.
+     *
+     * @param pModel  The model that would be run, with any drug block applied.
+     * @param printingTimeStep  The printing time step that would be used.
+     * @return The description.
+     */
+    std::string GetSteadyStateDescription(boost::shared_ptr<AbstractCvodeCell> pModel,
+                                          double printingTimeStep);
+
     /**
      * Set the control APD90. This is used in parameter sweeps to decide whether an
      * error message should be more like "no repolarisation" or "no
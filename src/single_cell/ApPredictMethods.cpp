@@ -33,24 +33,43 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <cmath>
 #include <fstream>
+#include <iomanip>
+#include <mutex>
 #include <numeric> // for std::accumulate
+#include <set>
+#include <sstream>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
 
 // ApPredict includes
 #include "AbstractDataStructure.hpp"
 #include "ActionPotentialDownsampler.hpp"
 #include "ApPredictMethods.hpp"
+#include "BatchManifestDataStructure.hpp"
 #include "BayesianInferer.hpp"
 #include "CipaQNetCalculator.hpp"
+#include "DistributedTasks.hpp"
 #include "DoseCalculator.hpp"
 #include "LookupTableLoader.hpp"
+#include "PkpdInterpolator.hpp"
+#include "SingleActionPotentialPrediction.hpp"
+#include "SteadyStateCache.hpp"
+#include "SteadyStateResult.hpp"
+#include "WorkerPool.hpp"
 
 // Chaste source includes
 #include "CommandLineArguments.hpp"
 #include "Exception.hpp"
 #include "FileFinder.hpp"
 #include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
 #include "ProgressReporter.hpp"
+#include "RandomNumberGenerator.hpp"
 #include "RegularStimulus.hpp"
 #include "SetupModel.hpp"
 #include "SteadyStateRunner.hpp"
@@ -82,6 +101,351 @@ double MedianOfStdVectorDouble(const std::vector<double> &rVec)
     }
 }
 
+/**
+ * Compounds in a batch run (see ApPredictMethods::RunBatch) are set up and write messages
+ * on several threads at once, but the singletons that this uses (warnings, random numbers,
+ * output folder creation) are not thread safe, so these are done under these locks.
+ */
+static std::mutex BatchSetupMutex;
+/** See #BatchSetupMutex. */
+static std::mutex BatchMessageMutex;
+
+/**
+ * @param isBatchCompound  Whether this is a compound in a batch run (otherwise there is nothing to lock out).
+ * @return A lock on #BatchSetupMutex for a compound in a batch run, or an empty lock otherwise.
+ */
+static std::unique_lock<std::mutex> LockBatchSetup(bool isBatchCompound)
+{
+    std::unique_lock<std::mutex> lock(BatchSetupMutex, std::defer_lock);
+    if (isBatchCompound)
+    {
+        lock.lock();
+    }
+    return lock;
+}
+
+/**
+ * Switches off a method's screen output for as long as this exists, and puts it back as it was
+ * afterwards (even if an exception is thrown). Used while worker threads call methods that would
+ * otherwise print, as their output would be interleaved.
+ */
+class OutputSuppressor
+{
+private:
+    /** The method's flag for whether its output is suppressed. */
+    bool& mrSuppressOutput;
+
+    /** Whether output was already suppressed. */
+    const bool mWasSuppressed;
+
+public:
+    /**
+     * Constructor
+     *
+     * @param rSuppressOutput  The flag to set while this exists.
+     */
+    OutputSuppressor(bool& rSuppressOutput)
+        : mrSuppressOutput(rSuppressOutput),
+          mWasSuppressed(rSuppressOutput)
+    {
+        mrSuppressOutput = true;
+    }
+
+    /**
+     * Destructor, puts the flag back.
+     */
+    ~OutputSuppressor()
+    {
+        mrSuppressOutput = mWasSuppressed;
+    }
+
+    /**
+     * @return Whether output was already suppressed, i.e. whether the caller should print anything itself.
+     */
+    bool WasSuppressed() const
+    {
+        return mWasSuppressed;
+    }
+};
+
+/**
+ * Share results between all the MPI processes, each process should have filled in the
+ * results of its own tasks (see DistributedTasks), and on return all processes have all
+ * the results. Does nothing when running sequentially.
+ *
+ * @param rResults  The results, one per task.
+ */
+void ShareSteadyStateResults(std::vector<SteadyStateResult>& rResults)
+{
+    if (PetscTools::IsSequential())
+    {
+        return;
+    }
+
+    std::vector<std::string> packed_results(rResults.size());
+    for (unsigned i = 0; i < rResults.size(); i++)
+    {
+        if (DistributedTasks::IsMine(i))
+        {
+            std::ostringstream stream;
+            boost::archive::binary_oarchive output_arch(stream);
+            output_arch << rResults[i];
+            packed_results[i] = stream.str();
+        }
+    }
+
+    DistributedTasks::ShareResults(packed_results);
+
+    for (unsigned i = 0; i < rResults.size(); i++)
+    {
+        std::istringstream stream(packed_results[i]);
+        boost::archive::binary_iarchive input_arch(stream);
+        input_arch >> rResults[i];
+    }
+}
+
+/**
+ * Read a request for a service run (see ApPredictMethods::RunService), a JSON object
+ * whose fields are command line options without the leading '--', taking a number or
+ * an array of numbers, plus an optional string "id".
+ *
+ * @param rLine  The request.
+ * @param rAllowedOptions  The options that a request can give.
+ * @param rId  Overwritten with the request's id if it has one.
+ * @param rArguments  Filled in with the values of each option.
+ */
+void ParseServiceRequest(const std::string& rLine,
+                         const std::set<std::string>& rAllowedOptions,
+                         std::string& rId,
+                         std::map<std::string, std::vector<double> >& rArguments)
+{
+    boost::property_tree::ptree request;
+    try
+    {
+        std::istringstream stream(rLine);
+        boost::property_tree::read_json(stream, request);
+    }
+    catch (const boost::property_tree::ptree_error& e)
+    {
+        EXCEPTION("Could not read request as JSON: " << e.what());
+    }
+
+    if (request.count("id") > 0u)
+    {
+        rId = request.get<std::string>("id");
+        if (rId.empty() || rId.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.") != std::string::npos
+            || rId[0] == '.')
+        {
+            EXCEPTION("The request id '" << rId << "' is used as a folder name, so should only contain letters, numbers, '_', '-' and '.'.");
+        }
+    }
+
+    for (const auto& r_field : request)
+    {
+        if (r_field.first == "id")
+        {
+            continue;
+        }
+        const std::string option = "--" + r_field.first;
+        if (rAllowedOptions.count(option) == 0u)
+        {
+            EXCEPTION("Unknown field '" << r_field.first << "' in request, only drug and concentration arguments can be given.");
+        }
+        std::vector<double> values;
+        try
+        {
+            if (r_field.second.empty())
+            {
+                values.push_back(r_field.second.get_value<double>());
+            }
+            for (const auto& r_value : r_field.second)
+            {
+                values.push_back(r_value.second.get_value<double>());
+            }
+        }
+        catch (const boost::property_tree::ptree_error&)
+        {
+            EXCEPTION("Field '" << r_field.first << "' in request should be a number or an array of numbers.");
+        }
+        if (values.empty())
+        {
+            EXCEPTION("Field '" << r_field.first << "' in request needs at least one value.");
+        }
+        rArguments[option] = values;
+    }
+}
+
+/**
+ * @param rString  A string.
+ * @return The string escaped to go inside quotes in JSON.
+ */
+std::string EscapeJson(const std::string& rString)
+{
+    std::stringstream escaped;
+    for (char c : rString)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped << '\\' << c;
+        }
+        else if (c == '\n')
+        {
+            escaped << "\\n";
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            escaped << ' ';
+        }
+        else
+        {
+            escaped << c;
+        }
+    }
+    return escaped.str();
+}
+
+/**
+ * Write an array of numbers in JSON, NaNs (e.g. APD90s that couldn't be evaluated) become null.
+ *
+ * @param rStream  The stream to write to.
+ * @param rValues  The numbers.
+ */
+void WriteJsonArray(std::ostream& rStream, const std::vector<double>& rValues)
+{
+    rStream << "[" << std::setprecision(10);
+    for (unsigned i = 0; i < rValues.size(); i++)
+    {
+        rStream << (i == 0u ? "" : ",");
+        if (std::isfinite(rValues[i]))
+        {
+            rStream << rValues[i];
+        }
+        else
+        {
+            rStream << "null";
+        }
+    }
+    rStream << "]";
+}
+
+/**
+ * Runs a model to steady state at a concentration, but keeps hold of any messages
+ * rather than writing them out, so that this can be used on a worker thread and
+ * the messages written to file in concentration order afterwards.
+ */
+class ConcentrationRunner : public SingleActionPotentialPrediction
+{
+private:
+    /** The messages generated by the last run. */
+    std::vector<std::string> mMessages;
+
+    /** The model this runner uses. */
+    boost::shared_ptr<AbstractCvodeCell> mpRunnerModel;
+
+protected:
+    /**
+     * Overridden to store the message rather than write it out.
+     *
+     * @param rMessage  The message.
+     */
+    void WriteMessageToFile(const std::string &rMessage)
+    {
+        mMessages.push_back(rMessage);
+    }
+
+public:
+    /**
+     * Constructor
+     *
+     * @param pModel  The model this runner will use.
+     */
+    ConcentrationRunner(boost::shared_ptr<AbstractCvodeCell> pModel)
+        : SingleActionPotentialPrediction(pModel),
+          mpRunnerModel(pModel)
+    {
+    }
+
+    /**
+     * Run to steady state at this concentration, forgetting anything about previous runs.
+     *
+     * @param conc  The drug concentration (just for messages, drug block should already be applied).
+     * @param calculateQNet  Whether to calculate qNet at the steady state.
+     * @param rResult  Filled in with the results.
+     */
+    void RunConcentration(double conc, bool calculateQNet, SteadyStateResult& rResult)
+    {
+        mMessages.clear();
+        mPeriodTwoBehaviour = false;
+        OdeSolution solution = RunSteadyPacingExperiment(conc);
+
+        rResult.mErrorOccurred = DidErrorOccur();
+        rResult.mErrorCode = GetErrorCode();
+        if (rResult.mErrorOccurred)
+        {
+            rResult.mErrorMessage = GetErrorMessage();
+        }
+        else
+        {
+            rResult.mApd90 = GetApd90();
+            rResult.mApd50 = GetApd50();
+            rResult.mUpstroke = GetUpstrokeVelocity();
+            rResult.mPeak = GetPeakVoltage();
+            rResult.mPeakTime = GetTimeOfPeakVoltage();
+            rResult.mCaMax = GetCaMax();
+            rResult.mCaMin = GetCaMin();
+        }
+
+        if (calculateQNet)
+        {
+            CipaQNetCalculator calculator(mpRunnerModel);
+            rResult.mQNet = calculator.ComputeQNet();
+        }
+
+        const unsigned voltage_index = mpRunnerModel->GetSystemInformation()->GetStateVariableIndex("membrane_voltage");
+        rResult.mMessages = mMessages;
+        rResult.mPeriodTwoBehaviour = mPeriodTwoBehaviour;
+        rResult.mTimes = solution.rGetTimes();
+        rResult.mVoltages = solution.GetVariableAtIndex(voltage_index);
+        rResult.mStateVariables = mpRunnerModel->GetStdVecStateVariables();
+    }
+
+    /**
+     * Run to steady state for a brute force credible interval sample, forgetting anything about previous runs.
+     *
+     * Unlike GetApd90() this returns whatever APD90 was evaluated, even if marker evaluation
+     * went wrong, as the brute force samples always have.
+     *
+     * @param conc  The drug concentration (just for messages, drug block should already be applied).
+     * @return The APD90 (ms).
+     */
+    double RunSample(double conc)
+    {
+        mMessages.clear();
+        mPeriodTwoBehaviour = false;
+        double apd90 = DOUBLE_UNSET;
+        double apd50, upstroke, peak, peak_time, ca_max, ca_min;
+        SteadyStatePacingExperiment(mpRunnerModel, apd90, apd50, upstroke, peak, peak_time, ca_max, ca_min,
+                                    0.1 /*ms printing timestep*/, conc);
+        return apd90;
+    }
+
+    /**
+     * @return The messages from the last run.
+     */
+    const std::vector<std::string> &rGetMessages() const
+    {
+        return mMessages;
+    }
+
+    /**
+     * @return Whether the last run showed period two behaviour.
+     */
+    bool HadPeriodTwoBehaviour() const
+    {
+        return mPeriodTwoBehaviour;
+    }
+};
+
 /* Citations */
 #include "Citations.hpp"
 
@@ -166,6 +530,11 @@ std::string ApPredictMethods::PrintCommonArguments()
                           "* --plasma-conc-count  Number of intermediate plasma concentrations to test \n"
                           "*                 (optional - defaults to 0 (for --plasma-concs) or 11 (for --plasma-conc-high))\n"
                           "* --plasma-conc-logscale <True/False> Whether to use log spacing for the plasma concentrations \n"
+                          "* --adaptive-concs <tolerance>  Add concentrations between the ones above, by repeated bisection,\n"
+                          "*                 wherever the change in APD90 (or its credible interval bounds) between\n"
+                          "*                 neighbouring concentrations is more than <tolerance> (% of control APD90),\n"
+                          "*                 so that interpolating linearly between them meets this tolerance (optional).\n"
+                          "*                 PKPD runs then start from the default concentrations rather than 100.\n"
                           "*\n"
                           "* SPECIFYING CONCENTRATIONS IN A FILE (for PKPD runs):\n"
                           "* if you want to run at concentrations in a file instead of specifying at command line, you can do:\n"
@@ -173,6 +542,9 @@ std::string ApPredictMethods::PrintCommonArguments()
                           "*   To evaluate APD90s throughout a PKPD profile please provide a file with the data format:\n"
                           "*   Time(any units)<tab>Conc_trace_1(uM)<tab>Conc_trace_2(uM)<tab>...Conc_trace_N(uM)\n"
                           "*   on each row.\n"
+                          "* --pkpd-conc-quantiles <N>  Simulate control and N concentrations at evenly spaced quantiles\n"
+                          "*                 of all the concentrations in the file, rather than 100 log spaced ones up to\n"
+                          "*                 the maximum (optional, can be refined further with --adaptive-concs).\n"
                           "*\n"
                           "* SECOND DRUG:\n"
                           "* To run a second compound, with independent binding model\n"
@@ -195,6 +567,7 @@ std::string ApPredictMethods::PrintCommonArguments()
                           "*    Methods, 68(1), 112-122. doi: 10.1016/j.vascn.2013.04.007 )\n"
                           "* --brute-force <N>  Make credible intervals with brute force forward simulations,\n"
                           "*                    rather than using lookup tables, and do N samples each time.\n"
+                          "*                    The samples are shared out over any --threads (see below).\n"
                           "*\n"
                           "*\n"
                           "* OTHER OPTIONS:\n"
@@ -203,6 +576,35 @@ std::string ApPredictMethods::PrintCommonArguments()
                           "* --output-dir       By default output goes into '$CHASTE_TEST_OUTPUT/ApPredict_output'\n"
                           "*                    but you can redirect it (useful for parallel scripting)\n"
                           "*                    with this argument.\n"
+                          "* --threads <N>      Run brute force samples, batch compounds, service requests and any\n"
+                          "*                    --parallel-concs on N threads at once (optional - defaults to 1,\n"
+                          "*                    0 uses all the cores on this machine). Results are the same as without.\n"
+                          "* --parallel-concs   Run the concentrations at the same time, on any --threads and MPI processes\n"
+                          "*                    (optional). Results are written out in concentration order as usual, but\n"
+                          "*                    each concentration starts from the control state rather than the previous\n"
+                          "*                    concentration's steady state, so they differ slightly from a run without\n"
+                          "*                    this option (but not with the number of threads or processes).\n"
+                          "* --batch <file>     Run many compounds, with the model, control steady state and any lookup\n"
+                          "*                    table set up once and shared. Each line of the file is a compound name\n"
+                          "*                    followed by its drug arguments as above, e.g. 'cmpd_1 --pic50-herg 5.1'.\n"
+                          "*                    Results for each compound go in a sub-folder named after it, with\n"
+                          "*                    a summary of APD90s in 'batch_summary.txt'. Compounds are run\n"
+                          "*                    concurrently on any --threads. Concentrations can also be given for\n"
+                          "*                    each compound, with --plasma-concs or --plasma-conc-high/low/count.\n"
+                          "* --service          Set up the model and any lookup table once, then answer requests for\n"
+                          "*                    predictions on stdin, one JSON object per line, whose fields are the\n"
+                          "*                    arguments allowed in a --batch file without '--' and an optional \"id\", e.g.\n"
+                          "*                    {\"id\": \"cmpd_1\", \"pic50-herg\": 5.1, \"plasma-concs\": [1, 10]}\n"
+                          "*                    Each gets a one line JSON reply on stdout with concentrations, APD90s\n"
+                          "*                    and any credible intervals, (ignore any other lines, such as warnings).\n"
+                          "*                    Requests are handled concurrently on any --threads.\n"
+                          "* --continuation     Start each concentration from the steady state of the nearest\n"
+                          "*                    concentration already simulated (optional). With --parallel-concs the\n"
+                          "*                    concentrations are then run in rounds: lowest and highest first, then\n"
+                          "*                    repeatedly bisecting, so the answers do not depend on the thread count.\n"
+                          "* --steady-state-cache <folder>  Keep the results of each steady state simulation in this\n"
+                          "*                    folder (relative to $CHASTE_TEST_OUTPUT), and re-use them whenever\n"
+                          "*                    exactly the same simulation is asked for again, in this or a later run.\n"
                           "* --version          Print out Chaste and ApPredict versions, along with dependency versions\n"
                           "*                    and exit immediately (this info automatically goes to a 'provenance_info.txt' \n"
                           "*                    file on completion of a normal run without this flag).\n"
@@ -221,16 +623,26 @@ void ApPredictMethods::ReadInIC50HillAndSaturation(
     {
         channel = "drug-two-" + channel;
     }
+    // Drug arguments come from the command line, or the batch file for a batch run.
     CommandLineArguments *p_args = CommandLineArguments::Instance();
+    auto option_exists = [&](const std::string &rOption) {
+        return mIsBatchCompound ? mBatchArguments.count(rOption) > 0u : p_args->OptionExists(rOption);
+    };
+    auto get_doubles = [&](const std::string &rOption) {
+        return mIsBatchCompound ? mBatchArguments.at(rOption) : p_args->GetDoublesCorrespondingToOption(rOption);
+    };
+    auto get_double = [&](const std::string &rOption) {
+        return mIsBatchCompound ? mBatchArguments.at(rOption)[0] : p_args->GetDoubleCorrespondingToOption(rOption);
+    };
     bool read_ic50s = false;
     bool read_hills = false;
     bool read_saturations = false;
 
     // Try loading any arguments given as IC50s
-    if (p_args->OptionExists("--ic50-" + channel))
+    if (option_exists("--ic50-" + channel))
     {
-        rIc50s = p_args->GetDoublesCorrespondingToOption("--ic50-" + channel);
-        if (p_args->OptionExists("--pic50-" + channel))
+        rIc50s = get_doubles("--ic50-" + channel);
+        if (option_exists("--pic50-" + channel))
         {
             EXCEPTION(
                 "Duplicate arguments, you cannot specify both IC50 and pIC50 for "
@@ -239,10 +651,10 @@ void ApPredictMethods::ReadInIC50HillAndSaturation(
         read_ic50s = true;
     }
     // If those don't exist try loading pIC50s.
-    else if (p_args->OptionExists("--pic50-" + channel))
+    else if (option_exists("--pic50-" + channel))
     {
         rIc50s.clear();
-        std::vector<double> pIC50s = p_args->GetDoublesCorrespondingToOption("--pic50-" + channel);
+        std::vector<double> pIC50s = get_doubles("--pic50-" + channel);
         for (unsigned i = 0; i < pIC50s.size(); i++)
         {
             rIc50s.push_back(AbstractDataStructure::ConvertPic50ToIc50(pIC50s[i]));
@@ -251,9 +663,9 @@ void ApPredictMethods::ReadInIC50HillAndSaturation(
     }
 
     // Try loading any Hills
-    if (p_args->OptionExists("--hill-" + channel))
+    if (option_exists("--hill-" + channel))
     {
-        rHills = p_args->GetDoublesCorrespondingToOption("--hill-" + channel);
+        rHills = get_doubles("--hill-" + channel);
         // But these must correspond to IC50s.
         if (!(rHills.size() == rIc50s.size()))
         {
@@ -265,9 +677,9 @@ void ApPredictMethods::ReadInIC50HillAndSaturation(
     }
 
     // Try loading any saturations
-    if (p_args->OptionExists("--saturation-" + channel))
+    if (option_exists("--saturation-" + channel))
     {
-        rSaturations = p_args->GetDoublesCorrespondingToOption("--saturation-" + channel);
+        rSaturations = get_doubles("--saturation-" + channel);
         // But these must correspond to IC50s.
         if (!(rSaturations.size() == rIc50s.size()))
         {
@@ -282,29 +694,29 @@ void ApPredictMethods::ReadInIC50HillAndSaturation(
     }
 
     // Collect any spread parameter information that has been inputted.
-    if (p_args->OptionExists("--pic50-spread-" + channel))
+    if (option_exists("--pic50-spread-" + channel))
     {
         if (secondDrug)
         {
-            mPic50SpreadsDrugTwo[channelIdx] = p_args->GetDoubleCorrespondingToOption("--pic50-spread-" + channel);
+            mPic50SpreadsDrugTwo[channelIdx] = get_double("--pic50-spread-" + channel);
         }
         else
         {
-            mPic50Spreads[channelIdx] = p_args->GetDoubleCorrespondingToOption("--pic50-spread-" + channel);
+            mPic50Spreads[channelIdx] = get_double("--pic50-spread-" + channel);
         }
     }
-    if (p_args->OptionExists("--hill-spread-" + channel))
+    if (option_exists("--hill-spread-" + channel))
     {
         if (secondDrug)
         {
-            mHillSpreadsDrugTwo[channelIdx] = p_args->GetDoubleCorrespondingToOption("--hill-spread-" + channel);
+            mHillSpreadsDrugTwo[channelIdx] = get_double("--hill-spread-" + channel);
         }
         else
         {
-            mHillSpreads[channelIdx] = p_args->GetDoubleCorrespondingToOption("--hill-spread-" + channel);
+            mHillSpreads[channelIdx] = get_double("--hill-spread-" + channel);
         }
     }
-    if (p_args->OptionExists("--saturation-spread-" + channel))
+    if (option_exists("--saturation-spread-" + channel))
     {
         EXCEPTION("Haven't yet coded up a method to deal with the spread of values on saturation levels.");
     }
@@ -420,7 +832,13 @@ ApPredictMethods::ApPredictMethods()
       mPercentiles(std::vector<double>{2.5, 97.5}),
       mConcentrationsFromFile(false),
       mComplete(false),
-      mCalculateQNet(false)
+      mCalculateQNet(false),
+      mModelIndex(UNSIGNED_UNSET),
+      mContinuation(false),
+      mIsBatchCompound(false),
+      mPresetVoltageThreshold(DOUBLE_UNSET),
+      mNumThreads(WorkerPool::GetNumThreadsFromCommandLine()),
+      mpSteadyStateCache(SteadyStateCache::CreateFromCommandLine())
 {
     // Here we list the possible drug blocks that can be applied with ApPredict
     mMetadataNames.push_back("membrane_fast_sodium_current_conductance");
@@ -802,35 +1220,72 @@ void ApPredictMethods::GetCredibleIntervalSamplesForThisConcentration(
             }
             sampling_points.push_back(sample_required_at);
         }
-        std::cout << "Calculating confidence intervals from Lookup Table...";
+        if (!mSuppressOutput)
+        {
+            std::cout << "Calculating confidence intervals from Lookup Table...";
+        }
         predictions = mpLookupTable->Interpolate(sampling_points);
     }
     // A section to deal with brute force sampling instead of lookup table interpolation.
     else
     {
-        std::cout << "Calculating confidence intervals using brute force sampling..." << std::endl;
-        bool suppressing_output = mSuppressOutput;
-        mSuppressOutput = true;
+        if (!mSuppressOutput)
+        {
+            std::cout << "Calculating confidence intervals using brute force sampling..." << std::endl;
+        }
+        OutputSuppressor output_suppressor(mSuppressOutput); // Stops ApplyDrugBlock printing from the workers.
+        const bool suppressing_output = output_suppressor.WasSuppressed();
         std::vector<double> state_vars = mpModel->GetStdVecStateVariables();
 
-        for (unsigned rand_idx = 0; rand_idx < num_samples; rand_idx++)
+        // The samples are shared out over any MPI processes, and then over the threads on each process.
+        // Each worker simulates its own copy of the model (with one thread that is just mpModel).
+        const unsigned num_my_samples = DistributedTasks::GetMyTasks(num_samples).size();
+        const unsigned num_threads = std::max(1u, std::min(mNumThreads, num_my_samples));
+        std::vector<boost::shared_ptr<AbstractCvodeCell> > models;
+        std::vector<boost::shared_ptr<ConcentrationRunner> > runners;
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            models.push_back(num_threads == 1u ? mpModel : CloneModel());
+            runners.push_back(boost::shared_ptr<ConcentrationRunner>(new ConcentrationRunner(models[i])));
+            runners[i]->SetMaxNumPaces(this->GetMaxNumPaces());
+            runners[i]->SetVoltageThresholdForRecordingAsActionPotential(this->GetVoltageThresholdForRecordingAsActionPotential());
+            runners[i]->SuppressOutput();
+            runners[i]->SuppressWarnings(mSuppressWarnings);
+        }
+        if (!suppressing_output && num_threads > 1u)
+        {
+            std::cout << "Running " << num_samples << " samples on " << num_threads << " threads..." << std::endl;
+        }
+        if (!suppressing_output && PetscTools::IsParallel())
         {
+            std::cout << "Running " << num_samples << " samples on " << PetscTools::GetNumProcs() << " processes..." << std::endl;
+        }
+
+        std::vector<SteadyStateResult> sample_results(num_samples);
+        WorkerPool pool(num_threads);
+        DistributedTasks::RunMyTasks(pool, num_samples, [&](unsigned rand_idx, unsigned worker_idx) {
+            if (!suppressing_output && num_threads == 1u && PetscTools::IsSequential())
+            {
+                std::cout << "Sample " << rand_idx + 1 << "/" << num_samples << std::endl;
+            }
+            boost::shared_ptr<AbstractCvodeCell> p_model = models[worker_idx];
 
-            std::cout << "Sample " << rand_idx + 1 << "/" << num_samples << std::endl;
+            // Start from the same state each sample (would be closer to steady state if we didn't but here at least eqi-distant each sample)
+            p_model->SetStateVariables(state_vars);
 
             // Apply drug block on each channel
             for (unsigned channel_idx = 0; channel_idx < mMetadataNames.size(); channel_idx++)
             {
                 if (mTwoDrugs)
                 {
-                    ApplyDrugBlock(mpModel, channel_idx, mDefaultConductances[channel_idx],
+                    ApplyDrugBlock(p_model, channel_idx, mDefaultConductances[channel_idx],
                                    mConcs[concIndex],
                                    mSampledIc50s[channel_idx][rand_idx], mSampledHills[channel_idx][rand_idx], rMedianSaturationLevels[channel_idx],
                                    mSampledIc50sDrugTwo[channel_idx][rand_idx], mSampledHillsDrugTwo[channel_idx][rand_idx], rMedianSaturationLevelsDrugTwo[channel_idx]);
                 }
                 else
                 {
-                    ApplyDrugBlock(mpModel, channel_idx, mDefaultConductances[channel_idx],
+                    ApplyDrugBlock(p_model, channel_idx, mDefaultConductances[channel_idx],
                                    mConcs[concIndex],
                                    mSampledIc50s[channel_idx][rand_idx],
                                    mSampledHills[channel_idx][rand_idx],
@@ -838,24 +1293,56 @@ void ApPredictMethods::GetCredibleIntervalSamplesForThisConcentration(
                 }
             }
 
-            double apd90, apd50, upstroke, peak, peak_time, ca_max, ca_min;
-            OdeSolution solution = SteadyStatePacingExperiment(mpModel, apd90, apd50, upstroke, peak, peak_time, ca_max, ca_min,
-                                                               0.1 /*ms printing timestep*/, mConcs[concIndex]);
+            // Samples are kept in any steady state cache too, marked as samples since they record less than a full run.
+            SteadyStateResult& r_result = sample_results[rand_idx];
+            std::string description;
+            if (mpSteadyStateCache)
+            {
+                std::stringstream extra;
+                extra << "sample concentration " << mConcs[concIndex] << "\nqnet " << mCalculateQNet << "\n";
+                description = runners[worker_idx]->GetSteadyStateDescription(p_model, 0.1) + extra.str();
+                if (mpSteadyStateCache->Load(description, r_result))
+                {
+                    return;
+                }
+            }
 
-            std::vector<double> qois;
-            qois.push_back(apd90);
+            r_result.mApd90 = runners[worker_idx]->RunSample(mConcs[concIndex]);
             if (mCalculateQNet)
             {
-                CipaQNetCalculator calculator(mpModel);
-                qois.push_back(calculator.ComputeQNet());
+                CipaQNetCalculator calculator(p_model);
+                r_result.mQNet = calculator.ComputeQNet();
             }
+            r_result.mMessages = runners[worker_idx]->rGetMessages();
+            r_result.mPeriodTwoBehaviour = runners[worker_idx]->HadPeriodTwoBehaviour();
 
-            predictions.push_back(qois);
+            if (mpSteadyStateCache)
+            {
+                r_result.mStateVariables = p_model->GetStdVecStateVariables();
+                mpSteadyStateCache->Save(description, r_result);
+            }
+        });
+        mpModel->SetStateVariables(state_vars);
+        ShareSteadyStateResults(sample_results);
+
+        // Gather up the predictions, and any messages, in sample order.
+        for (unsigned rand_idx = 0; rand_idx < num_samples; rand_idx++)
+        {
+            const SteadyStateResult& r_result = sample_results[rand_idx];
+            for (const std::string& r_message : r_result.mMessages)
+            {
+                WriteMessageToFile(r_message);
+            }
+            mPeriodTwoBehaviour = mPeriodTwoBehaviour || r_result.mPeriodTwoBehaviour;
 
-            // Reset state variables (would be closer to steady state if we didn't but here at least eqi-distant each sample)
-            mpModel->SetStateVariables(state_vars);
+            std::vector<double> qois;
+            qois.push_back(r_result.mApd90);
+            if (mCalculateQNet)
+            {
+                qois.push_back(r_result.mQNet);
+            }
+            predictions.push_back(qois);
         }
-        mSuppressOutput = suppressing_output;
     }
 
     assert(predictions.size() == mSampledIc50s[0].size());
@@ -911,26 +1398,383 @@ void ApPredictMethods::GetCredibleIntervalSamplesForThisConcentration(
     {
         mQNetCredibleRegions[concIndex] = qnet_credible_intervals;
     }
-    std::cout << "done." << std::endl;
+    if (!mSuppressOutput)
+    {
+        std::cout << "done." << std::endl;
+    }
 }
 
 void ApPredictMethods::Run()
 {
+    if (CommandLineArguments::Instance()->OptionExists("--batch"))
+    {
+        RunBatch();
+        return;
+    }
+    if (CommandLineArguments::Instance()->OptionExists("--service"))
+    {
+        RunService(std::cin, std::cout);
+        return;
+    }
+
     // Make and clean the above directories.
     mpFileHandler.reset(new OutputFileHandler(mOutputFolder));
 
     // This class will get model definition from command line, so we don't pass in
     // model index.
-    SetupModel setup(this->mHertz, UNSIGNED_UNSET, mpFileHandler);
-    mpModel = setup.GetModel();
+    mpSetupModel.reset(new SetupModel(this->mHertz, mModelIndex, mpFileHandler));
+    mpModel = mpSetupModel->GetModel();
 
     SetUpLookupTables();
 
     CommonRunMethod();
 }
 
+void ApPredictMethods::RunBatch()
+{
+    FileFinder batch_file(CommandLineArguments::Instance()->GetStringCorrespondingToOption("--batch"), RelativeTo::AbsoluteOrCwd);
+    if (!batch_file.IsFile())
+    {
+        EXCEPTION("The batch file '" << batch_file.GetAbsolutePath() << "' does not exist. Please give a relative or absolute path.");
+    }
+    BatchManifestDataStructure manifest(batch_file);
+    manifest.CheckOptions(GetCompoundOptions());
+
+    SetUpSharedSimulation();
+
+    const unsigned num_compounds = manifest.GetNumCompounds();
+    // With MPI each compound uses all the processes (and threads on them) in turn,
+    // otherwise the compounds are shared out over the threads.
+    const bool compounds_on_threads = PetscTools::IsSequential() && mNumThreads > 1u;
+    if (PetscTools::AmMaster())
+    {
+        std::cout << "Running a batch of " << num_compounds << " compounds";
+        if (compounds_on_threads)
+        {
+            std::cout << " on " << mNumThreads << " threads";
+        }
+        std::cout << "..." << std::endl;
+    }
+
+    std::vector<std::string> statuses(num_compounds, "Success");
+    std::vector<std::vector<double> > concs(num_compounds);
+    std::vector<std::vector<double> > apd90s(num_compounds);
+    auto run_compound = [&](unsigned compound_index) {
+        const std::string& r_name = manifest.rGetName(compound_index);
+        std::string error_message;
+        try
+        {
+            // Screen output from different compounds would be interleaved if they run at the same time.
+            boost::shared_ptr<ApPredictMethods> p_compound = RunCompound(r_name, manifest.rGetArguments(compound_index),
+                                                                         compounds_on_threads ? 1u : mNumThreads,
+                                                                         compounds_on_threads);
+            concs[compound_index] = p_compound->GetConcentrations();
+            apd90s[compound_index] = p_compound->GetApd90s();
+        }
+        // Nothing may escape from a worker thread, and one compound failing shouldn't stop the others.
+        catch (const Exception& e)
+        {
+            error_message = e.GetShortMessage();
+        }
+        catch (const std::exception& e)
+        {
+            error_message = std::string("Unexpected error: ") + e.what();
+        }
+        catch (...)
+        {
+            error_message = "Unexpected error.";
+        }
+        if (!error_message.empty())
+        {
+            // Keep the summary to one line per compound.
+            std::replace(error_message.begin(), error_message.end(), '\n', ' ');
+            std::replace(error_message.begin(), error_message.end(), '\t', ' ');
+            statuses[compound_index] = "Failed: " + error_message;
+            concs[compound_index].clear();
+            apd90s[compound_index].clear();
+        }
+        if (PetscTools::AmMaster())
+        {
+            std::stringstream message;
+            message << "Compound " << r_name << ": " << statuses[compound_index] << std::endl;
+            std::cout << message.str() << std::flush;
+        }
+    };
+
+    if (compounds_on_threads)
+    {
+        WorkerPool pool(std::min(mNumThreads, num_compounds));
+        pool.Run(num_compounds, [&](unsigned compound_index, unsigned /*worker_index*/) {
+            run_compound(compound_index);
+        });
+    }
+    else
+    {
+        for (unsigned compound_index = 0; compound_index < num_compounds; compound_index++)
+        {
+            run_compound(compound_index);
+        }
+    }
+
+    // Summarise the APD90s for all the compounds, using the concentrations of the first one that ran.
+    std::vector<double> summary_concs;
+    for (unsigned compound_index = 0; compound_index < num_compounds && summary_concs.empty(); compound_index++)
+    {
+        summary_concs = concs[compound_index];
+    }
+    out_stream summary_file = OpenOutputFileOnMaster("batch_summary.txt");
+    *summary_file << "Compound\tStatus";
+    for (unsigned i = 0; i < summary_concs.size(); i++)
+    {
+        *summary_file << "\tAPD90_at_" << summary_concs[i] << "uM(ms)";
+    }
+    *summary_file << std::endl;
+    for (unsigned compound_index = 0; compound_index < num_compounds; compound_index++)
+    {
+        *summary_file << manifest.rGetName(compound_index) << "\t" << statuses[compound_index];
+        for (unsigned i = 0; i < apd90s[compound_index].size(); i++)
+        {
+            *summary_file << "\t" << apd90s[compound_index][i];
+        }
+        *summary_file << std::endl;
+    }
+    summary_file->close();
+}
+
+std::set<std::string> ApPredictMethods::GetCompoundOptions() const
+{
+    std::set<std::string> options{ "--plasma-concs", "--plasma-conc-high", "--plasma-conc-low", "--plasma-conc-count" };
+    const std::vector<std::string> prefixes{ "--ic50-", "--pic50-", "--hill-", "--saturation-",
+                                             "--pic50-spread-", "--hill-spread-", "--saturation-spread-" };
+    for (const std::string& r_prefix : prefixes)
+    {
+        for (const std::string& r_channel : mShortNames)
+        {
+            options.insert(r_prefix + r_channel);
+            options.insert(r_prefix + "drug-two-" + r_channel);
+        }
+    }
+    return options;
+}
+
+void ApPredictMethods::SetUpSharedSimulation()
+{
+    // Drug properties have to be given for each compound, but the command line
+    // concentrations are used for any compound that doesn't give its own.
+    CommandLineArguments* p_args = CommandLineArguments::Instance();
+    for (const std::string& r_option : GetCompoundOptions())
+    {
+        if (r_option.find("--plasma-conc") != 0u && p_args->OptionExists(r_option))
+        {
+            EXCEPTION("The argument " << r_option << " can't be used with --batch or --service, please give drug arguments for each compound.");
+        }
+    }
+
+    mpFileHandler.reset(new OutputFileHandler(mOutputFolder));
+    mpSetupModel.reset(new SetupModel(this->mHertz, mModelIndex, mpFileHandler));
+    mpModel = mpSetupModel->GetModel();
+    SetUpLookupTables();
+
+    // Work out the voltage threshold and then run the control, in just the same way as
+    // CommonRunMethod would for each compound, so that every compound gets the same
+    // control results (and starts from the same steady state) as it would on its own.
+    {
+        SingleActionPotentialPrediction ap_runner(mpModel);
+        ap_runner.SuppressOutput();
+        ap_runner.SuppressWarnings();
+        ap_runner.SetMaxNumPaces(100u);
+        mPresetVoltageThreshold = ap_runner.DetectVoltageThresholdForActionPotential();
+    }
+    boost::shared_ptr<RegularStimulus> p_reg_stim = boost::static_pointer_cast<RegularStimulus>(mpModel->GetStimulusFunction());
+    p_reg_stim->SetStartTime(5.0);
+    const bool calculate_q_net = mpModel->GetSystemName() == "ohara_rudy_cipa_v1_2017" && p_reg_stim->GetPeriod() == 2000;
+    {
+        ConcentrationRunner control_runner(mpModel);
+        control_runner.SuppressOutput();
+        control_runner.SuppressWarnings();
+        control_runner.SetMaxNumPaces(this->GetMaxNumPaces());
+        control_runner.SetVoltageThresholdForRecordingAsActionPotential(mPresetVoltageThreshold);
+        boost::shared_ptr<SteadyStateResult> p_control_result(new SteadyStateResult);
+        control_runner.RunConcentration(0.0, calculate_q_net, *p_control_result);
+        mpSharedControlResult = p_control_result;
+    }
+}
+
+boost::shared_ptr<ApPredictMethods> ApPredictMethods::RunCompound(const std::string& rName,
+                                                                  const std::map<std::string, std::vector<double> >& rArguments,
+                                                                  unsigned numThreads,
+                                                                  bool suppressOutput)
+{
+    boost::shared_ptr<ApPredictMethods> p_compound;
+    {
+        std::lock_guard<std::mutex> lock(BatchSetupMutex); // See #BatchSetupMutex.
+        p_compound.reset(new ApPredictMethods);
+        p_compound->mOutputFolder = mOutputFolder + "/" + rName;
+        p_compound->mpFileHandler.reset(new OutputFileHandler(p_compound->mOutputFolder));
+        p_compound->mModelIndex = mModelIndex;
+        p_compound->mpSetupModel = mpSetupModel;
+    }
+    p_compound->mpModel = CloneModel();
+    p_compound->mpLookupTable = mpLookupTable;
+    p_compound->mLookupTableAvailable = mLookupTableAvailable;
+    p_compound->mPercentiles = mPercentiles;
+    p_compound->mPresetVoltageThreshold = mPresetVoltageThreshold;
+    p_compound->mpSharedControlResult = mpSharedControlResult;
+    p_compound->mIsBatchCompound = true;
+    p_compound->mBatchArguments = rArguments;
+    p_compound->mNumThreads = numThreads;
+    if (suppressOutput)
+    {
+        p_compound->SuppressOutput();
+        p_compound->SuppressWarnings();
+    }
+    p_compound->CommonRunMethod();
+    return p_compound;
+}
+
+void ApPredictMethods::RunService(std::istream& rInput, std::ostream& rOutput)
+{
+    if (PetscTools::IsParallel())
+    {
+        EXCEPTION("--service runs on a single process, use --threads to handle requests concurrently.");
+    }
+
+    SetUpSharedSimulation();
+    const std::set<std::string> allowed_options = GetCompoundOptions();
+    rOutput << "{\"status\":\"ready\"}" << std::endl;
+
+    // Workers take turns to read a request, and write each response as soon as it is ready.
+    std::mutex input_mutex;
+    std::mutex output_mutex;
+    std::set<std::string> active_ids;
+    unsigned num_requests = 0u;
+    WorkerPool pool(mNumThreads);
+    pool.Run(pool.GetNumWorkers(), [&](unsigned /*task_index*/, unsigned /*worker_index*/) {
+        while (true)
+        {
+            std::string id;
+            std::map<std::string, std::vector<double> > arguments;
+            std::string error_message;
+            {
+                std::lock_guard<std::mutex> lock(input_mutex);
+                std::string line;
+                do
+                {
+                    if (!std::getline(rInput, line))
+                    {
+                        return;
+                    }
+                } while (line.find_first_not_of(" \t\r") == std::string::npos);
+
+                std::stringstream default_id;
+                default_id << "request_" << num_requests++;
+                id = default_id.str();
+                try
+                {
+                    ParseServiceRequest(line, allowed_options, id, arguments);
+                    if (active_ids.count(id) > 0u)
+                    {
+                        EXCEPTION("A request with id '" << id << "' is already running.");
+                    }
+                    active_ids.insert(id);
+                }
+                // Any error goes back as the response to this request, and the service carries on.
+                catch (const Exception& e)
+                {
+                    error_message = e.GetShortMessage();
+                }
+                catch (const std::exception& e)
+                {
+                    error_message = std::string("Unexpected error: ") + e.what();
+                }
+                catch (...)
+                {
+                    error_message = "Unexpected error.";
+                }
+            }
+
+            std::stringstream response;
+            if (error_message.empty())
+            {
+                try
+                {
+                    boost::shared_ptr<ApPredictMethods> p_compound = RunCompound(id, arguments, 1u, true);
+                    response << "{\"id\":\"" << EscapeJson(id) << "\",\"status\":\"ok\"";
+                    response << ",\"concentrations\":";
+                    WriteJsonArray(response, p_compound->GetConcentrations());
+                    response << ",\"apd90\":";
+                    WriteJsonArray(response, p_compound->GetApd90s());
+                    if (p_compound->mLookupTableAvailable)
+                    {
+                        response << ",\"percentiles\":";
+                        WriteJsonArray(response, mPercentiles);
+                        response << ",\"apd90_credible_intervals\":[";
+                        const std::vector<std::vector<double> > credible_regions = p_compound->GetApd90CredibleRegions();
+                        for (unsigned i = 0; i < credible_regions.size(); i++)
+                        {
+                            response << (i == 0u ? "" : ",");
+                            WriteJsonArray(response, credible_regions[i]);
+                        }
+                        response << "]";
+                    }
+                    response << "}";
+                }
+                catch (const Exception& e)
+                {
+                    error_message = e.GetShortMessage();
+                }
+                catch (const std::exception& e)
+                {
+                    error_message = std::string("Unexpected error: ") + e.what();
+                }
+                catch (...)
+                {
+                    error_message = "Unexpected error.";
+                }
+                std::lock_guard<std::mutex> lock(input_mutex);
+                active_ids.erase(id);
+            }
+            if (!error_message.empty())
+            {
+                response.str("");
+                response << "{\"id\":\"" << EscapeJson(id) << "\",\"status\":\"error\",\"message\":\""
+                         << EscapeJson(error_message) << "\"}";
+            }
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            rOutput << response.str() << std::endl;
+        }
+    });
+}
+
+boost::shared_ptr<AbstractCvodeCell> ApPredictMethods::CloneModel()
+{
+    if (!mpSetupModel)
+    {
+        mpSetupModel.reset(new SetupModel(this->mHertz, mModelIndex, mpFileHandler));
+    }
+    boost::shared_ptr<AbstractCvodeCell> p_model = mpSetupModel->MakeAnotherModel();
+
+    // Give it its own copy of the stimulus mpModel is using (we may have moved it),
+    // and start from wherever mpModel has got to.
+    boost::shared_ptr<RegularStimulus> p_stimulus = boost::static_pointer_cast<RegularStimulus>(mpModel->GetStimulusFunction());
+    boost::shared_ptr<RegularStimulus> p_copied_stimulus(new RegularStimulus(p_stimulus->GetMagnitude(),
+                                                                              p_stimulus->GetDuration(),
+                                                                              p_stimulus->GetPeriod(),
+                                                                              p_stimulus->GetStartTime()));
+    p_model->SetStimulusFunction(p_copied_stimulus);
+    p_model->SetStateVariables(mpModel->GetStdVecStateVariables());
+    return p_model;
+}
+
 void ApPredictMethods::CommonRunMethod()
 {
+    // With MPI all processes share the simulations, but only the master reports on them.
+    if (!PetscTools::AmMaster())
+    {
+        mSuppressOutput = true;
+    }
+
     if (!mSuppressOutput)
     {
         std::cout << "* model = " << mpModel->GetSystemName() << std::endl;
@@ -992,15 +1836,61 @@ void ApPredictMethods::CommonRunMethod()
         }
 
         // Set up a structure to read the PK concentrations in.
-        mpPkpdReader = boost::shared_ptr<PkpdDataStructure>(new PkpdDataStructure(pkpd_file));
+        // The concentrations are only kept in memory if we need to place ours amongst them,
+        // otherwise they are parked in a temporary file and streamed back through at the end.
+        const bool keep_concentrations = CommandLineArguments::Instance()->OptionExists("--pkpd-conc-quantiles");
+        mpPkpdReader = boost::shared_ptr<PkpdDataStructure>(new PkpdDataStructure(pkpd_file, keep_concentrations));
         mConcentrationsFromFile = true;
 
         // Calculate maximum concentration to use... add 10% to the maximum we saw.
-        DoseCalculator dose_calculator(1.1 * mpPkpdReader->GetMaximumConcentration());
-        dose_calculator.SetNumSubdivisions(97); // Loads of detail for these sims
-        // to be accurately interpolated
-        // later.
-        mConcs = dose_calculator.GetConcentrations();
+        if (CommandLineArguments::Instance()->OptionExists("--pkpd-conc-quantiles"))
+        {
+            // Follow the distribution of concentrations in the file (along with control).
+            const unsigned num_quantiles = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("--pkpd-conc-quantiles");
+            mConcs = mpPkpdReader->GetConcentrationQuantiles(num_quantiles);
+            mConcs.insert(mConcs.begin(), 0.0);
+        }
+        else
+        {
+            DoseCalculator dose_calculator(1.1 * mpPkpdReader->GetMaximumConcentration());
+            if (!CommandLineArguments::Instance()->OptionExists("--adaptive-concs"))
+            {
+                dose_calculator.SetNumSubdivisions(97); // Loads of detail for these sims
+                // to be accurately interpolated
+                // later.
+            } // otherwise detail is added where it is needed below.
+            mConcs = dose_calculator.GetConcentrations();
+        }
+    }
+    else if (mIsBatchCompound && (mBatchArguments.count("--plasma-concs") > 0u || mBatchArguments.count("--plasma-conc-high") > 0u))
+    {
+        // This compound has its own concentrations, treat them as the equivalent command line arguments would be.
+        boost::shared_ptr<DoseCalculator> p_dose_calculator;
+        if (mBatchArguments.count("--plasma-concs") > 0u)
+        {
+            p_dose_calculator.reset(new DoseCalculator(mBatchArguments.at("--plasma-concs")));
+        }
+        else
+        {
+            const double low = mBatchArguments.count("--plasma-conc-low") > 0u ? mBatchArguments.at("--plasma-conc-low")[0] : 0.0;
+            p_dose_calculator.reset(new DoseCalculator(mBatchArguments.at("--plasma-conc-high")[0], low));
+        }
+        if (mBatchArguments.count("--plasma-conc-count") > 0u)
+        {
+            const double count = mBatchArguments.at("--plasma-conc-count")[0];
+            if (count < 0 || count != std::floor(count))
+            {
+                EXCEPTION("--plasma-conc-count should be a whole number, not " << count << ".");
+            }
+            p_dose_calculator->SetNumSubdivisions((unsigned)(count));
+        }
+        bool log_scale = true;
+        if (CommandLineArguments::Instance()->OptionExists("--plasma-conc-logscale"))
+        {
+            log_scale = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("--plasma-conc-logscale");
+        }
+        p_dose_calculator->SetLogScale(log_scale);
+        mConcs = p_dose_calculator->GetConcentrations();
     }
     else
     // this default DoseCalculator constructor reads command line arguments
@@ -1010,23 +1900,28 @@ void ApPredictMethods::CommonRunMethod()
         mConcs = dose_calculator.GetConcentrations();
     }
 
-    // We check the desired parameters are present in the model, warn if not.
-    // This method also changes some metadata names if the model has variants that
-    // will do, but aren't ideal
-    // and warns if it does this.
-    ParameterWrapper(mpModel, mMetadataNames);
-
-    // Use a helper method to read in IC50 from either --ic50 or --pic50 arguments.
-    // Note IC50 is now in micro Molar (1x10^-6 Molar) as per most Pharma use.
-    for (unsigned channel_idx = 0; channel_idx < mMetadataNames.size(); channel_idx++)
     {
-        ReadInIC50HillAndSaturation(IC50s[channel_idx], hills[channel_idx],
-                                    saturations[channel_idx], channel_idx);
+        // These may give warnings while other compounds of a batch are setting up, see #BatchSetupMutex.
+        std::unique_lock<std::mutex> lock = LockBatchSetup(mIsBatchCompound);
 
-        if (mTwoDrugs)
+        // We check the desired parameters are present in the model, warn if not.
+        // This method also changes some metadata names if the model has variants that
+        // will do, but aren't ideal
+        // and warns if it does this.
+        ParameterWrapper(mpModel, mMetadataNames);
+
+        // Use a helper method to read in IC50 from either --ic50 or --pic50 arguments.
+        // Note IC50 is now in micro Molar (1x10^-6 Molar) as per most Pharma use.
+        for (unsigned channel_idx = 0; channel_idx < mMetadataNames.size(); channel_idx++)
         {
-            ReadInIC50HillAndSaturation(IC50s_drug_two[channel_idx], hills_drug_two[channel_idx],
-                                        saturations_drug_two[channel_idx], channel_idx, true);
+            ReadInIC50HillAndSaturation(IC50s[channel_idx], hills[channel_idx],
+                                        saturations[channel_idx], channel_idx);
+
+            if (mTwoDrugs)
+            {
+                ReadInIC50HillAndSaturation(IC50s_drug_two[channel_idx], hills_drug_two[channel_idx],
+                                            saturations_drug_two[channel_idx], channel_idx, true);
+            }
         }
     }
 
@@ -1061,21 +1956,36 @@ void ApPredictMethods::CommonRunMethod()
 
     // Work out the best voltage threshold to use for this model
     // (in the same way as the LookupTableGenerator does to ensure consistent APD calcs with that).
+    double voltage_threshold = mPresetVoltageThreshold;
+    if (voltage_threshold != DOUBLE_UNSET)
+    {
+        this->SetVoltageThresholdForRecordingAsActionPotential(voltage_threshold);
+    }
+    else
     {
         SingleActionPotentialPrediction ap_runner(mpModel);
         ap_runner.SuppressOutput();
         ap_runner.SuppressWarnings(); // We expect this not to be converged and to cause AP failures, don't want warnings
         ap_runner.SetMaxNumPaces(100u);
-        this->SetVoltageThresholdForRecordingAsActionPotential(ap_runner.DetectVoltageThresholdForActionPotential());
+        voltage_threshold = ap_runner.DetectVoltageThresholdForActionPotential();
+        this->SetVoltageThresholdForRecordingAsActionPotential(voltage_threshold);
     }
 
-    CalculateDoseResponseParameterSamples(IC50s, hills);
-    if (mTwoDrugs)
     {
-        CalculateDoseResponseParameterSamples(IC50s_drug_two, hills_drug_two, true);
+        // Compounds in a batch take the same random samples as they would if run on their own,
+        // so no other compound can use the random number generator in between, see #BatchSetupMutex.
+        std::unique_lock<std::mutex> lock = LockBatchSetup(mIsBatchCompound);
+        if (mIsBatchCompound)
+        {
+            RandomNumberGenerator::Instance()->Reseed(0u);
+        }
+        CalculateDoseResponseParameterSamples(IC50s, hills);
+        if (mTwoDrugs)
+        {
+            CalculateDoseResponseParameterSamples(IC50s_drug_two, hills_drug_two, true);
+        }
     }
 
-    boost::shared_ptr<const AbstractOdeSystemInformation> p_ode_info = mpModel->GetSystemInformation();
     std::string model_name = mpModel->GetSystemName();
     boost::shared_ptr<RegularStimulus> p_reg_stim = boost::static_pointer_cast<RegularStimulus>(mpModel->GetStimulusFunction());
     p_reg_stim->SetStartTime(5.0);
@@ -1085,7 +1995,7 @@ void ApPredictMethods::CommonRunMethod()
     if (model_name == "ohara_rudy_cipa_v1_2017" && p_reg_stim->GetPeriod() == 2000)
     {
         mCalculateQNet = true;
-        q_net_results_file = mpFileHandler->OpenOutputFile("q_net.txt");
+        q_net_results_file = OpenOutputFileOnMaster("q_net.txt");
         if (mTwoDrugs) 
         {
             *q_net_results_file << "ConcentrationDrug1(uM)\tConcentrationDrug2(uM)\t";
@@ -1096,14 +2006,19 @@ void ApPredictMethods::CommonRunMethod()
         }
     }
 
-    // Print out a progress file for monitoring purposes.
+    // Print out a progress file for monitoring purposes (this makes an output handler, see #BatchSetupMutex).
+    std::unique_lock<std::mutex> reporter_lock = LockBatchSetup(mIsBatchCompound);
     ProgressReporter progress_reporter(mOutputFolder, 0.0, (double)(mConcs.size()));
+    if (reporter_lock.owns_lock())
+    {
+        reporter_lock.unlock();
+    }
     progress_reporter.PrintInitialising();
 
     // Open files and write headers
-    out_stream steady_voltage_results_file_html = mpFileHandler->OpenOutputFile("voltage_results.html");
+    out_stream steady_voltage_results_file_html = OpenOutputFileOnMaster("voltage_results.html");
 
-    out_stream steady_voltage_results_file = mpFileHandler->OpenOutputFile("voltage_results.dat");
+    out_stream steady_voltage_results_file = OpenOutputFileOnMaster("voltage_results.dat");
     if (mTwoDrugs)
     {
         *steady_voltage_results_file << "Concentration_Drug_1(uM)\tConcentration_Drug_2(uM)\t";
@@ -1288,41 +2203,82 @@ void ApPredictMethods::CommonRunMethod()
      * START LOOP OVER EACH CONCENTRATION TO TEST WITH
      */
     bool reliable_credible_intervals = true;
-    mApd90CredibleRegions.resize(mConcs.size());
-    mQNetCredibleRegions.resize(mConcs.size());
+    mApd90CredibleRegions.assign(mConcs.size(), std::vector<double>());
+    mQNetCredibleRegions.assign(mConcs.size(), std::vector<double>());
     double control_apd90 = 0;
-    for (unsigned conc_index = 0u; conc_index < mConcs.size(); conc_index++)
-    {
-        progress_reporter.Update((double)(conc_index));
-        std::cout << "Drug Conc = " << mConcs[conc_index] << " uM";
-        if (mTwoDrugs)
-            std::cout << ",\tDrug 2 Conc = " << mConcs[conc_index] * mDrugTwoConcentrationFactor << "uM";
-        std::cout << std::endl; //<< std::flush;
 
+    // Apply drug block for this concentration to a model, run it to steady state and store the results.
+    // This only touches the model and runner it is given, so it can be called from worker threads.
+    auto run_concentration = [&](boost::shared_ptr<AbstractCvodeCell> pModel,
+                                 ConcentrationRunner& rRunner,
+                                 const double concentration,
+                                 SteadyStateResult& rResult) {
         // Apply drug block on each channel
         for (unsigned channel_idx = 0; channel_idx < mMetadataNames.size(); channel_idx++)
         {
             if (mTwoDrugs)
             {
-                ApplyDrugBlock(mpModel, channel_idx, mDefaultConductances[channel_idx],
-                               mConcs[conc_index],
+                ApplyDrugBlock(pModel, channel_idx, mDefaultConductances[channel_idx],
+                               concentration,
                                median_ic50[channel_idx], median_hill[channel_idx], median_saturation[channel_idx],
                                median_ic50_drug_two[channel_idx], median_hill_drug_two[channel_idx], median_saturation_drug_two[channel_idx]);
             }
             else
             {
-                ApplyDrugBlock(mpModel, channel_idx, mDefaultConductances[channel_idx],
-                               mConcs[conc_index], median_ic50[channel_idx],
+                ApplyDrugBlock(pModel, channel_idx, mDefaultConductances[channel_idx],
+                               concentration, median_ic50[channel_idx],
                                median_hill[channel_idx], median_saturation[channel_idx]);
             }
         }
 
-        double apd90, apd50, upstroke, peak, peak_time, ca_max, ca_min;
-        OdeSolution solution = SteadyStatePacingExperiment(
-            mpModel, apd90, apd50, upstroke, peak, peak_time, ca_max, ca_min,
-            0.1 /*ms printing timestep*/, mConcs[conc_index]);
+        // Compounds in a batch all share the control steady state, see #SetUpSharedSimulation.
+        if (mpSharedControlResult && fabs(concentration) < 1e-12)
+        {
+            rResult = *mpSharedControlResult;
+            pModel->SetStateVariables(rResult.mStateVariables);
+            return;
+        }
+
+        // The concentration goes in the description too, as it appears in any messages.
+        std::string description;
+        if (mpSteadyStateCache)
+        {
+            std::stringstream extra;
+            extra << "concentration " << concentration << "\nqnet " << mCalculateQNet << "\n";
+            description = rRunner.GetSteadyStateDescription(pModel, 0.1) + extra.str();
+            if (mpSteadyStateCache->Load(description, rResult))
+            {
+                pModel->SetStateVariables(rResult.mStateVariables);
+                return;
+            }
+        }
+
+        rRunner.RunConcentration(concentration, mCalculateQNet, rResult);
+
+        if (mpSteadyStateCache)
+        {
+            mpSteadyStateCache->Save(description, rResult);
+        }
+    };
 
-        if (DidErrorOccur())
+    // Write the results for this concentration to the results files, must be called in concentration order.
+    auto record_concentration = [&](const unsigned conc_index, const SteadyStateResult& rResult) {
+        // Pass on any messages the runner generated, as if it had written them itself.
+        for (unsigned i = 0; i < rResult.mMessages.size(); i++)
+        {
+            WriteMessageToFile(rResult.mMessages[i]);
+        }
+        if (rResult.mPeriodTwoBehaviour)
+        {
+            mPeriodTwoBehaviour = true;
+        }
+
+        const double apd90 = rResult.mApd90;
+        const double apd50 = rResult.mApd50;
+        const double upstroke = rResult.mUpstroke;
+        const double peak = rResult.mPeak;
+
+        if (rResult.mErrorOccurred)
         {
             // Put a NaN in the APD90 vector if there was an error.
             mApd90s.push_back(std::numeric_limits<double>::quiet_NaN());
@@ -1334,8 +2290,7 @@ void ApPredictMethods::CommonRunMethod()
 
         if (mCalculateQNet)
         {
-            CipaQNetCalculator calculator(mpModel);
-            double q_net = calculator.ComputeQNet();
+            double q_net = rResult.mQNet;
             mQNets.push_back(q_net);
 
             if (conc_index == mConcs.size() - 1u && this->GetMaxNumPaces() < 750u)
@@ -1356,10 +2311,14 @@ void ApPredictMethods::CommonRunMethod()
             }
         }
 
-        // Populates mApd90CredibleRegions and mQNetCredibleRegions, relies on mApd90s and mQNets.
-        GetCredibleIntervalSamplesForThisConcentration(conc_index, median_saturation, median_saturation_drug_two);
+        // Populates mApd90CredibleRegions and mQNetCredibleRegions, relies on mApd90s and mQNets
+        // (unless --adaptive-concs has already worked them out).
+        if (conc_index == 0u || mApd90CredibleRegions[conc_index].empty())
+        {
+            GetCredibleIntervalSamplesForThisConcentration(conc_index, median_saturation, median_saturation_drug_two);
+        }
 
-        if (!DidErrorOccur())
+        if (!rResult.mErrorOccurred)
         {
             // Record the control APD90 if this concentration is zero.
             if (fabs(mConcs[conc_index]) < 1e-12)
@@ -1434,7 +2393,7 @@ void ApPredictMethods::CommonRunMethod()
         }
         else // error occurred in postprocessing APD
         {
-            std::string error_code = GetErrorMessage();
+            const std::string& error_code = rResult.mErrorMessage;
             if (!mSuppressOutput)
                 std::cout << mHertz << "Hz Upstroke velocity = " << error_code
                           << ", Peak mV = " << error_code << ", APD50 = " << error_code
@@ -1522,7 +2481,6 @@ void ApPredictMethods::CommonRunMethod()
             mpModel->GetStimulusFunction());
         double s1_period = p_default_stimulus->GetPeriod();
         double s_start = p_default_stimulus->GetStartTime() + s1_period;
-        std::vector<double> voltages = solution.GetVariableAtIndex(mpModel->GetSystemInformation()->GetStateVariableIndex("membrane_voltage"));
         double window = s1_period;
         if (this->mPeriodTwoBehaviour)
         {
@@ -1530,8 +2488,365 @@ void ApPredictMethods::CommonRunMethod()
         }
         double data_start = s1_period;
         ActionPotentialDownsampler(mOutputFolder, filename.str(),
-                                   solution.rGetTimes(), voltages, window, s_start, data_start);
-    } // Conc
+                                   rResult.mTimes, rResult.mVoltages, window, s_start, data_start);
+    };
+
+    // Give a runner the same settings as this class uses for its own simulations.
+    auto set_up_runner = [&](ConcentrationRunner& rRunner) {
+        rRunner.SetMaxNumPaces(this->GetMaxNumPaces());
+        rRunner.SetVoltageThresholdForRecordingAsActionPotential(voltage_threshold);
+        rRunner.SuppressOutput(mSuppressOutput);
+        rRunner.SuppressWarnings(mSuppressWarnings);
+    };
+
+    auto print_concentration = [&](const unsigned conc_index) {
+        if (mSuppressOutput)
+        {
+            return;
+        }
+        std::cout << "Drug Conc = " << mConcs[conc_index] << " uM";
+        if (mTwoDrugs)
+            std::cout << ",\tDrug 2 Conc = " << mConcs[conc_index] * mDrugTwoConcentrationFactor << "uM";
+        std::cout << std::endl; //<< std::flush;
+    };
+
+    // Remember the steady state at each concentration, starting with the control state we have already.
+    mContinuation = CommandLineArguments::Instance()->OptionExists("--continuation");
+    mSteadyStates.Clear();
+    mSteadyStates.Add(0.0, mpModel->GetStdVecStateVariables());
+    auto store_steady_state = [&](const double concentration, const SteadyStateResult& rResult) {
+        // Don't start anything else from a cell that failed to give an action potential.
+        if (!rResult.mErrorOccurred)
+        {
+            mSteadyStates.Add(concentration, rResult.mStateVariables);
+        }
+    };
+
+    // With --adaptive-concs we bisect any interval between neighbouring concentrations where the APD90,
+    // or the credible interval bounds from a lookup table, change by more than the tolerance.
+    // Brute force credible intervals would need a full set of samples at every trial concentration,
+    // so they are only calculated at the concentrations chosen on the APD90s.
+    const bool adaptive_concs = CommandLineArguments::Instance()->OptionExists("--adaptive-concs");
+    double adaptive_tolerance = DBL_MAX;
+    if (adaptive_concs)
+    {
+        adaptive_tolerance = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("--adaptive-concs");
+        if (adaptive_tolerance <= 0.0)
+        {
+            EXCEPTION("--adaptive-concs should be followed by a positive tolerance (% of control APD90), not " << adaptive_tolerance << ".");
+        }
+    }
+    const bool refine_on_credible_intervals = mLookupTableAvailable && !CommandLineArguments::Instance()->OptionExists("--brute-force");
+    bool log_scale_concs = true;
+    if (CommandLineArguments::Instance()->OptionExists("--plasma-conc-logscale"))
+    {
+        log_scale_concs = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("--plasma-conc-logscale");
+    }
+    const unsigned max_num_adaptive_concs = 250u; // More than the PKPD default, in case the APD90s never settle down.
+
+    // Return the concentrations that should be added between those in mConcs, given the results at each.
+    auto get_refinement_concentrations = [&](const std::vector<SteadyStateResult>& rResults) {
+        std::vector<double> new_concs;
+        if (fabs(mConcs[0]) > 1e-12 || rResults[0].mErrorOccurred)
+        {
+            WriteMessageToFile("Concentrations were not refined with --adaptive-concs, as the tolerance is relative to a "
+                               "control APD90 and there wasn't one.");
+            return new_concs;
+        }
+        const double reference_apd90 = rResults[0].mApd90;
+
+        if (refine_on_credible_intervals)
+        {
+            // Only concentrations added since last time need their credible intervals working out, these are
+            // kept for when they are recorded. The control's is just its APD90, and comes from mApd90s then.
+            for (unsigned conc_index = 1u; conc_index < mConcs.size(); conc_index++)
+            {
+                if (mApd90CredibleRegions[conc_index].empty())
+                {
+                    GetCredibleIntervalSamplesForThisConcentration(conc_index, median_saturation, median_saturation_drug_two);
+                }
+            }
+        }
+        auto differs = [&](double apd90, double other_apd90) {
+            return 100.0 * fabs(apd90 - other_apd90) / reference_apd90 > adaptive_tolerance;
+        };
+
+        for (unsigned conc_index = 0u; conc_index + 1u < mConcs.size(); conc_index++)
+        {
+            const SteadyStateResult& r_lower = rResults[conc_index];
+            const SteadyStateResult& r_upper = rResults[conc_index + 1u];
+            if (r_lower.mErrorOccurred && r_upper.mErrorOccurred)
+            {
+                continue;
+            }
+
+            // Home in on where action potentials start to fail too.
+            bool refine = (r_lower.mErrorOccurred != r_upper.mErrorOccurred) || differs(r_lower.mApd90, r_upper.mApd90);
+            if (!refine && refine_on_credible_intervals)
+            {
+                const std::vector<double>& r_upper_bounds = mApd90CredibleRegions[conc_index + 1u];
+                for (unsigned i = 0; i < mPercentiles.size(); i += std::max(1u, (unsigned)(mPercentiles.size()) - 1u))
+                {
+                    const double lower_bound = conc_index == 0u ? r_lower.mApd90 : mApd90CredibleRegions[conc_index][i];
+                    refine = refine || differs(lower_bound, r_upper_bounds[i]);
+                }
+            }
+
+            // Don't split intervals that are already tiny (e.g. across a discontinuity).
+            const double low = mConcs[conc_index];
+            const double high = mConcs[conc_index + 1u];
+            if (!refine || high - low < 1e-3 * high)
+            {
+                continue;
+            }
+            if (log_scale_concs && low > 0.0)
+            {
+                new_concs.push_back(sqrt(low * high));
+            }
+            else
+            {
+                new_concs.push_back(0.5 * (low + high));
+            }
+        }
+
+        if (!new_concs.empty() && mConcs.size() + new_concs.size() > max_num_adaptive_concs)
+        {
+            if (mConcs.size() >= max_num_adaptive_concs)
+            {
+                new_concs.clear();
+            }
+            else
+            {
+                new_concs.resize(max_num_adaptive_concs - mConcs.size());
+            }
+            std::stringstream message;
+            message << "Stopped adding concentrations for --adaptive-concs at " << max_num_adaptive_concs
+                    << ", APD90s may not be within tolerance of linear interpolation between them everywhere.";
+            WriteMessageToFile(message.str());
+        }
+        return new_concs;
+    };
+
+    // Concentrations are only run at the same time if asked for, as they then can't start from
+    // the previous one's steady state, so the results would differ from those of a serial run.
+    const bool parallel_concs = CommandLineArguments::Instance()->OptionExists("--parallel-concs");
+    const unsigned num_threads = parallel_concs ? std::min(mNumThreads, (unsigned)(mConcs.size())) : 1u;
+    if (!parallel_concs && !adaptive_concs)
+    {
+        // Run through the concentrations in turn on mpModel, each starting from where the last finished,
+        // or the nearest concentration that worked if we are doing continuation.
+        ConcentrationRunner runner(mpModel);
+        set_up_runner(runner);
+        for (unsigned conc_index = 0u; conc_index < mConcs.size(); conc_index++)
+        {
+            progress_reporter.Update((double)(conc_index));
+            print_concentration(conc_index);
+
+            if (mContinuation)
+            {
+                mpModel->SetStateVariables(mSteadyStates.GetNearestState(mConcs[conc_index]));
+            }
+
+            SteadyStateResult result;
+            run_concentration(mpModel, runner, mConcs[conc_index], result);
+            store_steady_state(mConcs[conc_index], result);
+            record_concentration(conc_index, result);
+        } // Conc
+    }
+    else
+    {
+        // Here all the simulations are run first, and then recorded in concentration order.
+        // Concentrations added by --adaptive-concs go in order, with room for their credible intervals.
+        std::vector<SteadyStateResult> results(mConcs.size());
+        auto insert_concentration = [&](const double concentration, const SteadyStateResult& rResult) {
+            const unsigned position = std::upper_bound(mConcs.begin(), mConcs.end(), concentration) - mConcs.begin();
+            mConcs.insert(mConcs.begin() + position, concentration);
+            results.insert(results.begin() + position, rResult);
+            mApd90CredibleRegions.insert(mApd90CredibleRegions.begin() + position, std::vector<double>());
+            mQNetCredibleRegions.insert(mQNetCredibleRegions.begin() + position, std::vector<double>());
+        };
+        const unsigned num_initial_concs = mConcs.size();
+        {
+            // Results are printed as they are recorded below, not as they run (or ApplyDrugBlock prints).
+            OutputSuppressor output_suppressor(mSuppressOutput);
+            if (parallel_concs)
+            {
+                // The concentrations are shared out over any MPI processes, and then over the threads on each
+                // process, with the results shared between all processes afterwards.
+                // Each worker gets its own copy of the model. Without continuation every concentration starts from
+                // the control state. With it, concentrations are run in rounds that bisect the concentration range,
+                // each starting from the nearest concentration done in an earlier round. Either way the starting
+                // states do not depend on which worker happened to run which concentration.
+                // Any concentrations added by --adaptive-concs are run in further rounds in the same way.
+                std::vector<std::vector<unsigned> > rounds(1u);
+                if (mContinuation)
+                {
+                    rounds[0].push_back(0u);
+                    if (mConcs.size() > 1u)
+                    {
+                        rounds[0].push_back(mConcs.size() - 1u);
+                    }
+                    std::vector<std::pair<unsigned, unsigned> > intervals(1u, std::make_pair(0u, (unsigned)(mConcs.size() - 1u)));
+                    while (!intervals.empty())
+                    {
+                        std::vector<std::pair<unsigned, unsigned> > next_intervals;
+                        std::vector<unsigned> round;
+                        for (const auto& r_interval : intervals)
+                        {
+                            if (r_interval.second - r_interval.first > 1u)
+                            {
+                                const unsigned mid = (r_interval.first + r_interval.second) / 2u;
+                                round.push_back(mid);
+                                next_intervals.push_back(std::make_pair(r_interval.first, mid));
+                                next_intervals.push_back(std::make_pair(mid, r_interval.second));
+                            }
+                        }
+                        if (!round.empty())
+                        {
+                            rounds.push_back(round);
+                        }
+                        intervals = next_intervals;
+                    }
+                }
+                else
+                {
+                    for (unsigned conc_index = 0u; conc_index < mConcs.size(); conc_index++)
+                    {
+                        rounds[0].push_back(conc_index);
+                    }
+                }
+
+                if (!output_suppressor.WasSuppressed())
+                {
+                    std::cout << "Running " << mConcs.size() << " concentrations on " << num_threads << " threads";
+                    if (PetscTools::IsParallel())
+                    {
+                        std::cout << " on each of " << PetscTools::GetNumProcs() << " processes";
+                    }
+                    std::cout << "..." << std::endl;
+                }
+                const std::vector<double> initial_state_variables = mpModel->GetStdVecStateVariables();
+                std::vector<boost::shared_ptr<AbstractCvodeCell> > models;
+                std::vector<boost::shared_ptr<ConcentrationRunner> > runners;
+                for (unsigned i = 0; i < num_threads; i++)
+                {
+                    models.push_back(CloneModel());
+                    runners.push_back(boost::shared_ptr<ConcentrationRunner>(new ConcentrationRunner(models[i])));
+                    set_up_runner(*runners[i]);
+                }
+
+                WorkerPool pool(num_threads);
+                auto run_round = [&](const std::vector<double>& rRoundConcs) {
+                    // Decide where each concentration starts before any of this round's results come in.
+                    std::vector<std::vector<double> > start_states(rRoundConcs.size(), initial_state_variables);
+                    if (mContinuation)
+                    {
+                        for (unsigned i = 0; i < rRoundConcs.size(); i++)
+                        {
+                            start_states[i] = mSteadyStates.GetNearestState(rRoundConcs[i]);
+                        }
+                    }
+
+                    std::vector<SteadyStateResult> round_results(rRoundConcs.size());
+                    DistributedTasks::RunMyTasks(pool, rRoundConcs.size(), [&](unsigned task_index, unsigned worker_index) {
+                        models[worker_index]->SetStateVariables(start_states[task_index]);
+                        run_concentration(models[worker_index], *runners[worker_index], rRoundConcs[task_index], round_results[task_index]);
+                    });
+                    ShareSteadyStateResults(round_results);
+
+                    for (unsigned i = 0; i < rRoundConcs.size(); i++)
+                    {
+                        store_steady_state(rRoundConcs[i], round_results[i]);
+                    }
+                    return round_results;
+                };
+
+                for (const std::vector<unsigned>& r_round : rounds)
+                {
+                    std::vector<double> round_concs;
+                    for (unsigned conc_index : r_round)
+                    {
+                        round_concs.push_back(mConcs[conc_index]);
+                    }
+                    std::vector<SteadyStateResult> round_results = run_round(round_concs);
+                    for (unsigned i = 0; i < r_round.size(); i++)
+                    {
+                        results[r_round[i]] = round_results[i];
+                    }
+                }
+
+                std::vector<double> new_concs = adaptive_concs ? get_refinement_concentrations(results) : std::vector<double>();
+                while (!new_concs.empty())
+                {
+                    std::vector<SteadyStateResult> new_results = run_round(new_concs);
+                    for (unsigned i = 0; i < new_concs.size(); i++)
+                    {
+                        insert_concentration(new_concs[i], new_results[i]);
+                    }
+                    new_concs = get_refinement_concentrations(results);
+                }
+            }
+            else
+            {
+                // Run through the concentrations in turn on mpModel, as in the serial loop above.
+                // Each added concentration then starts from the steady state of the next one down,
+                // just as it would have if we'd asked for it in the first place, or from the
+                // nearest concentration that worked if we are doing continuation.
+                ConcentrationRunner runner(mpModel);
+                set_up_runner(runner);
+                for (unsigned conc_index = 0u; conc_index < mConcs.size(); conc_index++)
+                {
+                    if (mContinuation)
+                    {
+                        mpModel->SetStateVariables(mSteadyStates.GetNearestState(mConcs[conc_index]));
+                    }
+                    run_concentration(mpModel, runner, mConcs[conc_index], results[conc_index]);
+                    store_steady_state(mConcs[conc_index], results[conc_index]);
+                }
+
+                std::vector<double> new_concs = get_refinement_concentrations(results);
+                while (!new_concs.empty())
+                {
+                    for (const double concentration : new_concs)
+                    {
+                        if (mContinuation)
+                        {
+                            mpModel->SetStateVariables(mSteadyStates.GetNearestState(concentration));
+                        }
+                        else
+                        {
+                            // New concentrations are always between two we have already done.
+                            const unsigned position = std::upper_bound(mConcs.begin(), mConcs.end(), concentration) - mConcs.begin();
+                            mpModel->SetStateVariables(results[position - 1u].mStateVariables);
+                        }
+                        SteadyStateResult result;
+                        run_concentration(mpModel, runner, concentration, result);
+                        store_steady_state(concentration, result);
+                        insert_concentration(concentration, result);
+                    }
+                    new_concs = get_refinement_concentrations(results);
+                }
+            }
+        }
+        if (adaptive_concs && !mSuppressOutput)
+        {
+            std::cout << "Added " << mConcs.size() - num_initial_concs << " concentrations to meet the tolerance of "
+                      << adaptive_tolerance << "% of control APD90." << std::endl;
+        }
+
+        // Record the results in concentration order, so that output files are written as in a serial run.
+        // The progress reporter was set up for the concentrations we started with.
+        const double progress_scale = (double)(num_initial_concs) / (double)(mConcs.size());
+        for (unsigned conc_index = 0u; conc_index < mConcs.size(); conc_index++)
+        {
+            progress_reporter.Update(progress_scale * (double)(conc_index));
+            print_concentration(conc_index);
+
+            // Leave mpModel where a serial run would have it, for any brute force credible intervals.
+            mpModel->SetStateVariables(results[conc_index].mStateVariables);
+            record_concentration(conc_index, results[conc_index]);
+        } // Conc
+    }
 
     if (!reliable_credible_intervals)
     {
@@ -1568,7 +2883,7 @@ void ApPredictMethods::CommonRunMethod()
         out_stream p_output_file;
         try
         {
-            p_output_file = mpFileHandler->OpenOutputFile("pkpd_results.txt");
+            p_output_file = OpenOutputFileOnMaster("pkpd_results.txt");
         }
         catch (Exception &e)
         {
@@ -1577,32 +2892,41 @@ void ApPredictMethods::CommonRunMethod()
                 "Error was: '"
                 << e.GetMessage() << "'");
         }
-        *p_output_file << "Time";
-        for (unsigned i = 0; i < mpPkpdReader->GetNumberOfPatients(); i++)
+        if (PetscTools::AmMaster())
         {
-            *p_output_file << "\tAPD90_for_patient_" << i << "(ms)";
-        }
-        *p_output_file << std::endl;
-
-        std::vector<std::string> times = mpPkpdReader->GetTimes();
-        for (unsigned i = 0; i < times.size(); i++)
-        {
-            *p_output_file << times[i];
-            const std::vector<double> &r_concs_at_this_time = mpPkpdReader->GetConcentrationsAtTimeIndex(i);
-            for (unsigned p = 0; p < r_concs_at_this_time.size(); p++)
+            *p_output_file << "Time";
+            for (unsigned i = 0; i < mpPkpdReader->GetNumberOfPatients(); i++)
             {
-                double interpolated_apd90 = DoLinearInterpolation(r_concs_at_this_time[p], mConcs, mApd90s);
-                *p_output_file << "\t" << interpolated_apd90;
+                *p_output_file << "\tAPD90_for_patient_" << i << "(ms)";
             }
             *p_output_file << std::endl;
+
+            PkpdInterpolator interpolator(mConcs, mApd90s);
+            interpolator.InterpolatePkpdData(*mpPkpdReader, *p_output_file, mNumThreads);
         }
         p_output_file->close();
     }
     mComplete = true;
 }
 
+out_stream ApPredictMethods::OpenOutputFileOnMaster(const std::string &rFileName)
+{
+    if (PetscTools::AmMaster())
+    {
+        return mpFileHandler->OpenOutputFile(rFileName);
+    }
+    // Other processes get a stream that isn't open, so anything written to it goes nowhere.
+    return out_stream(new std::ofstream);
+}
+
 void ApPredictMethods::WriteMessageToFile(const std::string &rMessage)
 {
+    // Every process knows about every message, but only the master writes them.
+    if (!PetscTools::AmMaster())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(BatchMessageMutex); // See #BatchMessageMutex.
     AbstractActionPotentialMethod::WriteMessageToFile(rMessage);
     assert(mpFileHandler);
     // work out what the absolute path of the message file will be
@@ -1633,6 +2957,15 @@ std::vector<double> ApPredictMethods::GetConcentrations(void)
     return mConcs;
 }
 
+const ConvergedStateStore& ApPredictMethods::rGetSteadyStates() const
+{
+    if (!mComplete)
+    {
+        EXCEPTION("Simulation has not been run - check arguments.");
+    }
+    return mSteadyStates;
+}
+
 std::vector<double> ApPredictMethods::GetApd90s(void)
 {
     if (!mComplete)
@@ -36,11 +36,19 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef APPREDICTMETHODS_HPP_
 #define APPREDICTMETHODS_HPP_
 
+#include <iostream>
+#include <map>
+#include <set>
+
 #include "AbstractActionPotentialMethod.hpp"
 #include "AbstractCvodeCell.hpp"
+#include "ConvergedStateStore.hpp"
 #include "LookupTableGenerator.hpp"
 #include "OutputFileHandler.hpp"
 #include "PkpdDataStructure.hpp"
+#include "SetupModel.hpp"
+#include "SteadyStateCache.hpp"
+#include "SteadyStateResult.hpp"
 
 /**
  * Common code to allow this to be run as a test via cmake and also as a
@@ -185,7 +193,7 @@ private:
   bool mTwoDrugs;
 
   /** A pointer to a lookup table */
-  boost::shared_ptr<AbstractUntemplatedLookupTableGenerator> mpLookupTable;
+  boost::shared_ptr<AbstractLookupTable> mpLookupTable;
 
   /**
      * A vector of pairs used to store the credible regions for APD90s,
@@ -252,6 +260,101 @@ protected:
   /** The model we're working with, refreshed on each Run call.*/
   boost::shared_ptr<AbstractCvodeCell> mpModel;
 
+  /** What set up #mpModel, to make copies of it for other threads (shared by the compounds of a batch). */
+  boost::shared_ptr<SetupModel> mpSetupModel;
+
+  /**
+   * The model index to pass to SetupModel, UNSIGNED_UNSET (the default)
+   * means read the model from the command line.
+   */
+  unsigned mModelIndex;
+
+  /**
+   * The steady state reached at each concentration on the last Run call,
+   * used to start later simulations from the nearest converged concentration.
+   */
+  ConvergedStateStore mSteadyStates;
+
+  /**
+   * Whether to start each concentration from the steady state of the nearest
+   * concentration already simulated (set by the --continuation option).
+   */
+  bool mContinuation;
+
+  /**
+   * The drug (and optionally concentration) arguments for this compound when it is part of
+   * a batch run (see #RunBatch) or a service request (see #RunService), these are used
+   * instead of the command line arguments.
+   */
+  std::map<std::string, std::vector<double> > mBatchArguments;
+
+  /** Whether this is one compound of a batch run, so drug arguments come from #mBatchArguments. */
+  bool mIsBatchCompound;
+
+  /**
+   * A voltage threshold for recording action potentials that has already been worked out
+   * for this model (by a batch run), DOUBLE_UNSET (the default) means work it out.
+   */
+  double mPresetVoltageThreshold;
+
+  /**
+   * The control results worked out once for all the compounds of a batch run, used for any
+   * zero concentration instead of running it again, empty (the default) if this isn't a batch compound.
+   */
+  boost::shared_ptr<const SteadyStateResult> mpSharedControlResult;
+
+  /** The number of threads to run concentrations and brute force samples on. */
+  unsigned mNumThreads;
+
+  /** A cache of steady state results (set by '--steady-state-cache'), empty if not in use. */
+  boost::shared_ptr<SteadyStateCache> mpSteadyStateCache;
+
+  /**
+   * Run all the compounds listed in the '--batch' manifest file.
+   *
+   * The model, its control steady state, the action potential voltage threshold
+   * and any lookup table are set up once and shared by every compound.
+   * Compounds are run concurrently on '--threads' threads, each writing its results
+   * to a sub-folder of the output folder named after the compound. A summary of
+   * the APD90s for all the compounds goes in 'batch_summary.txt'.
+   */
+  void RunBatch();
+
+  /**
+   * @return The options that can be given for each compound in a batch or service run:
+   * the drug properties and (optionally) the concentrations to test.
+   */
+  std::set<std::string> GetCompoundOptions() const;
+
+  /**
+   * Set up everything that doesn't depend on the drug, once, for a batch or service run:
+   * the output folder, model, lookup table, voltage threshold and control results.
+   */
+  void SetUpSharedSimulation();
+
+  /**
+   * Run one compound of a batch or service run, starting from the shared set up
+   * (see #SetUpSharedSimulation). Can be called on several threads at once.
+   *
+   * @param rName  The compound name, its results go in a sub-folder with this name.
+   * @param rArguments  The drug (and concentration) arguments for this compound.
+   * @param numThreads  The number of threads the compound can use for its own concentrations.
+   * @param suppressOutput  Whether to stop the compound printing its progress to screen.
+   * @return The finished simulation, to get the results from.
+   */
+  boost::shared_ptr<ApPredictMethods> RunCompound(const std::string& rName,
+                                                  const std::map<std::string, std::vector<double> >& rArguments,
+                                                  unsigned numThreads,
+                                                  bool suppressOutput);
+
+  /**
+   * Set up a fresh copy of the model in #mpModel, with the same stimulus and state variables,
+   * for use on another thread.
+   *
+   * @return a new model.
+   */
+  boost::shared_ptr<AbstractCvodeCell> CloneModel();
+
   /**
      * Read any input arguments corresponding to a particular channel and calculate the IC50 value (in uM)
      * from either raw IC50 (in uM) or pIC50 (in M).
@@ -272,6 +375,15 @@ protected:
                                    const unsigned channelIdx,
                                    bool secondDrug = false);
 
+  /**
+   * Open a file in the output directory for writing, on the master process only.
+   * Other processes get a stream that is not open, so anything they write to it is discarded.
+   *
+   * @param rFileName  The name of the file.
+   * @return the stream to write to.
+   */
+  out_stream OpenOutputFileOnMaster(const std::string &rFileName);
+
   /**
      * Write a log message to the messages.txt file that should be displayed alongside the results
      * (for example a warning that the cell failed to de/re-polarise at a certain concentration.)
@@ -327,6 +439,25 @@ public:
      */
   virtual void Run();
 
+  /**
+     * Run as a service, answering prediction requests until the input stream ends.
+     *
+     * Everything that doesn't depend on the drug is set up once at the start (see
+     * #SetUpSharedSimulation), then each line of input is a request in JSON, such as
+     *
+     * {"id": "cmpd_1", "pic50-herg": 5.2, "hill-herg": [0.9, 1.1], "plasma-concs": [1, 10]}
+     *
+     * where the fields are the command line options for a compound (see #GetCompoundOptions)
+     * without the leading '--'. Each request gets a single line JSON response with the
+     * concentrations, APD90s and any credible intervals, or an error message.
+     * Requests are handled concurrently on '--threads' threads, so responses may come back
+     * in a different order to the requests, and should be matched up using their "id".
+     *
+     * @param rInput  The stream to read requests from.
+     * @param rOutput  The stream to write responses to.
+     */
+  void RunService(std::istream& rInput, std::ostream& rOutput);
+
   /**
      * Set the output directory
      *
@@ -362,6 +493,11 @@ public:
      */
     std::vector<std::vector<double> > GetQNetCredibleRegions(void);
 
+    /**
+     * @return The steady states reached at each concentration that was simulated successfully.
+     */
+    const ConvergedStateStore& rGetSteadyStates() const;
+
     /**
      * Print commit of ApPredict to std:out.
      */
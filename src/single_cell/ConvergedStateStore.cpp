@@ -0,0 +1,125 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include <cmath>
+#include <iterator>
+
+#include "ConvergedStateStore.hpp"
+#include "Exception.hpp"
+
+void ConvergedStateStore::Add(double concentration, const std::vector<double>& rStateVariables)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStates[concentration] = rStateVariables;
+}
+
+bool ConvergedStateStore::IsEmpty() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStates.empty();
+}
+
+unsigned ConvergedStateStore::GetNumStates() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStates.size();
+}
+
+std::vector<double> ConvergedStateStore::GetConcentrations() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<double> concentrations;
+    for (const auto& r_entry : mStates)
+    {
+        concentrations.push_back(r_entry.first);
+    }
+    return concentrations;
+}
+
+double ConvergedStateStore::GetNearestConcentration(double concentration) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return FindNearest(concentration)->first;
+}
+
+std::vector<double> ConvergedStateStore::GetNearestState(double concentration) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return FindNearest(concentration)->second;
+}
+
+void ConvergedStateStore::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStates.clear();
+}
+
+std::map<double, std::vector<double> >::const_iterator ConvergedStateStore::FindNearest(double concentration) const
+{
+    if (mStates.empty())
+    {
+        EXCEPTION("No steady states have been recorded yet.");
+    }
+
+    // The first entry at or above this concentration.
+    auto above = mStates.lower_bound(concentration);
+    if (above != mStates.end() && above->first == concentration)
+    {
+        return above;
+    }
+
+    if (above == mStates.begin())
+    {
+        return above;
+    }
+    auto below = std::prev(above);
+    if (above == mStates.end())
+    {
+        return below;
+    }
+    if (below->first <= 0.0)
+    {
+        // Only start from the control state if there is no non-zero concentration to use.
+        return above;
+    }
+
+    // Both neighbours are positive concentrations, pick the closer on a log scale.
+    if (std::log(concentration / below->first) <= std::log(above->first / concentration))
+    {
+        return below;
+    }
+    return above;
+}
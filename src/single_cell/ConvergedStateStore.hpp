@@ -0,0 +1,116 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef CONVERGEDSTATESTORE_HPP_
+#define CONVERGEDSTATESTORE_HPP_
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * A record of the steady state reached by a cell model at each concentration
+ * of drug that has been simulated, so that later simulations can be started
+ * from the steady state of the nearest concentration already done
+ * (concentration continuation), rather than from the control state.
+ *
+ * Concentrations are compared on a log scale, as that is the scale on which
+ * block changes in a Hill curve. The control (zero) concentration is only used
+ * as a starting point for a non-zero concentration if there is nothing else.
+ *
+ * All methods are safe to call from more than one thread at once.
+ */
+class ConvergedStateStore
+{
+private:
+    /** The steady state variables, keyed by concentration (uM). */
+    std::map<double, std::vector<double> > mStates;
+
+    /** Protects mStates. */
+    mutable std::mutex mMutex;
+
+public:
+    /**
+     * Record the steady state reached at a concentration, replacing any
+     * existing state for that concentration.
+     *
+     * @param concentration  The drug concentration (uM).
+     * @param rStateVariables  The state variables at steady state.
+     */
+    void Add(double concentration, const std::vector<double>& rStateVariables);
+
+    /**
+     * @return Whether any states have been recorded yet.
+     */
+    bool IsEmpty() const;
+
+    /**
+     * @return The number of concentrations with a recorded state.
+     */
+    unsigned GetNumStates() const;
+
+    /**
+     * @return The concentrations with a recorded state, in ascending order.
+     */
+    std::vector<double> GetConcentrations() const;
+
+    /**
+     * @param concentration  A drug concentration (uM).
+     * @return The concentration (uM) of the recorded state we would start from
+     *         when simulating at this concentration.
+     */
+    double GetNearestConcentration(double concentration) const;
+
+    /**
+     * @param concentration  A drug concentration (uM).
+     * @return The recorded state of the nearest concentration to this one.
+     */
+    std::vector<double> GetNearestState(double concentration) const;
+
+    /**
+     * Forget all the recorded states.
+     */
+    void Clear();
+
+private:
+    /**
+     * @param concentration  A drug concentration (uM).
+     * @return An iterator to the nearest recorded state, mMutex must be held by the caller.
+     */
+    std::map<double, std::vector<double> >::const_iterator FindNearest(double concentration) const;
+};
+
+#endif // CONVERGEDSTATESTORE_HPP_
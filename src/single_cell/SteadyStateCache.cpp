@@ -0,0 +1,129 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/archive_exception.hpp>
+
+#include "CommandLineArguments.hpp"
+#include "OutputFileHandler.hpp"
+#include "SteadyStateCache.hpp"
+
+SteadyStateCache::SteadyStateCache(const std::string& rDirectory)
+{
+    OutputFileHandler handler(rDirectory, false);
+    mDirectory = handler.GetOutputDirectoryFullPath();
+}
+
+boost::shared_ptr<SteadyStateCache> SteadyStateCache::CreateFromCommandLine()
+{
+    boost::shared_ptr<SteadyStateCache> p_cache;
+    if (CommandLineArguments::Instance()->OptionExists("--steady-state-cache"))
+    {
+        p_cache.reset(new SteadyStateCache(CommandLineArguments::Instance()->GetStringCorrespondingToOption("--steady-state-cache")));
+    }
+    return p_cache;
+}
+
+std::string SteadyStateCache::Hash(const std::string& rDescription)
+{
+    // 64 bit FNV-1a, we only need it to spread descriptions over file names.
+    unsigned long long hash = 14695981039346656037ull;
+    for (char c : rDescription)
+    {
+        hash ^= (unsigned char)(c);
+        hash *= 1099511628211ull;
+    }
+    std::stringstream hex;
+    hex.fill('0');
+    hex.width(16);
+    hex << std::hex << hash;
+    return hex.str();
+}
+
+bool SteadyStateCache::Load(const std::string& rDescription, SteadyStateResult& rResult) const
+{
+    std::ifstream file((mDirectory + Hash(rDescription) + ".bin").c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    // A file from a different version of boost, or a half-written one, is just a miss.
+    try
+    {
+        boost::archive::binary_iarchive input_arch(file);
+        std::string description;
+        SteadyStateResult result;
+        input_arch >> description;
+        input_arch >> result;
+        if (description != rDescription)
+        {
+            return false;
+        }
+        rResult = result;
+    }
+    catch (const boost::archive::archive_exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+void SteadyStateCache::Save(const std::string& rDescription, const SteadyStateResult& rResult) const
+{
+    const std::string file_name = mDirectory + Hash(rDescription) + ".bin";
+
+    // Write to a file no other thread or process will be using, and then move it into place.
+    std::stringstream temp_file_name;
+    temp_file_name << file_name << ".tmp_" << getpid() << "_" << std::this_thread::get_id();
+    {
+        std::ofstream file(temp_file_name.str().c_str(), std::ios::binary);
+        boost::archive::binary_oarchive output_arch(file);
+        output_arch << rDescription;
+        output_arch << rResult;
+    }
+    if (std::rename(temp_file_name.str().c_str(), file_name.c_str()) != 0)
+    {
+        std::remove(temp_file_name.str().c_str());
+    }
+}
@@ -0,0 +1,106 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef STEADYSTATECACHE_HPP_
+#define STEADYSTATECACHE_HPP_
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include "SteadyStateResult.hpp"
+
+/**
+ * A cache on disk of the results of running cell models to steady state, so that
+ * repeated simulations (most often the control, which every run does) can be
+ * skipped, both within a run and between runs.
+ *
+ * Results are stored against a description of everything that determines them
+ * (see AbstractActionPotentialMethod::GetSteadyStateDescription()): the model,
+ * all its parameter values (so the conductance scalings), its starting state,
+ * the stimulus, maximum number of paces and how action potentials are evaluated.
+ * Each result goes in its own file named after a hash of its description, and
+ * the full description is stored with it and checked on loading, so a hash
+ * collision is just a cache miss.
+ *
+ * Files are written under a temporary name and then renamed, so any number of
+ * threads or processes can share a cache folder.
+ */
+class SteadyStateCache
+{
+private:
+    /** The absolute path of the cache folder (with trailing slash). */
+    std::string mDirectory;
+
+public:
+    /**
+     * Constructor, creates the cache folder if it doesn't exist, but never wipes it.
+     *
+     * @param rDirectory  The cache folder, relative to CHASTE_TEST_OUTPUT.
+     */
+    SteadyStateCache(const std::string& rDirectory);
+
+    /**
+     * @return A cache in the folder given by the '--steady-state-cache' command line
+     * option, or an empty pointer if that option isn't present.
+     */
+    static boost::shared_ptr<SteadyStateCache> CreateFromCommandLine();
+
+    /**
+     * @param rDescription  A description of a simulation.
+     * @return A hash of the description (16 hexadecimal characters), used as a file name.
+     */
+    static std::string Hash(const std::string& rDescription);
+
+    /**
+     * Look for a result in the cache.
+     *
+     * @param rDescription  A description of the simulation.
+     * @param rResult  Overwritten with the cached result, if there is one.
+     * @return Whether the result was found.
+     */
+    bool Load(const std::string& rDescription, SteadyStateResult& rResult) const;
+
+    /**
+     * Put a result in the cache (replacing any result with the same description).
+     *
+     * @param rDescription  A description of the simulation.
+     * @param rResult  Its result.
+     */
+    void Save(const std::string& rDescription, const SteadyStateResult& rResult) const;
+};
+
+#endif // STEADYSTATECACHE_HPP_
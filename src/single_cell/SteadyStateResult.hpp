@@ -0,0 +1,117 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef STEADYSTATERESULT_HPP_
+#define STEADYSTATERESULT_HPP_
+
+#include <string>
+#include <vector>
+
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "Exception.hpp" // for DOUBLE_UNSET
+
+/**
+ * The results of running a cell model to steady state and evaluating its
+ * action potential markers, stored so that simulations can be run on worker
+ * threads or other processes and their results written out afterwards, or
+ * kept in a SteadyStateCache and re-used by later runs.
+ */
+struct SteadyStateResult
+{
+    /** Whether an error occurred evaluating the AP markers. */
+    bool mErrorOccurred = false;
+    /** The error code (see AbstractActionPotentialMethod::GetErrorCode()), 0 if no error occurred. */
+    unsigned mErrorCode = 0u;
+    /** The error message (code), if an error occurred. */
+    std::string mErrorMessage;
+    /** APD90 (ms). */
+    double mApd90 = DOUBLE_UNSET;
+    /** APD50 (ms). */
+    double mApd50 = DOUBLE_UNSET;
+    /** Maximum upstroke velocity (mV/ms). */
+    double mUpstroke = DOUBLE_UNSET;
+    /** Peak voltage (mV). */
+    double mPeak = DOUBLE_UNSET;
+    /** Time of the peak voltage, relative to the stimulus (ms). */
+    double mPeakTime = DOUBLE_UNSET;
+    /** Maximum of the calcium transient (mM). */
+    double mCaMax = DOUBLE_UNSET;
+    /** Minimum of the calcium transient (mM). */
+    double mCaMin = DOUBLE_UNSET;
+    /** qNet (C/F), if it was calculated. */
+    double mQNet = DOUBLE_UNSET;
+    /** Whether period two behaviour (alternans etc.) was seen. */
+    bool mPeriodTwoBehaviour = false;
+    /** Any messages that would have been written to the messages file. */
+    std::vector<std::string> mMessages;
+    /** Times of the action potential trace (ms). */
+    std::vector<double> mTimes;
+    /** Voltages of the action potential trace (mV). */
+    std::vector<double> mVoltages;
+    /** The state variables of the model at the end of the run. */
+    std::vector<double> mStateVariables;
+
+    /**
+     * Archive the result, so it can be sent between processes or cached on disk.
+     *
+     * @param archive  the archive
+     * @param version  the current version of this class
+     */
+    template <class Archive>
+    void serialize(Archive& archive, const unsigned int version)
+    {
+        archive & mErrorOccurred;
+        archive & mErrorCode;
+        archive & mErrorMessage;
+        archive & mApd90;
+        archive & mApd50;
+        archive & mUpstroke;
+        archive & mPeak;
+        archive & mPeakTime;
+        archive & mCaMax;
+        archive & mCaMin;
+        archive & mQNet;
+        archive & mPeriodTwoBehaviour;
+        archive & mMessages;
+        archive & mTimes;
+        archive & mVoltages;
+        archive & mStateVariables;
+    }
+};
+
+#endif // STEADYSTATERESULT_HPP_
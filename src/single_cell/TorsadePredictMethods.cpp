@@ -57,7 +57,8 @@ void TorsadePredictMethods::Run()
     // Make and clean the above directories.
     mpFileHandler.reset(new OutputFileHandler(mOutputFolder));
 
-    SetupModel setup(this->mHertz, 5u); // Hardcoded to Grandi model.
+    mModelIndex = 5u; // Hardcoded to Grandi model.
+    SetupModel setup(this->mHertz, mModelIndex);
     mpModel = setup.GetModel();
 
     CommonRunMethod();
@@ -127,7 +128,7 @@ void TorsadePredictMethods::WriteTorsadeResultsToFile()
     assert(mpFileHandler);
 
     // Open an output file for the Torsade results
-    out_stream torsade_results_file = mpFileHandler->OpenOutputFile("tdp_results.html");
+    out_stream torsade_results_file = OpenOutputFileOnMaster("tdp_results.html");
     *torsade_results_file << "<html>\n<head><title>Torsade preDiCT Results</title></head>\n";
     *torsade_results_file << "<STYLE TYPE=\"text/css\">\n<!--\nTD{font-size: 12px;}\n--->\n</STYLE>\n";
     *torsade_results_file << "<body>\n";
@@ -0,0 +1,133 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include <exception>
+
+#include "DistributedTasks.hpp"
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+
+bool DistributedTasks::IsMine(unsigned taskIndex)
+{
+    return taskIndex % PetscTools::GetNumProcs() == PetscTools::GetMyRank();
+}
+
+std::vector<unsigned> DistributedTasks::GetMyTasks(unsigned numTasks)
+{
+    std::vector<unsigned> my_tasks;
+    for (unsigned i = PetscTools::GetMyRank(); i < numTasks; i += PetscTools::GetNumProcs())
+    {
+        my_tasks.push_back(i);
+    }
+    return my_tasks;
+}
+
+void DistributedTasks::RunMyTasks(WorkerPool& rPool, unsigned numTasks, const std::function<void(unsigned, unsigned)>& rTask)
+{
+    const std::vector<unsigned> my_tasks = GetMyTasks(numTasks);
+    try
+    {
+        rPool.Run(my_tasks.size(), [&](unsigned i, unsigned worker_index) {
+            rTask(my_tasks[i], worker_index);
+        });
+    }
+    catch (const Exception&)
+    {
+        PetscTools::ReplicateException(true);
+        throw;
+    }
+    catch (const std::exception&)
+    {
+        // e.g. std::bad_alloc or a boost archive error, the other processes still have to be told.
+        PetscTools::ReplicateException(true);
+        throw;
+    }
+    catch (...)
+    {
+        PetscTools::ReplicateException(true);
+        throw;
+    }
+    PetscTools::ReplicateException(false);
+}
+
+void DistributedTasks::ShareResults(std::vector<std::string>& rResults)
+{
+    if (PetscTools::IsSequential())
+    {
+        return;
+    }
+
+    const unsigned num_tasks = rResults.size();
+    const unsigned num_procs = PetscTools::GetNumProcs();
+
+    // Only the owner of each result knows its size, so add them up to tell everyone.
+    std::vector<int> my_sizes(num_tasks, 0);
+    std::string my_data;
+    for (unsigned i = 0; i < num_tasks; i++)
+    {
+        if (IsMine(i))
+        {
+            my_sizes[i] = rResults[i].size();
+            my_data += rResults[i];
+        }
+    }
+    std::vector<int> sizes(num_tasks, 0);
+    MPI_Allreduce(my_sizes.data(), sizes.data(), num_tasks, MPI_INT, MPI_SUM, PetscTools::GetWorld());
+
+    // Each process sends its own results one after another.
+    std::vector<int> counts(num_procs, 0);
+    for (unsigned i = 0; i < num_tasks; i++)
+    {
+        counts[i % num_procs] += sizes[i];
+    }
+    std::vector<int> displacements(num_procs, 0);
+    for (unsigned proc = 1; proc < num_procs; proc++)
+    {
+        displacements[proc] = displacements[proc - 1] + counts[proc - 1];
+    }
+    std::vector<char> all_data(displacements[num_procs - 1] + counts[num_procs - 1] + 1u); // +1 so it is never empty
+    MPI_Allgatherv(const_cast<char*>(my_data.data()), my_data.size(), MPI_CHAR,
+                   all_data.data(), counts.data(), displacements.data(), MPI_CHAR, PetscTools::GetWorld());
+
+    // Unpack them again in task order.
+    std::vector<int> offsets = displacements;
+    for (unsigned i = 0; i < num_tasks; i++)
+    {
+        const unsigned proc = i % num_procs;
+        rResults[i].assign(all_data.data() + offsets[proc], sizes[i]);
+        offsets[proc] += sizes[i];
+    }
+}
@@ -0,0 +1,95 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef DISTRIBUTEDTASKS_HPP_
+#define DISTRIBUTEDTASKS_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+/**
+ * Helpers for sharing a numbered list of independent tasks out between MPI
+ * processes, and then sharing the results back so that every process has all
+ * of them.
+ *
+ * Tasks are dealt out round-robin, so task i belongs to process
+ * i % num_procs. Each process can then run its own share on a WorkerPool.
+ *
+ * When running sequentially every task belongs to this process, and sharing
+ * results does nothing.
+ */
+class DistributedTasks
+{
+public:
+    /**
+     * @param taskIndex  The index of a task.
+     * @return Whether this process should do this task.
+     */
+    static bool IsMine(unsigned taskIndex);
+
+    /**
+     * @param numTasks  The total number of tasks.
+     * @return The indices of the tasks that this process should do, in ascending order.
+     */
+    static std::vector<unsigned> GetMyTasks(unsigned numTasks);
+
+    /**
+     * Run this process' share of the tasks on a worker pool. This is collective.
+     *
+     * If any process fails then they all throw, rather than leaving the others
+     * waiting to share results.
+     *
+     * @param rPool  The pool to run the tasks on.
+     * @param numTasks  The total number of tasks (over all processes).
+     * @param rTask  The work to do, called as rTask(task_index, worker_index).
+     */
+    static void RunMyTasks(WorkerPool& rPool, unsigned numTasks, const std::function<void(unsigned, unsigned)>& rTask);
+
+    /**
+     * Share results between all processes. This is collective.
+     *
+     * On entry each process should have filled in the results for its own
+     * tasks (others are ignored), on exit every process has every result.
+     *
+     * @param rResults  One (serialized) result per task.
+     */
+    static void ShareResults(std::vector<std::string>& rResults);
+};
+
+#endif // DISTRIBUTEDTASKS_HPP_
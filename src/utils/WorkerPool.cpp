@@ -0,0 +1,147 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CommandLineArguments.hpp"
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(unsigned numWorkers)
+        : mNumWorkers(numWorkers)
+{
+    if (mNumWorkers == 0u)
+    {
+        mNumWorkers = GetNumHardwareThreads();
+    }
+}
+
+unsigned WorkerPool::GetNumWorkers() const
+{
+    return mNumWorkers;
+}
+
+void WorkerPool::Run(unsigned numTasks, const std::function<void(unsigned, unsigned)>& rTask)
+{
+    // Don't bother with threads if there is only one worker (or task),
+    // exceptions then come straight back to the caller.
+    if (mNumWorkers == 1u || numTasks <= 1u)
+    {
+        for (unsigned task_idx = 0; task_idx < numTasks; task_idx++)
+        {
+            rTask(task_idx, 0u);
+        }
+        return;
+    }
+
+    std::atomic<unsigned> next_task(0u);
+    std::atomic<bool> failed(false);
+    std::mutex error_mutex;
+    unsigned failed_task = numTasks;
+    std::exception_ptr p_error;
+
+    auto worker_loop = [&](unsigned workerIdx) {
+        while (!failed)
+        {
+            const unsigned task_idx = next_task++;
+            if (task_idx >= numTasks)
+            {
+                break;
+            }
+            try
+            {
+                rTask(task_idx, workerIdx);
+            }
+            catch (...)
+            {
+                // Remember the lowest numbered failure so the reported error does
+                // not depend on thread scheduling.
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (task_idx < failed_task)
+                {
+                    failed_task = task_idx;
+                    p_error = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    const unsigned num_threads = std::min(mNumWorkers, numTasks);
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; i++)
+    {
+        threads.push_back(std::thread(worker_loop, i));
+    }
+    for (unsigned i = 0; i < num_threads; i++)
+    {
+        threads[i].join();
+    }
+
+    if (p_error)
+    {
+        std::rethrow_exception(p_error);
+    }
+}
+
+unsigned WorkerPool::GetNumThreadsFromCommandLine()
+{
+    unsigned num_threads = 1u;
+    if (CommandLineArguments::Instance()->OptionExists("--threads"))
+    {
+        num_threads = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("--threads");
+    }
+    if (num_threads == 0u)
+    {
+        num_threads = GetNumHardwareThreads();
+    }
+    return num_threads;
+}
+
+unsigned WorkerPool::GetNumHardwareThreads()
+{
+    unsigned num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0u)
+    {
+        // hardware_concurrency() is allowed to return zero if it can't tell.
+        num_threads = 1u;
+    }
+    return num_threads;
+}
@@ -0,0 +1,99 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef WORKERPOOL_HPP_
+#define WORKERPOOL_HPP_
+
+#include <functional>
+#include <string>
+
+/**
+ * A simple fixed-size pool of threads that works through a numbered list of
+ * independent tasks.
+ *
+ * Tasks are handed out in order from a shared counter, so a worker picks up the
+ * next task as soon as it finishes its last one. The worker index is passed to
+ * the task as well as the task index, so that callers can give each worker its
+ * own (non thread-safe) resources, such as a cell model, to use for all the
+ * tasks it runs.
+ *
+ * With a single worker the tasks are run in order on the calling thread.
+ *
+ * If any task throws, no further tasks are started, and the exception from the
+ * lowest numbered task that failed is re-thrown by Run() once all the workers
+ * have stopped.
+ */
+class WorkerPool
+{
+private:
+    /** The number of worker threads to use. */
+    unsigned mNumWorkers;
+
+public:
+    /**
+     * Constructor
+     *
+     * @param numWorkers  The number of worker threads to use, zero means
+     *                    one per hardware thread on this machine.
+     */
+    WorkerPool(unsigned numWorkers = 1u);
+
+    /**
+     * @return The number of workers this pool will use.
+     */
+    unsigned GetNumWorkers() const;
+
+    /**
+     * Run tasks 0,1,...,numTasks-1 on the workers, returning when all are done.
+     *
+     * @param numTasks  The number of tasks to run.
+     * @param rTask  The work to do, called as rTask(task_index, worker_index).
+     */
+    void Run(unsigned numTasks, const std::function<void(unsigned, unsigned)>& rTask);
+
+    /**
+     * @return The number of threads requested with the '--threads' command line
+     * option, defaults to 1 if the option is not present. A value of zero
+     * means one per hardware thread on this machine.
+     */
+    static unsigned GetNumThreadsFromCommandLine();
+
+    /**
+     * @return The number of hardware threads on this machine (at least 1).
+     */
+    static unsigned GetNumHardwareThreads();
+};
+
+#endif // WORKERPOOL_HPP_
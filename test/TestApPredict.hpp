@@ -37,14 +37,21 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _TESTAPPREDICT_HPP_
 #define _TESTAPPREDICT_HPP_
 
+#include <algorithm>
 #include <boost/assign/list_of.hpp>
 #include <cxxtest/TestSuite.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
 
 #include <boost/shared_ptr.hpp>
 #include "ApPredictMethods.hpp"
 #include "CommandLineArgumentsMocker.hpp"
+#include "FileComparison.hpp"
 #include "FileFinder.hpp"
 #include "NumericFileComparison.hpp"
+#include "RandomNumberGenerator.hpp"
 #include "SetupModel.hpp"
 
 class TestApPredict : public CxxTest::TestSuite
@@ -210,6 +217,367 @@ public:
         }
     }
 
+    void TestThreadedConcentrationSweep(void)
+    {
+        // ORd CiPA at 0.5Hz, so that q_net.txt is written too.
+        const std::string args = "--model 8 --pacing-freq 0.5 --plasma-concs 1 3 10 30 --pic50-herg 5.5 --pic50-cal 5 --pacing-max-time 0.5";
+
+        std::vector<double> serial_apd90s;
+        {
+            CommandLineArgumentsMocker wrapper(args + " --output-dir ApPredict_output_serial");
+            ApPredictMethods methods;
+            methods.Run();
+            serial_apd90s = methods.GetApd90s();
+        }
+
+        // Threads on their own don't change anything, the concentrations still follow on from each other.
+        {
+            CommandLineArgumentsMocker wrapper(args + " --threads 2 --output-dir ApPredict_output_threads_serial");
+            ApPredictMethods methods;
+            methods.Run();
+            std::vector<double> apd90s = methods.GetApd90s();
+            TS_ASSERT_EQUALS(apd90s.size(), serial_apd90s.size());
+            for (unsigned i = 0; i < serial_apd90s.size(); i++)
+            {
+                TS_ASSERT_EQUALS(apd90s[i], serial_apd90s[i]);
+            }
+        }
+
+        std::vector<std::vector<double> > threaded_apd90s;
+        for (unsigned num_threads = 1u; num_threads <= 3u; num_threads++)
+        {
+            std::stringstream thread_args;
+            thread_args << args << " --parallel-concs --threads " << num_threads << " --output-dir ApPredict_output_threads_" << num_threads;
+            CommandLineArgumentsMocker wrapper(thread_args.str());
+            ApPredictMethods methods;
+            methods.Run();
+            threaded_apd90s.push_back(methods.GetApd90s());
+        }
+
+        // Every concentration starts from the same state with --parallel-concs,
+        // so the answers don't depend on the number of threads.
+        for (unsigned run = 0; run < threaded_apd90s.size(); run++)
+        {
+            TS_ASSERT_EQUALS(threaded_apd90s[run].size(), serial_apd90s.size());
+        }
+        for (unsigned i = 0; i < serial_apd90s.size(); i++)
+        {
+            TS_ASSERT_EQUALS(threaded_apd90s[0][i], threaded_apd90s[1][i]);
+            TS_ASSERT_EQUALS(threaded_apd90s[1][i], threaded_apd90s[2][i]);
+        }
+
+        // The control starts from the same place as in a serial run too.
+        TS_ASSERT_EQUALS(threaded_apd90s[1][0], serial_apd90s[0]);
+
+        // And the same output files are written, byte for byte whatever the number of threads.
+        const std::string output_files[3] = { "voltage_results.dat", "q_net.txt", "conc_30_voltage_trace.dat" };
+        for (unsigned i = 0; i < 3u; i++)
+        {
+            FileFinder one_thread_file("ApPredict_output_threads_1/" + output_files[i], RelativeTo::ChasteTestOutput);
+            for (unsigned num_threads = 2u; num_threads <= 3u; num_threads++)
+            {
+                std::stringstream folder;
+                folder << "ApPredict_output_threads_" << num_threads << "/";
+                FileFinder threaded_file(folder.str() + output_files[i], RelativeTo::ChasteTestOutput);
+                TS_ASSERT(threaded_file.IsFile());
+                FileComparison comparer(one_thread_file, threaded_file);
+                TS_ASSERT(comparer.CompareFiles());
+            }
+
+            // Without --parallel-concs, threads give exactly the serial output.
+            FileFinder serial_file("ApPredict_output_serial/" + output_files[i], RelativeTo::ChasteTestOutput);
+            FileFinder threads_serial_file("ApPredict_output_threads_serial/" + output_files[i], RelativeTo::ChasteTestOutput);
+            TS_ASSERT(threads_serial_file.IsFile());
+            FileComparison serial_comparer(serial_file, threads_serial_file);
+            TS_ASSERT(serial_comparer.CompareFiles());
+        }
+
+        // The control trace is the same as the serial run's.
+        FileFinder serial_control_trace("ApPredict_output_serial/conc_0_voltage_trace.dat", RelativeTo::ChasteTestOutput);
+        FileFinder threaded_control_trace("ApPredict_output_threads_2/conc_0_voltage_trace.dat", RelativeTo::ChasteTestOutput);
+        FileComparison control_comparer(serial_control_trace, threaded_control_trace);
+        TS_ASSERT(control_comparer.CompareFiles());
+
+        // And matches the same reference output as TestChangingSimulusDuration does for a serial run.
+        {
+            CommandLineArgumentsMocker wrapper("--model 4 --pacing-freq 1 --plasma-concs 0 --pacing-max-time 0.2 --no-downsampling --parallel-concs --threads 2 --output-dir ApPredict_output_threads_reference");
+            ApPredictMethods methods;
+            methods.Run();
+
+            FileFinder generated_file("ApPredict_output_threads_reference/conc_0_voltage_trace.dat", RelativeTo::ChasteTestOutput);
+            FileFinder reference_file("projects/ApPredict/test/data/hund_rudy_default_stimulus.dat", RelativeTo::ChasteSourceRoot);
+            TS_ASSERT(generated_file.IsFile());
+            NumericFileComparison comparer(generated_file, reference_file);
+            TS_ASSERT(comparer.CompareFiles(1.5e-2));
+        }
+    }
+
+    void TestConcentrationContinuation(void)
+    {
+        const std::string args = "--model 1 --pacing-freq 1 --plasma-concs 1 3 10 30 --pic50-herg 5.5 --pic50-cal 5 --pacing-max-time 0.5";
+
+        std::vector<double> serial_apd90s;
+        {
+            CommandLineArgumentsMocker wrapper(args + " --output-dir ApPredict_output_serial");
+            ApPredictMethods methods;
+            methods.Run();
+            serial_apd90s = methods.GetApd90s();
+        }
+
+        // Concentrations go up in turn, so in serial the nearest converged
+        // concentration is always the previous one, as without continuation.
+        {
+            CommandLineArgumentsMocker wrapper(args + " --continuation --output-dir ApPredict_output_continuation");
+            ApPredictMethods methods;
+            methods.Run();
+            std::vector<double> apd90s = methods.GetApd90s();
+            TS_ASSERT_EQUALS(apd90s.size(), serial_apd90s.size());
+            for (unsigned i = 0; i < serial_apd90s.size(); i++)
+            {
+                TS_ASSERT_EQUALS(apd90s[i], serial_apd90s[i]);
+            }
+
+            // A steady state is recorded for control and every concentration.
+            std::vector<double> stored_concs = methods.rGetSteadyStates().GetConcentrations();
+            TS_ASSERT_EQUALS(stored_concs.size(), 5u);
+            TS_ASSERT_DELTA(stored_concs[0], 0.0, 1e-12);
+            TS_ASSERT_DELTA(stored_concs[4], 30.0, 1e-12);
+        }
+
+        // With --parallel-concs, the concentrations are run in rounds that don't depend on the number of threads.
+        std::vector<std::vector<double> > threaded_apd90s;
+        for (unsigned num_threads = 2u; num_threads <= 3u; num_threads++)
+        {
+            std::stringstream thread_args;
+            thread_args << args << " --continuation --parallel-concs --threads " << num_threads
+                        << " --output-dir ApPredict_output_continuation_threads_" << num_threads;
+            CommandLineArgumentsMocker wrapper(thread_args.str());
+            ApPredictMethods methods;
+            methods.Run();
+            threaded_apd90s.push_back(methods.GetApd90s());
+        }
+        TS_ASSERT_EQUALS(threaded_apd90s[0].size(), serial_apd90s.size());
+        TS_ASSERT_EQUALS(threaded_apd90s[1].size(), serial_apd90s.size());
+        for (unsigned i = 0; i < serial_apd90s.size(); i++)
+        {
+            TS_ASSERT_EQUALS(threaded_apd90s[0][i], threaded_apd90s[1][i]);
+        }
+        TS_ASSERT_EQUALS(threaded_apd90s[0][0], serial_apd90s[0]);
+    }
+
+    void TestAdaptiveConcentrations(void)
+    {
+        const std::string args = "--model 1 --pacing-freq 1 --plasma-concs 1 10 100 --pic50-herg 5.5 --pic50-cal 5 --pacing-max-time 0.2";
+
+        // The concentrations we asked for are run one after another just as they are without
+        // --adaptive-concs, and each added one follows on from the one below it.
+        std::vector<double> fixed_concs;
+        std::vector<double> fixed_apd90s;
+        {
+            CommandLineArgumentsMocker wrapper(args + " --output-dir ApPredict_output_fixed_concs");
+            ApPredictMethods methods;
+            methods.Run();
+            fixed_concs = methods.GetConcentrations();
+            fixed_apd90s = methods.GetApd90s();
+        }
+
+        {
+            CommandLineArgumentsMocker wrapper(args + " --adaptive-concs 0 --output-dir ApPredict_output_adaptive_concs");
+            ApPredictMethods methods;
+            TS_ASSERT_THROWS_THIS(methods.Run(),
+                                  "--adaptive-concs should be followed by a positive tolerance (% of control APD90), not 0.");
+        }
+
+        const double tolerance = 2.0; // % of control APD90
+        CommandLineArgumentsMocker wrapper(args + " --adaptive-concs 2 --output-dir ApPredict_output_adaptive_concs");
+        ApPredictMethods methods;
+        methods.Run();
+        std::vector<double> concs = methods.GetConcentrations();
+        std::vector<double> apd90s = methods.GetApd90s();
+        TS_ASSERT_EQUALS(concs.size(), apd90s.size());
+        TS_ASSERT_LESS_THAN(fixed_concs.size(), concs.size());
+
+        // The concentrations we asked for are still there with the same answers, and more were added in order.
+        for (unsigned i = 0; i < fixed_concs.size(); i++)
+        {
+            std::vector<double>::iterator it = std::find(concs.begin(), concs.end(), fixed_concs[i]);
+            TS_ASSERT(it != concs.end());
+            TS_ASSERT_EQUALS(apd90s[it - concs.begin()], fixed_apd90s[i]);
+        }
+        for (unsigned i = 1; i < concs.size(); i++)
+        {
+            TS_ASSERT_LESS_THAN(concs[i - 1], concs[i]);
+
+            // Neighbouring APD90s are all within tolerance.
+            TS_ASSERT_DELTA(apd90s[i], apd90s[i - 1], 1e-2 * tolerance * apd90s[0]);
+        }
+
+        // Added concentrations are written out like any other.
+        FileFinder results_file("ApPredict_output_adaptive_concs/voltage_results.dat", RelativeTo::ChasteTestOutput);
+        TS_ASSERT(results_file.IsFile());
+    }
+
+    void TestAdaptiveConcentrationsStartingAboveTheLimit(void)
+    {
+        // More starting concentrations than --adaptive-concs will ever add up to, and a tolerance that
+        // wants them refined, so no more can be added.
+        CommandLineArgumentsMocker wrapper("--model 1 --pacing-freq 1 --plasma-conc-high 100 --plasma-conc-count 260 "
+                                           "--pic50-herg 5.5 --pic50-cal 5 --pacing-max-time 0.2 --no-downsampling "
+                                           "--adaptive-concs 0.01 --parallel-concs --threads 4 --output-dir ApPredict_output_adaptive_concs_limit");
+        ApPredictMethods methods;
+        methods.Run();
+        std::vector<double> concs = methods.GetConcentrations();
+        TS_ASSERT_LESS_THAN(250u, concs.size());
+        TS_ASSERT_EQUALS(methods.GetApd90s().size(), concs.size());
+        for (unsigned i = 1; i < concs.size(); i++)
+        {
+            TS_ASSERT_LESS_THAN(concs[i - 1], concs[i]);
+        }
+
+        FileFinder messages_file("ApPredict_output_adaptive_concs_limit/messages.txt", RelativeTo::ChasteTestOutput);
+        TS_ASSERT(messages_file.IsFile());
+        std::ifstream messages(messages_file.GetAbsolutePath().c_str());
+        std::string contents((std::istreambuf_iterator<char>(messages)), std::istreambuf_iterator<char>());
+        TS_ASSERT(contents.find("Stopped adding concentrations for --adaptive-concs at 250") != std::string::npos);
+    }
+
+    void TestThreadedBruteForceCredibleIntervals(void)
+    {
+        const std::string args = "--model 1 --pacing-freq 1 --plasma-concs 10 --pic50-herg 5.5 --pic50-spread-herg 0.2 "
+                                 "--credible-intervals --brute-force 6 --pacing-max-time 0.2";
+
+        std::vector<std::vector<std::vector<double> > > credible_regions;
+        for (unsigned num_threads = 1u; num_threads <= 3u; num_threads += 2u)
+        {
+            // Draw the same dose-response samples each time.
+            RandomNumberGenerator::Instance()->Reseed(0u);
+
+            std::stringstream thread_args;
+            thread_args << args << " --threads " << num_threads
+                        << " --output-dir ApPredict_output_brute_force_threads_" << num_threads;
+            CommandLineArgumentsMocker wrapper(thread_args.str());
+            ApPredictMethods methods;
+            methods.Run();
+            credible_regions.push_back(methods.GetApd90CredibleRegions());
+        }
+
+        // Control and one concentration.
+        TS_ASSERT_EQUALS(credible_regions[0].size(), 2u);
+        TS_ASSERT_EQUALS(credible_regions[1].size(), 2u);
+        for (unsigned conc_idx = 0; conc_idx < credible_regions[0].size(); conc_idx++)
+        {
+            TS_ASSERT_EQUALS(credible_regions[0][conc_idx].size(), credible_regions[1][conc_idx].size());
+            for (unsigned i = 0; i < credible_regions[0][conc_idx].size(); i++)
+            {
+                // Every sample starts from the same state on whichever thread runs it.
+                TS_ASSERT_DELTA(credible_regions[0][conc_idx][i], credible_regions[1][conc_idx][i], 1e-6);
+            }
+        }
+        // Block lowers hERG so the lower percentile should be longer than control.
+        TS_ASSERT_LESS_THAN(credible_regions[0][0][0], credible_regions[0][1][0]);
+    }
+
+    void TestBatchOfCompounds(void)
+    {
+        const std::string args = "--model 1 --pacing-freq 1 --plasma-concs 1 10 --pacing-max-time 0.5";
+
+        {
+            CommandLineArgumentsMocker wrapper(args + " --batch projects/ApPredict/test/data/batch_manifest.txt --pic50-herg 5");
+            ApPredictMethods methods;
+            TS_ASSERT_THROWS_THIS(methods.Run(),
+                                  "The argument --pic50-herg can't be used with --batch or --service, please give drug arguments for each compound.");
+        }
+
+        {
+            CommandLineArgumentsMocker wrapper(args + " --batch projects/ApPredict/test/data/batch_manifest.txt "
+                                                      "--threads 2 --output-dir ApPredict_output_batch");
+            ApPredictMethods methods;
+            methods.Run();
+        }
+
+        // Each compound gets its own folder of results.
+        FileFinder trace("ApPredict_output_batch/cmpd_na/conc_10_voltage_trace.dat", RelativeTo::ChasteTestOutput);
+        TS_ASSERT(trace.IsFile());
+        FileFinder results("ApPredict_output_batch/cmpd_herg_cal/voltage_results.dat", RelativeTo::ChasteTestOutput);
+        TS_ASSERT(results.IsFile());
+
+        // Read the APD90s for the first compound from the summary.
+        FileFinder summary("ApPredict_output_batch/batch_summary.txt", RelativeTo::ChasteTestOutput);
+        std::ifstream summary_file(summary.GetAbsolutePath().c_str());
+        std::string line;
+        std::getline(summary_file, line);
+        TS_ASSERT_EQUALS(line, "Compound\tStatus\tAPD90_at_0uM(ms)\tAPD90_at_0.001uM(ms)\tAPD90_at_1uM(ms)\tAPD90_at_10uM(ms)");
+        std::string name;
+        std::string status;
+        summary_file >> name >> status;
+        TS_ASSERT_EQUALS(name, "cmpd_herg_cal");
+        TS_ASSERT_EQUALS(status, "Success");
+        std::vector<std::string> batch_apd90s(4u);
+        for (unsigned i = 0; i < batch_apd90s.size(); i++)
+        {
+            summary_file >> batch_apd90s[i];
+        }
+
+        // These should be exactly what a run of the compound on its own gives, as the
+        // control is run up front in just the same way and each compound carries on from it.
+        CommandLineArgumentsMocker wrapper(args + " --pic50-herg 5.5 --pic50-cal 5 --output-dir ApPredict_output_batch_single");
+        ApPredictMethods methods;
+        methods.Run();
+        std::vector<double> apd90s = methods.GetApd90s();
+        TS_ASSERT_EQUALS(apd90s.size(), batch_apd90s.size());
+        for (unsigned i = 0; i < apd90s.size(); i++)
+        {
+            // Written out in the same way as the summary does.
+            std::stringstream apd90;
+            apd90 << apd90s[i];
+            TS_ASSERT_EQUALS(batch_apd90s[i], apd90.str());
+        }
+    }
+
+    void TestServiceRequests(void)
+    {
+        CommandLineArgumentsMocker wrapper("--model 1 --pacing-freq 1 --plasma-concs 1 10 --pacing-max-time 0.5 "
+                                           "--threads 2 --output-dir ApPredict_output_service");
+
+        std::stringstream requests;
+        requests << "{\"id\": \"cmpd_herg\", \"pic50-herg\": 5.5}\n"
+                 << "\n" // blank lines are skipped
+                 << "{\"id\": \"cmpd_concs\", \"ic50-na\": [10, 12], \"plasma-concs\": [3]}\n"
+                 << "{\"id\": \"bad\", \"pacing-freq\": 2}\n"
+                 << "not json\n";
+        std::stringstream responses;
+
+        ApPredictMethods methods;
+        methods.RunService(requests, responses);
+
+        // Responses come back in whatever order they finish.
+        std::map<std::string, std::string> response_for_id;
+        std::string line;
+        std::getline(responses, line);
+        TS_ASSERT_EQUALS(line, "{\"status\":\"ready\"}");
+        unsigned num_responses = 0u;
+        while (std::getline(responses, line))
+        {
+            num_responses++;
+            const size_t id_start = line.find("\"id\":\"") + 6u;
+            response_for_id[line.substr(id_start, line.find('"', id_start) - id_start)] = line;
+        }
+        TS_ASSERT_EQUALS(num_responses, 4u);
+
+        TS_ASSERT_EQUALS(response_for_id["bad"],
+                         "{\"id\":\"bad\",\"status\":\"error\",\"message\":\"Unknown field 'pacing-freq' in request, "
+                         "only drug and concentration arguments can be given.\"}");
+        TS_ASSERT_EQUALS(response_for_id["request_3"].find("{\"id\":\"request_3\",\"status\":\"error\","), 0u);
+
+        // Concentrations come from the command line unless the request gives them.
+        TS_ASSERT_EQUALS(response_for_id["cmpd_herg"].find("{\"id\":\"cmpd_herg\",\"status\":\"ok\",\"concentrations\":[0,0.001,1,10],\"apd90\":["), 0u);
+        TS_ASSERT_EQUALS(response_for_id["cmpd_concs"].find("{\"id\":\"cmpd_concs\",\"status\":\"ok\",\"concentrations\":[0,0.001,3],\"apd90\":["), 0u);
+
+        // Each request has its own results folder.
+        FileFinder results("ApPredict_output_service/cmpd_concs/voltage_results.dat", RelativeTo::ChasteTestOutput);
+        TS_ASSERT(results.IsFile());
+    }
+
     void TestCrash(void)
     {
         CommandLineArgumentsMocker wrapper("--pic50-herg 6 --pic50-spread-herg 0.2 --plasma-concs 10 --credible-intervals --model 8 --pacing-freq 1 --pacing-max-time 5");
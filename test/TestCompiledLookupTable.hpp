@@ -0,0 +1,563 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TESTCOMPILEDLOOKUPTABLE_HPP_
+#define TESTCOMPILEDLOOKUPTABLE_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <cstring>
+#include <fstream>
+
+#include "CompiledLookupTable.hpp"
+#include "OutputFileHandler.hpp"
+#include "ParameterBox.hpp"
+#include "RandomNumberGenerator.hpp"
+#include "Timer.hpp"
+
+/**
+ * Test the flat copy of a lookup table gives the same answers as the tree of boxes.
+ */
+class TestCompiledLookupTable : public CxxTest::TestSuite
+{
+private:
+    // Two QoIs that vary in different ways.
+    template <unsigned DIM, class CORNER_SET>
+    void AssignData(ParameterBox<DIM>& rBox, const CORNER_SET& rCorners)
+    {
+        for (auto it = rCorners.begin(); it != rCorners.end(); ++it)
+        {
+            std::vector<double> qoi;
+            qoi.push_back(exp(2.0 * (**it)[0]) + sin(5.0 * (**it)[DIM - 1]));
+            qoi.push_back(cos(4.0 * (**it)[0]) * (**it)[DIM - 1]);
+            boost::shared_ptr<ParameterPointData> p_data(new ParameterPointData(qoi, 0u));
+            rBox.AssignQoIValues(*it, p_data);
+        }
+    }
+
+    // Refine a table, sometimes splitting boxes along every dimension, sometimes only along some.
+    template <unsigned DIM>
+    void MakeTable(ParameterBox<DIM>& rBox, unsigned numRefinements)
+    {
+        AssignData(rBox, rBox.GetCorners());
+        std::vector<double> tolerances(2u, 1e-3);
+        for (unsigned i = 0; i < numRefinements; i++)
+        {
+            ParameterBox<DIM>* p_box = rBox.FindBoxWithLargestNormalisedQoIErrorEstimate(tolerances);
+            TS_ASSERT(p_box);
+            AssignData(rBox, (i % 2u == 0u) ? p_box->SubDivide() : p_box->SubDivide(p_box->GetDimensionsToRefine(tolerances)));
+        }
+    }
+
+public:
+    void TestCompiledTableMatchesBoxes2d()
+    {
+        ParameterBox<2> parent_box(NULL);
+        MakeTable(parent_box, 40u);
+
+        CompiledLookupTable<2> table(parent_box);
+        TS_ASSERT_EQUALS(table.GetNumQoIs(), 2u);
+        TS_ASSERT(table.HasPointLocationIndex());
+
+        std::vector<ParameterBox<2>*> boxes = parent_box.GetWholeFamilyOfBoxes();
+        unsigned num_leaves = 0u;
+        for (unsigned i = 0; i < boxes.size(); i++)
+        {
+            if (!boxes[i]->IsParent())
+            {
+                num_leaves++;
+            }
+        }
+        TS_ASSERT_EQUALS(table.GetNumLeaves(), num_leaves);
+
+        // A grid of points including lots on the faces of boxes, where the same box has to be chosen.
+        const unsigned num_points_each_way = 65u;
+        std::vector<double> points;
+        for (unsigned i = 0; i < num_points_each_way; i++)
+        {
+            for (unsigned j = 0; j < num_points_each_way; j++)
+            {
+                points.push_back(i / (num_points_each_way - 1.0));
+                points.push_back(j / (num_points_each_way - 1.0));
+            }
+        }
+        const unsigned num_points = points.size() / 2u;
+        std::vector<double> results(2u * num_points);
+        table.Interpolate(points.data(), num_points, results.data());
+
+        for (unsigned i = 0; i < num_points; i++)
+        {
+            c_vector<double, 2u> point;
+            point[0] = points[2u * i];
+            point[1] = points[2u * i + 1u];
+            std::vector<double> expected = parent_box.InterpolateQoIsAt(point);
+
+            // The arithmetic is the same, so the answers are identical.
+            TS_ASSERT_EQUALS(results[2u * i], expected[0]);
+            TS_ASSERT_EQUALS(results[2u * i + 1u], expected[1]);
+        }
+
+        // Outside the table.
+        double outside[2] = { 0.5, 1.1 };
+        TS_ASSERT_THROWS_THIS(table.FindLeafContainingPoint(outside),
+                              "This point is not contained within this box (or any of its children).");
+        TS_ASSERT_THROWS_THIS(table.Interpolate(outside, 1u, results.data()),
+                              "This point is not contained within this box (or any of its children).");
+    }
+
+    void TestCompiledTableMatchesBoxes3d()
+    {
+        ParameterBox<3> parent_box(NULL);
+        MakeTable(parent_box, 30u);
+        CompiledLookupTable<3> table(parent_box);
+
+        std::vector<c_vector<double, 3u>*> corners = parent_box.GetCornersAsVector();
+        for (unsigned i = 0; i < corners.size(); i++)
+        {
+            // Move some of the points off the corners, into the boxes.
+            c_vector<double, 3u> point = *(corners[i]);
+            point[i % 3u] = 0.9 * point[i % 3u] + 0.05;
+            std::vector<double> expected = parent_box.InterpolateQoIsAt(point);
+
+            double results[2];
+            table.Interpolate(&(point[0]), 1u, results);
+            TS_ASSERT_EQUALS(results[0], expected[0]);
+            TS_ASSERT_EQUALS(results[1], expected[1]);
+        }
+    }
+
+    void TestBatchInterpolation5d()
+    {
+        ParameterBox<5> parent_box(NULL);
+        MakeTable(parent_box, 20u);
+        CompiledLookupTable<5> table(parent_box);
+
+        // Not a whole number of batches, so the last few points are done one at a time.
+        const unsigned num_points = 1003u;
+        std::vector<double> points(5u * num_points);
+        for (unsigned i = 0; i < points.size(); i++)
+        {
+            points[i] = RandomNumberGenerator::Instance()->ranf();
+        }
+        std::vector<double> results(2u * num_points);
+        table.Interpolate(points.data(), num_points, results.data());
+
+        for (unsigned i = 0; i < num_points; i++)
+        {
+            double single_results[2];
+            table.InterpolateInLeaf(table.FindLeafContainingPoint(&(points[5u * i])), &(points[5u * i]), single_results);
+            TS_ASSERT_EQUALS(results[2u * i], single_results[0]);
+            TS_ASSERT_EQUALS(results[2u * i + 1u], single_results[1]);
+
+            c_vector<double, 5u> point;
+            std::copy(points.begin() + 5u * i, points.begin() + 5u * (i + 1u), point.begin());
+            std::vector<double> expected = parent_box.InterpolateQoIsAt(point);
+            TS_ASSERT_EQUALS(results[2u * i], expected[0]);
+            TS_ASSERT_EQUALS(results[2u * i + 1u], expected[1]);
+        }
+
+        // Time the batches against the same points done one at a time. How many points a second either does
+        // depends on the machine and compiler flags, so isn't tested, but batching them should never be
+        // much slower (the factor of three allows for a busy machine).
+        const unsigned num_repeats = 100u;
+        std::vector<double> scalar_results(2u * num_points);
+        Timer::Reset();
+        for (unsigned i = 0; i < num_repeats; i++)
+        {
+            for (unsigned j = 0; j < num_points; j++)
+            {
+                table.Interpolate(&(points[5u * j]), 1u, &(scalar_results[2u * j]));
+            }
+        }
+        const double scalar_time = Timer::GetElapsedTime();
+
+        std::fill(results.begin(), results.end(), 0.0);
+        Timer::Reset();
+        for (unsigned i = 0; i < num_repeats; i++)
+        {
+            table.Interpolate(points.data(), num_points, results.data());
+        }
+        const double batch_time = Timer::GetElapsedTime();
+        for (unsigned i = 0; i < results.size(); i++)
+        {
+            TS_ASSERT_EQUALS(results[i], scalar_results[i]);
+        }
+        TS_ASSERT_LESS_THAN(batch_time, 3.0 * scalar_time);
+
+        std::cout << "Interpolated " << num_repeats * num_points << " points in a 5d table with "
+                  << table.GetNumLeaves() << " boxes in " << batch_time << "s in batches, and "
+                  << scalar_time << "s one at a time." << std::endl;
+    }
+
+    void TestInterpolationThroughput5d()
+    {
+        ParameterBox<5> parent_box(NULL);
+        MakeTable(parent_box, 20u);
+        CompiledLookupTable<5> table(parent_box);
+
+        // The same 10^5 points every time, spread evenly over the table (an additive recurrence with
+        // irrational steps), as in a credible interval calculation with 10^5 samples.
+        const unsigned num_points = 100000u;
+        const double steps[5] = { sqrt(2.0), sqrt(3.0), sqrt(5.0), sqrt(7.0), sqrt(11.0) };
+        std::vector<double> points(5u * num_points);
+        for (unsigned i = 0; i < num_points; i++)
+        {
+            for (unsigned d = 0; d < 5u; d++)
+            {
+                const double x = (i + 1u) * steps[d];
+                points[5u * i + d] = x - floor(x);
+            }
+        }
+        std::vector<double> results(2u * num_points);
+
+        // Keep going for at least half a second, so the timer resolution doesn't matter.
+        unsigned num_repeats = 0u;
+        double elapsed_time = 0.0;
+        Timer::Reset();
+        while (elapsed_time < 0.5)
+        {
+            table.Interpolate(points.data(), num_points, results.data());
+            num_repeats++;
+            elapsed_time = Timer::GetElapsedTime();
+        }
+        const double interpolations_per_second = (double)(num_repeats) * num_points / elapsed_time;
+
+        std::cout << "Interpolated " << interpolations_per_second << " points per second on one core in a 5d table with "
+                  << table.GetNumLeaves() << " boxes." << std::endl;
+
+        /*
+         * We aim for 10^7 interpolations a second on one core. The floor is a tenth of that in optimised builds,
+         * to leave room for slower and busy test machines, and a hundredth in debug builds, which aren't
+         * optimised at all.
+         */
+        const double target = 1e7;
+#ifdef NDEBUG
+        TS_ASSERT_LESS_THAN(0.1 * target, interpolations_per_second);
+#else
+        TS_ASSERT_LESS_THAN(0.01 * target, interpolations_per_second);
+#endif
+    }
+
+    void TestPointLocationIndex()
+    {
+        ParameterBox<3> parent_box(NULL);
+        MakeTable(parent_box, 60u);
+        CompiledLookupTable<3> table(parent_box);
+        TS_ASSERT(table.HasPointLocationIndex());
+
+        // Every point on a grid as fine as the smallest boxes, so all the faces, edges and corners
+        // of the boxes are tried, must find the same leaf as walking the tree.
+        const unsigned num_points_each_way = (1u << table.mIndexBits) + 1u;
+        unsigned num_points = 0u;
+        for (unsigned i = 0; i < num_points_each_way; i++)
+        {
+            for (unsigned j = 0; j < num_points_each_way; j++)
+            {
+                for (unsigned k = 0; k < num_points_each_way; k++)
+                {
+                    double point[3] = { i / (num_points_each_way - 1.0),
+                                        j / (num_points_each_way - 1.0),
+                                        k / (num_points_each_way - 1.0) };
+                    TS_ASSERT_EQUALS(table.FindLeafContainingPoint(point), table.FindLeafInTree(point));
+                    num_points++;
+                }
+            }
+        }
+        TS_ASSERT_EQUALS(num_points, num_points_each_way * num_points_each_way * num_points_each_way);
+
+        // Points outside the table still throw.
+        double outside[3] = { 0.5, -1e-12, 0.5 };
+        TS_ASSERT_THROWS_THIS(table.FindLeafContainingPoint(outside),
+                              "This point is not contained within this box (or any of its children).");
+
+        // A table that isn't the unit hypercube is located by walking the tree.
+        c_vector<double, 2u> min = zero_vector<double>(2u);
+        c_vector<double, 2u> max = scalar_vector<double>(2u, 1.0);
+        max[1] = 3.0;
+        ParameterBox<2> stretched_box(NULL, min, max);
+        MakeTable(stretched_box, 10u);
+        CompiledLookupTable<2> stretched_table(stretched_box);
+        TS_ASSERT(!stretched_table.HasPointLocationIndex());
+
+        c_vector<double, 2u> point;
+        point[0] = 0.5;
+        point[1] = 2.25;
+        std::vector<double> expected = stretched_box.InterpolateQoIsAt(point);
+        double results[2];
+        stretched_table.Interpolate(&(point[0]), 1u, results);
+        TS_ASSERT_EQUALS(results[0], expected[0]);
+        TS_ASSERT_EQUALS(results[1], expected[1]);
+    }
+
+    void TestWritingAndMappingCompiledTables()
+    {
+        OutputFileHandler handler("TestCompiledLookupTable", false);
+        const std::string file_name = handler.GetOutputDirectoryFullPath() + "table_3d.lut";
+
+        ParameterBox<3> parent_box(NULL);
+        MakeTable(parent_box, 30u);
+        std::vector<std::string> names;
+        names.push_back("membrane_rapid_delayed_rectifier_potassium_current_conductance");
+        names.push_back("membrane_fast_sodium_current_conductance");
+        names.push_back("membrane_L_type_calcium_current_conductance");
+        CompiledLookupTable<3> table(parent_box, names);
+        TS_ASSERT(!table.IsMappedFromFile());
+        table.WriteToFile(file_name);
+
+        CompiledLookupTable<3> mapped_table(file_name);
+        TS_ASSERT(mapped_table.IsMappedFromFile());
+
+        // The point location index isn't made until it is needed.
+        TS_ASSERT_EQUALS(mapped_table.mIndexBits, 0u);
+        TS_ASSERT(mapped_table.mLeafCodes.empty());
+        TS_ASSERT(mapped_table.HasPointLocationIndex());
+        TS_ASSERT_EQUALS(mapped_table.mLeafCodes.size(), mapped_table.GetNumLeaves());
+        TS_ASSERT_EQUALS(mapped_table.GetDimension(), 3u);
+        TS_ASSERT_EQUALS(mapped_table.GetNumQoIs(), 2u);
+        TS_ASSERT_EQUALS(mapped_table.GetNumLeaves(), table.GetNumLeaves());
+        TS_ASSERT_EQUALS(mapped_table.GetParameterNames().size(), 3u);
+        for (unsigned j = 0; j < 3u; j++)
+        {
+            TS_ASSERT_EQUALS(mapped_table.GetParameterNames()[j], names[j]);
+        }
+
+        // Each corner is stored once, with the QoIs that were evaluated there.
+        TS_ASSERT_EQUALS(mapped_table.GetNumCorners(), parent_box.GetCornersAsVector().size());
+        for (unsigned corner = 0; corner < mapped_table.GetNumCorners(); corner++)
+        {
+            c_vector<double, 3u> location;
+            std::copy(mapped_table.GetCornerLocation(corner), mapped_table.GetCornerLocation(corner) + 3u, location.begin());
+            TS_ASSERT_DELTA(mapped_table.GetCornerQoIs(corner)[0], exp(2.0 * location[0]) + sin(5.0 * location[2]), 1e-12);
+            TS_ASSERT_DELTA(mapped_table.GetCornerQoIs(corner)[1], cos(4.0 * location[0]) * location[2], 1e-12);
+        }
+
+        std::vector<std::vector<double> > points;
+        for (unsigned i = 0; i < 100u; i++)
+        {
+            std::vector<double> point(3u);
+            for (unsigned j = 0; j < 3u; j++)
+            {
+                point[j] = RandomNumberGenerator::Instance()->ranf();
+            }
+            points.push_back(point);
+        }
+        std::vector<std::vector<double> > results = table.Interpolate(points);
+        std::vector<std::vector<double> > mapped_results = mapped_table.Interpolate(points);
+        TS_ASSERT_EQUALS(mapped_results.size(), 100u);
+        for (unsigned i = 0; i < points.size(); i++)
+        {
+            TS_ASSERT_EQUALS(mapped_results[i].size(), 2u);
+            TS_ASSERT_EQUALS(mapped_results[i][0], results[i][0]);
+            TS_ASSERT_EQUALS(mapped_results[i][1], results[i][1]);
+        }
+
+        // A table can note the archive it was made from, and is out of date once that changes.
+        const std::string archive_name = handler.GetOutputDirectoryFullPath() + "table_3d.arch";
+        {
+            std::ofstream archive(archive_name.c_str());
+            archive << "A lookup table archive." << std::endl;
+        }
+        table.WriteToFile(file_name, archive_name);
+        CompiledLookupTable<3> current_table(file_name, archive_name);
+        TS_ASSERT_EQUALS(current_table.GetNumLeaves(), table.GetNumLeaves());
+        {
+            std::ofstream archive(archive_name.c_str(), std::ios::app);
+            archive << "A bigger lookup table archive." << std::endl;
+        }
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<3> stale_table(file_name, archive_name),
+                              "'" + file_name + "' could not be used: This compiled lookup table is out of date, it wasn't made from '"
+                                  + archive_name + "' as it is now.");
+        TS_ASSERT_THROWS_THIS(table.WriteToFile(file_name, handler.GetOutputDirectoryFullPath() + "missing.arch"),
+                              "Could not find '" + handler.GetOutputDirectoryFullPath() + "missing.arch', which the compiled lookup table '"
+                                  + file_name + "' is made from.");
+
+        // Writing the file again replaces it, rather than overwriting the tables that have it mapped.
+        table.WriteToFile(file_name);
+        mapped_results = mapped_table.Interpolate(points);
+        for (unsigned i = 0; i < points.size(); i++)
+        {
+            TS_ASSERT_EQUALS(mapped_results[i][0], results[i][0]);
+            TS_ASSERT_EQUALS(mapped_results[i][1], results[i][1]);
+        }
+
+        // A table without any names.
+        ParameterBox<2> parent_box_2d(NULL);
+        MakeTable(parent_box_2d, 5u);
+        CompiledLookupTable<2> table_2d(parent_box_2d);
+        table_2d.WriteToFile(handler.GetOutputDirectoryFullPath() + "table_2d.lut");
+        CompiledLookupTable<2> mapped_table_2d(handler.GetOutputDirectoryFullPath() + "table_2d.lut");
+        TS_ASSERT(mapped_table_2d.GetParameterNames().empty());
+        TS_ASSERT_EQUALS(mapped_table_2d.GetNumLeaves(), table_2d.GetNumLeaves());
+
+        // Files that can't be used.
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<3> missing_table(handler.GetOutputDirectoryFullPath() + "missing.lut"),
+                              "Could not open the compiled lookup table '" + handler.GetOutputDirectoryFullPath() + "missing.lut'.");
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<2> wrong_table(file_name),
+                              "'" + file_name + "' could not be used: This compiled lookup table has 3 dimensions, not 2.");
+
+        const std::string bad_file_name = handler.GetOutputDirectoryFullPath() + "bad.lut";
+        {
+            std::ofstream bad_file(bad_file_name.c_str());
+            bad_file << "This is a text file, and not a lookup table at all, though it is long enough to have a header." << std::endl;
+        }
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<3> bad_table(bad_file_name),
+                              "'" + bad_file_name + "' could not be used: This is not a compiled lookup table.");
+
+        {
+            // Chop the end off the table.
+            std::ifstream good_file(file_name.c_str(), std::ios::binary);
+            std::string contents((std::istreambuf_iterator<char>(good_file)), std::istreambuf_iterator<char>());
+            std::ofstream bad_file(bad_file_name.c_str(), std::ios::binary);
+            bad_file.write(contents.data(), contents.size() / 2u);
+        }
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<3> bad_table(bad_file_name),
+                              "'" + bad_file_name + "' could not be used: This compiled lookup table is the wrong size, it may be truncated.");
+
+        // Damaged tables of the right size, where the ids in the file would send a lookup outside the table.
+        const std::string table_contents(table.mpTable, table.mTableSize);
+        const size_t first_daughters_offset = reinterpret_cast<const char*>(table.mpFirstDaughters) - table.mpTable;
+        const size_t leaf_corner_ids_offset = reinterpret_cast<const char*>(table.mpLeafCornerIds) - table.mpTable;
+        const size_t names_offset = sizeof(CompiledLookupTableHeader);
+        const size_t names_size = reinterpret_cast<const char*>(table.mpBoxMins) - table.mpTable - names_offset;
+
+        std::vector<std::pair<size_t, std::string> > damages;
+        damages.push_back(std::make_pair(first_daughters_offset, "The daughters of box 0 of this compiled lookup table are wrong."));
+        damages.push_back(std::make_pair(leaf_corner_ids_offset + 5u * sizeof(unsigned),
+                                         "Leaf 0 of this compiled lookup table has a corner that doesn't exist."));
+        damages.push_back(std::make_pair(names_offset + names_size - 1u,
+                                         "The parameter names of this compiled lookup table are not terminated."));
+        for (unsigned i = 0; i < damages.size(); i++)
+        {
+            std::string contents = table_contents;
+            memset(&contents[damages[i].first], 0xff, i + 1u < damages.size() ? sizeof(unsigned) : 1u);
+            std::ofstream bad_file(bad_file_name.c_str(), std::ios::binary);
+            bad_file.write(contents.data(), contents.size());
+            bad_file.close();
+            TS_ASSERT_THROWS_THIS(CompiledLookupTable<3> bad_table(bad_file_name),
+                                  "'" + bad_file_name + "' could not be used: " + damages[i].second);
+        }
+    }
+
+    void TestSlicingTables()
+    {
+        ParameterBox<4> parent_box(NULL);
+        MakeTable(parent_box, 60u);
+        std::vector<std::string> names;
+        names.push_back("membrane_rapid_delayed_rectifier_potassium_current_conductance");
+        names.push_back("membrane_slow_delayed_rectifier_potassium_current_conductance");
+        names.push_back("membrane_fast_sodium_current_conductance");
+        names.push_back("membrane_L_type_calcium_current_conductance");
+        CompiledLookupTable<4> table(parent_box, names);
+
+        std::vector<std::vector<unsigned> > slices(3u);
+        slices[0].push_back(0u);
+        slices[0].push_back(3u);
+        slices[1].push_back(1u);
+        slices[1].push_back(2u);
+        slices[1].push_back(3u);
+        slices[2].push_back(2u);
+        for (unsigned s = 0; s < slices.size(); s++)
+        {
+            const std::vector<unsigned>& r_dims = slices[s];
+            boost::shared_ptr<AbstractLookupTable> p_slice = table.MakeSlice(r_dims);
+            TS_ASSERT_EQUALS(p_slice->GetDimension(), r_dims.size());
+            TS_ASSERT_EQUALS(p_slice->GetNumQoIs(), 2u);
+            TS_ASSERT_EQUALS(p_slice->GetParameterNames().size(), r_dims.size());
+            for (unsigned k = 0; k < r_dims.size(); k++)
+            {
+                TS_ASSERT_EQUALS(p_slice->GetParameterNames()[k], names[r_dims[k]]);
+            }
+
+            // Random points on the slice, and a grid of them to try the faces of the boxes,
+            // must give exactly the same answers as the whole table with the other parameters at 1.0.
+            std::vector<std::vector<double> > points;
+            std::vector<std::vector<double> > slice_points;
+            for (unsigned i = 0; i < 200u; i++)
+            {
+                std::vector<double> point(4u, 1.0);
+                std::vector<double> slice_point;
+                for (unsigned k = 0; k < r_dims.size(); k++)
+                {
+                    point[r_dims[k]] = (i < 100u) ? RandomNumberGenerator::Instance()->ranf()
+                                                  : (RandomNumberGenerator::Instance()->randMod(17u) / 16.0);
+                    slice_point.push_back(point[r_dims[k]]);
+                }
+                points.push_back(point);
+                slice_points.push_back(slice_point);
+            }
+            std::vector<std::vector<double> > results = table.Interpolate(points);
+            std::vector<std::vector<double> > slice_results = p_slice->Interpolate(slice_points);
+            for (unsigned i = 0; i < points.size(); i++)
+            {
+                TS_ASSERT_EQUALS(slice_results[i][0], results[i][0]);
+                TS_ASSERT_EQUALS(slice_results[i][1], results[i][1]);
+            }
+        }
+
+        // Only the leaves touching the slice are kept.
+        boost::shared_ptr<CompiledLookupTable<2> > p_slice_2d
+            = boost::dynamic_pointer_cast<CompiledLookupTable<2> >(table.MakeSlice(slices[0]));
+        TS_ASSERT(p_slice_2d);
+        TS_ASSERT_LESS_THAN(p_slice_2d->GetNumLeaves(), table.GetNumLeaves());
+        TS_ASSERT(p_slice_2d->HasPointLocationIndex());
+
+        TS_ASSERT_THROWS_THIS(table.MakeSlice(std::vector<unsigned>()),
+                              "A slice of a lookup table must keep at least one of its dimensions.");
+        TS_ASSERT_THROWS_THIS(table.MakeSlice(std::vector<unsigned>(2u, 1u)),
+                              "The dimensions of a slice must be dimensions of the table, in increasing order.");
+        TS_ASSERT_THROWS_THIS(table.MakeSlice(std::vector<unsigned>(1u, 4u)),
+                              "The dimensions of a slice must be dimensions of the table, in increasing order.");
+    }
+
+    void TestCompilingIncompleteTables()
+    {
+        ParameterBox<2> parent_box(NULL);
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<2> table(parent_box),
+                              "A lookup table can only be compiled once the corners of all its boxes have been evaluated.");
+
+        AssignData(parent_box, parent_box.GetCorners());
+        parent_box.SubDivide();
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<2> table(parent_box),
+                              "A lookup table can only be compiled once the corners of all its boxes have been evaluated.");
+        TS_ASSERT_THROWS_THIS(CompiledLookupTable<2> table(*(parent_box.GetDaughterBoxes()[0])),
+                              "A lookup table can only be compiled from the original parameter box.");
+
+        AssignData(parent_box, parent_box.GetCorners());
+        CompiledLookupTable<2> table(parent_box);
+        TS_ASSERT_EQUALS(table.GetNumLeaves(), 4u);
+    }
+};
+
+#endif // TESTCOMPILEDLOOKUPTABLE_HPP_
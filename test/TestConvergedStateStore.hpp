@@ -0,0 +1,98 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef _TESTCONVERGEDSTATESTORE_HPP_
+#define _TESTCONVERGEDSTATESTORE_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+
+#include "ConvergedStateStore.hpp"
+#include "Exception.hpp"
+
+class TestConvergedStateStore : public CxxTest::TestSuite
+{
+public:
+    void TestNearestConcentration(void)
+    {
+        ConvergedStateStore store;
+        TS_ASSERT(store.IsEmpty());
+        TS_ASSERT_THROWS_THIS(store.GetNearestState(1.0),
+                              "No steady states have been recorded yet.");
+
+        // With only the control state, everything starts from that.
+        store.Add(0.0, std::vector<double>(2u, 0.0));
+        TS_ASSERT(!store.IsEmpty());
+        TS_ASSERT_DELTA(store.GetNearestConcentration(0.0), 0.0, 1e-12);
+        TS_ASSERT_DELTA(store.GetNearestConcentration(100.0), 0.0, 1e-12);
+
+        store.Add(1.0, std::vector<double>(2u, 1.0));
+        store.Add(100.0, std::vector<double>(2u, 100.0));
+        TS_ASSERT_EQUALS(store.GetNumStates(), 3u);
+
+        // Exact matches.
+        TS_ASSERT_DELTA(store.GetNearestConcentration(0.0), 0.0, 1e-12);
+        TS_ASSERT_DELTA(store.GetNearestConcentration(1.0), 1.0, 1e-12);
+
+        // Below the lowest non-zero concentration we still prefer it to control.
+        TS_ASSERT_DELTA(store.GetNearestConcentration(1e-6), 1.0, 1e-12);
+
+        // Nearest on a log scale (9 is closer to 1 than to 100 linearly, but not on a log scale).
+        TS_ASSERT_DELTA(store.GetNearestConcentration(9.0), 1.0, 1e-12);
+        TS_ASSERT_DELTA(store.GetNearestConcentration(11.0), 100.0, 1e-12);
+        TS_ASSERT_DELTA(store.GetNearestConcentration(1000.0), 100.0, 1e-12);
+
+        std::vector<double> state = store.GetNearestState(50.0);
+        TS_ASSERT_EQUALS(state.size(), 2u);
+        TS_ASSERT_DELTA(state[0], 100.0, 1e-12);
+
+        // Adding again replaces the stored state.
+        store.Add(100.0, std::vector<double>(2u, 3.0));
+        TS_ASSERT_EQUALS(store.GetNumStates(), 3u);
+        TS_ASSERT_DELTA(store.GetNearestState(100.0)[1], 3.0, 1e-12);
+
+        std::vector<double> concs = store.GetConcentrations();
+        TS_ASSERT_EQUALS(concs.size(), 3u);
+        TS_ASSERT_DELTA(concs[0], 0.0, 1e-12);
+        TS_ASSERT_DELTA(concs[2], 100.0, 1e-12);
+
+        store.Clear();
+        TS_ASSERT(store.IsEmpty());
+    }
+};
+
+#endif // _TESTCONVERGEDSTATESTORE_HPP_
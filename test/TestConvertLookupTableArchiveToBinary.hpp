@@ -51,6 +51,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "FileFinder.hpp"
 #include "LookupTableGenerator.hpp"
+#include "LookupTableLoader.hpp"
 #include "SetupModel.hpp"
 #include "SingleActionPotentialPrediction.hpp"
 
@@ -66,6 +67,9 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * https://cardiac.nottingham.ac.uk/lookup_tables/
  * (will require unpacking)
  *
+ * We also convert it into a compiled table (a ".lut" file) that is mapped straight into memory
+ * rather than deserialised, as LookupTableLoader does the first time it loads an archive.
+ *
  * Finally we want to compare times for loading the various archive files from disk.
  *
  * If you upgrade boost, then the binary archive might become corrupt for your new version.
@@ -78,6 +82,7 @@ private:
     boost::shared_ptr<FileFinder> mpBinaryArchiveFile;
     boost::shared_ptr<FileFinder> mpCompressedAsciiArchiveFile;
     boost::shared_ptr<FileFinder> mpCompressedBinaryArchiveFile;
+    boost::shared_ptr<FileFinder> mpCompiledTableFile;
 
 public:
     void TestDownloadAsciiArchiveIfMissing()
@@ -91,6 +96,7 @@ public:
         mpBinaryArchiveFile.reset(new FileFinder(lookup_table_name + "_BINARY.arch", RelativeTo::CWD));
         mpCompressedAsciiArchiveFile.reset(new FileFinder(lookup_table_name + "_COMPRESSED.arch", RelativeTo::CWD));
         mpCompressedBinaryArchiveFile.reset(new FileFinder(lookup_table_name + "_BINARY_COMPRESSED.arch", RelativeTo::CWD));
+        mpCompiledTableFile.reset(new FileFinder(lookup_table_name + ".lut", RelativeTo::CWD));
 
         if (!mpAsciiArchiveFile->IsFile())
         {
@@ -136,6 +142,22 @@ public:
             output_arch << p_arch_generator;
         }
 
+        // Create a compiled table if we don't already have one.
+        if (!mpCompiledTableFile->IsFile())
+        {
+            std::cout << "Loading lookup table from binary file into memory, this can take a few seconds..." << std::flush;
+
+            std::ifstream ifs((mpBinaryArchiveFile->GetAbsolutePath()).c_str(), std::ios::binary);
+            boost::archive::binary_iarchive input_arch(ifs);
+
+            AbstractUntemplatedLookupTableGenerator* p_generator;
+            input_arch >> p_generator;
+
+            std::cout << " loaded.\nConverting to a compiled table.\n";
+            p_generator->SaveCompiledTable(mpCompiledTableFile->GetAbsolutePath(), mpBinaryArchiveFile->GetAbsolutePath());
+            delete p_generator;
+        }
+
 #ifdef CHASTE_BOOST_IOSTREAMS
         // Now archive in compressed format?
         if (!mpCompressedAsciiArchiveFile->IsFile())
@@ -255,6 +277,55 @@ public:
             WARNING("Binary archive is not present, not testing load speed!");
         }
 
+        if (mpCompiledTableFile->IsFile())
+        {
+            std::cout << "Mapping compiled lookup table into memory..." << std::flush;
+            Timer::Reset();
+
+            boost::shared_ptr<AbstractLookupTable> p_table = LookupTableLoader::LoadCompiledTable(mpCompiledTableFile->GetAbsolutePath());
+
+            std::cout << " mapped.\nIt took " << Timer::GetElapsedTime() << "s\n";
+            TS_ASSERT_EQUALS(p_table->GetDimension(), 4u);
+
+            // Interpolating from it gives exactly the same answers as the generator.
+            if (mpBinaryArchiveFile->IsFile())
+            {
+                std::ifstream ifs((mpBinaryArchiveFile->GetAbsolutePath()).c_str(), std::ios::binary);
+                boost::archive::binary_iarchive input_arch(ifs);
+                AbstractUntemplatedLookupTableGenerator* p_generator;
+                input_arch >> p_generator;
+
+                TS_ASSERT_EQUALS(p_table->GetNumQoIs(), p_generator->GetNumQoIs());
+                TS_ASSERT_EQUALS(p_table->GetParameterNames().size(), 4u);
+                for (unsigned j = 0; j < 4u; j++)
+                {
+                    TS_ASSERT_EQUALS(p_table->GetParameterNames()[j], p_generator->GetParameterNames()[j]);
+                }
+
+                std::vector<std::vector<double> > points;
+                for (unsigned i = 0; i <= 20u; i++)
+                {
+                    std::vector<double> point(4u, 0.05 * i);
+                    point[i % 4u] = 1.0 - 0.05 * i;
+                    points.push_back(point);
+                }
+                std::vector<std::vector<double> > generator_results = p_generator->Interpolate(points);
+                std::vector<std::vector<double> > table_results = p_table->Interpolate(points);
+                for (unsigned i = 0; i < points.size(); i++)
+                {
+                    for (unsigned q = 0; q < p_table->GetNumQoIs(); q++)
+                    {
+                        TS_ASSERT_EQUALS(table_results[i][q], generator_results[i][q]);
+                    }
+                }
+                delete p_generator;
+            }
+        }
+        else
+        {
+            WARNING("Compiled table is not present, not testing load speed!");
+        }
+
 #ifdef CHASTE_BOOST_IOSTREAMS
         if (mpCompressedAsciiArchiveFile->IsFile())
         {
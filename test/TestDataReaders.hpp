@@ -38,7 +38,9 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cxxtest/TestSuite.h>
 
+#include "BatchManifestDataStructure.hpp"
 #include "CardiovascRes2011DataStructure.hpp"
+#include "OutputFileHandler.hpp"
 
 class TestDataReaders : public CxxTest::TestSuite
 {
@@ -92,6 +94,50 @@ public:
         TS_ASSERT_DELTA(drug_data.GetIC50Value(tedisamil, 1), -2, 1e-9);
     }
 
+    void TestBatchManifestLoading(void)
+    {
+        FileFinder file("projects/ApPredict/test/data/batch_manifest.txt", RelativeTo::ChasteSourceRoot);
+        BatchManifestDataStructure manifest(file);
+
+        TS_ASSERT_EQUALS(manifest.GetNumCompounds(), 2u);
+        TS_ASSERT_EQUALS(manifest.rGetName(0u), "cmpd_herg_cal");
+        TS_ASSERT_EQUALS(manifest.rGetName(1u), "cmpd_na");
+
+        const std::map<std::string, std::vector<double> >& r_args = manifest.rGetArguments(1u);
+        TS_ASSERT_EQUALS(r_args.size(), 2u);
+        TS_ASSERT_EQUALS(r_args.at("--ic50-na").size(), 1u);
+        TS_ASSERT_DELTA(r_args.at("--ic50-na")[0], 10.0, 1e-12);
+        TS_ASSERT_DELTA(r_args.at("--hill-na")[0], 1.2, 1e-12);
+
+        std::set<std::string> allowed_options{ "--pic50-herg", "--pic50-cal", "--ic50-na", "--hill-na" };
+        TS_ASSERT_THROWS_NOTHING(manifest.CheckOptions(allowed_options));
+        allowed_options.erase("--hill-na");
+        TS_ASSERT_THROWS_THIS(manifest.CheckOptions(allowed_options),
+                              "Option --hill-na (for compound 'cmpd_na') can't be used in a batch file, "
+                              "only drug and concentration arguments can be given for each compound.");
+
+        // Check some badly formatted files are caught.
+        OutputFileHandler handler("TestBatchManifestLoading");
+        std::vector<std::string> bad_lines{ "--pic50-herg 5", "cmpd --pic50-herg five", "cmpd 5", "cmpd --hill-na 1 --hill-na 1" };
+        std::vector<std::string> errors{ "Each line of a batch file should start with a compound name, not '--pic50-herg'.",
+                                         "Could not read 'five' as a number for option --pic50-herg of compound 'cmpd'.",
+                                         "Expected an option (like --pic50-herg) after compound 'cmpd', not '5'.",
+                                         "Option --hill-na is given more than once for compound 'cmpd'." };
+        for (unsigned i = 0; i < bad_lines.size(); i++)
+        {
+            out_stream p_file = handler.OpenOutputFile("bad_manifest.txt");
+            *p_file << bad_lines[i] << std::endl;
+            p_file->close();
+            TS_ASSERT_THROWS_THIS(BatchManifestDataStructure(handler.FindFile("bad_manifest.txt")), errors[i]);
+        }
+
+        out_stream p_file = handler.OpenOutputFile("repeated_manifest.txt");
+        *p_file << "cmpd --pic50-herg 5\ncmpd --pic50-herg 6" << std::endl;
+        p_file->close();
+        TS_ASSERT_THROWS_THIS(BatchManifestDataStructure(handler.FindFile("repeated_manifest.txt")),
+                              "Compound 'cmpd' appears more than once in the batch file.");
+    }
+
     void TestConductanceFactorCalculations()
     {
         // We've got two inputs that we want to return unchanged conductance:
@@ -0,0 +1,110 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _TESTDISTRIBUTEDLOOKUPTABLEGENERATOR_HPP_
+#define _TESTDISTRIBUTEDLOOKUPTABLEGENERATOR_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FileFinder.hpp"
+#include "LookupTableGenerator.hpp"
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * This runs in the parallel test pack, where the points of a lookup table
+ * are shared out between the processes.
+ */
+class TestDistributedLookupTableGenerator : public CxxTest::TestSuite
+{
+public:
+    void TestGeneratingALookupTableOnSeveralProcesses()
+    {
+        unsigned model_index = 2u; // Ten Tusscher 2006 epi
+
+        std::string file_name = "1d_distributed_test";
+        OutputFileHandler handler("TestDistributedLookupTables"); // Wipe the folder for a fresh test each time.
+
+        LookupTableGenerator<1> generator(model_index, file_name, "TestDistributedLookupTables");
+        generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+        generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+        generator.SetNumThreads(1u);
+        generator.SetNumBoxesToRefineTogether(2u);
+        generator.SetMaxNumEvaluations(5u);
+        generator.GenerateLookupTable();
+
+        // Every process has the whole table.
+        std::vector<c_vector<double, 1u> > parameter_values = generator.GetParameterPoints();
+        std::vector<std::vector<double> > quantities_of_interest = generator.GetFunctionValues();
+        TS_ASSERT_EQUALS(parameter_values.size(), 5u);
+        TS_ASSERT_EQUALS(quantities_of_interest.size(), 5u);
+
+        // And it is the same on every process.
+        double my_sum = 0.0;
+        for (unsigned i = 0; i < quantities_of_interest.size(); i++)
+        {
+            my_sum += parameter_values[i][0] + quantities_of_interest[i][0];
+        }
+        double min_sum;
+        double max_sum;
+        MPI_Allreduce(&my_sum, &min_sum, 1, MPI_DOUBLE, MPI_MIN, PetscTools::GetWorld());
+        MPI_Allreduce(&my_sum, &max_sum, 1, MPI_DOUBLE, MPI_MAX, PetscTools::GetWorld());
+        TS_ASSERT_EQUALS(min_sum, max_sum);
+
+        // Only the master writes the table out (a header and a line per point).
+        PetscTools::Barrier("TestGeneratingALookupTableOnSeveralProcesses");
+        if (PetscTools::AmMaster())
+        {
+            FileFinder output_file("TestDistributedLookupTables/" + file_name + ".dat", RelativeTo::ChasteTestOutput);
+            TS_ASSERT(output_file.IsFile());
+            std::ifstream file(output_file.GetAbsolutePath().c_str());
+            unsigned num_lines = 0u;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                num_lines++;
+            }
+            TS_ASSERT_EQUALS(num_lines, 6u);
+        }
+    }
+};
+
+#endif // _TESTDISTRIBUTEDLOOKUPTABLEGENERATOR_HPP_
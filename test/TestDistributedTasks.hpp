@@ -0,0 +1,134 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef _TESTDISTRIBUTEDTASKS_HPP_
+#define _TESTDISTRIBUTEDTASKS_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DistributedTasks.hpp"
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+#include "WorkerPool.hpp"
+
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * This runs in the continuous test pack (sequentially) and the parallel test pack.
+ */
+class TestDistributedTasks : public CxxTest::TestSuite
+{
+public:
+    void TestSharingOutTasks(void)
+    {
+        const unsigned num_tasks = 11u;
+        std::vector<unsigned> my_tasks = DistributedTasks::GetMyTasks(num_tasks);
+
+        // Round-robin, so every process gets within one of the same number of tasks.
+        const unsigned num_procs = PetscTools::GetNumProcs();
+        TS_ASSERT_LESS_THAN_EQUALS(my_tasks.size(), num_tasks / num_procs + 1u);
+        TS_ASSERT_LESS_THAN_EQUALS(num_tasks / num_procs, my_tasks.size());
+        for (unsigned i = 0; i < num_tasks; i++)
+        {
+            bool in_list = std::find(my_tasks.begin(), my_tasks.end(), i) != my_tasks.end();
+            TS_ASSERT_EQUALS(DistributedTasks::IsMine(i), in_list);
+        }
+        if (PetscTools::IsSequential())
+        {
+            TS_ASSERT_EQUALS(my_tasks.size(), num_tasks);
+        }
+
+        // Run our share on a pool, and share the results with everyone.
+        std::vector<std::string> results(num_tasks);
+        WorkerPool pool(2u);
+        DistributedTasks::RunMyTasks(pool, num_tasks, [&](unsigned task_idx, unsigned worker_idx) {
+            TS_ASSERT(DistributedTasks::IsMine(task_idx));
+            std::stringstream result;
+            result << "Task " << task_idx << " on process " << PetscTools::GetMyRank();
+            results[task_idx] = result.str();
+        });
+        DistributedTasks::ShareResults(results);
+
+        for (unsigned i = 0; i < num_tasks; i++)
+        {
+            std::stringstream expected;
+            expected << "Task " << i << " on process " << i % num_procs;
+            TS_ASSERT_EQUALS(results[i], expected.str());
+        }
+
+        // Empty results (and no tasks at all) are fine too.
+        std::vector<std::string> empty_results(3u);
+        DistributedTasks::ShareResults(empty_results);
+        TS_ASSERT_EQUALS(empty_results[2], "");
+        std::vector<std::string> no_results;
+        DistributedTasks::ShareResults(no_results);
+        TS_ASSERT(no_results.empty());
+    }
+
+    void TestExceptionsOnAnyProcess(void)
+    {
+        // Task 0 is always on the master, everyone should throw, not just the master.
+        WorkerPool pool(1u);
+        TS_ASSERT_THROWS_ANYTHING(DistributedTasks::RunMyTasks(pool, 4u, [&](unsigned task_idx, unsigned worker_idx) {
+            if (task_idx == 0u)
+            {
+                EXCEPTION("Task zero went wrong.");
+            }
+        }));
+
+        // The same for failures that aren't Chaste exceptions.
+        TS_ASSERT_THROWS_ANYTHING(DistributedTasks::RunMyTasks(pool, 4u, [&](unsigned task_idx, unsigned worker_idx) {
+            if (task_idx == 0u)
+            {
+                throw std::bad_alloc();
+            }
+        }));
+        TS_ASSERT_THROWS_ANYTHING(DistributedTasks::RunMyTasks(pool, 4u, [&](unsigned task_idx, unsigned worker_idx) {
+            if (task_idx == 0u)
+            {
+                throw 42;
+            }
+        }));
+    }
+};
+
+#endif // _TESTDISTRIBUTEDTASKS_HPP_
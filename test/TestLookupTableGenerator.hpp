@@ -38,6 +38,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cxxtest/TestSuite.h>
 
+#include <boost/filesystem.hpp>
+
 #include "CheckpointArchiveTypes.hpp"
 
 #include "AbstractUntemplatedLookupTableGenerator.hpp"
@@ -45,6 +47,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "NumericFileComparison.hpp"
 #include "SetupModel.hpp"
 #include "SingleActionPotentialPrediction.hpp"
+#include "Timer.hpp"
+#include "WorkerPool.hpp"
 
 /**
  * Here we want to generate lookup tables for a given % block of
@@ -115,6 +119,58 @@ public:
             std::cout << parameter_values[i][0] << "\t" << quantities_of_interest[i][0] << "\n";
         }
 
+        // The same table is made however many threads are used.
+        {
+            LookupTableGenerator<1> serial_generator(model_index, file_name + "_serial", "TestLookupTables");
+            serial_generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+            serial_generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+            serial_generator.SetNumThreads(1u);
+            serial_generator.SetMaxNumEvaluations(5u);
+            serial_generator.GenerateLookupTable();
+
+            std::vector<c_vector<double, 1u>> serial_parameter_values = serial_generator.GetParameterPoints();
+            std::vector<std::vector<double>> serial_quantities_of_interest = serial_generator.GetFunctionValues();
+            TS_ASSERT_EQUALS(serial_parameter_values.size(), parameter_values.size());
+            for (unsigned i = 0; i < serial_parameter_values.size(); i++)
+            {
+                TS_ASSERT_EQUALS(serial_parameter_values[i][0], parameter_values[i][0]);
+                TS_ASSERT_EQUALS(serial_quantities_of_interest[i][0], quantities_of_interest[i][0]);
+            }
+        }
+
+        // Refining two boxes at a time evaluates both quarter points in one batch.
+        {
+            LookupTableGenerator<1> batch_generator(model_index, file_name + "_batch", "TestLookupTables");
+            batch_generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+            batch_generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+            TS_ASSERT_THROWS_THIS(batch_generator.SetNumBoxesToRefineTogether(0u),
+                                  "At least one box must be refined at a time.");
+            batch_generator.SetNumBoxesToRefineTogether(2u);
+            batch_generator.SetMaxNumEvaluations(5u);
+            batch_generator.GenerateLookupTable();
+
+            std::vector<c_vector<double, 1u>> batch_parameter_values = batch_generator.GetParameterPoints();
+            std::vector<std::vector<double>> batch_quantities_of_interest = batch_generator.GetFunctionValues();
+            TS_ASSERT_EQUALS(batch_parameter_values.size(), 5u);
+            const double expected_points[5] = { 0.0, 1.0, 0.5, 0.25, 0.75 };
+            for (unsigned i = 0; i < batch_parameter_values.size(); i++)
+            {
+                TS_ASSERT_DELTA(batch_parameter_values[i][0], expected_points[i], 1e-12);
+            }
+
+            // Points in both tables have the same answers.
+            for (unsigned i = 0; i < batch_parameter_values.size(); i++)
+            {
+                for (unsigned j = 0; j < parameter_values.size(); j++)
+                {
+                    if (fabs(batch_parameter_values[i][0] - parameter_values[j][0]) < 1e-12)
+                    {
+                        TS_ASSERT_EQUALS(batch_quantities_of_interest[i][0], quantities_of_interest[j][0]);
+                    }
+                }
+            }
+        }
+
         // Run the generator again
         generator.SetMaxNumEvaluations(10u);
         generator.GenerateLookupTable();
@@ -125,6 +181,294 @@ public:
 
         TS_ASSERT_EQUALS(parameter_values.size(), 10u);
         TS_ASSERT_EQUALS(quantities_of_interest.size(), 10u);
+
+        // Several threads can interpolate at once, the first to ask makes the compiled table for them all.
+        std::vector<double> points;
+        for (unsigned i = 0; i <= 100u; i++)
+        {
+            points.push_back(0.01 * i);
+        }
+        const unsigned num_threads = 4u;
+        std::vector<std::vector<double> > threaded_results(num_threads, std::vector<double>(points.size()));
+        WorkerPool pool(num_threads);
+        pool.Run(num_threads, [&](unsigned task, unsigned /*worker*/) {
+            generator.Interpolate(points.data(), points.size(), threaded_results[task].data());
+        });
+        std::vector<double> results(points.size());
+        generator.Interpolate(points.data(), points.size(), results.data());
+        for (unsigned task = 0; task < num_threads; task++)
+        {
+            for (unsigned i = 0; i < points.size(); i++)
+            {
+                TS_ASSERT_EQUALS(threaded_results[task][i], results[i]);
+            }
+        }
+    }
+
+    void TestLookupTableContinuation1d()
+    {
+        unsigned model_index = 2u; // Ten Tusscher 2006 epi
+        OutputFileHandler handler("TestLookupTableContinuation");
+
+        LookupTableGenerator<1> cold_generator(model_index, "1d_cold", "TestLookupTableContinuation");
+        cold_generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+        cold_generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+        cold_generator.SetMaxNumEvaluations(5u);
+        cold_generator.GenerateLookupTable();
+        std::vector<c_vector<double, 1u>> cold_parameter_values = cold_generator.GetParameterPoints();
+        std::vector<std::vector<double>> cold_quantities_of_interest = cold_generator.GetFunctionValues();
+
+        // Starting each point from its nearest neighbour's steady state should get to (nearly) the same place.
+        std::string archive_filename = handler.GetOutputDirectoryFullPath() + "Generator1dContinuation.arch";
+        {
+            AbstractUntemplatedLookupTableGenerator *const p_generator = new LookupTableGenerator<1>(model_index, "1d_continuation", "TestLookupTableContinuation");
+            p_generator->SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+            p_generator->AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+            p_generator->SetContinuation(true);
+            p_generator->SetMaxNumEvaluations(5u);
+            p_generator->GenerateLookupTable();
+
+            LookupTableGenerator<1u> *p_1d_generator = dynamic_cast<LookupTableGenerator<1u> *>(p_generator);
+            std::vector<c_vector<double, 1u>> parameter_values = p_1d_generator->GetParameterPoints();
+            std::vector<std::vector<double>> quantities_of_interest = p_generator->GetFunctionValues();
+            TS_ASSERT_EQUALS(parameter_values.size(), 5u);
+            for (unsigned i = 0; i < parameter_values.size(); i++)
+            {
+                for (unsigned j = 0; j < cold_parameter_values.size(); j++)
+                {
+                    if (fabs(parameter_values[i][0] - cold_parameter_values[j][0]) < 1e-12)
+                    {
+                        TS_ASSERT_DELTA(quantities_of_interest[i][0], cold_quantities_of_interest[j][0], 0.5 /*ms*/);
+                    }
+                }
+            }
+
+            std::ofstream ofs(archive_filename.c_str());
+            boost::archive::text_oarchive output_arch(ofs);
+            output_arch << p_generator;
+            delete p_generator;
+        }
+
+        // The steady states (and the setting) come back from the archive, and refinement carries on from them.
+        {
+            AbstractUntemplatedLookupTableGenerator *p_generator;
+            std::ifstream ifs(archive_filename.c_str(), std::ios::binary);
+            boost::archive::text_iarchive input_arch(ifs);
+            input_arch >> p_generator;
+
+            TS_ASSERT_EQUALS(p_generator->GetNumEvaluations(), 5u);
+            p_generator->SetMaxNumEvaluations(7u);
+            p_generator->GenerateLookupTable();
+            TS_ASSERT_EQUALS(p_generator->GetFunctionValues().size(), 7u);
+            delete p_generator;
+        }
+    }
+
+    void TestLookupTableJournal1d()
+    {
+        unsigned model_index = 2u; // Ten Tusscher 2006 epi
+        OutputFileHandler handler("TestLookupTableJournal");
+        const std::string journal_filename = handler.GetOutputDirectoryFullPath() + "Generator1d.journal";
+        const std::string archive_filename = handler.GetOutputDirectoryFullPath() + "Generator1d.arch";
+
+        LookupTableGenerator<1> generator(model_index, "1d_journal", "TestLookupTableJournal");
+        generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+        generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+        generator.SetJournalFile(journal_filename);
+        generator.SetMaxNumEvaluations(5u);
+        generator.GenerateLookupTable();
+
+        // A new generator replays the journal instead of simulating. These generators only do one pace per
+        // point, so if they did any simulations their APDs would not be identical to the ones above.
+        {
+            LookupTableGenerator<1> replaying_generator(model_index, "1d_replay", "TestLookupTableJournal");
+            replaying_generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+            replaying_generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+            replaying_generator.SetMaxNumPaces(1u);
+            replaying_generator.SetJournalFile(journal_filename);
+            replaying_generator.SetMaxNumEvaluations(5u);
+            replaying_generator.GenerateLookupTable();
+
+            TS_ASSERT_EQUALS(replaying_generator.GetNumEvaluations(), 5u);
+            for (unsigned i = 0; i < 5u; i++)
+            {
+                TS_ASSERT_EQUALS(replaying_generator.GetParameterPoints()[i][0], generator.GetParameterPoints()[i][0]);
+                TS_ASSERT_EQUALS(replaying_generator.GetFunctionValues()[i][0], generator.GetFunctionValues()[i][0]);
+            }
+        }
+
+        // Snapshot the generator, after which the journal only has the points evaluated since.
+        {
+            AbstractUntemplatedLookupTableGenerator *const p_generator = &generator;
+            std::ofstream ofs(archive_filename.c_str());
+            boost::archive::text_oarchive output_arch(ofs);
+            output_arch << p_generator;
+        }
+        generator.StartNewJournal();
+        generator.SetMaxNumEvaluations(10u);
+        generator.GenerateLookupTable();
+        TS_ASSERT_EQUALS(generator.GetNumEvaluations(), 10u);
+
+        // After its header, each record is the evaluation number, the point, the error code, one QoI and no state variables.
+        {
+            std::ifstream journal(journal_filename.c_str(), std::ios::binary);
+            unsigned header_size;
+            journal.read(reinterpret_cast<char *>(&header_size), sizeof(header_size));
+            std::string header(header_size, ' ');
+            journal.read(&header[0], header_size);
+            TS_ASSERT_EQUALS(header, "ApPredict lookup table journal 1\n"
+                                     "model 2\n"
+                                     "frequency 1\n"
+                                     "parameter membrane_rapid_delayed_rectifier_potassium_current_conductance 0 1\n"
+                                     "qois 1\n");
+
+            const unsigned record_size = 5u * sizeof(unsigned) + 2u * sizeof(double);
+            journal.seekg(0, std::ios::end);
+            TS_ASSERT_EQUALS((unsigned)(journal.tellg()), sizeof(unsigned) + header_size + 5u * record_size);
+        }
+
+        // Journals can't be replayed into tables they weren't kept for.
+        {
+            LookupTableGenerator<1> other_generator(model_index, "1d_other", "TestLookupTableJournal");
+            other_generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+            other_generator.AddQuantityOfInterest(Apd90, 0.1 /*ms*/);
+            other_generator.AddQuantityOfInterest(Apd50, 0.1 /*ms*/);
+            other_generator.SetJournalFile(journal_filename);
+            TS_ASSERT_THROWS_CONTAINS(other_generator.GenerateLookupTable(),
+                                      "Generator1d.journal was kept for a different lookup table.");
+
+            out_stream p_file = handler.OpenOutputFile("not_a_journal.txt");
+            *p_file << "Hello";
+            p_file->close();
+            TS_ASSERT_THROWS_CONTAINS(other_generator.SetJournalFile(handler.GetOutputDirectoryFullPath() + "not_a_journal.txt"),
+                                      "not_a_journal.txt is not a lookup table journal");
+        }
+
+        // Recover from the snapshot and the journal.
+        {
+            AbstractUntemplatedLookupTableGenerator *p_generator;
+            std::ifstream ifs(archive_filename.c_str(), std::ios::binary);
+            boost::archive::text_iarchive input_arch(ifs);
+            input_arch >> p_generator;
+
+            TS_ASSERT_EQUALS(p_generator->GetNumEvaluations(), 5u);
+            p_generator->SetMaxNumPaces(1u);
+            p_generator->SetJournalFile(journal_filename);
+            p_generator->SetMaxNumEvaluations(10u);
+            p_generator->GenerateLookupTable();
+
+            LookupTableGenerator<1u> *p_1d_generator = dynamic_cast<LookupTableGenerator<1u> *>(p_generator);
+            TS_ASSERT_EQUALS(p_1d_generator->GetNumEvaluations(), 10u);
+            for (unsigned i = 0; i < 10u; i++)
+            {
+                TS_ASSERT_EQUALS(p_1d_generator->GetParameterPoints()[i][0], generator.GetParameterPoints()[i][0]);
+                TS_ASSERT_EQUALS(p_1d_generator->GetFunctionValues()[i][0], generator.GetFunctionValues()[i][0]);
+            }
+            delete p_generator;
+        }
+
+        // Stop part way through writing the last record, then carry on from the snapshot and the journal.
+        const unsigned record_size = 5u * sizeof(unsigned) + 2u * sizeof(double);
+        const unsigned complete_size = boost::filesystem::file_size(journal_filename);
+        boost::filesystem::resize_file(journal_filename, complete_size - record_size / 2u);
+        std::vector<c_vector<double, 1u> > resumed_points;
+        std::vector<std::vector<double> > resumed_values;
+        {
+            AbstractUntemplatedLookupTableGenerator *p_generator;
+            std::ifstream ifs(archive_filename.c_str(), std::ios::binary);
+            boost::archive::text_iarchive input_arch(ifs);
+            input_arch >> p_generator;
+
+            // The first four records are replayed and the rest simulated again, the torn record is cut off before they are appended.
+            p_generator->SetJournalFile(journal_filename);
+            p_generator->SetMaxNumEvaluations(12u);
+            p_generator->GenerateLookupTable();
+            TS_ASSERT_EQUALS((unsigned)(boost::filesystem::file_size(journal_filename)), complete_size + 2u * record_size);
+
+            LookupTableGenerator<1u> *p_1d_generator = dynamic_cast<LookupTableGenerator<1u> *>(p_generator);
+            TS_ASSERT_EQUALS(p_1d_generator->GetNumEvaluations(), 12u);
+            for (unsigned i = 0; i < 10u; i++)
+            {
+                TS_ASSERT_EQUALS(p_1d_generator->GetParameterPoints()[i][0], generator.GetParameterPoints()[i][0]);
+                TS_ASSERT_EQUALS(p_1d_generator->GetFunctionValues()[i][0], generator.GetFunctionValues()[i][0]);
+            }
+            resumed_points = p_1d_generator->GetParameterPoints();
+            resumed_values = p_1d_generator->GetFunctionValues();
+            delete p_generator;
+        }
+
+        // Every record in the journal can be read back again, so nothing is simulated (with one pace per point it would differ).
+        {
+            AbstractUntemplatedLookupTableGenerator *p_generator;
+            std::ifstream ifs(archive_filename.c_str(), std::ios::binary);
+            boost::archive::text_iarchive input_arch(ifs);
+            input_arch >> p_generator;
+
+            p_generator->SetMaxNumPaces(1u);
+            p_generator->SetJournalFile(journal_filename);
+            p_generator->SetMaxNumEvaluations(12u);
+            p_generator->GenerateLookupTable();
+
+            LookupTableGenerator<1u> *p_1d_generator = dynamic_cast<LookupTableGenerator<1u> *>(p_generator);
+            TS_ASSERT_EQUALS(p_1d_generator->GetNumEvaluations(), 12u);
+            for (unsigned i = 0; i < 12u; i++)
+            {
+                TS_ASSERT_EQUALS(p_1d_generator->GetParameterPoints()[i][0], resumed_points[i][0]);
+                TS_ASSERT_EQUALS(p_1d_generator->GetFunctionValues()[i][0], resumed_values[i][0]);
+            }
+            delete p_generator;
+        }
+    }
+
+    void TestReusingAModelForEachPoint()
+    {
+        /*
+         * The generator used to set up a new model for every point, now each worker re-uses one model.
+         * Here we generate the same table both ways, checking the answers are identical and timing them.
+         */
+        unsigned model_index = 2u; // Ten Tusscher 2006 epi
+
+        std::vector<std::vector<c_vector<double, 1u> > > parameter_points;
+        std::vector<std::vector<std::vector<double> > > function_values;
+        std::vector<double> times;
+        for (unsigned reuse = 0u; reuse < 2u; reuse++)
+        {
+            LookupTableGenerator<1u> generator(model_index, reuse ? "reused_models" : "new_models", "TestReusingModels");
+            generator.SetParameterToScale("membrane_rapid_delayed_rectifier_potassium_current_conductance", 0.0, 1.0);
+            generator.AddQuantityOfInterest(Apd90, 0.5 /*ms*/);
+            generator.AddQuantityOfInterest(PeakVoltage, 1.0 /*mV*/);
+            generator.SetMaxNumPaces(100u);
+            generator.SetMaxNumEvaluations(8u);
+            generator.SetNumThreads(2u);
+            generator.SetNumBoxesToRefineTogether(2u); // So each worker has more than one point in a batch.
+            generator.SetReuseModels(reuse == 1u);
+
+            Timer::Reset();
+            generator.GenerateLookupTable();
+            times.push_back(Timer::GetElapsedTime());
+
+            parameter_points.push_back(generator.GetParameterPoints());
+            function_values.push_back(generator.GetFunctionValues());
+        }
+
+        TS_ASSERT_LESS_THAN_EQUALS(8u, parameter_points[1].size());
+        TS_ASSERT_EQUALS(parameter_points[1].size(), parameter_points[0].size());
+        TS_ASSERT_EQUALS(function_values[1].size(), function_values[0].size());
+        for (unsigned i = 0; i < parameter_points[0].size() && i < parameter_points[1].size(); i++)
+        {
+            TS_ASSERT_EQUALS(parameter_points[1][i][0], parameter_points[0][i][0]);
+            TS_ASSERT_EQUALS(function_values[1][i].size(), 2u);
+            for (unsigned j = 0; j < function_values[0][i].size() && j < function_values[1][i].size(); j++)
+            {
+                TS_ASSERT_EQUALS(function_values[1][i][j], function_values[0][i][j]);
+            }
+        }
+
+        std::cout << "Evaluations per second setting up a model for each point: "
+                  << parameter_points[0].size() / times[0] << "\n"
+                  << "Evaluations per second re-using a model on each worker: "
+                  << parameter_points[1].size() / times[1] << "\n"
+                  << std::flush;
     }
 
     void TestLookupTableMaker5d()
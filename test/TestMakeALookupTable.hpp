@@ -37,14 +37,19 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define TESTMAKEALOOKUPTABLE_HPP_
 
 #include <boost/shared_ptr.hpp>
+#include <cstdio>
 #include <cxxtest/TestSuite.h>
 
 #include "CheckpointArchiveTypes.hpp"
 
 #include "FileFinder.hpp"
 #include "LookupTableGenerator.hpp"
+#include "PetscTools.hpp"
 #include "SetupModel.hpp"
 #include "SingleActionPotentialPrediction.hpp"
+#include "WorkerPool.hpp"
+
+#include "PetscSetupAndFinalize.hpp"
 
 class TestMakeALookupTable : public CxxTest::TestSuite
 {
@@ -78,6 +83,12 @@ public:
                          " * --hertz <freq>  (the pacing frequency in Hertz - defaults to 1Hz)\n"
                          " then a list of ion channels that you would like to block:\n"
                          " * --channels <space separated list> (choice of: hERG, ICaL, INa, IKs, Ito, INaL, IK1)\n"
+                         " * --threads <num>  (optional, threads to run simulations on in each process - defaults to one per hardware thread)\n"
+                         " * --boxes-per-batch <num>  (optional, boxes to refine together so their points run in one batch - defaults to 1)\n"
+                         " * --continuation  (optional, start each point from the steady state of the nearest point already done)\n"
+                         " * --anisotropic  (optional, split boxes only along the channels that cause most of their error)\n"
+                         "Run with mpirun to share the simulations out between processes.\n"
+                         "If it is stopped, run it again with the same options to carry on from where it got to.\n"
                       << std::flush;
             return;
         }
@@ -230,29 +241,65 @@ public:
             p_generator->SetMaxVariationInRefinement(5u); // This prevents over-refining in one area.
         }
 
+        if (CommandLineArguments::Instance()->OptionExists("--threads"))
+        {
+            p_generator->SetNumThreads(WorkerPool::GetNumThreadsFromCommandLine());
+        }
+
+        if (CommandLineArguments::Instance()->OptionExists("--boxes-per-batch"))
+        {
+            p_generator->SetNumBoxesToRefineTogether(CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("--boxes-per-batch"));
+        }
+
+        if (CommandLineArguments::Instance()->OptionExists("--continuation"))
+        {
+            p_generator->SetContinuation(true);
+        }
+
+        if (CommandLineArguments::Instance()->OptionExists("--anisotropic"))
+        {
+            p_generator->SetAnisotropicRefinement(true);
+        }
+
+        // Every batch of evaluations is appended to the journal as it is done, and any evaluations
+        // in there that weren't in the archive are replayed, so a run can be stopped at any time.
+        p_generator->SetJournalFile(handler.GetOutputDirectoryFullPath() + model_name + "/" + mFileName + "_generator.journal");
+
         const unsigned start_evaluations = p_generator->GetNumEvaluations();
         std::cout << "Started with " << start_evaluations << " evaluations.\n";
         const unsigned max_num_evaluations = 2000000;
-        const unsigned evaluations_per_checkpoint = 500;
+        const unsigned evaluations_per_snapshot = 10000;
 
         for (unsigned i = start_evaluations;
              i < max_num_evaluations;
-             i += evaluations_per_checkpoint)
+             i += evaluations_per_snapshot)
         {
             // Run some evaluations
-            p_generator->SetMaxNumEvaluations(i + evaluations_per_checkpoint);
+            p_generator->SetMaxNumEvaluations(i + evaluations_per_snapshot);
             bool converged = p_generator->GenerateLookupTable();
 
-            // Overwrite archive entry
+            // Overwrite archive entry (every process has the whole generator, the master writes it).
+            // The archive is written alongside and then moved over the old one, so that if we are
+            // stopped part way through there is still a complete archive to go with the journal.
+            if (PetscTools::AmMaster())
             {
                 AbstractUntemplatedLookupTableGenerator* const p_arch_generator = p_generator;
+                const std::string new_archive_filename = mArchiveFilename + ".new";
+                {
+                    std::ofstream ofs(new_archive_filename.c_str());
+                    boost::archive::text_oarchive output_arch(ofs);
 
-                std::ofstream ofs(mArchiveFilename.c_str());
-                boost::archive::text_oarchive output_arch(ofs);
-
-                output_arch << p_arch_generator;
+                    output_arch << p_arch_generator;
+                }
+                if (std::rename(new_archive_filename.c_str(), mArchiveFilename.c_str()) != 0)
+                {
+                    EXCEPTION("Could not move " << new_archive_filename << " to " << mArchiveFilename);
+                }
             }
 
+            // The archive has everything in the journal now.
+            p_generator->StartNewJournal();
+
             if (converged)
             {
                 break;
@@ -37,6 +37,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define TESTPARAMETERBOX_HPP_
 
 #include <cxxtest/TestSuite.h>
+#include <algorithm>
 #include "CheckpointArchiveTypes.hpp"
 
 #include "OutputFileHandler.hpp"
@@ -96,6 +97,170 @@ private:
         }
     }
 
+    // The way boxes were chosen for refinement before the refinement queues, by scanning the whole tree.
+    template <unsigned DIM>
+    ParameterBox<DIM>* FindBoxByScanningTree(ParameterBox<DIM>& rBox, double tolerance, unsigned maxGenerationDifference)
+    {
+        ParameterBox<DIM>* p_box = nullptr;
+        double error_in_QoI_estimate = -DBL_MAX;
+        unsigned num_QoI_error_codes = UNSIGNED_UNSET;
+        rBox.GetErrorEstimateInAllBoxes(p_box, error_in_QoI_estimate, num_QoI_error_codes, tolerance, 0u);
+        if (error_in_QoI_estimate > tolerance)
+        {
+            ParameterBox<DIM>* most_refined = rBox.GetMostRefinedChild();
+            ParameterBox<DIM>* least_refined = rBox.GetLeastRefinedChild(tolerance, 0u);
+            if (least_refined
+                && ((most_refined->GetGeneration() - least_refined->GetGeneration()) == maxGenerationDifference)
+                && (p_box->GetGeneration() == most_refined->GetGeneration()))
+            {
+                return least_refined;
+            }
+        }
+        return p_box;
+    }
+
+    // Some data that varies in both directions.
+    void AssignWavyData(ParameterBox<2>& rBox, const std::set<c_vector<double, 2u>*, c_vector_compare<2u> >& rCorners)
+    {
+        for (auto it = rCorners.begin(); it != rCorners.end(); ++it)
+        {
+            std::vector<double> qoi(1u, exp(2.0 * (**it)[0]) + sin(5.0 * (**it)[1]));
+            boost::shared_ptr<ParameterPointData> p_data(new ParameterPointData(qoi, 0u));
+            rBox.AssignQoIValues(*it, p_data);
+        }
+    }
+
+    // Two quantities of interest that vary in different ways.
+    void AssignTwoQoIData(ParameterBox<2>& rBox, const std::set<c_vector<double, 2u>*, c_vector_compare<2u> >& rCorners)
+    {
+        for (auto it = rCorners.begin(); it != rCorners.end(); ++it)
+        {
+            std::vector<double> qoi;
+            qoi.push_back(exp(2.0 * (**it)[0]) + sin(5.0 * (**it)[1]));
+            qoi.push_back(cos(4.0 * (**it)[0]) * (**it)[1] * (**it)[1]);
+            boost::shared_ptr<ParameterPointData> p_data(new ParameterPointData(qoi, 0u));
+            rBox.AssignQoIValues(*it, p_data);
+        }
+    }
+
+    // Data from a function of the parameters.
+    template <unsigned DIM, class CORNER_SET, class FUNCTION>
+    void AssignFunctionData(ParameterBox<DIM>& rBox, const CORNER_SET& rCorners, FUNCTION function)
+    {
+        for (auto it = rCorners.begin(); it != rCorners.end(); ++it)
+        {
+            std::vector<double> qoi(1u, function(**it));
+            boost::shared_ptr<ParameterPointData> p_data(new ParameterPointData(qoi, 0u));
+            rBox.AssignQoIValues(*it, p_data);
+        }
+    }
+
+    // Curves along x, linear in y and constant in any other direction.
+    template <unsigned DIM>
+    static double CurvedAlongX(const c_vector<double, DIM>& rPoint)
+    {
+        return exp(2.0 * rPoint[0]) + 0.1 * rPoint[1];
+    }
+
+    // Only varies with a combination of x and y.
+    static double ProductOfXAndY(const c_vector<double, 2u>& rPoint)
+    {
+        return rPoint[0] * rPoint[1];
+    }
+
+    /*
+     * Loads an archive of a 2D box refined four times with two QoIs, exp(2x) + sin(5y) and
+     * cos(4x)y^2 (see AssignTwoQoIData()), and checks it holds the same table whichever version wrote it.
+     * The expected values were all given by the code that wrote the version 0 archive.
+     */
+    void CheckArchivedTwoQoITable(const std::string& rArchiveName)
+    {
+        FileFinder archive_file("projects/ApPredict/test/data/" + rArchiveName, RelativeTo::ChasteSourceRoot);
+        ParameterBox<2>* p_box;
+        {
+            std::ifstream ifs(archive_file.GetAbsolutePath().c_str(), std::ios::binary);
+            boost::archive::text_iarchive input_arch(ifs);
+            input_arch >> p_box;
+        }
+        TS_ASSERT_EQUALS(p_box->GetWholeFamilyOfBoxes().size(), 17u);
+
+        // Each corner once, with its x, y and QoIs (the versions number the corners in different orders).
+        const double corners[22][4] = {
+            { 0, 0, 1, 0 },
+            { 0.25, 0, 1.6487212707001282, 0 },
+            { 0, 0.25, 1.9489846193555862, 0.0625 },
+            { 0.25, 0.25, 2.5977058900557144, 0.033768894116758735 },
+            { 0.5, 0, 2.7182818284590451, 0 },
+            { 0.5, 0.25, 3.6672664478146313, -0.0260091772841964 },
+            { 0, 0.5, 1.5984721441039564, 0.25 },
+            { 0.25, 0.5, 2.2471934148040846, 0.13507557646703494 },
+            { 0.5, 0.5, 3.3167539725630015, -0.1040367091367856 },
+            { 1, 0, 7.3890560989306504, 0 },
+            { 1, 0.5, 7.9875282430346068, -0.16341090521590299 },
+            { 0, 0.75, 0.42843868125765627, 0.5625 },
+            { 0.25, 0.75, 1.0771599519577846, 0.30392004705082865 },
+            { 0.5, 0.75, 2.1467205097167015, -0.23408259555776761 },
+            { 0, 1, 0.041075725336861546, 1 },
+            { 0.25, 1, 0.68979699603698974, 0.54030230586813977 },
+            { 0.5, 1, 1.7593575537959065, -0.41614683654714241 },
+            { 0.75, 0.5, 5.080161214442021, -0.24749812415011135 },
+            { 0.75, 0.75, 3.9101277515957209, -0.55687077933775053 },
+            { 1, 0.75, 6.8174947801883068, -0.36767453673578177 },
+            { 0.75, 1, 3.522764795674926, -0.98999249660044542 },
+            { 1, 1, 6.4301318242675123, -0.65364362086361194 },
+        };
+        TS_ASSERT_EQUALS(p_box->mCornerLocations.size(), 22u);
+        TS_ASSERT_EQUALS(p_box->mNumQoIs, 2u);
+        TS_ASSERT_EQUALS(p_box->mCornerQoIs.size(), 2u);
+        TS_ASSERT_EQUALS(p_box->mCornerQoIs[0].size(), 22u);
+        TS_ASSERT_EQUALS(p_box->mCornerQoIs[1].size(), 22u);
+        for (unsigned i = 0; i < 22u; i++)
+        {
+            c_vector<double, 2u> location;
+            location[0] = corners[i][0];
+            location[1] = corners[i][1];
+            unsigned id = p_box->FindCornerId(location);
+            TS_ASSERT_DIFFERS(id, UNSIGNED_UNSET);
+            if (id != UNSIGNED_UNSET)
+            {
+                TS_ASSERT_EQUALS(p_box->mCornerLocations[id][0], corners[i][0]);
+                TS_ASSERT_EQUALS(p_box->mCornerLocations[id][1], corners[i][1]);
+                TS_ASSERT_EQUALS(p_box->mCornerErrorCodes[id], 0u);
+                TS_ASSERT_DELTA(p_box->mCornerQoIs[0][id], corners[i][2], 1e-12);
+                TS_ASSERT_DELTA(p_box->mCornerQoIs[1][id], corners[i][3], 1e-12);
+            }
+        }
+        TS_ASSERT_EQUALS(p_box->GetCornersAsVector().size(), 22u);
+
+        // Interpolating gives the same answers as before.
+        const double points[5][4] = {
+            { 0.1, 0.2, 2.0186762037645205, 0.040806046117362799 },
+            { 0.3, 0.9, 1.058654289957091, 0.28793529384269378 },
+            { 0.6, 0.4, 4.1312143978365317, -0.092729238682087267 },
+            { 0.8, 0.7, 4.7256078498834988, -0.46136136072653927 },
+            { 0.95, 0.05, 6.981825886293886, -0.015747348560799124 },
+        };
+        for (unsigned i = 0; i < 5u; i++)
+        {
+            c_vector<double, 2u> point;
+            point[0] = points[i][0];
+            point[1] = points[i][1];
+            std::vector<double> qois = p_box->InterpolateQoIsAt(point);
+            TS_ASSERT_EQUALS(qois.size(), 2u);
+            TS_ASSERT_DELTA(qois[0], points[i][2], 1e-12);
+            TS_ASSERT_DELTA(qois[1], points[i][3], 1e-12);
+        }
+
+        // And so does refinement.
+        ParameterBox<2u>* p_worst_box = p_box->FindBoxWithLargestQoIErrorEstimate(0u, DBL_MIN);
+        TS_ASSERT(p_worst_box);
+        TS_ASSERT_DELTA(p_worst_box->GetMaxErrorsInPredictedQoIs()[0], 1.4762462210062801, 1e-12);
+        TS_ASSERT_EQUALS((*(p_worst_box->GetCornersAsVector()[0]))[0], 0.5);
+        TS_ASSERT_EQUALS((*(p_worst_box->GetCornersAsVector()[0]))[1], 0.0);
+
+        delete p_box;
+    }
+
 public:
     void TestParameterBox1d()
     {
@@ -289,6 +454,8 @@ public:
                             (exp(1) - exp(0.5)) / 2.0 + exp(0.5) - exp(0.75), 1e-12);
             TS_ASSERT_DELTA((*(p_best_box->GetCornersAsVector()[0]))[0], 0.5, 1e-12);
             TS_ASSERT_DELTA((*(p_best_box->GetCornersAsVector()[1]))[0], 0.75, 1e-12);
+            TS_ASSERT_DELTA(p_best_box->mMaxErrorsInEachDimension[0][0],
+                            (exp(1) - exp(0.5)) / 2.0 + exp(0.5) - exp(0.75), 1e-12);
 
             daughter_boxes = p_parent_box_1d->GetDaughterBoxes();
             TS_ASSERT_EQUALS(daughter_boxes.size(), 2u);
@@ -329,12 +496,26 @@ public:
                             (exp(1) - exp(0.5)) / 2.0 + exp(0.5) - exp(0.75), 1e-12);
             TS_ASSERT_DELTA((*(p_best_box->GetCornersAsVector()[0]))[0], 0.5, 1e-12);
             TS_ASSERT_DELTA((*(p_best_box->GetCornersAsVector()[1]))[0], 0.75, 1e-12);
+            TS_ASSERT_DELTA(p_best_box->mMaxErrorsInEachDimension[0][0],
+                            (exp(1) - exp(0.5)) / 2.0 + exp(0.5) - exp(0.75), 1e-12);
 
             // Clean up memory, usually done by LookupTableGenerator
             delete p_box;
         }
     }
 
+    void TestLoadingVersion0Archive()
+    {
+        // This archive was written before corners were stored by id (version 0 of ParameterBox).
+        CheckArchivedTwoQoITable("ParameterBox2d_version0.arch");
+    }
+
+    void TestLoadingVersion2Archive()
+    {
+        // The same table written when the QoIs were stored corner by corner (version 2 of ParameterBox).
+        CheckArchivedTwoQoITable("ParameterBox2d_version2.arch");
+    }
+
     void TestParameterBox2d()
     {
         ParameterBox<2> parent_box_2d(NULL);
@@ -419,6 +600,287 @@ public:
         TS_ASSERT_DELTA((*(daughter_boxes[3]->GetCornersAsVector()[3]))[0], 1, 1e-12);
         TS_ASSERT_DELTA((*(daughter_boxes[3]->GetCornersAsVector()[3]))[1], 1, 1e-12);
     }
+
+    void TestCornersAreStoredOnce()
+    {
+        ParameterBox<2> parent_box_2d(NULL);
+        std::vector<c_vector<double, 2u>*> corner_parameters = parent_box_2d.GetCornersAsVector();
+        AssignExponentialData(parent_box_2d, corner_parameters);
+        parent_box_2d.SubDivide();
+        corner_parameters = parent_box_2d.GetCornersAsVector();
+        AssignExponentialData(parent_box_2d, corner_parameters);
+        std::vector<ParameterBox<2>*> daughter_boxes = parent_box_2d.GetDaughterBoxes();
+        daughter_boxes[0]->SubDivide();
+        corner_parameters = parent_box_2d.GetCornersAsVector();
+        AssignExponentialData(parent_box_2d, corner_parameters);
+
+        // 4 corners, then 5 more for each subdivision, each stored once on the original box.
+        TS_ASSERT_EQUALS(corner_parameters.size(), 14u);
+        TS_ASSERT_EQUALS(parent_box_2d.mCornerLocations.size(), 14u);
+        TS_ASSERT_EQUALS(parent_box_2d.mCornerErrorCodes.size(), 14u);
+        TS_ASSERT_EQUALS(parent_box_2d.mCornerQoIs.size(), 1u); // One array for each QoI.
+        TS_ASSERT_EQUALS(parent_box_2d.mCornerQoIs[0].size(), 14u);
+        for (unsigned i = 0; i < 14u; i++)
+        {
+            TS_ASSERT_EQUALS(parent_box_2d.mCornerErrorCodes[i], 0u);
+            TS_ASSERT_DELTA(parent_box_2d.mCornerQoIs[0][i], exp(parent_box_2d.mCornerLocations[i][0]), 1e-12);
+        }
+
+        // Neighbouring boxes share the corner (0.5, 0.5) rather than having a copy each.
+        TS_ASSERT_EQUALS(daughter_boxes[1]->mCornerIds[2], daughter_boxes[2]->mCornerIds[1]);
+        TS_ASSERT_EQUALS(daughter_boxes[1]->GetOwnCorners()[2], daughter_boxes[2]->GetOwnCorners()[1]);
+        TS_ASSERT_DELTA((*(daughter_boxes[1]->GetOwnCorners()[2]))[0], 0.5, 1e-12);
+        TS_ASSERT_DELTA((*(daughter_boxes[1]->GetOwnCorners()[2]))[1], 0.5, 1e-12);
+
+        // Corners are looked up exactly by where they are, but not fooled by rounding errors.
+        c_vector<double, 2u> nearly_middle;
+        nearly_middle[0] = 0.5 + 1e-15;
+        nearly_middle[1] = 0.5 - 1e-15;
+        TS_ASSERT_EQUALS(parent_box_2d.FindCornerId(nearly_middle), daughter_boxes[1]->mCornerIds[2]);
+        nearly_middle[0] = 0.5 + 1e-9;
+        TS_ASSERT_EQUALS(parent_box_2d.FindCornerId(nearly_middle), UNSIGNED_UNSET);
+
+        // Parent boxes leave their corners to their daughters.
+        TS_ASSERT_EQUALS(daughter_boxes[0]->GetOwnCorners().size(), 0u);
+        TS_ASSERT_EQUALS(daughter_boxes[0]->GetCorners().size(), 9u);
+    }
+
+    void TestRefinementQueuesMatchScanningTheTree()
+    {
+        const unsigned max_generation_differences[2] = { UNSIGNED_UNSET, 2u };
+        for (unsigned i = 0; i < 2u; i++)
+        {
+            ParameterBox<2> parent_box_2d(NULL);
+            AssignWavyData(parent_box_2d, parent_box_2d.GetCorners());
+
+            for (unsigned step = 0; step < 60u; step++)
+            {
+                ParameterBox<2>* p_scanned_box = FindBoxByScanningTree(parent_box_2d, 1e-3, max_generation_differences[i]);
+                ParameterBox<2>* p_box = parent_box_2d.FindBoxWithLargestQoIErrorEstimate(0u, 1e-3, max_generation_differences[i]);
+                TS_ASSERT_EQUALS(p_box, p_scanned_box);
+                if (!p_box)
+                {
+                    break;
+                }
+                AssignWavyData(parent_box_2d, p_box->SubDivide());
+            }
+            TS_ASSERT_EQUALS(parent_box_2d.GetWholeFamilyOfBoxes().size(), 1u + 4u * 60u);
+        }
+    }
+
+    void TestRefiningBoxesTogether2d()
+    {
+        ParameterBox<2> parent_box_2d(NULL);
+        std::vector<c_vector<double, 2u>*> corner_parameters = parent_box_2d.GetCornersAsVector();
+        AssignExponentialData(parent_box_2d, corner_parameters);
+
+        std::set<c_vector<double, 2u>*, c_vector_compare<2u> > new_points = parent_box_2d.SubDivide();
+        std::vector<c_vector<double, 2u>*> new_corners(new_points.begin(), new_points.end());
+        AssignExponentialData(parent_box_2d, new_corners);
+
+        // Asking for one box gives the same choice as usual.
+        ParameterBox<2>* p_best_box = parent_box_2d.FindBoxWithLargestQoIErrorEstimate(0u, DBL_MIN);
+        std::vector<ParameterBox<2>*> boxes = parent_box_2d.FindBoxesWithLargestQoIErrorEstimates(0u, DBL_MIN, 1u);
+        TS_ASSERT_EQUALS(boxes.size(), 1u);
+        TS_ASSERT_EQUALS(boxes[0], p_best_box);
+
+        // Asking for more gives all four daughters, still starting with the usual choice.
+        boxes = parent_box_2d.FindBoxesWithLargestQoIErrorEstimates(0u, DBL_MIN, 10u);
+        std::vector<ParameterBox<2>*> daughter_boxes = parent_box_2d.GetDaughterBoxes();
+        TS_ASSERT_EQUALS(boxes.size(), 4u);
+        TS_ASSERT_EQUALS(boxes[0], p_best_box);
+        for (unsigned i = 0; i < daughter_boxes.size(); i++)
+        {
+            TS_ASSERT(std::find(boxes.begin(), boxes.end(), daughter_boxes[i]) != boxes.end());
+        }
+
+        // Nothing is returned if everything meets the tolerance.
+        TS_ASSERT_EQUALS(parent_box_2d.FindBoxesWithLargestQoIErrorEstimates(0u, DBL_MAX, 10u).size(), 0u);
+        TS_ASSERT_THROWS_THIS(daughter_boxes[0]->FindBoxesWithLargestQoIErrorEstimates(0u, DBL_MIN, 10u),
+                              "Only the original parameter box should call this method.");
+
+        // Subdividing the neighbours together only makes each shared point once (a 5x5 grid).
+        std::set<c_vector<double, 2u>*, c_vector_compare<2u> > batch_of_points;
+        for (unsigned i = 0; i < boxes.size(); i++)
+        {
+            new_points = boxes[i]->SubDivide();
+            batch_of_points.insert(new_points.begin(), new_points.end());
+        }
+        TS_ASSERT_EQUALS(batch_of_points.size(), 16u);
+        TS_ASSERT_EQUALS(parent_box_2d.GetCorners().size(), 25u);
+
+        // Every new box has a prediction at every new corner, so gets an error estimate once evaluated.
+        new_corners = std::vector<c_vector<double, 2u>*>(batch_of_points.begin(), batch_of_points.end());
+        AssignExponentialData(parent_box_2d, new_corners);
+        boxes = parent_box_2d.FindBoxesWithLargestQoIErrorEstimates(0u, DBL_MIN, 100u);
+        TS_ASSERT_EQUALS(boxes.size(), 16u);
+    }
+    void TestRefiningAllQoIsTogether()
+    {
+        std::vector<double> tolerances;
+        tolerances.push_back(1e-2);
+        tolerances.push_back(5e-3);
+
+        ParameterBox<2> parent_box_2d(NULL);
+        AssignTwoQoIData(parent_box_2d, parent_box_2d.GetCorners());
+
+        // The original box always needs refining.
+        TS_ASSERT_EQUALS(parent_box_2d.FindBoxWithLargestNormalisedQoIErrorEstimate(tolerances), &parent_box_2d);
+
+        ParameterBox<2>* p_box = nullptr;
+        unsigned num_steps = 0u;
+        while ((p_box = parent_box_2d.FindBoxWithLargestNormalisedQoIErrorEstimate(tolerances)) && num_steps < 10000u)
+        {
+            // The box chosen most exceeds the tolerances, relative to each of them.
+            const double normalised_error = p_box->GetMaxNormalisedErrorInQoIEstimatesInThisBox(tolerances);
+            if (p_box != &parent_box_2d)
+            {
+                TS_ASSERT_LESS_THAN(1.0, normalised_error);
+            }
+            AssignTwoQoIData(parent_box_2d, p_box->SubDivide());
+            num_steps++;
+        }
+        TS_ASSERT(!p_box);
+        TS_ASSERT(parent_box_2d.FindBoxesWithLargestNormalisedQoIErrorEstimates(tolerances, 10u).empty());
+
+        // Every box left meets both tolerances in one pass.
+        std::vector<ParameterBox<2>*> boxes = parent_box_2d.GetWholeFamilyOfBoxes();
+        for (unsigned i = 0; i < boxes.size(); i++)
+        {
+            if (!boxes[i]->IsParent())
+            {
+                std::vector<double> errors = boxes[i]->GetMaxErrorsInPredictedQoIs();
+                TS_ASSERT_LESS_THAN_EQUALS(errors[0], tolerances[0]);
+                TS_ASSERT_LESS_THAN_EQUALS(errors[1], tolerances[1]);
+            }
+        }
+        const unsigned num_corners = parent_box_2d.GetCorners().size();
+
+        // Refining for one QoI after the other instead, as we used to.
+        ParameterBox<2> sequential_box(NULL);
+        AssignTwoQoIData(sequential_box, sequential_box.GetCorners());
+        for (unsigned q = 0; q < 2u; q++)
+        {
+            while ((p_box = sequential_box.FindBoxWithLargestQoIErrorEstimate(q, tolerances[q])))
+            {
+                AssignTwoQoIData(sequential_box, p_box->SubDivide());
+            }
+        }
+        std::cout << "Refining the QoIs together took " << num_corners << " points, one after the other took "
+                  << sequential_box.GetCorners().size() << " points.\n";
+
+        // A single QoI orders boxes exactly as before.
+        std::vector<double> one_tolerance(1u, 1e-3);
+        ParameterBox<2> single_box(NULL);
+        AssignTwoQoIData(single_box, single_box.GetCorners());
+        for (unsigned step = 0; step < 20u; step++)
+        {
+            ParameterBox<2>* p_usual_box = single_box.FindBoxWithLargestQoIErrorEstimate(0u, 1e-3);
+            TS_ASSERT_EQUALS(single_box.FindBoxWithLargestNormalisedQoIErrorEstimate(one_tolerance), p_usual_box);
+            AssignTwoQoIData(single_box, p_usual_box->SubDivide());
+        }
+
+        tolerances[1] = 0.0;
+        TS_ASSERT_THROWS_THIS(parent_box_2d.FindBoxWithLargestNormalisedQoIErrorEstimate(tolerances),
+                              "The tolerance for each quantity of interest must be positive.");
+        TS_ASSERT_THROWS_THIS(parent_box_2d.GetDaughterBoxes()[0]->FindBoxWithLargestNormalisedQoIErrorEstimate(one_tolerance),
+                              "Only the original parameter box should call this method.");
+    }
+
+    void TestAnisotropicSubdivision()
+    {
+        std::vector<double> tolerances(1u, 1e-3);
+
+        ParameterBox<2> parent_box_2d(NULL);
+        AssignFunctionData(parent_box_2d, parent_box_2d.GetCorners(), CurvedAlongX<2u>);
+
+        std::vector<unsigned> dimensions;
+        TS_ASSERT_THROWS_THIS(parent_box_2d.SubDivide(dimensions),
+                              "A box can only be subdivided along between 1 and 2 different dimensions, each less than 2.");
+        dimensions.push_back(2u);
+        TS_ASSERT_THROWS_THIS(parent_box_2d.SubDivide(dimensions),
+                              "A box can only be subdivided along between 1 and 2 different dimensions, each less than 2.");
+        dimensions[0] = 0u;
+        dimensions.push_back(0u);
+        TS_ASSERT_THROWS_THIS(parent_box_2d.SubDivide(dimensions),
+                              "A box can only be subdivided along between 1 and 2 different dimensions, each less than 2.");
+
+        // We don't know anything about the original box, so it is split along everything.
+        TS_ASSERT_EQUALS(parent_box_2d.GetDimensionsToRefine(tolerances).size(), 2u);
+        AssignFunctionData(parent_box_2d, parent_box_2d.SubDivide(), CurvedAlongX<2u>);
+
+        // The daughters know that the data curves along x, and not y.
+        ParameterBox<2>* p_box = parent_box_2d.GetDaughterBoxes()[0];
+        TS_ASSERT_EQUALS(p_box->mMaxErrorsInEachDimension.size(), 2u);
+        TS_ASSERT_DELTA(p_box->mMaxErrorsInEachDimension[0][0], 0.5 * (exp(0.0) + exp(2.0)) - exp(1.0), 1e-12);
+        TS_ASSERT_DELTA(p_box->mMaxErrorsInEachDimension[1][0], 0.0, 1e-12);
+        dimensions = p_box->GetDimensionsToRefine(tolerances);
+        TS_ASSERT_EQUALS(dimensions.size(), 1u);
+        TS_ASSERT_EQUALS(dimensions[0], 0u);
+
+        // Halving the box along x only needs two new points.
+        std::set<c_vector<double, 2u>*, c_vector_compare<2u> > new_points = p_box->SubDivide(dimensions);
+        TS_ASSERT_EQUALS(new_points.size(), 2u);
+        for (auto it = new_points.begin(); it != new_points.end(); ++it)
+        {
+            TS_ASSERT_DELTA((**it)[0], 0.25, 1e-12);
+        }
+        AssignFunctionData(parent_box_2d, new_points, CurvedAlongX<2u>);
+        TS_ASSERT_EQUALS(p_box->GetDaughterBoxes().size(), 2u);
+        TS_ASSERT_THROWS_THIS(p_box->SubDivide(dimensions), "Already subdivided this box.");
+
+        // The granddaughters measure the curvature along x again, and keep what we knew about y.
+        ParameterBox<2>* p_granddaughter = p_box->GetDaughterBoxes()[1];
+        TS_ASSERT_DELTA(p_granddaughter->mMin[0], 0.25, 1e-12);
+        TS_ASSERT_DELTA(p_granddaughter->mMax[0], 0.5, 1e-12);
+        TS_ASSERT_DELTA(p_granddaughter->mMin[1], 0.0, 1e-12);
+        TS_ASSERT_DELTA(p_granddaughter->mMax[1], 0.5, 1e-12);
+        TS_ASSERT_DELTA(p_granddaughter->mMaxErrorsInEachDimension[0][0], 0.5 * (exp(0.0) + exp(1.0)) - exp(0.5), 1e-12);
+        TS_ASSERT_DELTA(p_granddaughter->mMaxErrorsInEachDimension[1][0], 0.0, 1e-12);
+        TS_ASSERT_DELTA(parent_box_2d.InterpolateQoIsAt(p_granddaughter->mMin)[0], CurvedAlongX<2u>(p_granddaughter->mMin), 1e-12);
+
+        // Data that varies with x times y doesn't curve along either, so boxes are split along both.
+        ParameterBox<2> product_box(NULL);
+        AssignFunctionData(product_box, product_box.GetCorners(), ProductOfXAndY);
+        AssignFunctionData(product_box, product_box.SubDivide(), ProductOfXAndY);
+        TS_ASSERT_EQUALS(product_box.GetDaughterBoxes()[0]->GetDimensionsToRefine(tolerances).size(), 2u);
+
+        // Refining a 3D table of data that only curves along x.
+        tolerances[0] = 5e-2;
+        unsigned num_points[2];
+        for (unsigned anisotropic = 0; anisotropic < 2u; anisotropic++)
+        {
+            ParameterBox<3> parent_box_3d(NULL);
+            AssignFunctionData(parent_box_3d, parent_box_3d.GetCorners(), CurvedAlongX<3u>);
+            ParameterBox<3>* p_box_3d = nullptr;
+            while ((p_box_3d = parent_box_3d.FindBoxWithLargestQoIErrorEstimate(0u, tolerances[0])))
+            {
+                std::set<c_vector<double, 3u>*, c_vector_compare<3u> > points = anisotropic
+                    ? p_box_3d->SubDivide(p_box_3d->GetDimensionsToRefine(tolerances))
+                    : p_box_3d->SubDivide();
+                AssignFunctionData(parent_box_3d, points, CurvedAlongX<3u>);
+            }
+            num_points[anisotropic] = parent_box_3d.GetCorners().size();
+
+            // Either way the table is about as accurate as asked for.
+            double max_error = 0.0;
+            for (unsigned i = 0; i <= 20u; i++)
+            {
+                for (unsigned j = 0; j <= 4u; j++)
+                {
+                    c_vector<double, 3u> point;
+                    point[0] = i / 20.0;
+                    point[1] = j / 4.0;
+                    point[2] = 0.3;
+                    max_error = std::max(max_error, fabs(parent_box_3d.InterpolateQoIsAt(point)[0] - CurvedAlongX<3u>(point)));
+                }
+            }
+            TS_ASSERT_LESS_THAN(max_error, 2.0 * tolerances[0]);
+        }
+        std::cout << "Refining along every dimension took " << num_points[0] << " points, along the dimensions with most error took "
+                  << num_points[1] << " points.\n";
+        TS_ASSERT_LESS_THAN(4u * num_points[1], num_points[0]);
+    }
 };
 
 #endif // TESTPARAMETERBOX_HPP_
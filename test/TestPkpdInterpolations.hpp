@@ -90,6 +90,31 @@ public:
         NumericFileComparison comparison(pkpd_results_file, pkpd_reference_file);
         comparison.CompareFiles(1e-2);
     }
+
+    void TestPkpdSimulationsAtQuantiles()
+    {
+        CommandLineArgumentsMocker wrapper(
+            "--pkpd-file projects/ApPredict/test/data/pkpd_data.txt --model 2 --pic50-herg 6 "
+            "--pkpd-conc-quantiles 12 --adaptive-concs 0.2 --output-dir ApPredict_output_pkpd_quantiles");
+
+        ApPredictMethods pkpd_runner;
+        pkpd_runner.Run();
+
+        // Far fewer simulations than the ~100 used above...
+        std::vector<double> concs = pkpd_runner.GetConcentrations();
+        TS_ASSERT_LESS_THAN(concs.size(), 50u);
+        TS_ASSERT_DELTA(concs[0], 0.0, 1e-12);
+        TS_ASSERT_DELTA(concs.back(), 4.1515, 1e-4); // uM, the maximum in the file.
+
+        // ...but still close to the same interpolated APD90s.
+        FileFinder pkpd_results_file("ApPredict_output_pkpd_quantiles/pkpd_results.txt", RelativeTo::ChasteTestOutput);
+        TS_ASSERT_EQUALS(pkpd_results_file.IsFile(), true);
+
+        FileFinder pkpd_reference_file("projects/ApPredict/test/data/pkpd_results.txt", RelativeTo::ChasteSourceRoot);
+
+        NumericFileComparison comparison(pkpd_results_file, pkpd_reference_file);
+        comparison.CompareFiles(1.0);
+    }
 };
 
 #endif // TESTPKPDINTERPOLATIONS_HPP_
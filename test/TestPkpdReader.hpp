@@ -38,7 +38,14 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cxxtest/TestSuite.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include "OutputFileHandler.hpp"
 #include "PkpdDataStructure.hpp"
+#include "PkpdInterpolator.hpp"
 
 /**
  * A test that checks we are reading in concentration information correctly.
@@ -78,6 +85,38 @@ public:
         TS_ASSERT_DELTA(concs2.back(), 1.11562, 1e-9); // uM
 
         TS_ASSERT_DELTA(pkpd_data.GetMaximumConcentration(), 4.1515, 1e-4); // uM
+
+        // Concentrations placed according to the distribution of those in the file.
+        TS_ASSERT_THROWS_THIS(pkpd_data.GetConcentrationQuantiles(1u),
+                              "At least two concentrations are needed to cover the PKPD concentrations, not 1.");
+        std::vector<double> quantiles = pkpd_data.GetConcentrationQuantiles(11u);
+        TS_ASSERT_EQUALS(quantiles.size(), 11u);
+        TS_ASSERT_LESS_THAN(0.0, quantiles[0]);
+        TS_ASSERT_LESS_THAN_EQUALS(quantiles[0], concs[1]);
+        TS_ASSERT_DELTA(quantiles.back(), pkpd_data.GetMaximumConcentration(), 1e-12);
+        for (unsigned i = 1; i < quantiles.size(); i++)
+        {
+            TS_ASSERT_LESS_THAN(quantiles[i - 1], quantiles[i]);
+        }
+
+        // Half of the (non-zero) concentrations in the file are below the median.
+        unsigned num_below_median = 0u;
+        unsigned num_non_zero = 0u;
+        for (unsigned t = 0; t < times.size(); t++)
+        {
+            for (double conc : pkpd_data.GetConcentrationsAtTimeIndex(t))
+            {
+                if (conc > 0.0)
+                {
+                    num_non_zero++;
+                    if (conc < quantiles[5])
+                    {
+                        num_below_median++;
+                    }
+                }
+            }
+        }
+        TS_ASSERT_DELTA((double)(num_below_median) / (double)(num_non_zero), 0.5, 1e-2);
     }
 
     void TestPkPdDataReaderDos()
@@ -107,6 +146,192 @@ public:
 
         TS_ASSERT_EQUALS(pkpd_data.GetNumberOfPatients(), 4u);
     }
+
+    void TestPkpdInterpolator()
+    {
+        TS_ASSERT_THROWS_THIS(PkpdInterpolator(std::vector<double>(2u, 1.0), std::vector<double>(3u, 1.0)),
+                              "Need the same (non-zero) number of concentrations and values to interpolate, not 2 and 3.");
+
+        {
+            // The same cases as ApPredictMethods::DoLinearInterpolation() is tested on.
+            std::vector<double> x{ 0.0, 1.0, 2.0, 3.0 };
+            std::vector<double> y{ 1.0, 1.1, -0.1, 0.0 };
+            PkpdInterpolator interpolator(x, y);
+            TS_ASSERT_DELTA(interpolator.Interpolate(-0.1), 1.0, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(0.0), 1.0, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(1.0), 1.1, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(0.5), 1.05, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(1.5), 0.5, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(2.5), -0.05, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(3.0), 0.0, 1e-6);
+            TS_ASSERT_DELTA(interpolator.Interpolate(3.1), 0.0, 1e-6);
+        }
+
+        // Any number of concentrations (not just powers of two), and NaNs where simulations failed.
+        for (unsigned num_concs = 1u; num_concs <= 9u; num_concs++)
+        {
+            std::vector<double> x;
+            std::vector<double> y;
+            for (unsigned i = 0; i < num_concs; i++)
+            {
+                x.push_back(i * i * 0.1);
+                y.push_back(i == 5u ? std::numeric_limits<double>::quiet_NaN() : 300.0 + i);
+            }
+            PkpdInterpolator interpolator(x, y);
+
+            std::vector<double> concs;
+            for (double conc = -0.05; conc < 8.0; conc += 0.05)
+            {
+                concs.push_back(conc);
+            }
+            concs.insert(concs.end(), x.begin(), x.end()); // Hit every simulated concentration exactly too.
+            std::vector<double> results(concs.size());
+            interpolator.Interpolate(concs.data(), concs.size(), results.data());
+
+            for (unsigned i = 0; i < concs.size(); i++)
+            {
+                // Work it out the slow way.
+                double expected;
+                if (concs[i] <= x[0])
+                {
+                    expected = y[0];
+                }
+                else if (concs[i] >= x.back())
+                {
+                    expected = y.back();
+                }
+                else
+                {
+                    unsigned upper = std::lower_bound(x.begin(), x.end(), concs[i]) - x.begin();
+                    expected = y[upper - 1u] + ((concs[i] - x[upper - 1u]) / (x[upper] - x[upper - 1u])) * (y[upper] - y[upper - 1u]);
+                }
+
+                if (std::isnan(expected))
+                {
+                    TS_ASSERT(std::isnan(results[i]));
+                }
+                else
+                {
+                    TS_ASSERT_EQUALS(results[i], expected);
+                }
+            }
+        }
+    }
+
+    void TestStreamingPkpdInterpolation()
+    {
+        FileFinder pkpd_data_file("projects/ApPredict/test/data/pkpd_data.txt",
+                                  RelativeTo::ChasteSourceRoot);
+
+        // Without keeping the concentrations in memory we still know about the file.
+        PkpdDataStructure pkpd_summary(pkpd_data_file, false);
+        TS_ASSERT_EQUALS(pkpd_summary.GetTimes().size(), 749u);
+        TS_ASSERT_EQUALS(pkpd_summary.GetNumberOfPatients(), 57u);
+        TS_ASSERT_DELTA(pkpd_summary.GetMaximumConcentration(), 4.1515, 1e-4); // uM
+        TS_ASSERT_THROWS_THIS(pkpd_summary.GetConcentrationsForPatient(0u),
+                              "The concentrations in the PKPD file were not kept, see PkpdDataStructure constructor.");
+
+        // But can get them back in blocks, as they were read.
+        PkpdDataStructure pkpd_data(pkpd_data_file);
+        std::vector<double> block;
+        TS_ASSERT_EQUALS(pkpd_summary.GetConcentrationsAtTimeIndices(745u, 10u, block), 4u);
+        TS_ASSERT_EQUALS(block.size(), 4u * 57u);
+        for (unsigned t = 0; t < 4u; t++)
+        {
+            for (unsigned p = 0; p < 57u; p++)
+            {
+                TS_ASSERT_EQUALS(block[t * 57u + p], pkpd_data.GetConcentrationsAtTimeIndex(745u + t)[p]);
+            }
+        }
+        TS_ASSERT_EQUALS(pkpd_summary.GetConcentrationsAtTimeIndices(749u, 10u, block), 0u);
+        TS_ASSERT(block.empty());
+
+        std::vector<double> concs{ 0.0, 0.001, 0.1, 1.0, 4.2 };
+        std::vector<double> apd90s{ 300.0, 300.1, 310.0, 350.0, 420.0 };
+        PkpdInterpolator interpolator(concs, apd90s);
+
+        // The result is the same however it is split up, and whether or not the concentrations were kept.
+        std::vector<std::string> outputs;
+        for (unsigned num_threads = 1u; num_threads <= 3u; num_threads += 2u)
+        {
+            for (unsigned block_size = 7u; block_size <= 1000u; block_size += 993u)
+            {
+                std::stringstream output;
+                TS_ASSERT_EQUALS(interpolator.InterpolatePkpdData(pkpd_summary, output, num_threads, block_size), 749u);
+                outputs.push_back(output.str());
+            }
+        }
+        {
+            std::stringstream output;
+            TS_ASSERT_EQUALS(interpolator.InterpolatePkpdData(pkpd_data, output, 2u), 749u);
+            outputs.push_back(output.str());
+        }
+        for (unsigned i = 1; i < outputs.size(); i++)
+        {
+            TS_ASSERT_EQUALS(outputs[i], outputs[0]);
+        }
+
+        // And is what we'd get from interpolating the data one by one.
+        std::stringstream expected;
+        std::vector<std::string> times = pkpd_data.GetTimes();
+        for (unsigned t = 0; t < times.size(); t++)
+        {
+            expected << times[t];
+            for (double conc : pkpd_data.GetConcentrationsAtTimeIndex(t))
+            {
+                expected << "\t" << interpolator.Interpolate(conc);
+            }
+            expected << "\n";
+        }
+        TS_ASSERT_EQUALS(outputs[0], expected.str());
+    }
+
+    void TestStreamingPkpdLineHandling()
+    {
+        OutputFileHandler handler("TestStreamingPkpdLineHandling");
+        std::vector<double> concs{ 0.0, 1.0 };
+        std::vector<double> apd90s{ 300.0, 400.0 };
+        PkpdInterpolator interpolator(concs, apd90s);
+
+        // Files with LF, CRLF and CR-only line endings, CSV or not, or with no line ending at the end, all read the same.
+        const std::string expected = "0\t300\t300\n0.5\t310\t320\n1\t350\t400\n";
+        std::vector<std::string> contents{ "0\t0\t0\n0.5\t0.1\t0.2\n1\t0.5\t1\n",
+                                           "0\t0\t0\r\n0.5\t0.1\t0.2\r\n1\t0.5\t1\r\n",
+                                           "0,0,0\r0.5,0.1,0.2\r1,0.5,1\r",
+                                           "0 0 0\n0.5 0.1 0.2\n1 0.5 1" };
+        for (unsigned i = 0; i < contents.size(); i++)
+        {
+            std::stringstream file_name;
+            file_name << "line_endings_" << i << ".txt";
+            out_stream p_file = handler.OpenOutputFile(file_name.str(), std::ios::out | std::ios::binary);
+            *p_file << contents[i];
+            p_file->close();
+
+            for (unsigned keep = 0u; keep < 2u; keep++)
+            {
+                FileFinder pkpd_file = handler.FindFile(file_name.str());
+                PkpdDataStructure pkpd_data(pkpd_file, keep == 1u);
+                TS_ASSERT_EQUALS(pkpd_data.GetNumberOfPatients(), 2u);
+                std::stringstream output;
+                TS_ASSERT_EQUALS(interpolator.InterpolatePkpdData(pkpd_data, output, 2u, 2u), 3u);
+                TS_ASSERT_EQUALS(output.str(), expected);
+            }
+        }
+
+        // Blank lines part way through are an error, as they always were.
+        out_stream p_file = handler.OpenOutputFile("blank_line_pkpd.txt");
+        *p_file << "0\t0\t0\n\n1\t0.1\t0.2\n";
+        p_file->close();
+        FileFinder blank_line_file = handler.FindFile("blank_line_pkpd.txt");
+        TS_ASSERT_THROWS_THIS(PkpdDataStructure(blank_line_file, false), "No data found on line 2");
+
+        // And so are ragged files.
+        p_file = handler.OpenOutputFile("ragged_pkpd.txt");
+        *p_file << "0\t0\t0\n1\t0.1\t0.2\n2\t0.3\n";
+        p_file->close();
+        FileFinder ragged_file = handler.FindFile("ragged_pkpd.txt");
+        TS_ASSERT_THROWS_ANYTHING(PkpdDataStructure(ragged_file, false));
+    }
 };
 
 #endif // TESTPKPDREADER_HPP_
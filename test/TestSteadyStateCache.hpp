@@ -0,0 +1,169 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef _TESTSTEADYSTATECACHE_HPP_
+#define _TESTSTEADYSTATECACHE_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <string>
+#include <vector>
+
+#include "CommandLineArgumentsMocker.hpp"
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "SteadyStateCache.hpp"
+
+#ifdef CHASTE_CVODE
+#include "ApPredictMethods.hpp"
+#include "SetupModel.hpp"
+#include "SingleActionPotentialPrediction.hpp"
+#endif
+
+class TestSteadyStateCache : public CxxTest::TestSuite
+{
+public:
+    void TestSaveAndLoad(void)
+    {
+        OutputFileHandler handler("TestSteadyStateCache", true); // wipe it
+
+        // Hashes are stable and usable as file names.
+        TS_ASSERT_EQUALS(SteadyStateCache::Hash("model 1\n").size(), 16u);
+        TS_ASSERT_EQUALS(SteadyStateCache::Hash("model 1\n"), SteadyStateCache::Hash("model 1\n"));
+        TS_ASSERT_DIFFERS(SteadyStateCache::Hash("model 1\n"), SteadyStateCache::Hash("model 2\n"));
+        TS_ASSERT_EQUALS(SteadyStateCache::Hash(""), "cbf29ce484222325");
+
+        SteadyStateCache cache("TestSteadyStateCache");
+
+        SteadyStateResult result;
+        TS_ASSERT(!cache.Load("model 1\n", result));
+
+        result.mApd90 = 280.5;
+        result.mPeak = 32.1;
+        result.mMessages.push_back("A message");
+        result.mStateVariables = std::vector<double>(3u, -86.2);
+        cache.Save("model 1\n", result);
+
+        SteadyStateResult loaded;
+        TS_ASSERT(cache.Load("model 1\n", loaded));
+        TS_ASSERT_EQUALS(loaded.mErrorOccurred, false);
+        TS_ASSERT_EQUALS(loaded.mApd90, 280.5);
+        TS_ASSERT_EQUALS(loaded.mPeak, 32.1);
+        TS_ASSERT_EQUALS(loaded.mApd50, DOUBLE_UNSET);
+        TS_ASSERT_EQUALS(loaded.mMessages.size(), 1u);
+        TS_ASSERT_EQUALS(loaded.mMessages[0], "A message");
+        TS_ASSERT_EQUALS(loaded.mStateVariables.size(), 3u);
+        TS_ASSERT_EQUALS(loaded.mStateVariables[2], -86.2);
+
+        // A different simulation is a miss.
+        TS_ASSERT(!cache.Load("model 2\n", loaded));
+
+        // A corrupted file is a miss too.
+        {
+            std::ofstream file(handler.GetOutputDirectoryFullPath() + SteadyStateCache::Hash("model 2\n") + ".bin");
+            file << "Not an archive";
+        }
+        TS_ASSERT(!cache.Load("model 2\n", loaded));
+
+        // Only created from the command line when asked for.
+        {
+            CommandLineArgumentsMocker wrapper("--model 1");
+            TS_ASSERT(!SteadyStateCache::CreateFromCommandLine());
+        }
+        {
+            CommandLineArgumentsMocker wrapper("--steady-state-cache TestSteadyStateCache");
+            boost::shared_ptr<SteadyStateCache> p_cache = SteadyStateCache::CreateFromCommandLine();
+            TS_ASSERT(p_cache);
+            TS_ASSERT(p_cache->Load("model 1\n", loaded));
+        }
+    }
+
+#ifdef CHASTE_CVODE
+    void TestDescriptionsIncludeSolverSettings(void)
+    {
+        SetupModel setup(1.0, 1u);
+        boost::shared_ptr<AbstractCvodeCell> p_model = setup.GetModel();
+        SingleActionPotentialPrediction runner(p_model);
+        const std::string description = runner.GetSteadyStateDescription(p_model, 0.1);
+        TS_ASSERT_EQUALS(runner.GetSteadyStateDescription(p_model, 0.1), description);
+
+        // Results converged with other tolerances or time steps mustn't be re-used.
+        p_model->SetTolerances(1e-6, 1e-8);
+        const std::string loose_description = runner.GetSteadyStateDescription(p_model, 0.1);
+        TS_ASSERT_DIFFERS(loose_description, description);
+
+        p_model->SetMaxTimestep(0.5);
+        TS_ASSERT_DIFFERS(runner.GetSteadyStateDescription(p_model, 0.1), loose_description);
+    }
+
+    void TestApPredictUsesCache(void)
+    {
+        OutputFileHandler handler("TestSteadyStateCache_ApPredict", true); // wipe it
+
+        const std::string args = "--model 1 --pacing-freq 1 --plasma-concs 1 10 --pic50-herg 5.5 "
+                                 "--pacing-max-time 0.2 --steady-state-cache TestSteadyStateCache_ApPredict";
+
+        std::vector<double> first_apd90s;
+        {
+            CommandLineArgumentsMocker wrapper(args + " --output-dir ApPredict_output_cache_1");
+            ApPredictMethods methods;
+            methods.Run();
+            first_apd90s = methods.GetApd90s();
+        }
+
+        // A result was stored for control and each concentration.
+        FileFinder cache_folder("TestSteadyStateCache_ApPredict", RelativeTo::ChasteTestOutput);
+        std::vector<FileFinder> cached_files = cache_folder.FindMatches("*.bin");
+        TS_ASSERT_EQUALS(cached_files.size(), first_apd90s.size());
+
+        // The second time round everything comes from the cache.
+        {
+            CommandLineArgumentsMocker wrapper(args + " --output-dir ApPredict_output_cache_2");
+            ApPredictMethods methods;
+            methods.Run();
+            std::vector<double> apd90s = methods.GetApd90s();
+            TS_ASSERT_EQUALS(apd90s.size(), first_apd90s.size());
+            for (unsigned i = 0; i < apd90s.size(); i++)
+            {
+                TS_ASSERT_EQUALS(apd90s[i], first_apd90s[i]);
+            }
+        }
+        TS_ASSERT_EQUALS(cache_folder.FindMatches("*.bin").size(), cached_files.size());
+    }
+#endif // CHASTE_CVODE
+};
+
+#endif // _TESTSTEADYSTATECACHE_HPP_
@@ -0,0 +1,123 @@
+/*
+
+Copyright (c) 2005-2025, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _TESTWORKERPOOL_HPP_
+#define _TESTWORKERPOOL_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <atomic>
+#include <vector>
+
+#include "CommandLineArgumentsMocker.hpp"
+#include "Exception.hpp"
+#include "WorkerPool.hpp"
+
+class TestWorkerPool : public CxxTest::TestSuite
+{
+public:
+    void TestEveryTaskRunsOnce(void)
+    {
+        for (unsigned num_workers = 1u; num_workers <= 4u; num_workers++)
+        {
+            WorkerPool pool(num_workers);
+            TS_ASSERT_EQUALS(pool.GetNumWorkers(), num_workers);
+
+            const unsigned num_tasks = 100u;
+            std::vector<unsigned> results(num_tasks, 0u);
+            std::vector<unsigned> workers_used(num_tasks, UNSIGNED_UNSET);
+            pool.Run(num_tasks, [&](unsigned task_idx, unsigned worker_idx) {
+                results[task_idx] += task_idx * task_idx;
+                workers_used[task_idx] = worker_idx;
+            });
+
+            for (unsigned i = 0; i < num_tasks; i++)
+            {
+                TS_ASSERT_EQUALS(results[i], i * i);
+                TS_ASSERT_LESS_THAN(workers_used[i], num_workers);
+            }
+        }
+
+        // Zero workers means 'one per hardware thread'.
+        WorkerPool pool(0u);
+        TS_ASSERT_EQUALS(pool.GetNumWorkers(), WorkerPool::GetNumHardwareThreads());
+
+        // No tasks is fine.
+        pool.Run(0u, [&](unsigned task_idx, unsigned worker_idx) {
+            TS_FAIL("Should not be called.");
+        });
+    }
+
+    void TestExceptionsArePassedBack(void)
+    {
+        for (unsigned num_workers = 1u; num_workers <= 3u; num_workers++)
+        {
+            WorkerPool pool(num_workers);
+            std::atomic<unsigned> num_run(0u);
+            auto task = [&](unsigned task_idx, unsigned worker_idx) {
+                num_run++;
+                if (task_idx == 7u)
+                {
+                    EXCEPTION("Task seven went wrong.");
+                }
+            };
+            TS_ASSERT_THROWS_THIS(pool.Run(50u, task), "Task seven went wrong.");
+
+            if (num_workers == 1u)
+            {
+                // Tasks are run in order on this thread, so we stop straight away.
+                TS_ASSERT_EQUALS(num_run.load(), 8u);
+            }
+        }
+    }
+
+    void TestCommandLineOption(void)
+    {
+        {
+            CommandLineArgumentsMocker wrapper("--model 1");
+            TS_ASSERT_EQUALS(WorkerPool::GetNumThreadsFromCommandLine(), 1u);
+        }
+        {
+            CommandLineArgumentsMocker wrapper("--threads 3");
+            TS_ASSERT_EQUALS(WorkerPool::GetNumThreadsFromCommandLine(), 3u);
+        }
+        {
+            CommandLineArgumentsMocker wrapper("--threads 0");
+            TS_ASSERT_EQUALS(WorkerPool::GetNumThreadsFromCommandLine(), WorkerPool::GetNumHardwareThreads());
+        }
+    }
+};
+
+#endif // _TESTWORKERPOOL_HPP_